@@ -0,0 +1,127 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "accumulate.h"
+
+#if defined (__x86_64__)
+#include <immintrin.h>          /* _mm256_cvtepi32_epi64 ().  */
+#endif
+
+accumulate_add_fn accumulate_add = accumulate_add_scalar;
+accumulate_max_fn accumulate_max = accumulate_max_scalar;
+
+/* Add the memory fields of PROC into TOTALS, one field at a time.  */
+void
+accumulate_add_scalar (totals_t *totals, const stat_struct_t *proc)
+{
+  for (int i = 0; i < NB_FIELDS; i++) {
+    totals->fields[i] += proc->fields[i];
+  }
+}
+
+/* Raise each field of MAX to the value in TOTALS, one field at a
+   time.  */
+void
+accumulate_max_scalar (totals_t *max, const totals_t *totals)
+{
+  for (int i = 0; i < NB_FIELDS; i++) {
+    if (totals->fields[i] > max->fields[i]) {
+      max->fields[i] = totals->fields[i];
+    }
+  }
+}
+
+#if defined (__x86_64__)
+
+/* Add the memory fields of PROC into TOTALS, 4 fields at a time.
+   SSE2 has no sign extension instruction, so the high halves of the
+   64-bit lanes are built from the sign bits with an arithmetic
+   shift.  */
+void
+accumulate_add_sse2 (totals_t *totals, const stat_struct_t *proc)
+{
+  int i = 0;
+  for (; i + 4 <= NB_FIELDS; i += 4) {
+    __m128i values = _mm_loadu_si128 ((const __m128i *) (proc->fields + i));
+    __m128i signs = _mm_srai_epi32 (values, 31);
+    __m128i low = _mm_unpacklo_epi32 (values, signs);
+    __m128i high = _mm_unpackhi_epi32 (values, signs);
+    __m128i *dest = (__m128i *) (totals->fields + i);
+    _mm_storeu_si128 (dest, _mm_add_epi64 (_mm_loadu_si128 (dest), low));
+    _mm_storeu_si128 (dest + 1, _mm_add_epi64 (_mm_loadu_si128 (dest + 1), high));
+  }
+  for (; i < NB_FIELDS; i++) {
+    totals->fields[i] += proc->fields[i];
+  }
+}
+
+/* Add the memory fields of PROC into TOTALS, 4 fields at a time
+   with sign extension (vpmovsxdq).  */
+__attribute__ ((target ("avx2")))
+void
+accumulate_add_avx2 (totals_t *totals, const stat_struct_t *proc)
+{
+  int i = 0;
+  for (; i + 4 <= NB_FIELDS; i += 4) {
+    __m256i values = _mm256_cvtepi32_epi64 (_mm_loadu_si128 ((const __m128i *) (proc->fields + i)));
+    __m256i *dest = (__m256i *) (totals->fields + i);
+    _mm256_storeu_si256 (dest, _mm256_add_epi64 (_mm256_loadu_si256 (dest), values));
+  }
+  for (; i < NB_FIELDS; i++) {
+    totals->fields[i] += proc->fields[i];
+  }
+}
+
+/* Raise each field of MAX to the value in TOTALS, 4 fields at a time.
+   There is no 64-bit vpmaxsq before AVX-512, so this is a compare
+   (vpcmpgtq) and a blend.  */
+__attribute__ ((target ("avx2")))
+void
+accumulate_max_avx2 (totals_t *max, const totals_t *totals)
+{
+  int i = 0;
+  for (; i + 4 <= NB_FIELDS; i += 4) {
+    __m256i *dest = (__m256i *) (max->fields + i);
+    __m256i current = _mm256_loadu_si256 (dest);
+    __m256i candidate = _mm256_loadu_si256 ((const __m256i *) (totals->fields + i));
+    __m256i greater = _mm256_cmpgt_epi64 (candidate, current);
+    _mm256_storeu_si256 (dest, _mm256_blendv_epi8 (current, candidate, greater));
+  }
+  for (; i < NB_FIELDS; i++) {
+    if (totals->fields[i] > max->fields[i]) {
+      max->fields[i] = totals->fields[i];
+    }
+  }
+}
+
+#endif
+
+/* Select the best kernels for the running CPU.  */
+void
+accumulate_init (void)
+{
+#if defined (__x86_64__)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) {
+    accumulate_add = accumulate_add_avx2;
+    accumulate_max = accumulate_max_avx2;
+  } else {
+    accumulate_add = accumulate_add_sse2;
+    accumulate_max = accumulate_max_scalar;
+  }
+#endif
+}
@@ -0,0 +1,52 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "stat-struct.h"        /* stat_struct_t, totals_t.  */
+
+/* Kernel adding the memory fields of PROC into TOTALS.  */
+typedef void (*accumulate_add_fn) (totals_t *totals, const stat_struct_t *proc);
+
+/* Kernel raising each field of MAX to the value in TOTALS if the
+   latter is greater.  */
+typedef void (*accumulate_max_fn) (totals_t *max, const totals_t *totals);
+
+/* Kernels used by the queries.  They are the scalar ones until
+   accumulate_init () selects the best ones for the running CPU.  */
+extern accumulate_add_fn accumulate_add;
+extern accumulate_max_fn accumulate_max;
+
+/* Select the best kernels for the running CPU.  */
+void
+accumulate_init (void);
+
+/* Portable kernels.  */
+void
+accumulate_add_scalar (totals_t *totals, const stat_struct_t *proc);
+void
+accumulate_max_scalar (totals_t *max, const totals_t *totals);
+
+#if defined (__x86_64__)
+/* SSE2 is part of the x86-64 baseline, so this one needs no check.  */
+void
+accumulate_add_sse2 (totals_t *totals, const stat_struct_t *proc);
+
+/* Only call these when __builtin_cpu_supports ("avx2").  */
+void
+accumulate_add_avx2 (totals_t *totals, const stat_struct_t *proc);
+void
+accumulate_max_avx2 (totals_t *max, const totals_t *totals);
+#endif
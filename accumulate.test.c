@@ -0,0 +1,97 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "accumulate.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memcmp ().  */
+#include <limits.h>             /* INT_MAX.  */
+
+/* Number of processes summed by each test.  */
+#define NB_PROCS 1000
+
+/* Fill PROCS with pseudo-random values, including extreme ones.  */
+static void
+fill_procs (stat_struct_t *procs)
+{
+  unsigned int seed = 12345;
+  for (int p = 0; p < NB_PROCS; p++) {
+    procs[p].Pid = p + 1;
+    procs[p].PPid = 1;
+    for (int i = 0; i < NB_FIELDS; i++) {
+      seed = seed * 1103515245 + 12345;
+      procs[p].fields[i] = (int) seed;
+    }
+  }
+  procs[0].fields[0] = INT_MAX;
+  procs[1].fields[NB_FIELDS - 1] = INT_MIN;
+}
+
+/* Sum PROCS with ADD, taking the running max with MAX after each
+   process, and check the results against the scalar kernels.  */
+static int
+test_kernels (const char *name, accumulate_add_fn add, accumulate_max_fn max)
+{
+  static stat_struct_t procs[NB_PROCS];
+  fill_procs (procs);
+
+  totals_t expected_totals, expected_max, actual_totals, actual_max;
+  memset (&expected_totals, 0, sizeof expected_totals);
+  memset (&expected_max, 0, sizeof expected_max);
+  memset (&actual_totals, 0, sizeof actual_totals);
+  memset (&actual_max, 0, sizeof actual_max);
+
+  for (int p = 0; p < NB_PROCS; p++) {
+    accumulate_add_scalar (&expected_totals, procs + p);
+    accumulate_max_scalar (&expected_max, &expected_totals);
+    add (&actual_totals, procs + p);
+    max (&actual_max, &actual_totals);
+  }
+
+  int error = 0;
+  if (memcmp (&expected_totals, &actual_totals, sizeof expected_totals)) {
+    fprintf (stderr, "accumulate kernel %s: totals differ from the scalar kernel\n", name);
+    error = 1;
+  }
+  if (memcmp (&expected_max, &actual_max, sizeof expected_max)) {
+    fprintf (stderr, "accumulate kernel %s: max differs from the scalar kernel\n", name);
+    error = 1;
+  }
+  return error;
+}
+
+/* Run all tests on the accumulate.c file.  */
+void
+test_accumulate (void)
+{
+  int error = 0;
+
+#if defined (__x86_64__)
+  error += test_kernels ("sse2", accumulate_add_sse2, accumulate_max_scalar);
+  if (__builtin_cpu_supports ("avx2")) {
+    error += test_kernels ("avx2", accumulate_add_avx2, accumulate_max_avx2);
+  }
+#endif
+
+  accumulate_init ();
+  error += test_kernels ("selected", accumulate_add, accumulate_max);
+
+  if (error) {
+    exit (1);
+  }
+}
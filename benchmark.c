@@ -0,0 +1,384 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "bench.h"              /* BENCH_ROOT_PID.  */
+#include "lib.h"                /* get ().  */
+#include "history.h"            /* history_open ().  */
+#include "tree.h"               /* tree_totals ().  */
+#include "accumulate.h"         /* accumulate_init ().  */
+#include "parse-time.h"         /* format_time ().  */
+#include "get-all-pids.h"       /* get_all_pids ().  */
+#include "proc-root.h"          /* proc_root.  */
+#include "query.h"              /* query_get ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/resource.h>       /* struct rusage.  */
+#include <sys/wait.h>           /* wait4 ().  */
+#include <fcntl.h>              /* open ().  */
+#include <getopt.h>             /* getopt_long ().  */
+#include <limits.h>             /* INT_MAX.  */
+#include <stdio.h>              /* printf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strcmp ().  */
+#include <time.h>               /* clock_gettime ().  */
+#include <unistd.h>             /* fork ().  */
+
+/*
+ * Run benchmarks on the process-watcher.out of the current directory,
+ * e.g. one written by generate-history, and print the results as one
+ * JSON object per line.  Each benchmark is run several times and the
+ * fastest run is reported, since the slower ones are usually the ones
+ * that were disturbed.
+ *
+ * - "decode": walk all the snapshots and read all the processes.
+ * - "membership": compute the tree totals of PID in each snapshot,
+ *   i.e. decide which processes belong to the tree.
+ * - "get", "get_top": run "process-watcher get" (with "--top=5") over
+ *   the whole history in a child process, and report its maximum
+ *   resident size too.
+ * - "get_whole_map": the same as "get", with the whole history file
+ *   mapped at once instead of a sliding window.
+ * - "query_first", "query_again": query_get () over the whole history
+ *   on a new query_t, then again on the same one, which has the
+ *   history indexed and the totals of the tree cached.
+ * - "procfs", with --proc-root=DIR: list and read the processes of
+ *   DIR as the capture does for each sample, e.g. on a tree written
+ *   by "generate-history --procfs=DIR".
+ */
+
+/* Print the help message.  */
+static void
+usage (void) {
+  puts ("benchmark [OPTION...]\n"
+        " Run benchmarks on the process-watcher.out of the current\n"
+        " directory and print the results as JSON lines.\n"
+        "Options:\n"
+        "  --pid=PID   Top PID of the tree to query (default 1000).\n"
+        "  --runs=N    Number of runs of each benchmark (default 3).\n"
+        "  --proc-root=DIR\n"
+        "              Also benchmark reading the processes of the procfs\n"
+        "              tree DIR.\n"
+        "  -h, --help  Show this help.");
+}
+
+/* Return the time of a monotonic clock in seconds.  */
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Size and time span of the history.  */
+typedef struct {
+  size_t bytes;
+  long long snapshots;
+  long long processes;
+  time_t begin;
+  time_t end;
+} history_stats_t;
+
+/* Open the history and map it all.  Exit on error.  */
+static void
+open_history (history_t *history)
+{
+  if (history_open (history, history_filename) || history_update (history)) {
+    exit (1);
+  }
+}
+
+/* Walk all the snapshots of the history, store their statistics into
+   STATS and return the time it took.  */
+static double
+bench_decode (history_stats_t *stats)
+{
+  history_t history;
+  open_history (&history);
+  memset (stats, 0, sizeof *stats);
+
+  double start = now_seconds ();
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  /* Sum something from each process so that it is really read.  */
+  volatile long long checksum = 0;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    if (stats->snapshots == 0) {
+      stats->begin = snapshot.timestamp;
+    }
+    stats->end = snapshot.timestamp;
+    stats->snapshots++;
+    stats->processes += snapshot.nbpids;
+    for (int i = 0; i < snapshot.nbpids; i++) {
+      checksum += snapshot.procs[i].fields[NB_FIELDS - 1];
+    }
+  }
+  double seconds = now_seconds () - start;
+
+  stats->bytes = history.file_len;
+  history_close (&history);
+  return seconds;
+}
+
+/* Compute the totals of the tree rooted at PID in each snapshot, and
+   return the time it took.  */
+static double
+bench_membership (int pid)
+{
+  history_t history;
+  open_history (&history);
+  proc_id_t top = { .pid = pid };
+
+  double start = now_seconds ();
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    totals_t totals;
+    tree_totals (&snapshot, &top, &totals);
+  }
+  double seconds = now_seconds () - start;
+
+  history_close (&history);
+  return seconds;
+}
+
+/* Run "process-watcher get" with OPTIONS on the tree rooted at PID
+   between BEGIN and END, in a child process whose output is
+   discarded.  Store its maximum resident size in KiB into *MAX_RSS
+   and return the time it took.  */
+static double
+bench_get (const options_t *options, int pid, time_t begin, time_t end, long *max_rss)
+{
+  char pid_string[16];
+  char begin_string[15];
+  char end_string[15];
+  snprintf (pid_string, sizeof pid_string, "%d", pid);
+  format_time (begin, begin_string);
+  format_time (end, end_string);
+  fflush (stdout);
+
+  double start = now_seconds ();
+  pid_t child = fork ();
+  if (child < 0) {
+    perror ("could not fork");
+    exit (1);
+  }
+  if (child == 0) {
+    int null_fd = open ("/dev/null", O_WRONLY);
+    if (null_fd < 0 || dup2 (null_fd, STDOUT_FILENO) < 0) {
+      perror ("could not redirect the output");
+      _exit (1);
+    }
+    get (options, pid_string, begin_string, end_string);
+    fflush (stdout);
+    _exit (0);
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4 (child, &status, 0, &usage) != child) {
+    perror ("could not wait for the child");
+    exit (1);
+  }
+  double seconds = now_seconds () - start;
+  if (! WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+    fprintf (stderr, "get failed\n");
+    exit (1);
+  }
+  *max_rss = usage.ru_maxrss;
+  return seconds;
+}
+
+/* Query the tree rooted at PID between BEGIN and END twice on the
+   same query_t, and store the time each query took into SECONDS.  */
+static void
+bench_query (int pid, time_t begin, time_t end, double seconds[2])
+{
+  query_t *query = query_open (NULL);
+  if (query == NULL) {
+    exit (1);
+  }
+  proc_id_t top = { .pid = pid };
+  for (int i = 0; i < 2; i++) {
+    query_result_t result;
+    double start = now_seconds ();
+    if (query_get (query, &top, begin, end, &result)) {
+      exit (1);
+    }
+    seconds[i] = now_seconds () - start;
+  }
+  query_close (query);
+}
+
+/* List and read the processes of proc_root like a capture sample,
+   store their number into *NBPROCS and return the time it took.  */
+static double
+bench_procfs (int *nbprocs)
+{
+  static stat_struct_t *procs;
+  static char (*names)[NAME_SIZE];
+  static int capacity;
+
+  double start = now_seconds ();
+  pid_t *pids;
+  int nbpids;
+  get_all_pids (&pids, &nbpids);
+  if (nbpids > capacity) {
+    capacity = nbpids;
+    procs = xreallocarray (procs, capacity, sizeof (stat_struct_t));
+    names = xreallocarray (names, capacity, NAME_SIZE);
+  }
+  *nbprocs = read_processes (pids, nbpids, procs, names);
+  return now_seconds () - start;
+}
+
+/* Print the result of benchmark NAME, whose fastest run took SECONDS
+   over STATS.  */
+static void
+print_result (const char *name, int runs, double seconds, const history_stats_t *stats)
+{
+  printf ("{\"benchmark\": \"%s\", \"runs\": %d, \"seconds\": %.6f, "
+          "\"bytes\": %zu, \"snapshots\": %lld, \"processes\": %lld, "
+          "\"mb_per_s\": %.1f, \"snapshots_per_s\": %.1f, \"ns_per_process\": %.2f",
+          name, runs, seconds, stats->bytes, stats->snapshots, stats->processes,
+          stats->bytes / 1e6 / seconds, stats->snapshots / seconds,
+          stats->processes ? seconds * 1e9 / stats->processes : 0.0);
+}
+
+/* Values returned by getopt_long () for options without a short
+   form.  */
+enum {
+  OPT_PID = 256,
+  OPT_RUNS,
+  OPT_PROC_ROOT,
+};
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option long_opt[] = {
+    { "help", no_argument, NULL, 'h' },
+    { "pid", required_argument, NULL, OPT_PID },
+    { "runs", required_argument, NULL, OPT_RUNS },
+    { "proc-root", required_argument, NULL, OPT_PROC_ROOT },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int pid = BENCH_ROOT_PID;
+  int runs = 3;
+  int procfs = 0;
+
+  while (1) {
+    const int c = getopt_long (argc, argv, "h", long_opt, NULL);
+    if (c == -1)
+      break;
+    char *end;
+    long value;
+    switch (c) {
+    case 'h':
+      usage ();
+      return 0;
+    case OPT_PROC_ROOT:
+      proc_root = optarg;
+      procfs = 1;
+      break;
+    case OPT_PID:
+    case OPT_RUNS:
+      value = strtol (optarg, &end, 10);
+      if (end == optarg || *end != 0 || value < 1 || value > INT_MAX) {
+        fprintf (stderr, "invalid value %s\n", optarg);
+        return 1;
+      }
+      if (c == OPT_PID) {
+        pid = value;
+      } else {
+        runs = value;
+      }
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (optind < argc) {
+    fprintf (stderr, "too many arguments\n");
+    return 1;
+  }
+
+  accumulate_init ();
+
+  history_stats_t stats;
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    double seconds = bench_decode (&stats);
+    best = run == 0 || seconds < best ? seconds : best;
+  }
+  print_result ("decode", runs, best, &stats);
+  printf ("}\n");
+
+  for (int run = 0; run < runs; run++) {
+    double seconds = bench_membership (pid);
+    best = run == 0 || seconds < best ? seconds : best;
+  }
+  print_result ("membership", runs, best, &stats);
+  printf ("}\n");
+
+  options_t options = {
+    .shm_slots = 128,
+    .shm_procs = 4096,
+    .top_field = field_index ("VmRSS"),
+  };
+  static const char *const names[] = { "get", "get_top", "get_whole_map" };
+  for (int variant = 0; variant < 3; variant++) {
+    options.top = variant == 1 ? 5 : 0;
+    options.map_window = variant == 2 ? 0 : 64 << 20;
+    long max_rss = 0;
+    for (int run = 0; run < runs; run++) {
+      long run_max_rss;
+      double seconds = bench_get (&options, pid, stats.begin, stats.end, &run_max_rss);
+      best = run == 0 || seconds < best ? seconds : best;
+      max_rss = run_max_rss > max_rss ? run_max_rss : max_rss;
+    }
+    print_result (names[variant], runs, best, &stats);
+    printf (", \"max_rss_kb\": %ld}\n", max_rss);
+  }
+
+  double query_best[2];
+  for (int run = 0; run < runs; run++) {
+    double seconds[2];
+    bench_query (pid, stats.begin, stats.end, seconds);
+    for (int i = 0; i < 2; i++) {
+      query_best[i] = run == 0 || seconds[i] < query_best[i] ? seconds[i] : query_best[i];
+    }
+  }
+  print_result ("query_first", runs, query_best[0], &stats);
+  printf ("}\n");
+  print_result ("query_again", runs, query_best[1], &stats);
+  printf ("}\n");
+
+  if (procfs) {
+    int nbprocs = 0;
+    for (int run = 0; run < runs; run++) {
+      double seconds = bench_procfs (&nbprocs);
+      best = run == 0 || seconds < best ? seconds : best;
+    }
+    printf ("{\"benchmark\": \"procfs\", \"runs\": %d, \"seconds\": %.6f, \"processes\": %d, "
+            "\"processes_per_s\": %.1f, \"us_per_process\": %.3f}\n",
+            runs, best, nbprocs, nbprocs / best, nbprocs ? best * 1e6 / nbprocs : 0.0);
+  }
+
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+/* Enable GNU extensions such as qsort_r ().  */
+#define _GNU_SOURCE
+
+#include "breakdown.h"
+
+#include "comm.h"               /* comm_lookup ().  */
+#include "names.h"              /* names_open ().  */
+#include "parse-time.h"         /* format_time ().  */
+#include "schema.h"             /* field_names.  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <stdlib.h>             /* qsort_r ().  */
+#include <string.h>             /* memset ().  */
+
+/* Start tracking the subtree totals of FIELD.  */
+void
+breakdown_init (breakdown_t *breakdown, int field)
+{
+  memset (breakdown, 0, sizeof *breakdown);
+  breakdown->field = field;
+}
+
+/* Forget the processes seen so far.  */
+void
+breakdown_reset (breakdown_t *breakdown)
+{
+  breakdown->nbnodes = 0;
+  if (breakdown->slots != NULL) {
+    memset (breakdown->slots, 0, breakdown->nbslots * sizeof (int));
+  }
+}
+
+/* Return the slot of PID and START_TIME in a table of MASK + 1
+   slots.  */
+static size_t
+hash_slot (int pid, unsigned int start_time, size_t mask)
+{
+  return (((unsigned int) pid * 2654435761u) ^ (start_time * 40503u)) & mask;
+}
+
+/* Insert node INDEX into the hash table.  */
+static void
+insert_node (breakdown_t *breakdown, int index)
+{
+  const breakdown_node_t *node = breakdown->nodes + index;
+  size_t mask = breakdown->nbslots - 1;
+  size_t slot = hash_slot (node->pid, node->start_time, mask);
+  while (breakdown->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  breakdown->slots[slot] = index + 1;
+}
+
+/* Return the index of the node of PROC, adding it below node PARENT if
+   it is new.  */
+static int
+find_node (breakdown_t *breakdown, const stat_struct_t *proc, int parent)
+{
+  if (breakdown->nbslots > 0) {
+    size_t mask = breakdown->nbslots - 1;
+    size_t slot = hash_slot (proc->Pid, proc->StartTime, mask);
+    while (breakdown->slots[slot] != 0) {
+      int index = breakdown->slots[slot] - 1;
+      if (breakdown->nodes[index].pid == proc->Pid && breakdown->nodes[index].start_time == proc->StartTime) {
+        return index;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  if (breakdown->nbnodes == breakdown->capacity) {
+    breakdown->capacity = breakdown->capacity == 0 ? 256 : 2 * breakdown->capacity;
+    breakdown->nodes = xreallocarray (breakdown->nodes, breakdown->capacity, sizeof (breakdown_node_t));
+  }
+  int index = breakdown->nbnodes++;
+  breakdown_node_t *node = breakdown->nodes + index;
+  memset (node, 0, sizeof *node);
+  node->pid = proc->Pid;
+  node->start_time = proc->StartTime;
+  node->parent = parent;
+  node->peak = -1;
+
+  /* Keep the table at most half full.  */
+  if (2 * (size_t) breakdown->nbnodes > breakdown->nbslots) {
+    breakdown->nbslots = breakdown->nbslots == 0 ? 1024 : 2 * breakdown->nbslots;
+    free (breakdown->slots);
+    breakdown->slots = xreallocarray (NULL, breakdown->nbslots, sizeof (int));
+    memset (breakdown->slots, 0, breakdown->nbslots * sizeof (int));
+    for (int i = 0; i < index; i++) {
+      insert_node (breakdown, i);
+    }
+  }
+  insert_node (breakdown, index);
+  return index;
+}
+
+/* Return the slot of PID in the table of the PIDs of the members.  */
+static size_t
+pid_slot (int pid, size_t mask)
+{
+  return ((unsigned int) pid * 2654435761u) & mask;
+}
+
+/* Take into account the members of the tree in a snapshot.  */
+void
+breakdown_add (breakdown_t *breakdown, time_t timestamp, stat_struct_t *const *members, int nbmembers)
+{
+  if (nbmembers > breakdown->work_capacity) {
+    breakdown->work_capacity = nbmembers;
+    breakdown->parents = xreallocarray (breakdown->parents, nbmembers, sizeof (int));
+    breakdown->order = xreallocarray (breakdown->order, nbmembers, sizeof (int));
+    breakdown->child_counts = xreallocarray (breakdown->child_counts, nbmembers, sizeof (int));
+    breakdown->children = xreallocarray (breakdown->children, nbmembers, sizeof (int));
+    breakdown->node_of = xreallocarray (breakdown->node_of, nbmembers, sizeof (int));
+    breakdown->sums = xreallocarray (breakdown->sums, nbmembers, sizeof (long long));
+  }
+  while (breakdown->nbpid_slots < 2 * (size_t) nbmembers) {
+    breakdown->nbpid_slots = breakdown->nbpid_slots == 0 ? 1024 : 2 * breakdown->nbpid_slots;
+    free (breakdown->pid_slots);
+    breakdown->pid_slots = xreallocarray (NULL, breakdown->nbpid_slots, sizeof (int));
+  }
+
+  /* Index of the parent of each member, -1 for the top.  */
+  size_t mask = breakdown->nbpid_slots - 1;
+  int *pid_slots = breakdown->pid_slots;
+  memset (pid_slots, 0, breakdown->nbpid_slots * sizeof (int));
+  for (int i = 0; i < nbmembers; i++) {
+    size_t slot = pid_slot (members[i]->Pid, mask);
+    while (pid_slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    pid_slots[slot] = i + 1;
+  }
+  int *parents = breakdown->parents;
+  int *child_counts = breakdown->child_counts;
+  for (int i = 0; i < nbmembers; i++) {
+    parents[i] = -1;
+    child_counts[i] = 0;
+    size_t slot = pid_slot (members[i]->PPid, mask);
+    while (pid_slots[slot] != 0) {
+      int candidate = pid_slots[slot] - 1;
+      if (members[candidate]->Pid == members[i]->PPid) {
+        parents[i] = candidate == i ? -1 : candidate;
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  /* Children of each member, the ones of member I ending at
+     CHILD_COUNTS[I] and starting where those of member I - 1 end.  */
+  for (int i = 0; i < nbmembers; i++) {
+    if (parents[i] >= 0) {
+      child_counts[parents[i]]++;
+    }
+  }
+  int total = 0;
+  for (int i = 0; i < nbmembers; i++) {
+    int count = child_counts[i];
+    child_counts[i] = total;
+    total += count;
+  }
+  for (int i = 0; i < nbmembers; i++) {
+    if (parents[i] >= 0) {
+      breakdown->children[child_counts[parents[i]]++] = i;
+    }
+  }
+
+  /* Members from the top down, each after its parent, with their
+     nodes.  */
+  int *order = breakdown->order;
+  int nborder = 0;
+  for (int i = 0; i < nbmembers; i++) {
+    if (parents[i] < 0) {
+      order[nborder++] = i;
+    }
+  }
+  for (int k = 0; k < nborder; k++) {
+    int i = order[k];
+    int parent = parents[i];
+    breakdown->node_of[i] = find_node (breakdown, members[i], parent >= 0 ? breakdown->node_of[parent] : -1);
+    for (int c = i == 0 ? 0 : child_counts[i - 1]; c < child_counts[i]; c++) {
+      order[nborder++] = breakdown->children[c];
+    }
+  }
+
+  /* Subtree sums from the leaves up: each member comes after its
+     children.  */
+  long long *sums = breakdown->sums;
+  for (int k = 0; k < nborder; k++) {
+    sums[order[k]] = members[order[k]]->fields[breakdown->field];
+  }
+  for (int k = nborder - 1; k >= 0; k--) {
+    int i = order[k];
+    if (parents[i] >= 0) {
+      sums[parents[i]] += sums[i];
+    }
+    breakdown_node_t *node = breakdown->nodes + breakdown->node_of[i];
+    if (sums[i] > node->peak) {
+      node->peak = sums[i];
+      node->peak_time = timestamp;
+      node->name_id = members[i]->NameId;
+    }
+  }
+}
+
+/* What breakdown_print () needs to print a node.  */
+struct print_context {
+  const breakdown_t *breakdown;
+  FILE *output;
+  long long threshold;
+  /* Children of each node, the ones of node I from STARTS[I] to
+     STARTS[I + 1].  */
+  int *starts;
+  int *children;
+  /* Name dictionary, if any.  */
+  names_t names;
+  int has_names;
+};
+
+/* Compare the peaks of the nodes of indexes A and B, the largest
+   first, for qsort_r ().  */
+static int
+compare_peaks (const void *a, const void *b, void *data)
+{
+  const breakdown_node_t *nodes = data;
+  long long peak_a = nodes[*(const int *) a].peak;
+  long long peak_b = nodes[*(const int *) b].peak;
+  return (peak_a < peak_b) - (peak_a > peak_b);
+}
+
+/* Print node INDEX at DEPTH, then its children.  */
+static void
+print_node (const struct print_context *context, int index, int depth)
+{
+  const breakdown_node_t *node = context->breakdown->nodes + index;
+  if (node->peak < context->threshold) {
+    return;
+  }
+
+  char name[NAME_SIZE];
+  if (! context->has_names || names_lookup (&context->names, node->name_id, name)) {
+    comm_lookup (1, &node->peak_time, &node->pid, &name);
+  }
+  char time_string[15];
+  format_time (node->peak_time, time_string);
+  fprintf (context->output, " %20lld  %s  %*spid %d  %s\n", node->peak, time_string, 2 * depth, "", node->pid, name);
+
+  for (int c = context->starts[index]; c < context->starts[index + 1]; c++) {
+    print_node (context, context->children[c], depth + 1);
+  }
+}
+
+/* Print the tree of the nodes above PERCENT % of the top.  */
+void
+breakdown_print (const breakdown_t *breakdown, int percent, FILE *output)
+{
+  if (breakdown->nbnodes == 0) {
+    return;
+  }
+  int nbnodes = breakdown->nbnodes;
+  struct print_context context = {
+    .breakdown = breakdown,
+    .output = output,
+    .threshold = breakdown->nodes[0].peak * percent / 100,
+  };
+
+  /* Children of each node, the largest peak first.  */
+  context.starts = xreallocarray (NULL, nbnodes + 1, sizeof (int));
+  context.children = xreallocarray (NULL, nbnodes, sizeof (int));
+  memset (context.starts, 0, (nbnodes + 1) * sizeof (int));
+  for (int i = 0; i < nbnodes; i++) {
+    if (breakdown->nodes[i].parent >= 0) {
+      context.starts[breakdown->nodes[i].parent + 1]++;
+    }
+  }
+  for (int i = 0; i < nbnodes; i++) {
+    context.starts[i + 1] += context.starts[i];
+  }
+  int *ends = xreallocarray (NULL, nbnodes, sizeof (int));
+  memcpy (ends, context.starts, nbnodes * sizeof (int));
+  for (int i = 0; i < nbnodes; i++) {
+    if (breakdown->nodes[i].parent >= 0) {
+      context.children[ends[breakdown->nodes[i].parent]++] = i;
+    }
+  }
+  free (ends);
+  for (int i = 0; i < nbnodes; i++) {
+    qsort_r (context.children + context.starts[i], context.starts[i + 1] - context.starts[i], sizeof (int), compare_peaks, breakdown->nodes);
+  }
+
+  context.has_names = ! names_open (&context.names, names_filename);
+  fprintf (output, "Peaks of %s of the subtrees above %d%% of the tree:\n", field_names[breakdown->field], percent);
+  for (int i = 0; i < nbnodes; i++) {
+    if (breakdown->nodes[i].parent < 0) {
+      print_node (&context, i, 0);
+    }
+  }
+  if (context.has_names) {
+    names_close (&context.names);
+  }
+  free (context.starts);
+  free (context.children);
+}
+
+/* Free BREAKDOWN.  */
+void
+breakdown_free (breakdown_t *breakdown)
+{
+  free (breakdown->nodes);
+  free (breakdown->slots);
+  free (breakdown->parents);
+  free (breakdown->order);
+  free (breakdown->child_counts);
+  free (breakdown->children);
+  free (breakdown->node_of);
+  free (breakdown->sums);
+  free (breakdown->pid_slots);
+}
@@ -0,0 +1,93 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#ifndef BREAKDOWN_H
+#define BREAKDOWN_H
+
+#include "stat-struct.h"        /* stat_struct_t.  */
+
+#include <stdio.h>              /* FILE.  */
+#include <stddef.h>             /* size_t.  */
+#include <time.h>               /* time_t.  */
+
+/* A process seen in a tree, with the envelope of its subtree.  */
+typedef struct {
+  int pid;
+  unsigned int start_time;
+  /* Index of the node of its parent when it was first seen, -1 for the
+     top of the tree.  */
+  int parent;
+  /* Peak of the field summed over its subtree, the time of that peak,
+     and the NameId of the process then.  */
+  long long peak;
+  time_t peak_time;
+  int name_id;
+} breakdown_node_t;
+
+/* Envelopes of every subtree of a tree over a time window.  */
+typedef struct {
+  /* Index of the field whose subtree totals are tracked.  */
+  int field;
+  /* Processes seen in the tree so far.  */
+  breakdown_node_t *nodes;
+  int nbnodes;
+  int capacity;
+  /* Open addressing hash table of the nodes by PID and start time,
+     holding their index plus 1, 0 for an empty slot.  Its size is a
+     power of 2.  */
+  int *slots;
+  size_t nbslots;
+  /* Work arrays with room for one entry per member of the tree in a
+     snapshot, and the table of their PIDs.  */
+  int *parents;
+  int *order;
+  int *child_counts;
+  int *children;
+  int *node_of;
+  long long *sums;
+  int work_capacity;
+  int *pid_slots;
+  size_t nbpid_slots;
+} breakdown_t;
+
+/* Start tracking into BREAKDOWN the subtree totals of FIELD.  */
+void
+breakdown_init (breakdown_t *breakdown, int field);
+
+/* Forget the processes seen so far.  */
+void
+breakdown_reset (breakdown_t *breakdown);
+
+/* Take into account the NBMEMBERS processes MEMBERS of the tree, in
+   ascending PID order, in the snapshot taken at TIMESTAMP: sum the
+   field over each of their subtrees, from the leaves up, and raise the
+   peaks of their nodes.  The cost is linear in NBMEMBERS.  */
+void
+breakdown_add (breakdown_t *breakdown, time_t timestamp, stat_struct_t *const *members, int nbmembers);
+
+/* Print into OUTPUT the tree of the nodes whose peak is at least
+   PERCENT % of the peak of the top, the largest children first, with
+   their PIDs and names.  */
+void
+breakdown_print (const breakdown_t *breakdown, int percent, FILE *output);
+
+/* Free BREAKDOWN.  */
+void
+breakdown_free (breakdown_t *breakdown);
+
+#endif /* BREAKDOWN_H */
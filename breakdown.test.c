@@ -0,0 +1,120 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+/* Enable GNU extensions such as open_memstream ().  */
+#define _GNU_SOURCE
+
+#include "breakdown.test.h"
+
+#include "breakdown.h"
+#include "schema.h"             /* field_index ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Add the NBPROCS processes PROCS, in ascending PID order, to
+   BREAKDOWN.  */
+static void
+add_snapshot (breakdown_t *breakdown, time_t timestamp, stat_struct_t *procs, int nbprocs)
+{
+  stat_struct_t *members[nbprocs];
+  for (int i = 0; i < nbprocs; i++) {
+    members[i] = procs + i;
+  }
+  breakdown_add (breakdown, timestamp, members, nbprocs);
+}
+
+/* Check the peaks of the subtrees of 1 -> 2 -> 4 and 1 -> 3 over two
+   snapshots, where 4 exits and 3 grows, and the pruned tree.  */
+void
+test_breakdown (void)
+{
+  int error = 0;
+  breakdown_t breakdown;
+  breakdown_init (&breakdown, field_index ("VmRSS"));
+
+  stat_struct_t procs[4];
+  memset (procs, 0, sizeof procs);
+  static const int pids[4][3] = { { 1, 0, 1 }, { 2, 1, 10 }, { 3, 1, 5 }, { 4, 2, 100 } };
+  for (int i = 0; i < 4; i++) {
+    procs[i].Pid = pids[i][0];
+    procs[i].PPid = pids[i][1];
+    procs[i].VmRSS = pids[i][2];
+    procs[i].StartTime = 1000 + i;
+  }
+  add_snapshot (&breakdown, 100, procs, 4);
+  procs[2].VmRSS = 50;
+  add_snapshot (&breakdown, 102, procs, 3);
+
+  static const long long peaks[4] = { 116, 110, 50, 100 };
+  static const time_t peak_times[4] = { 100, 100, 102, 100 };
+  static const int parents[4] = { -1, 0, 0, 1 };
+  if (breakdown.nbnodes != 4) {
+    fprintf (stderr, "breakdown_add () made %d nodes\n", breakdown.nbnodes);
+    exit (1);
+  }
+  for (int i = 0; i < 4; i++) {
+    const breakdown_node_t *node = breakdown.nodes + i;
+    int expected = node->pid - 1;
+    if (node->peak != peaks[expected] || node->peak_time != peak_times[expected]
+        || (node->parent == -1 ? -1 : breakdown.nodes[node->parent].pid - 1) != parents[expected]) {
+      fprintf (stderr, "breakdown_add () gave pid %d a peak of %lld at %ld\n", node->pid, node->peak, (long) node->peak_time);
+      error = 1;
+    }
+  }
+
+  /* 3 is printed after 2, whose peak is larger, and 4 after 2, below
+     which it is.  Above 90 %, only 1 and 2 remain.  */
+  static const char *const outputs[2] = {
+    "Peaks of VmRSS of the subtrees above 40% of the tree:\n"
+    "                  116  19700101000140  pid 1  ?\n"
+    "                  110  19700101000140    pid 2  ?\n"
+    "                  100  19700101000140      pid 4  ?\n"
+    "                   50  19700101000142    pid 3  ?\n",
+    "Peaks of VmRSS of the subtrees above 90% of the tree:\n"
+    "                  116  19700101000140  pid 1  ?\n"
+    "                  110  19700101000140    pid 2  ?\n",
+  };
+  static const int percents[2] = { 40, 90 };
+  for (int i = 0; i < 2; i++) {
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *output = open_memstream (&text, &text_size);
+    breakdown_print (&breakdown, percents[i], output);
+    fclose (output);
+    if (strcmp (text, outputs[i])) {
+      fprintf (stderr, "breakdown_print () printed:\n%s", text);
+      error = 1;
+    }
+    free (text);
+  }
+
+  /* After a reset, the nodes are new.  */
+  breakdown_reset (&breakdown);
+  add_snapshot (&breakdown, 104, procs, 1);
+  if (breakdown.nbnodes != 1 || breakdown.nodes[0].peak != 1) {
+    fprintf (stderr, "breakdown_reset () kept the nodes\n");
+    error = 1;
+  }
+  breakdown_free (&breakdown);
+
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,153 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "capture-stats.h"
+
+#include <sys/resource.h>       /* getrusage ().  */
+#include <stdlib.h>             /* malloc ().  */
+#include <string.h>             /* strlen ().  */
+#include <stdio.h>              /* rename ().  */
+#include <time.h>               /* clock_gettime ().  */
+
+/*
+ * OUTPUT FORMAT
+ *
+ * One "name value" pair per line, e.g.:
+ *
+ * samples 1800
+ * processes_read 3254011
+ * ...
+ * cpu_user_seconds 12.034
+ * cpu_system_seconds 41.270
+ * status.count 1800
+ * status.sum_ns 49201556311
+ * status.max_ns 101532207
+ * status.bucket.24 1713
+ * status.bucket.25 87
+ *
+ * "PHASE.bucket.B" is the number of durations of PHASE between 2^B
+ * and 2^(B+1) - 1 nanoseconds; the empty buckets are omitted.
+ */
+
+/* Names of the phases in the output.  */
+const char *const phase_names[NB_PHASES] = {
+  [PHASE_PIDS] = "pids",
+  [PHASE_STATUS] = "status",
+  [PHASE_SMAPS] = "smaps",
+  [PHASE_IO] = "io",
+  [PHASE_REGISTRY] = "registry",
+  [PHASE_LOCK] = "lock",
+  [PHASE_WRITE] = "write",
+  [PHASE_SIDE_FILES] = "side_files",
+  [PHASE_CGROUPS] = "cgroups",
+  [PHASE_RING] = "ring",
+  [PHASE_SAMPLE] = "sample",
+};
+
+/* Return the time of CLOCK_MONOTONIC in nanoseconds.  */
+long long
+stats_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Return the histogram bucket of a duration of NS nanoseconds.  */
+int
+stats_bucket (long long ns)
+{
+  if (ns <= 1) {
+    return 0;
+  }
+  int bucket = 63 - __builtin_clzll ((unsigned long long) ns);
+  return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+/* Account a duration of NS nanoseconds to PHASE in STATS.  */
+void
+stats_record (capture_stats_t *stats, int phase, long long ns)
+{
+  phase_stats_t *phase_stats = stats->phases + phase;
+  phase_stats->count++;
+  phase_stats->sum_ns += ns;
+  if (ns > phase_stats->max_ns) {
+    phase_stats->max_ns = ns;
+  }
+  phase_stats->buckets[stats_bucket (ns)]++;
+}
+
+/* Print STATS and the CPU time of the capture into OUTPUT.  */
+void
+stats_print (const capture_stats_t *stats, FILE *output)
+{
+  fprintf (output, "samples %lld\n", stats->samples);
+  fprintf (output, "processes_read %lld\n", stats->processes_read);
+  fprintf (output, "processes_vanished %lld\n", stats->processes_vanished);
+  fprintf (output, "smaps_read %lld\n", stats->smaps_read);
+  fprintf (output, "smaps_estimated %lld\n", stats->smaps_estimated);
+  fprintf (output, "bytes_written %lld\n", stats->bytes_written);
+  fprintf (output, "overruns %lld\n", stats->overruns);
+
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0) {
+    fprintf (output, "cpu_user_seconds %ld.%03ld\n", (long) usage.ru_utime.tv_sec, (long) usage.ru_utime.tv_usec / 1000);
+    fprintf (output, "cpu_system_seconds %ld.%03ld\n", (long) usage.ru_stime.tv_sec, (long) usage.ru_stime.tv_usec / 1000);
+    fprintf (output, "max_rss_kb %ld\n", usage.ru_maxrss);
+  }
+
+  for (int phase = 0; phase < NB_PHASES; phase++) {
+    const phase_stats_t *phase_stats = stats->phases + phase;
+    fprintf (output, "%s.count %lld\n", phase_names[phase], phase_stats->count);
+    fprintf (output, "%s.sum_ns %lld\n", phase_names[phase], phase_stats->sum_ns);
+    fprintf (output, "%s.max_ns %lld\n", phase_names[phase], phase_stats->max_ns);
+    for (int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+      if (phase_stats->buckets[bucket] != 0) {
+        fprintf (output, "%s.bucket.%d %lld\n", phase_names[phase], bucket, phase_stats->buckets[bucket]);
+      }
+    }
+  }
+}
+
+/* Replace FILENAME with the output of stats_print () atomically.  */
+int
+stats_write_file (const capture_stats_t *stats, const char *filename)
+{
+  size_t filename_len = strlen (filename);
+  char temporary[filename_len + 5];
+  memcpy (temporary, filename, filename_len);
+  memcpy (temporary + filename_len, ".tmp", 5);
+
+  FILE *output = fopen (temporary, "w");
+  if (output == NULL) {
+    fprintf (stderr, "could not open %s for writing: ", temporary);
+    perror ("");
+    return 1;
+  }
+  stats_print (stats, output);
+  if (fclose (output)) {
+    fprintf (stderr, "could not write %s: ", temporary);
+    perror ("");
+    return 1;
+  }
+  if (rename (temporary, filename)) {
+    fprintf (stderr, "could not rename %s to %s: ", temporary, filename);
+    perror ("");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef CAPTURE_STATS_H
+#define CAPTURE_STATS_H
+
+#include <stdio.h>              /* FILE.  */
+
+/* Phases of a capture sample that are timed.  */
+enum {
+  /* get_all_pids ().  */
+  PHASE_PIDS,
+  /* Reading /proc/PID/status and /proc/PID/stat of all processes.  */
+  PHASE_STATUS,
+  /* Reading /proc/PID/smaps_rollup with capture --smaps.  */
+  PHASE_SMAPS,
+  /* Reading /proc/PID/io with capture --io.  */
+  PHASE_IO,
+  /* registry_poll () and registry_update ().  */
+  PHASE_REGISTRY,
+  /* Waiting for the write lock on the history.  */
+  PHASE_LOCK,
+  /* Writing and flushing the snapshot to the history.  */
+  PHASE_WRITE,
+  /* Writing the rollup, comm and index side files.  */
+  PHASE_SIDE_FILES,
+  /* Sampling the cgroups with capture --cgroup or --cgroup-tree.  */
+  PHASE_CGROUPS,
+  /* Publishing the snapshot in shared memory.  */
+  PHASE_RING,
+  /* The whole sample, from get_all_pids () to the end.  */
+  PHASE_SAMPLE,
+  NB_PHASES
+};
+
+/* Names of the phases, e.g. "status".  */
+extern const char *const phase_names[NB_PHASES];
+
+/* Number of buckets of the latency histograms.  Bucket B counts the
+   durations between 2^B and 2^(B+1) - 1 nanoseconds, and the last one
+   everything longer.  */
+#define STATS_BUCKETS 40
+
+/* Latencies of one phase.  */
+typedef struct {
+  long long count;
+  long long sum_ns;
+  long long max_ns;
+  long long buckets[STATS_BUCKETS];
+} phase_stats_t;
+
+/* Statistics of a capture since it started.  */
+typedef struct {
+  phase_stats_t phases[NB_PHASES];
+  long long samples;
+  /* Processes whose status was read, and those that disappeared
+     before it could be.  */
+  long long processes_read;
+  long long processes_vanished;
+  /* Processes whose smaps_rollup was read, and those whose
+     smaps_rollup fields were estimated.  */
+  long long smaps_read;
+  long long smaps_estimated;
+  /* Bytes appended to the history.  */
+  long long bytes_written;
+  /* Samples that took longer than the sampling period.  */
+  long long overruns;
+} capture_stats_t;
+
+/* Return the time of CLOCK_MONOTONIC in nanoseconds.  */
+long long
+stats_now_ns (void);
+
+/* Return the histogram bucket of a duration of NS nanoseconds.  */
+int
+stats_bucket (long long ns);
+
+/* Account a duration of NS nanoseconds to PHASE in STATS.  */
+void
+stats_record (capture_stats_t *stats, int phase, long long ns);
+
+/* Print STATS, and the CPU time used by the capture, into OUTPUT, one
+   "name value" pair per line.  */
+void
+stats_print (const capture_stats_t *stats, FILE *output);
+
+/* Replace FILENAME with the output of stats_print () atomically, so
+   that readers never see a partial file.
+   On success, return 0; on error, print a message and return 1.  */
+int
+stats_write_file (const capture_stats_t *stats, const char *filename);
+
+#endif /* CAPTURE_STATS_H */
@@ -0,0 +1,84 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "capture-stats.test.h"
+
+#include "capture-stats.h"      /* stats_record ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Check that a duration of NS nanoseconds falls into bucket
+   EXPECTED.  */
+static int
+test_stats_bucket_args (long long ns, int expected)
+{
+  int bucket = stats_bucket (ns);
+  if (bucket != expected) {
+    fprintf (stderr, "stats_bucket (%lld) returned %d instead of %d\n", ns, bucket, expected);
+    return 1;
+  }
+  return 0;
+}
+
+/* Record a few durations and check the counters.  */
+static int
+test_stats_record (void)
+{
+  capture_stats_t stats;
+  memset (&stats, 0, sizeof stats);
+  stats_record (&stats, PHASE_LOCK, 1000);
+  stats_record (&stats, PHASE_LOCK, 1023);
+  stats_record (&stats, PHASE_LOCK, 5000000);
+
+  const phase_stats_t *lock = stats.phases + PHASE_LOCK;
+  int error = 0;
+  if (lock->count != 3 || lock->sum_ns != 5002023 || lock->max_ns != 5000000) {
+    fprintf (stderr, "wrong count %lld, sum %lld or max %lld\n", lock->count, lock->sum_ns, lock->max_ns);
+    error = 1;
+  }
+  if (lock->buckets[9] != 2 || lock->buckets[22] != 1) {
+    fprintf (stderr, "wrong buckets %lld and %lld\n", lock->buckets[9], lock->buckets[22]);
+    error = 1;
+  }
+  if (stats.phases[PHASE_WRITE].count != 0) {
+    fprintf (stderr, "another phase was changed\n");
+    error = 1;
+  }
+  return error;
+}
+
+/* Run all tests on the capture-stats.c file.  */
+void
+test_capture_stats (void)
+{
+  int error = 0;
+
+  error += test_stats_bucket_args (0, 0);
+  error += test_stats_bucket_args (1, 0);
+  error += test_stats_bucket_args (2, 1);
+  error += test_stats_bucket_args (3, 1);
+  error += test_stats_bucket_args (1024, 10);
+  error += test_stats_bucket_args (2047, 10);
+  error += test_stats_bucket_args (1LL << 50, STATS_BUCKETS - 1);
+  error += test_stats_record ();
+
+  if (error) {
+    exit (1);
+  }
+}
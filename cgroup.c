@@ -0,0 +1,342 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "cgroup.h"
+
+#include "xmalloc.h"            /* xreallocarray ().  */
+#include "side-file.h"          /* side_file_create ().  */
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* pread ().  */
+#include <dirent.h>             /* opendir ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strcmp ().  */
+#include <limits.h>             /* PATH_MAX.  */
+
+/*
+ * FILE FORMAT
+ *
+ * Header: "# process-watcher cgroup format 1\n\n\n\n\n\n\n" (40 bytes,
+ * without NUL character), then a sequence of cgroup_record_t in
+ * ascending timestamp order, each CGROUP_PATH record being followed
+ * by its path.  Numbers are in host order.
+ *
+ * With cgroup v2, memory.current and memory.peak count all the memory
+ * charged to the cgroup and its descendants, page cache and kernel
+ * memory included.  Since Linux 6.12, writing to memory.peak resets
+ * the peak seen through that file descriptor, so that each sample
+ * gets the exact max since the previous one.
+ */
+
+/* Cgroup file name.  */
+static const char cgroup_filename[] = "process-watcher.cgroup";
+
+/* First bytes of the cgroup file.
+   The strlen is a multiple of 8 for alignment purposes.  */
+static const char cgroup_header[] = "# process-watcher cgroup format 1\n\n\n\n\n\n\n";
+
+/* Open the cgroup file for writing and prepare SAMPLER.  */
+void
+cgroup_create (cgroup_sampler_t *sampler, const char *const *dirs, int nbdirs, const char *const *trees, int nbtrees, int append)
+{
+  memset (sampler, 0, sizeof *sampler);
+  sampler->dirs = dirs;
+  sampler->nbdirs = nbdirs;
+  sampler->trees = trees;
+  sampler->nbtrees = nbtrees;
+
+  sampler->output = side_file_create (cgroup_filename, cgroup_header, sizeof (cgroup_record_t), append);
+}
+
+/* Copy PATH into NORMALIZED (PATH_MAX bytes) without its trailing
+   slashes.  Return 1 if it is too long, 0 otherwise.  */
+static int
+normalize_path (const char *path, char *normalized)
+{
+  size_t len = strlen (path);
+  while (len > 1 && path[len - 1] == '/') {
+    len--;
+  }
+  if (len >= PATH_MAX) {
+    return 1;
+  }
+  memcpy (normalized, path, len);
+  normalized[len] = 0;
+  return 0;
+}
+
+/* Read the number in the file open as FD into *VALUE.
+   On success, return 0; on error, return 1.  */
+static int
+read_number (int fd, uint64_t *value)
+{
+  char text[32];
+  ssize_t len = pread (fd, text, sizeof text - 1, 0);
+  if (len <= 0) {
+    return 1;
+  }
+  text[len] = 0;
+  char *end;
+  *value = strtoull (text, &end, 10);
+  return end == text || (*end != '\n' && *end != 0);
+}
+
+/* Write RECORD into the output of SAMPLER, followed by LEN bytes of
+   DATA padded to a multiple of the size of a record.  */
+static void
+write_record (cgroup_sampler_t *sampler, const cgroup_record_t *record, const char *data, size_t len)
+{
+  static const char padding[sizeof (cgroup_record_t)];
+  size_t padding_len = (sizeof *record - len % sizeof *record) % sizeof *record;
+  if (fwrite_unlocked (record, sizeof *record, 1, sampler->output) != 1
+      || fwrite_unlocked (data, 1, len, sampler->output) != len
+      || fwrite_unlocked (padding, 1, padding_len, sampler->output) != padding_len) {
+    perror ("could not write a cgroup record");
+    exit (1);
+  }
+}
+
+/* Close the files of CGROUP and free it.  */
+static void
+cgroup_close (cgroup_t *cgroup)
+{
+  close (cgroup->current_fd);
+  if (cgroup->peak_fd >= 0) {
+    close (cgroup->peak_fd);
+  }
+  free (cgroup->path);
+}
+
+/* Return the cgroup of SAMPLER whose directory is PATH, opening its
+   files and writing its path if it is new.  Return NULL if PATH is
+   not a cgroup with the memory controller.  */
+static cgroup_t *
+cgroup_find (cgroup_sampler_t *sampler, const char *path, time_t timestamp)
+{
+  for (int i = 0; i < sampler->nbcgroups; i++) {
+    if (! strcmp (sampler->cgroups[i].path, path)) {
+      return sampler->cgroups + i;
+    }
+  }
+
+  char filename[PATH_MAX];
+  if (snprintf (filename, sizeof filename, "%s/memory.current", path) >= (int) sizeof filename) {
+    return NULL;
+  }
+  int current_fd = open (filename, O_RDONLY | O_CLOEXEC);
+  if (current_fd < 0) {
+    return NULL;
+  }
+  int peak_writable = 0;
+  int peak_fd = -1;
+  if (snprintf (filename, sizeof filename, "%s/memory.peak", path) < (int) sizeof filename) {
+    peak_fd = open (filename, O_RDWR | O_CLOEXEC);
+    if (peak_fd >= 0) {
+      peak_writable = 1;
+    } else {
+      /* Before Linux 6.12, memory.peak is read-only.  */
+      peak_fd = open (filename, O_RDONLY | O_CLOEXEC);
+    }
+  }
+
+  if (sampler->nbcgroups == sampler->capacity) {
+    sampler->capacity = sampler->capacity ? 2 * sampler->capacity : 16;
+    sampler->cgroups = xreallocarray (sampler->cgroups, sampler->capacity, sizeof (cgroup_t));
+  }
+  cgroup_t *cgroup = sampler->cgroups + sampler->nbcgroups++;
+  size_t len = strlen (path) + 1;
+  cgroup->path = xreallocarray (NULL, len, 1);
+  memcpy (cgroup->path, path, len);
+  cgroup->id = sampler->next_id++;
+  cgroup->current_fd = current_fd;
+  cgroup->peak_fd = peak_fd;
+  cgroup->peak_writable = peak_writable;
+  /* A cgroup that was not there at the previous sample was created
+     since, and its peak is that of the interval.  */
+  cgroup->peak_reset = sampler->samples > 0;
+  cgroup->seen = 0;
+
+  cgroup_record_t record = {
+    .timestamp = timestamp,
+    .current = len,
+    .id = cgroup->id,
+    .flags = CGROUP_PATH,
+  };
+  write_record (sampler, &record, path, len);
+  return cgroup;
+}
+
+/* Sample the cgroup PATH and write its record.  */
+static void
+cgroup_sample_path (cgroup_sampler_t *sampler, const char *path, time_t timestamp)
+{
+  char normalized[PATH_MAX];
+  if (normalize_path (path, normalized)) {
+    return;
+  }
+  cgroup_t *cgroup = cgroup_find (sampler, normalized, timestamp);
+  if (cgroup == NULL || cgroup->seen) {
+    return;
+  }
+
+  cgroup_record_t record = {
+    .timestamp = timestamp,
+    .id = cgroup->id,
+    .flags = cgroup->peak_reset ? CGROUP_PEAK_RESET : 0,
+  };
+  if (read_number (cgroup->current_fd, &record.current)) {
+    /* The cgroup was removed: it is closed with the others that were
+       not seen.  */
+    return;
+  }
+  if (cgroup->peak_fd >= 0 && read_number (cgroup->peak_fd, &record.peak)) {
+    record.peak = 0;
+  }
+  cgroup->peak_reset = 0;
+  if (cgroup->peak_writable) {
+    if (write (cgroup->peak_fd, "reset\n", 6) == 6) {
+      cgroup->peak_reset = 1;
+    } else {
+      cgroup->peak_writable = 0;
+    }
+  }
+  write_record (sampler, &record, NULL, 0);
+  cgroup->seen = 1;
+}
+
+/* Sample the cgroup PATH and all the cgroups under it.  */
+static void
+cgroup_sample_tree (cgroup_sampler_t *sampler, const char *path, time_t timestamp)
+{
+  cgroup_sample_path (sampler, path, timestamp);
+  DIR *dir = opendir (path);
+  if (dir == NULL) {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != NULL) {
+    if (entry->d_type != DT_DIR || ! strcmp (entry->d_name, ".") || ! strcmp (entry->d_name, "..")) {
+      continue;
+    }
+    char child[PATH_MAX];
+    if (snprintf (child, sizeof child, "%s/%s", path, entry->d_name) < (int) sizeof child) {
+      cgroup_sample_tree (sampler, child, timestamp);
+    }
+  }
+  closedir (dir);
+}
+
+/* Sample the cgroups of SAMPLER.  */
+void
+cgroup_sample (cgroup_sampler_t *sampler, time_t timestamp)
+{
+  for (int i = 0; i < sampler->nbcgroups; i++) {
+    sampler->cgroups[i].seen = 0;
+  }
+  for (int i = 0; i < sampler->nbdirs; i++) {
+    cgroup_sample_path (sampler, sampler->dirs[i], timestamp);
+  }
+  for (int i = 0; i < sampler->nbtrees; i++) {
+    char path[PATH_MAX];
+    if (! normalize_path (sampler->trees[i], path)) {
+      cgroup_sample_tree (sampler, path, timestamp);
+    }
+  }
+
+  /* Forget the cgroups that were removed.  */
+  int kept = 0;
+  for (int i = 0; i < sampler->nbcgroups; i++) {
+    if (sampler->cgroups[i].seen) {
+      sampler->cgroups[kept++] = sampler->cgroups[i];
+    } else {
+      cgroup_close (sampler->cgroups + i);
+    }
+  }
+  sampler->nbcgroups = kept;
+  sampler->samples++;
+  fflush_unlocked (sampler->output);
+}
+
+/* Call CALLBACK (RECORD, DATA) on each record of the cgroup PATH
+   between BEGIN and END.  */
+int
+cgroup_read (const char *path, time_t begin, time_t end, void (*callback) (const cgroup_record_t *record, void *data), void *data)
+{
+  char normalized[PATH_MAX];
+  if (normalize_path (path, normalized)) {
+    return 1;
+  }
+  int fd = open (cgroup_filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  const size_t header_len = strlen (cgroup_header);
+  if (fstat (fd, &st) || (size_t) st.st_size <= header_len) {
+    close (fd);
+    return 1;
+  }
+  size_t map_len = st.st_size;
+  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED) {
+    return 1;
+  }
+  if (memcmp (map, cgroup_header, header_len) != 0) {
+    munmap (map, map_len);
+    return 1;
+  }
+
+  /* The cgroup may have been removed and created again, under a new
+     id, and the ids start again from 0 after the capture is restarted
+     with --append.  */
+  int id = -1;
+  int found = 0;
+  size_t offset = header_len;
+  while (offset + sizeof (cgroup_record_t) <= map_len) {
+    const cgroup_record_t *record = (const cgroup_record_t *) (map + offset);
+    offset += sizeof *record;
+    if (record->timestamp > end) {
+      break;
+    }
+    if (record->flags & CGROUP_PATH) {
+      size_t len = record->current;
+      size_t padded_len = (len + sizeof *record - 1) / sizeof *record * sizeof *record;
+      if (len == 0 || offset + padded_len > map_len) {
+        break;
+      }
+      const char *record_path = map + offset;
+      if (record_path[len - 1] == 0 && ! strcmp (record_path, normalized)) {
+        id = record->id;
+      } else if (record->id == id) {
+        id = -1;
+      }
+      offset += padded_len;
+    } else if (record->id == id && record->timestamp >= begin) {
+      found = 1;
+      callback (record, data);
+    }
+  }
+
+  munmap (map, map_len);
+  return ! found;
+}
@@ -0,0 +1,106 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <stdio.h>              /* FILE.  */
+#include <stdint.h>             /* uint64_t.  */
+#include <time.h>               /* time_t.  */
+
+/* Records of the cgroup file, written next to the history file, one
+   per sampled cgroup per snapshot.  */
+typedef struct {
+  /* Timestamp of the snapshot.  */
+  time_t timestamp;
+  /* memory.current of the cgroup, in bytes.  For a CGROUP_PATH
+     record, the length of the path, NUL included.  */
+  uint64_t current;
+  /* memory.peak of the cgroup, in bytes: since the previous sample
+     if CGROUP_PEAK_RESET is in FLAGS, else since the cgroup was
+     created.  0 if the cgroup has no memory.peak.  */
+  uint64_t peak;
+  /* Number of the cgroup in the file.  */
+  int id;
+  /* CGROUP_* flags.  */
+  int flags;
+} cgroup_record_t;
+
+/* The record is followed by the path of cgroup ID, padded with NUL
+   characters to a multiple of the size of a record.  It comes before
+   the first sample of the cgroup.  */
+#define CGROUP_PATH 1
+
+/* The peak is the max since the previous sample: either memory.peak
+   was reset then, or the cgroup did not exist yet.  */
+#define CGROUP_PEAK_RESET 2
+
+/* A cgroup being sampled.  */
+typedef struct {
+  char *path;
+  int id;
+  /* Open files memory.current and memory.peak of the cgroup, or -1.  */
+  int current_fd;
+  int peak_fd;
+  /* Whether memory.peak can be written to reset it, and whether it
+     was reset after the previous sample.  */
+  int peak_writable;
+  int peak_reset;
+  /* Whether the cgroup was found in the current sample.  */
+  int seen;
+} cgroup_t;
+
+/* Sampler of the cgroups given to the capture.  */
+typedef struct {
+  /* Directories of the cgroups to sample, and of the cgroups whose
+     whole subtree is sampled.  */
+  const char *const *dirs;
+  int nbdirs;
+  const char *const *trees;
+  int nbtrees;
+  /* The cgroups sampled so far.  */
+  cgroup_t *cgroups;
+  int nbcgroups;
+  int capacity;
+  int next_id;
+  /* Number of samples taken.  */
+  long long samples;
+  FILE *output;
+} cgroup_sampler_t;
+
+/* Open the cgroup file for writing into SAMPLER, truncating it unless
+   APPEND (see side_file_create ()), to sample the cgroups of DIRS
+   (NBDIRS of them) and those under TREES (NBTREES of them), both
+   included.  Exit on error.  */
+void
+cgroup_create (cgroup_sampler_t *sampler, const char *const *dirs, int nbdirs, const char *const *trees, int nbtrees, int append);
+
+/* Sample the cgroups of SAMPLER and write their records for the
+   snapshot taken at TIMESTAMP.  The cgroups under the trees are
+   looked for again at each sample, as they come and go.  Exit on
+   write error.  */
+void
+cgroup_sample (cgroup_sampler_t *sampler, time_t timestamp);
+
+/* Call CALLBACK (RECORD, DATA) on each record of the cgroup PATH
+   between BEGIN and END, in time order.
+   Return 0 on success, 1 if there are no records for PATH in the time
+   window.  */
+int
+cgroup_read (const char *path, time_t begin, time_t end, void (*callback) (const cgroup_record_t *record, void *data), void *data);
+
+#endif /* CGROUP_H */
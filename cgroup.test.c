@@ -0,0 +1,148 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "cgroup.test.h"
+
+#include "cgroup.h"             /* cgroup_sample ().  */
+#include "test-procfs.h"        /* test_procfs_write ().  */
+
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <sys/stat.h>           /* mkdir ().  */
+#include <unistd.h>             /* chdir (), truncate ().  */
+
+/* Write VALUE into the file NAME of the directory DIR under ROOT.  */
+static void
+write_cgroup_file (const char *root, const char *dir, const char *name, unsigned long long value)
+{
+  char text[32];
+  int len = snprintf (text, sizeof text, "%llu\n", value);
+  test_procfs_write (root, dir, name, text, len);
+}
+
+/* Records read back by cgroup_read ().  */
+struct records {
+  cgroup_record_t records[4];
+  int count;
+};
+
+/* Append RECORD to DATA, for use with cgroup_read ().  */
+static void
+add_record (const cgroup_record_t *record, void *data)
+{
+  struct records *records = data;
+  assert (records->count < 4);
+  records->records[records->count++] = *record;
+}
+
+/* Sample a fake cgroup tree twice, with a cgroup that appears and one
+   that disappears in between, and read the records back.  */
+static void
+test_cgroup_sample (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  char old_cwd[PATH_MAX];
+  char *got_cwd = getcwd (old_cwd, sizeof old_cwd);
+  assert (got_cwd != NULL);
+  int status = chdir (root);
+  assert (status == 0);
+
+  /* Without memory.current, "none" is not a memory cgroup, but its
+     children may be.  */
+  write_cgroup_file (root, "a", "memory.current", 1000);
+  write_cgroup_file (root, "a", "memory.peak", 5000);
+  write_cgroup_file (root, "a/b", "memory.current", 10);
+  char none[PATH_MAX];
+  snprintf (none, sizeof none, "%s/none", root);
+  status = mkdir (none, 0755);
+  assert (status == 0);
+
+  /* "a" is also given alone, and sampled only once.  */
+  char a[PATH_MAX];
+  snprintf (a, sizeof a, "%s/a/", root);
+  const char *dirs[] = { a };
+  const char *trees[] = { root };
+  cgroup_sampler_t sampler;
+  cgroup_create (&sampler, dirs, 1, trees, 1, 0);
+  cgroup_sample (&sampler, 100);
+
+  /* Regular files can be written, as memory.peak since Linux 6.12.  */
+  write_cgroup_file (root, "a", "memory.current", 2000);
+  write_cgroup_file (root, "a", "memory.peak", 3000);
+  write_cgroup_file (root, "none/d", "memory.current", 700);
+  /* The files of a removed cgroup cannot be read anymore, even if
+     they are still open.  */
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/a/b/memory.current", root);
+  status = truncate (filename, 0);
+  assert (status == 0);
+  cgroup_sample (&sampler, 102);
+  fclose (sampler.output);
+
+  int error = 0;
+  struct records records;
+  memset (&records, 0, sizeof records);
+  snprintf (a, sizeof a, "%s/a", root);
+  if (cgroup_read (a, 0, 200, add_record, &records) || records.count != 2
+      || records.records[0].current != 1000 || records.records[0].peak != 5000 || records.records[0].flags != 0
+      || records.records[1].current != 2000 || records.records[1].peak != 3000
+      || records.records[1].flags != CGROUP_PEAK_RESET) {
+    fprintf (stderr, "cgroup_read (\"%s\") found %d records\n", a, records.count);
+    error = 1;
+  }
+
+  /* "a/b" is gone at 102.  */
+  memset (&records, 0, sizeof records);
+  snprintf (a, sizeof a, "%s/a/b", root);
+  if (cgroup_read (a, 101, 200, add_record, &records) == 0) {
+    fprintf (stderr, "cgroup_read (\"%s\") found records after its removal\n", a);
+    error = 1;
+  }
+
+  /* "none/d" appeared after the first sample.  */
+  memset (&records, 0, sizeof records);
+  snprintf (a, sizeof a, "%s/none/d", root);
+  if (cgroup_read (a, 0, 200, add_record, &records) || records.count != 1
+      || records.records[0].current != 700 || records.records[0].flags != CGROUP_PEAK_RESET) {
+    fprintf (stderr, "cgroup_read (\"%s\") found %d records\n", a, records.count);
+    error = 1;
+  }
+
+  test_procfs_remove (root, "a/b", "memory.current");
+  test_procfs_remove (root, "a", "memory.current");
+  test_procfs_remove (root, "a", "memory.peak");
+  test_procfs_remove (root, "none/d", "memory.current");
+  test_procfs_remove (root, ".", "process-watcher.cgroup");
+  rmdir (none);
+  status = chdir (old_cwd);
+  assert (status == 0);
+  rmdir (root);
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run all tests on the cgroup.c file.  */
+void
+test_cgroup (void)
+{
+  test_cgroup_sample ();
+}
@@ -0,0 +1,179 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "comm.h"
+
+#include "xmalloc.h"            /* xreallocarray ().  */
+#include "side-file.h"          /* side_file_create ().  */
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* close ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memcmp ().  */
+
+/*
+ * FILE FORMAT
+ *
+ * Header: "# process-watcher comm format\n\n\n" (32 bytes, without
+ * NUL character), then a sequence of comm_record_t in ascending
+ * timestamp order.  Numbers are in host order.  A process is written
+ * when it first appears in a snapshot, and again when its name changes
+ * (execve).
+ */
+
+/* PID-to-name file name.  */
+static const char comm_filename[] = "process-watcher.comm";
+
+/* First bytes of the PID-to-name file.
+   The strlen is a multiple of 8 for alignment purposes.  */
+static const char comm_header[] = "# process-watcher comm format\n\n\n";
+
+/* Open the PID-to-name file for writing into WRITER, truncating it
+   unless APPEND.  */
+void
+comm_create (comm_writer_t *writer, int append)
+{
+  memset (writer, 0, sizeof *writer);
+  writer->output = side_file_create (comm_filename, comm_header, sizeof (comm_record_t), append);
+}
+
+/* Write the names of the processes of the snapshot taken at TIMESTAMP
+   that are new or renamed since the previous call.  */
+void
+comm_write (comm_writer_t *writer, time_t timestamp, const stat_struct_t *procs, char (*names)[NAME_SIZE], int nbprocs)
+{
+  /* Both the previous and the current processes are in ascending PID
+     order: walk them together.  */
+  int previous = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    while (previous < writer->nbpids && writer->pids[previous] < procs[i].Pid) {
+      previous++;
+    }
+    if (previous < writer->nbpids
+        && writer->pids[previous] == procs[i].Pid
+        && ! strcmp (writer->names[previous], names[i])) {
+      continue;
+    }
+
+    comm_record_t record;
+    memset (&record, 0, sizeof record);
+    record.timestamp = timestamp;
+    record.pid = procs[i].Pid;
+    strcpy (record.name, names[i]);
+    if (fwrite_unlocked (&record, sizeof record, 1, writer->output) != 1) {
+      perror ("could not write a comm record");
+      exit (1);
+    }
+  }
+  fflush_unlocked (writer->output);
+
+  /* Remember the current processes for the next call.  */
+  if (nbprocs > writer->capacity) {
+    writer->capacity = nbprocs;
+    writer->pids = xreallocarray (writer->pids, writer->capacity, sizeof (int));
+    writer->names = xreallocarray (writer->names, writer->capacity, NAME_SIZE);
+  }
+  for (int i = 0; i < nbprocs; i++) {
+    writer->pids[i] = procs[i].Pid;
+  }
+  memcpy (writer->names, names, (size_t) nbprocs * NAME_SIZE);
+  writer->nbpids = nbprocs;
+}
+
+/* Fill NAMES with the names that the NBPIDS processes PIDS had at
+   their TIMESTAMPS, or "?" for those that are unknown.  */
+void
+comm_lookup (int nbpids, const time_t *timestamps, const int *pids, char (*names)[NAME_SIZE])
+{
+  for (int i = 0; i < nbpids; i++) {
+    strcpy (names[i], "?");
+  }
+
+  int fd = open (comm_filename, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  const size_t header_len = strlen (comm_header);
+  if (fstat (fd, &st) || (size_t) st.st_size <= header_len) {
+    close (fd);
+    return;
+  }
+  size_t map_len = st.st_size;
+  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED) {
+    return;
+  }
+  if (memcmp (map, comm_header, header_len) != 0) {
+    munmap (map, map_len);
+    return;
+  }
+
+  const comm_record_t *records = (const comm_record_t *) (map + header_len);
+  size_t nbrecords = (map_len - header_len) / sizeof (comm_record_t);
+
+  /* One walk per distinct timestamp, for all the processes at that
+     time.  */
+  char done[nbpids];
+  memset (done, 0, nbpids);
+  for (int first = 0; first < nbpids; first++) {
+    if (done[first]) {
+      continue;
+    }
+    time_t timestamp = timestamps[first];
+    char found[nbpids];
+    int missing = 0;
+    for (int j = first; j < nbpids; j++) {
+      found[j] = done[j] || timestamps[j] != timestamp;
+      missing += ! found[j];
+      done[j] |= ! found[j];
+    }
+
+    /* Find the first record after TIMESTAMP.  */
+    size_t low = 0;
+    size_t high = nbrecords;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (records[middle].timestamp <= timestamp) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    /* Walk back to the latest record of each process.  */
+    for (size_t i = low; i > 0 && missing > 0; i--) {
+      const comm_record_t *record = records + i - 1;
+      for (int j = first; j < nbpids; j++) {
+        if (pids[j] == record->pid && ! found[j]) {
+          memcpy (names[j], record->name, NAME_SIZE);
+          names[j][NAME_SIZE - 1] = 0;
+          found[j] = 1;
+          missing--;
+        }
+      }
+    }
+  }
+
+  munmap (map, map_len);
+}
@@ -0,0 +1,57 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "status.h"             /* NAME_SIZE.  */
+
+#include <time.h>               /* time_t.  */
+
+/* A record of the PID-to-name file: from TIMESTAMP on, process PID is
+   named NAME.  */
+typedef struct {
+  time_t timestamp;
+  int pid;
+  char name[NAME_SIZE];
+  int padding;
+} comm_record_t;
+
+/* Writer of the PID-to-name file.  It remembers the names of the
+   previous snapshot, so as to write only the new or renamed
+   processes.  */
+typedef struct {
+  FILE *output;
+  int *pids;
+  char (*names)[NAME_SIZE];
+  int nbpids;
+  int capacity;
+} comm_writer_t;
+
+/* Open the PID-to-name file for writing into WRITER, truncating it
+   unless APPEND (see side_file_create ()).  Exit on error.  */
+void
+comm_create (comm_writer_t *writer, int append);
+
+/* Write the names of the processes of the snapshot taken at TIMESTAMP
+   (NBPROCS processes PROCS, named NAMES) that are new or renamed since
+   the previous call.  Exit on error.  */
+void
+comm_write (comm_writer_t *writer, time_t timestamp, const stat_struct_t *procs, char (*names)[NAME_SIZE], int nbprocs);
+
+/* Fill NAMES with the names that the NBPIDS processes PIDS had at
+   their TIMESTAMPS, or "?" for those that are unknown.  The file is
+   read once for all of them.  */
+void
+comm_lookup (int nbpids, const time_t *timestamps, const int *pids, char (*names)[NAME_SIZE]);
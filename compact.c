@@ -0,0 +1,302 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fileno_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "compact.h"
+
+#include "history.h"            /* history_next_snapshot ().  */
+#include "index.h"              /* index_add ().  */
+#include "names.h"              /* names_id ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/stat.h>           /* mkdir ().  */
+#include <errno.h>              /* errno.  */
+#include <unistd.h>             /* chdir ().  */
+#include <stdio.h>              /* printf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strerror ().  */
+#include <limits.h>             /* PATH_MAX.  */
+
+/* One of the histories being merged, with its next snapshot.  */
+struct input {
+  history_t history;
+  size_t offset;
+  snapshot_t snapshot;
+  /* Whether SNAPSHOT holds the next snapshot, i.e. the history is not
+     exhausted.  */
+  int pending;
+  /* Name dictionary of the history, and for each of its NameIds, the
+     id of the same name in the output.  NBNAME_IDS is 0 if the history
+     has no dictionary.  */
+  names_t names;
+  int *name_ids;
+  int nbname_ids;
+};
+
+/* Read the next snapshot of INPUT, if any.  Exit on error.  */
+static void
+input_next (struct input *input)
+{
+  input->pending = ! history_next_snapshot (&input->history, &input->offset, &input->snapshot);
+  if (input->history.failed) {
+    exit (1);
+  }
+}
+
+/* Compare the PIDs of the processes A and B, for bsearch ().  */
+static int
+compare_pids (const void *a, const void *b)
+{
+  int pid_a = ((const stat_struct_t *) a)->Pid;
+  int pid_b = ((const stat_struct_t *) b)->Pid;
+  return (pid_a > pid_b) - (pid_a < pid_b);
+}
+
+/* Store the processes of PROCS that are not idle into KEPT.  */
+int
+compact_drop_idle (const schema_t *schema, const stat_struct_t *procs, int nbprocs, stat_struct_t *kept)
+{
+  /* The name of a process does not make it busy.  */
+  char identity[NB_FIELDS];
+  for (int field = 0; field < NB_FIELDS; field++) {
+    identity[field] = identity_field (field);
+  }
+
+  /* A process without memory nor CPU time may still be the ancestor
+     of a busy one: mark the parents first, so as not to cut the
+     trees.  Use the Pid of KEPT as the marks.  */
+  for (int i = 0; i < nbprocs; i++) {
+    kept[i].Pid = 0;
+  }
+  for (int i = 0; i < nbprocs; i++) {
+    stat_struct_t key = { .Pid = procs[i].PPid };
+    const stat_struct_t *parent = bsearch (&key, procs, nbprocs, sizeof *procs, compare_pids);
+    if (parent != NULL) {
+      kept[parent - procs].Pid = 1;
+    }
+  }
+
+  int nbkept = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    int busy = kept[i].Pid;
+    for (int r = 0; r < schema->nbruns && ! busy; r++) {
+      const schema_run_t *run = schema->runs + r;
+      for (int field = run->field; field < run->field + run->count; field++) {
+        if (procs[i].fields[field] != 0 && ! identity[field]) {
+          busy = 1;
+          break;
+        }
+      }
+    }
+    if (busy) {
+      /* NBKEPT <= I: the marks of the processes after I are still
+         there.  */
+      kept[nbkept++] = procs[i];
+    }
+  }
+  return nbkept;
+}
+
+/* Perform the "process-watcher compact" command.  */
+void
+compact (const options_t *options, char *const *inputs, int nbinputs)
+{
+  struct input *in = xreallocarray (NULL, nbinputs, sizeof (struct input));
+  char selected[NB_FIELDS];
+  memset (selected, 0, sizeof selected);
+  for (int i = 0; i < nbinputs; i++) {
+    history_t *history = &in[i].history;
+    if (history_open (history, inputs[i])) {
+      exit (1);
+    }
+    /* Each input is read from the beginning to the end, through a
+       window, so that the memory used does not depend on the length of
+       the files.  */
+    history_set_window (history, options->map_window);
+    if (history_update (history)) {
+      fprintf (stderr, "could not read %s\n", inputs[i]);
+      exit (1);
+    }
+    for (int field = 0; field < NB_FIELDS; field++) {
+      selected[field] |= schema_has_field (&history->schema, field);
+    }
+    in[i].offset = history_first_offset (history);
+
+    /* The dictionary is next to the history.  */
+    char filename[PATH_MAX];
+    const char *slash = strrchr (inputs[i], '/');
+    int dir_len = slash == NULL ? 0 : slash - inputs[i] + 1;
+    snprintf (filename, sizeof filename, "%.*s%s", dir_len, inputs[i], names_filename);
+    in[i].name_ids = NULL;
+    in[i].nbname_ids = 0;
+    if (! names_open (&in[i].names, filename)) {
+      in[i].nbname_ids = in[i].names.nbnames + 1;
+    }
+  }
+
+  schema_t schema;
+  if (options->fields != NULL ? schema_select (&schema, options->fields) : schema_select_mask (&schema, selected)) {
+    exit (1);
+  }
+
+  /* The inputs are open: the output directory may be relative to the
+     same working directory.  */
+  if (mkdir (options->output, 0777) && errno != EEXIST) {
+    fprintf (stderr, "could not create %s: %s\n", options->output, strerror (errno));
+    exit (1);
+  }
+  if (chdir (options->output)) {
+    fprintf (stderr, "could not cd to %s: %s\n", options->output, strerror (errno));
+    exit (1);
+  }
+  FILE *output = fopen (history_filename, "wx");
+  if (output == NULL) {
+    fprintf (stderr, "could not create %s/%s: %s\n", options->output, history_filename, strerror (errno));
+    exit (1);
+  }
+  uint64_t history_len = history_write_header (&schema, output);
+  if (history_len == 0) {
+    fprintf (stderr, "write error while writing the header: %s\n", strerror (errno));
+    exit (1);
+  }
+  index_writer_t index_writer;
+  index_create (&index_writer, history_len);
+
+  /* The ids of the names differ between the inputs: merge their
+     dictionaries.  */
+  int name_field = -1;
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (schema_has_field (&schema, field) && ! strcmp (field_names[field], "NameId")) {
+      name_field = field;
+    }
+  }
+  names_writer_t names_writer;
+  if (name_field >= 0) {
+    names_create (&names_writer, names_filename, 0);
+  }
+  for (int i = 0; i < nbinputs; i++) {
+    if (in[i].nbname_ids == 0) {
+      continue;
+    }
+    if (name_field >= 0) {
+      in[i].name_ids = xreallocarray (NULL, in[i].nbname_ids, sizeof (int));
+      in[i].name_ids[0] = 0;
+      for (int id = 1; id < in[i].nbname_ids; id++) {
+        char name[NAME_SIZE];
+        memcpy (name, in[i].names.names[id - 1], NAME_SIZE);
+        name[NAME_SIZE - 1] = 0;
+        in[i].name_ids[id] = names_id (&names_writer, name);
+      }
+    } else {
+      in[i].nbname_ids = 0;
+    }
+    names_close (&in[i].names);
+  }
+
+  for (int i = 0; i < nbinputs; i++) {
+    input_next (in + i);
+  }
+
+  stat_struct_t *kept = NULL;
+  int kept_capacity = 0;
+  long long snapshots_read = 0;
+  long long snapshots_written = 0;
+  long long processes_read = 0;
+  long long processes_written = 0;
+  uint64_t bytes_read = 0;
+  time_t last_bucket = -1;
+  while (1) {
+    /* Take the oldest pending snapshot, the first input first in case
+       of a tie.  A linear scan is enough for the few files of a
+       host.  */
+    struct input *oldest = NULL;
+    for (int i = 0; i < nbinputs; i++) {
+      if (in[i].pending && (oldest == NULL || in[i].snapshot.timestamp < oldest->snapshot.timestamp)) {
+        oldest = in + i;
+      }
+    }
+    if (oldest == NULL) {
+      break;
+    }
+    snapshot_t snapshot = oldest->snapshot;
+    snapshots_read++;
+    processes_read += snapshot.nbpids;
+
+    int keep = 1;
+    if (options->downsample > 0
+        && (options->downsample_before == 0 || snapshot.timestamp < options->downsample_before)) {
+      time_t bucket = snapshot.timestamp / options->downsample;
+      keep = bucket != last_bucket;
+      last_bucket = bucket;
+    }
+    if (keep && (options->drop_idle || name_field >= 0) && snapshot.nbpids > kept_capacity) {
+      kept_capacity = snapshot.nbpids;
+      kept = xreallocarray (kept, kept_capacity, sizeof (stat_struct_t));
+    }
+    if (keep && options->drop_idle) {
+      snapshot.nbpids = compact_drop_idle (&schema, snapshot.procs, snapshot.nbpids, kept);
+      snapshot.procs = kept;
+    }
+    if (keep && name_field >= 0) {
+      if (snapshot.procs != kept) {
+        memcpy (kept, snapshot.procs, (size_t) snapshot.nbpids * sizeof (stat_struct_t));
+        snapshot.procs = kept;
+      }
+      for (int j = 0; j < snapshot.nbpids; j++) {
+        int id = kept[j].fields[name_field];
+        kept[j].fields[name_field] = id > 0 && id < oldest->nbname_ids ? oldest->name_ids[id] : 0;
+      }
+    }
+    if (keep) {
+      size_t snapshot_len = history_write_snapshot (&schema, &snapshot, output);
+      if (snapshot_len == 0) {
+        fprintf (stderr, "could not write a snapshot: %s\n", strerror (errno));
+        exit (1);
+      }
+      history_len += snapshot_len;
+      index_add (&index_writer, &snapshot, history_len);
+      snapshots_written++;
+      processes_written += snapshot.nbpids;
+    }
+
+    size_t offset = oldest->offset;
+    input_next (oldest);
+    bytes_read += oldest->offset - offset;
+  }
+
+  if (fclose (output)) {
+    fprintf (stderr, "could not write %s: %s\n", history_filename, strerror (errno));
+    exit (1);
+  }
+  if (name_field >= 0) {
+    names_writer_close (&names_writer);
+  }
+  printf ("%lld snapshots read, %lld written\n"
+          "%lld processes read, %lld written\n"
+          "%llu bytes read, %llu written\n",
+          snapshots_read, snapshots_written, processes_read, processes_written,
+          (unsigned long long) bytes_read, (unsigned long long) history_len);
+
+  for (int i = 0; i < nbinputs; i++) {
+    history_close (&in[i].history);
+    free (in[i].name_ids);
+  }
+  free (kept);
+  free (in);
+}
@@ -0,0 +1,44 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include "options.h"            /* options_t.  */
+#include "stat-struct.h"        /* stat_struct_t.  */
+#include "schema.h"             /* schema_t.  */
+
+/* Store into KEPT the processes of PROCS (NBPROCS of them, in
+   ascending PID order) that are not idle, i.e. that have some field
+   of SCHEMA that is not 0 or some child process, and return their
+   number.  */
+int
+compact_drop_idle (const schema_t *schema, const stat_struct_t *procs, int nbprocs, stat_struct_t *kept);
+
+/* Perform the "process-watcher compact" command: merge the snapshots
+   of the history files INPUTS (NBINPUTS of them) in timestamp order
+   into the history of the directory OPTIONS->output, with their name
+   dictionaries merged (the inputs' are next to them), with the fields
+   of OPTIONS->fields (by default, those of any input), without the
+   idle processes if OPTIONS->drop_idle, and keeping only the first
+   snapshot of each OPTIONS->downsample seconds (before
+   OPTIONS->downsample_before, if set) if OPTIONS->downsample is set.
+   Exit on error.  */
+void
+compact (const options_t *options, char *const *inputs, int nbinputs);
+
+#endif /* COMPACT_H */
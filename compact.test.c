@@ -0,0 +1,201 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "compact.test.h"
+
+#include "compact.h"
+#include "history.h"            /* history_next_snapshot ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <unistd.h>             /* chdir (), unlink ().  */
+
+/* Check that the idle processes are dropped, but not those with
+   children.  */
+static int
+test_compact_drop_idle (void)
+{
+  stat_struct_t procs[5];
+  memset (procs, 0, sizeof procs);
+  static const int pids[5][2] = { { 1, 0 }, { 2, 0 }, { 3, 2 }, { 5, 1 }, { 7, 1 } };
+  for (int i = 0; i < 5; i++) {
+    procs[i].Pid = pids[i][0];
+    procs[i].PPid = pids[i][1];
+  }
+  /* Only process 5 has some memory, and process 7 some VmPeak, which
+     is not recorded.  */
+  procs[3].VmRSS = 10;
+  procs[4].VmPeak = 10;
+  schema_t schema;
+  int selected = schema_select (&schema, "VmRSS");
+  assert (selected == 0);
+
+  stat_struct_t kept[5];
+  int nbkept = compact_drop_idle (&schema, procs, 5, kept);
+  if (nbkept != 3 || kept[0].Pid != 1 || kept[1].Pid != 2 || kept[2].Pid != 5 || kept[2].VmRSS != 10) {
+    fprintf (stderr, "test_compact_drop_idle: %d processes kept\n", nbkept);
+    return 1;
+  }
+  return 0;
+}
+
+/* Write into FILENAME a history of NBSNAPSHOTS snapshots taken every 4
+   seconds from FIRST, with 2 processes whose VmRSS is their
+   timestamp.  */
+static void
+write_input (const char *filename, time_t first, int nbsnapshots)
+{
+  FILE *file = fopen (filename, "w");
+  assert (file != NULL);
+  schema_t schema;
+  schema_init (&schema);
+  size_t header_len = history_write_header (&schema, file);
+  assert (header_len != 0);
+  stat_struct_t procs[2];
+  memset (procs, 0, sizeof procs);
+  procs[0].Pid = 1;
+  procs[1].Pid = 10;
+  procs[1].PPid = 1;
+  for (int s = 0; s < nbsnapshots; s++) {
+    snapshot_t snapshot = { .timestamp = first + 4 * s, .nbpids = 2, .procs = procs };
+    procs[0].VmRSS = procs[1].VmRSS = snapshot.timestamp;
+    procs[0].VmHWM = 1;
+    size_t snapshot_len = history_write_snapshot (&schema, &snapshot, file);
+    assert (snapshot_len != 0);
+  }
+  int closed = fclose (file);
+  assert (closed == 0);
+}
+
+/* Compact the histories a and b into the directory OUTPUT with
+   OPTIONS, and check that the compacted history has the EXPECTED
+   timestamps, and only the VmRSS of the inputs.  Return 0 if it does,
+   1 otherwise.  */
+static int
+check_compact (options_t *options, const char *output, const time_t *expected, int nbexpected)
+{
+  char cwd[PATH_MAX];
+  char *got_cwd = getcwd (cwd, sizeof cwd);
+  assert (got_cwd != NULL);
+  char *inputs[] = { "a", "b" };
+  options->output = output;
+  compact (options, inputs, 2);
+  int status = chdir (cwd);
+  assert (status == 0);
+
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/%s", output, history_filename);
+  history_t history;
+  status = history_open (&history, filename);
+  assert (status == 0);
+  status = history_update (&history);
+  assert (status == 0);
+  int error = 0;
+  if (history.schema.nbfields != 1 || strcmp (history.schema.names[0], "VmRSS")) {
+    fprintf (stderr, "check_compact: %s has other fields\n", output);
+    error = 1;
+  }
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  int s = 0;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    if (s == nbexpected || snapshot.timestamp != expected[s] || snapshot.nbpids != 2
+        || snapshot.procs[1].VmRSS != snapshot.timestamp || snapshot.procs[0].VmHWM != 0) {
+      fprintf (stderr, "check_compact: wrong snapshot %d in %s\n", s, output);
+      error = 1;
+      break;
+    }
+    s++;
+  }
+  if (s != nbexpected) {
+    fprintf (stderr, "check_compact: %d snapshots in %s instead of %d\n", s, output, nbexpected);
+    error = 1;
+  }
+  history_close (&history);
+  return error;
+}
+
+/* Remove the compacted history OUTPUT written by check_compact ().  */
+static void
+remove_output (const char *output)
+{
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/%s", output, history_filename);
+  unlink (filename);
+  snprintf (filename, sizeof filename, "%s/process-watcher.idx", output);
+  unlink (filename);
+  rmdir (output);
+}
+
+/* Merge two interleaved histories, then downsample them.  */
+static int
+test_compact_merge (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  char old_cwd[PATH_MAX];
+  char *got_cwd = getcwd (old_cwd, sizeof old_cwd);
+  assert (got_cwd != NULL);
+  int status = chdir (root);
+  assert (status == 0);
+  write_input ("a", 100, 10);
+  write_input ("b", 102, 10);
+
+  options_t options;
+  memset (&options, 0, sizeof options);
+  options.fields = "VmRSS";
+  options.map_window = 4096;
+  int error = 0;
+  time_t expected[20];
+  for (int s = 0; s < 20; s++) {
+    expected[s] = 100 + 2 * s;
+  }
+  error |= check_compact (&options, "merged", expected, 20);
+
+  /* One snapshot per 10 seconds before 120, then all of them.  */
+  options.downsample = 10;
+  options.downsample_before = 120;
+  static const time_t downsampled[] = { 100, 110, 120, 122, 124, 126, 128, 130, 132, 134, 136, 138 };
+  error |= check_compact (&options, "downsampled", downsampled, sizeof downsampled / sizeof downsampled[0]);
+
+  remove_output ("merged");
+  remove_output ("downsampled");
+  unlink ("a");
+  unlink ("b");
+  status = chdir (old_cwd);
+  assert (status == 0);
+  rmdir (root);
+  return error;
+}
+
+/* Run all tests on the compact.c file.  */
+void
+test_compact (void)
+{
+  int error = 0;
+
+  error += test_compact_drop_idle ();
+  error += test_compact_merge ();
+
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,252 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "crc32c.h"
+
+#include <string.h>             /* memcpy ().  */
+
+#if defined __aarch64__ && defined __ARM_FEATURE_CRC32
+#include <arm_acle.h>           /* __crc32cd ().  */
+#endif
+
+/* CRC-32C polynomial, bit-reversed.  */
+#define POLYNOMIAL 0x82f63b78
+
+/* TABLES[0][B] is the CRC of the byte B, and TABLES[K][B] the CRC of
+   B followed by K zero bytes, so that 8 bytes are processed at once
+   ("slicing-by-8").  */
+static uint32_t tables[8][256];
+
+/* Fill TABLES.  */
+static void
+init_tables (void)
+{
+  for (int b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+    }
+    tables[0][b] = crc;
+  }
+  for (int b = 0; b < 256; b++) {
+    uint32_t crc = tables[0][b];
+    for (int k = 1; k < 8; k++) {
+      crc = tables[0][crc & 0xff] ^ (crc >> 8);
+      tables[k][b] = crc;
+    }
+  }
+}
+
+/* Same as crc32c (), with tables only.  */
+uint32_t
+crc32c_portable (uint32_t crc, const void *data, size_t len)
+{
+  if (tables[0][1] == 0) {
+    init_tables ();
+  }
+
+  const unsigned char *bytes = (const unsigned char *) data;
+  crc = ~crc;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; len >= 8; bytes += 8, len -= 8) {
+    uint64_t word;
+    memcpy (&word, bytes, sizeof word);
+    word ^= crc;
+    crc = tables[7][word & 0xff] ^ tables[6][(word >> 8) & 0xff]
+      ^ tables[5][(word >> 16) & 0xff] ^ tables[4][(word >> 24) & 0xff]
+      ^ tables[3][(word >> 32) & 0xff] ^ tables[2][(word >> 40) & 0xff]
+      ^ tables[1][(word >> 48) & 0xff] ^ tables[0][word >> 56];
+  }
+#endif
+  for (; len > 0; bytes++, len--) {
+    crc = tables[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+#if defined __x86_64__
+
+/* The CRC32 instruction has a latency of 3 cycles, but a throughput
+   of 1 per cycle: it is 3 times faster on 3 independent blocks at
+   once, whose CRCs are then combined.  The blocks are LONG_BLOCK
+   bytes long, then SHORT_BLOCK bytes long for what remains.  */
+#define LONG_BLOCK 8192
+#define SHORT_BLOCK 256
+
+/* Tables to shift a CRC by LONG_BLOCK and SHORT_BLOCK zero bytes, by
+   pieces of 8 bits, as in crc32c_shift ().  */
+static uint32_t long_shifts[4][256];
+static uint32_t short_shifts[4][256];
+
+/* Return the product of the 32x32 matrix over GF(2) MATRIX, given by
+   columns, with VECTOR.  */
+static uint32_t
+gf2_matrix_times (const uint32_t *matrix, uint32_t vector)
+{
+  uint32_t sum = 0;
+  for (; vector != 0; vector >>= 1, matrix++) {
+    if (vector & 1) {
+      sum ^= *matrix;
+    }
+  }
+  return sum;
+}
+
+/* Store the square of MATRIX into SQUARE.  */
+static void
+gf2_matrix_square (uint32_t *square, const uint32_t *matrix)
+{
+  for (int n = 0; n < 32; n++) {
+    square[n] = gf2_matrix_times (matrix, matrix[n]);
+  }
+}
+
+/* Fill SHIFTS to shift a CRC by LEN zero bytes, LEN being a power of
+   2.  */
+static void
+init_shifts (uint32_t shifts[4][256], size_t len)
+{
+  /* Start from the operator for one zero bit, and square it up to
+     LEN bytes.  */
+  uint32_t odd[32];
+  uint32_t even[32];
+  odd[0] = POLYNOMIAL;
+  for (int n = 1; n < 32; n++) {
+    odd[n] = 1U << (n - 1);
+  }
+  gf2_matrix_square (even, odd);
+  gf2_matrix_square (odd, even);
+  const uint32_t *op;
+  while (1) {
+    gf2_matrix_square (even, odd);
+    len >>= 1;
+    if (len == 0) {
+      op = even;
+      break;
+    }
+    gf2_matrix_square (odd, even);
+    len >>= 1;
+    if (len == 0) {
+      op = odd;
+      break;
+    }
+  }
+
+  for (uint32_t b = 0; b < 256; b++) {
+    for (int k = 0; k < 4; k++) {
+      shifts[k][b] = gf2_matrix_times (op, b << (8 * k));
+    }
+  }
+}
+
+/* Return CRC shifted by the zero bytes of SHIFTS.  */
+static uint32_t
+crc32c_shift (uint32_t shifts[4][256], uint32_t crc)
+{
+  return shifts[0][crc & 0xff] ^ shifts[1][(crc >> 8) & 0xff]
+    ^ shifts[2][(crc >> 16) & 0xff] ^ shifts[3][crc >> 24];
+}
+
+/* Update the raw CRC *CRC with the 3 consecutive blocks of LEN bytes
+   each at *BYTES, and move *BYTES past them.  */
+__attribute__ ((target ("sse4.2")))
+static void
+crc32c_sse42_blocks (uint64_t *crc, const unsigned char **bytes, size_t len, uint32_t shifts[4][256])
+{
+  const unsigned char *block = *bytes;
+  uint64_t crc0 = *crc;
+  uint64_t crc1 = 0;
+  uint64_t crc2 = 0;
+  for (const unsigned char *end = block + len; block < end; block += 8) {
+    uint64_t word0, word1, word2;
+    memcpy (&word0, block, sizeof word0);
+    memcpy (&word1, block + len, sizeof word1);
+    memcpy (&word2, block + 2 * len, sizeof word2);
+    crc0 = __builtin_ia32_crc32di (crc0, word0);
+    crc1 = __builtin_ia32_crc32di (crc1, word1);
+    crc2 = __builtin_ia32_crc32di (crc2, word2);
+  }
+  crc0 = crc32c_shift (shifts, crc0) ^ crc1;
+  *crc = crc32c_shift (shifts, crc0) ^ crc2;
+  *bytes += 3 * len;
+}
+
+/* Same as crc32c (), with the CRC32 instruction of SSE 4.2.  */
+__attribute__ ((target ("sse4.2")))
+static uint32_t
+crc32c_sse42 (uint32_t crc, const void *data, size_t len)
+{
+  const unsigned char *bytes = (const unsigned char *) data;
+  uint64_t crc64 = (uint32_t) ~crc;
+  for (; len >= 3 * LONG_BLOCK; len -= 3 * LONG_BLOCK) {
+    crc32c_sse42_blocks (&crc64, &bytes, LONG_BLOCK, long_shifts);
+  }
+  for (; len >= 3 * SHORT_BLOCK; len -= 3 * SHORT_BLOCK) {
+    crc32c_sse42_blocks (&crc64, &bytes, SHORT_BLOCK, short_shifts);
+  }
+  for (; len >= 8; bytes += 8, len -= 8) {
+    uint64_t word;
+    memcpy (&word, bytes, sizeof word);
+    crc64 = __builtin_ia32_crc32di (crc64, word);
+  }
+  crc = crc64;
+  for (; len > 0; bytes++, len--) {
+    crc = __builtin_ia32_crc32qi (crc, *bytes);
+  }
+  return ~crc;
+}
+
+#elif defined __aarch64__ && defined __ARM_FEATURE_CRC32
+
+/* Same as crc32c (), with the CRC32C instructions of ARMv8.  */
+static uint32_t
+crc32c_arm (uint32_t crc, const void *data, size_t len)
+{
+  const unsigned char *bytes = (const unsigned char *) data;
+  crc = ~crc;
+  for (; len >= 8; bytes += 8, len -= 8) {
+    uint64_t word;
+    memcpy (&word, bytes, sizeof word);
+    crc = __crc32cd (crc, word);
+  }
+  for (; len > 0; bytes++, len--) {
+    crc = __crc32cb (crc, *bytes);
+  }
+  return ~crc;
+}
+
+#endif
+
+/* Return the CRC-32C of the LEN bytes at DATA, following CRC.  */
+uint32_t
+crc32c (uint32_t crc, const void *data, size_t len)
+{
+#if defined __x86_64__
+  static int has_sse42 = -1;
+  if (has_sse42 < 0) {
+    init_shifts (long_shifts, LONG_BLOCK);
+    init_shifts (short_shifts, SHORT_BLOCK);
+    has_sse42 = __builtin_cpu_supports ("sse4.2") != 0;
+  }
+  if (has_sse42) {
+    return crc32c_sse42 (crc, data, len);
+  }
+#elif defined __aarch64__ && defined __ARM_FEATURE_CRC32
+  return crc32c_arm (crc, data, len);
+#endif
+  return crc32c_portable (crc, data, len);
+}
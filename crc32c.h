@@ -0,0 +1,34 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>             /* size_t.  */
+#include <stdint.h>             /* uint32_t.  */
+
+/* Return the CRC-32C (Castagnoli) of the LEN bytes at DATA, following
+   the CRC of the preceding bytes CRC, which is 0 at the start.  It
+   uses the CRC32 instructions of the processor when it has them.  */
+uint32_t
+crc32c (uint32_t crc, const void *data, size_t len);
+
+/* Same as crc32c (), with tables only.  */
+uint32_t
+crc32c_portable (uint32_t crc, const void *data, size_t len);
+
+#endif /* CRC32C_H */
@@ -0,0 +1,82 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "crc32c.test.h"
+
+#include "crc32c.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strlen ().  */
+
+/* Check the CRC of STR, in one go and in two parts, against
+   EXPECTED.  Return 0 if it is right, 1 otherwise.  */
+static int
+test_crc32c_string (const char *str, uint32_t expected)
+{
+  int error = 0;
+  size_t len = strlen (str);
+  uint32_t actual = crc32c (0, str, len);
+  uint32_t portable = crc32c_portable (0, str, len);
+  uint32_t split = crc32c (crc32c (0, str, len / 3), str + len / 3, len - len / 3);
+  if (actual != expected || portable != expected || split != expected) {
+    fprintf (stderr, "test_crc32c_string: \"%s\" should give %08x but gave %08x, %08x portably and %08x in two parts\n",
+             str, expected, actual, portable, split);
+    error = 1;
+  }
+  return error;
+}
+
+/* Check that crc32c () and crc32c_portable () agree on buffers of all
+   lengths and alignments, up to several times the blocks that
+   crc32c () may process at once.  Return 0 if they do, 1 otherwise.  */
+static int
+test_crc32c_lengths (void)
+{
+  static unsigned char buffer[60000];
+  for (size_t i = 0; i < sizeof buffer; i++) {
+    buffer[i] = i * 97 + 13;
+  }
+  for (size_t start = 0; start < 8; start++) {
+    for (size_t len = 0; start + len <= sizeof buffer; len += len < 1000 ? 1 : 997) {
+      uint32_t actual = crc32c (0x12345678, buffer + start, len);
+      uint32_t expected = crc32c_portable (0x12345678, buffer + start, len);
+      if (actual != expected) {
+        fprintf (stderr, "test_crc32c_lengths: %zu bytes at %zu give %08x instead of %08x\n", len, start, actual, expected);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Run all tests on the crc32c.c file.  */
+void
+test_crc32c (void)
+{
+  int error = 0;
+
+  /* The check value of CRC-32C, and a common test string.  */
+  error += test_crc32c_string ("", 0);
+  error += test_crc32c_string ("123456789", 0xe3069283);
+  error += test_crc32c_string ("The quick brown fox jumps over the lazy dog", 0x22620404);
+  error += test_crc32c_lengths ();
+
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,431 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as open_memstream ().  */
+#define _GNU_SOURCE
+
+#include "exporter.h"
+
+#include "usage.h"              /* measure_field ().  */
+#include "schema.h"             /* field_names.  */
+#include "string-has-only-digits.h" /* string_has_only_digits ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/socket.h>         /* socket ().  */
+#include <sys/un.h>             /* struct sockaddr_un.  */
+#include <sys/resource.h>       /* getrusage ().  */
+#include <sys/stat.h>           /* lstat ().  */
+#include <netinet/in.h>         /* struct sockaddr_in.  */
+#include <arpa/inet.h>          /* htonl ().  */
+#include <signal.h>             /* pthread_sigmask ().  */
+#include <unistd.h>             /* unlink ().  */
+#include <stdlib.h>             /* atoi ().  */
+#include <string.h>             /* memcpy ().  */
+#include <errno.h>              /* errno.  */
+
+/*
+ * PROTOCOL
+ *
+ * Any HTTP GET request, e.g. "curl http://localhost:9100/metrics" or
+ * "curl --unix-socket process-watcher.metrics http://localhost/",
+ * gets the metrics in the OpenMetrics text format:
+ *
+ * - process_watcher_tree_bytes{pid,start_time,field}: memory field
+ *   FIELD of the tree registered with "process-watcher register",
+ *   summed over its processes, in the latest snapshot.
+ * - process_watcher_tree_max_bytes{pid,start_time,field}: running max
+ *   of process_watcher_tree_bytes since the registration.
+ * - process_watcher_snapshot_timestamp_seconds, process_watcher_processes:
+ *   time and number of processes of the latest snapshot.
+ * - counters and latency histograms of the capture, as printed on
+ *   SIGUSR1 (see capture-stats.c).
+ *
+ * Clients are served one at a time, each with a one-second timeout.
+ */
+
+/* Maximum length of a request.  */
+#define MAX_REQUEST_LEN 4096
+
+/* Write the sample metrics of METRICS into OUTPUT.  */
+static void
+format_sample (const metrics_t *metrics, FILE *output)
+{
+  fprintf (output, "# TYPE process_watcher_snapshot_timestamp_seconds gauge\n"
+           "# UNIT process_watcher_snapshot_timestamp_seconds seconds\n"
+           "# HELP process_watcher_snapshot_timestamp_seconds Time of the latest snapshot.\n"
+           "process_watcher_snapshot_timestamp_seconds %lld\n", (long long) metrics->timestamp);
+  fprintf (output, "# TYPE process_watcher_processes gauge\n"
+           "# HELP process_watcher_processes Number of processes in the latest snapshot.\n"
+           "process_watcher_processes %d\n", metrics->nbprocs);
+
+  /* The memory fields of the status files are in KiB.  */
+  static const char *const names[2] = { "process_watcher_tree_bytes", "process_watcher_tree_max_bytes" };
+  static const char *const helps[2] = {
+    "Memory of the registered process trees in the latest snapshot.",
+    "Max memory of the registered process trees since their registration.",
+  };
+  for (int max = 0; max < 2; max++) {
+    fprintf (output, "# TYPE %s gauge\n# UNIT %s bytes\n# HELP %s %s\n", names[max], names[max], names[max], helps[max]);
+    for (int i = 0; i < metrics->nbtrees; i++) {
+      const registered_tree_t *tree = metrics->trees + i;
+      const totals_t *totals = max ? &tree->max : &tree->totals;
+      for (int field = 0; field < NB_FIELDS; field++) {
+        if (measure_field (field)) {
+          fprintf (output, "%s{pid=\"%d\",start_time=\"%u\",field=\"%s\"} %lld\n", names[max], tree->id.pid, tree->id.start_time, field_names[field], totals->fields[field] * 1024);
+        }
+      }
+    }
+  }
+
+  /* The cumulative fields are only meaningful summed over the tree.
+     The CPU time is in hundredths of seconds, and the I/O in kB.  */
+  fprintf (output, "# TYPE process_watcher_tree_cpu_seconds gauge\n"
+           "# UNIT process_watcher_tree_cpu_seconds seconds\n"
+           "# HELP process_watcher_tree_cpu_seconds CPU time of the registered process trees and of their exited children in the latest snapshot.\n");
+  for (int i = 0; i < metrics->nbtrees; i++) {
+    const registered_tree_t *tree = metrics->trees + i;
+    long long cpu = usage_counter (&tree->totals, USAGE_CPU);
+    fprintf (output, "process_watcher_tree_cpu_seconds{pid=\"%d\",start_time=\"%u\"} %lld.%02lld\n", tree->id.pid, tree->id.start_time, cpu / 100, cpu % 100);
+  }
+  fprintf (output, "# TYPE process_watcher_tree_io_bytes gauge\n"
+           "# UNIT process_watcher_tree_io_bytes bytes\n"
+           "# HELP process_watcher_tree_io_bytes Storage I/O of the registered process trees and of their exited children in the latest snapshot.\n");
+  for (int i = 0; i < metrics->nbtrees; i++) {
+    const registered_tree_t *tree = metrics->trees + i;
+    fprintf (output, "process_watcher_tree_io_bytes{pid=\"%d\",start_time=\"%u\",direction=\"read\"} %lld\n"
+             "process_watcher_tree_io_bytes{pid=\"%d\",start_time=\"%u\",direction=\"write\"} %lld\n",
+             tree->id.pid, tree->id.start_time, usage_counter (&tree->totals, USAGE_READ) * 1024,
+             tree->id.pid, tree->id.start_time, usage_counter (&tree->totals, USAGE_WRITE) * 1024);
+  }
+  fprintf (output, "# TYPE process_watcher_tree_io_syscalls gauge\n"
+           "# HELP process_watcher_tree_io_syscalls Read and write system calls of the registered process trees and of their exited children in the latest snapshot.\n");
+  for (int i = 0; i < metrics->nbtrees; i++) {
+    const registered_tree_t *tree = metrics->trees + i;
+    fprintf (output, "process_watcher_tree_io_syscalls{pid=\"%d\",start_time=\"%u\",direction=\"read\"} %lld\n"
+             "process_watcher_tree_io_syscalls{pid=\"%d\",start_time=\"%u\",direction=\"write\"} %lld\n",
+             tree->id.pid, tree->id.start_time, usage_counter (&tree->totals, USAGE_SYSCR),
+             tree->id.pid, tree->id.start_time, usage_counter (&tree->totals, USAGE_SYSCW));
+  }
+
+  const capture_stats_t *stats = &metrics->stats;
+  static const struct {
+    const char *name;
+    const char *unit;
+    const char *help;
+  } counters[] = {
+    { "process_watcher_samples", NULL, "Samples taken by the capture." },
+    { "process_watcher_processes_read", NULL, "Processes whose status was read." },
+    { "process_watcher_processes_vanished", NULL, "Processes that disappeared before their status could be read." },
+    { "process_watcher_smaps_read", NULL, "Processes whose smaps_rollup was read." },
+    { "process_watcher_smaps_estimated", NULL, "Processes whose smaps_rollup fields were estimated from VmRSS." },
+    { "process_watcher_written_bytes", "bytes", "Bytes appended to the history." },
+    { "process_watcher_overruns", NULL, "Samples that took longer than the sampling period." },
+    { "process_watcher_metrics_skipped", NULL, "Samples not published because a scrape was reading the previous ones." },
+  };
+  const long long values[] = {
+    stats->samples, stats->processes_read, stats->processes_vanished,
+    stats->smaps_read, stats->smaps_estimated,
+    stats->bytes_written, stats->overruns, metrics->skipped,
+  };
+  for (size_t i = 0; i < sizeof counters / sizeof counters[0]; i++) {
+    fprintf (output, "# TYPE %s counter\n", counters[i].name);
+    if (counters[i].unit != NULL) {
+      fprintf (output, "# UNIT %s %s\n", counters[i].name, counters[i].unit);
+    }
+    fprintf (output, "# HELP %s %s\n%s_total %lld\n", counters[i].name, counters[i].help, counters[i].name, values[i]);
+  }
+
+  /* Bucket B holds the durations below 2^(B+1) nanoseconds, and the
+     last one everything longer.  */
+  fprintf (output, "# TYPE process_watcher_phase_seconds histogram\n"
+           "# UNIT process_watcher_phase_seconds seconds\n"
+           "# HELP process_watcher_phase_seconds Durations of the phases of the samples.\n");
+  for (int phase = 0; phase < NB_PHASES; phase++) {
+    const phase_stats_t *phase_stats = stats->phases + phase;
+    long long count = 0;
+    for (int bucket = 0; bucket < STATS_BUCKETS - 1; bucket++) {
+      count += phase_stats->buckets[bucket];
+      fprintf (output, "process_watcher_phase_seconds_bucket{phase=\"%s\",le=\"%.9f\"} %lld\n",
+               phase_names[phase], (double) (1LL << (bucket + 1)) / 1e9, count);
+    }
+    fprintf (output, "process_watcher_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lld\n", phase_names[phase], phase_stats->count);
+    fprintf (output, "process_watcher_phase_seconds_count{phase=\"%s\"} %lld\n", phase_names[phase], phase_stats->count);
+    fprintf (output, "process_watcher_phase_seconds_sum{phase=\"%s\"} %.9f\n", phase_names[phase], phase_stats->sum_ns / 1e9);
+  }
+}
+
+/* Write METRICS and the CPU time into OUTPUT.  */
+void
+exporter_format (const metrics_t *metrics, FILE *output)
+{
+  if (metrics != NULL) {
+    format_sample (metrics, output);
+  }
+
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0) {
+    fprintf (output, "# TYPE process_watcher_cpu_seconds counter\n"
+             "# UNIT process_watcher_cpu_seconds seconds\n"
+             "# HELP process_watcher_cpu_seconds CPU time used by the capture.\n"
+             "process_watcher_cpu_seconds_total{mode=\"user\"} %ld.%06ld\n"
+             "process_watcher_cpu_seconds_total{mode=\"system\"} %ld.%06ld\n",
+             (long) usage.ru_utime.tv_sec, (long) usage.ru_utime.tv_usec,
+             (long) usage.ru_stime.tv_sec, (long) usage.ru_stime.tv_usec);
+  }
+  fputs ("# EOF\n", output);
+}
+
+/* Publish the metrics of a sample.  */
+void
+exporter_publish (exporter_t *exporter, time_t timestamp, int nbprocs, const registry_t *registry, const capture_stats_t *stats)
+{
+  pthread_mutex_lock (&exporter->lock);
+  int back = exporter->front == 0 ? 1 : 0;
+  int busy = exporter->readers[back] > 0;
+  pthread_mutex_unlock (&exporter->lock);
+  if (busy) {
+    exporter->skipped++;
+    return;
+  }
+
+  /* Scrapes only start reading the front buffer, so that this one
+     is ours until it is made the front one.  */
+  metrics_t *metrics = exporter->buffers + back;
+  metrics->timestamp = timestamp;
+  metrics->nbprocs = nbprocs;
+  metrics->nbtrees = 0;
+  for (int i = 0; i < registry->nbtrees; i++) {
+    if (registry->trees[i].registered == 0) {
+      continue;
+    }
+    if (metrics->nbtrees == metrics->capacity) {
+      metrics->capacity = metrics->capacity ? 2 * metrics->capacity : 16;
+      metrics->trees = xreallocarray (metrics->trees, metrics->capacity, sizeof (registered_tree_t));
+    }
+    metrics->trees[metrics->nbtrees++] = registry->trees[i];
+  }
+  metrics->stats = *stats;
+  metrics->skipped = exporter->skipped;
+
+  pthread_mutex_lock (&exporter->lock);
+  exporter->front = back;
+  pthread_mutex_unlock (&exporter->lock);
+}
+
+/* Send the LEN bytes of DATA to client FD.
+   On success, return 0; on error, return 1.  */
+static int
+send_all (int fd, const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t written = send (fd, data, len, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 1;
+    }
+    data += written;
+    len -= written;
+  }
+  return 0;
+}
+
+/* Read the request of client FD and answer it.  */
+static void
+serve_client (exporter_t *exporter, int fd)
+{
+  char request[MAX_REQUEST_LEN + 1];
+  size_t request_len = 0;
+  while (request_len < MAX_REQUEST_LEN) {
+    ssize_t len = recv (fd, request + request_len, MAX_REQUEST_LEN - request_len, 0);
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      /* Closed, or timed out.  */
+      return;
+    }
+    request_len += len;
+    request[request_len] = 0;
+    if (strstr (request, "\r\n\r\n") != NULL || strstr (request, "\n\n") != NULL) {
+      break;
+    }
+  }
+
+  if (strncmp (request, "GET ", 4) != 0) {
+    static const char not_allowed[] = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send_all (fd, not_allowed, strlen (not_allowed));
+    return;
+  }
+
+  char *body = NULL;
+  size_t body_len = 0;
+  FILE *output = open_memstream (&body, &body_len);
+  if (output == NULL) {
+    perror ("could not open a memory stream");
+    return;
+  }
+
+  pthread_mutex_lock (&exporter->lock);
+  int front = exporter->front;
+  if (front >= 0) {
+    exporter->readers[front]++;
+  }
+  pthread_mutex_unlock (&exporter->lock);
+
+  exporter_format (front >= 0 ? exporter->buffers + front : NULL, output);
+
+  if (front >= 0) {
+    pthread_mutex_lock (&exporter->lock);
+    exporter->readers[front]--;
+    pthread_mutex_unlock (&exporter->lock);
+  }
+  fclose (output);
+
+  char header[256];
+  int header_len = snprintf (header, sizeof header,
+                             "HTTP/1.0 200 OK\r\n"
+                             "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                             "Content-Length: %zu\r\n"
+                             "Connection: close\r\n\r\n", body_len);
+  if (! send_all (fd, header, header_len)) {
+    send_all (fd, body, body_len);
+  }
+  free (body);
+}
+
+/* Serve the clients of EXPORTER forever.  */
+static void *
+serve_clients (void *data)
+{
+  exporter_t *exporter = data;
+  while (1) {
+    int fd = accept (exporter->listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno != EINTR) {
+        perror ("could not accept a metrics connection");
+        sleep (1);
+      }
+      continue;
+    }
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+    serve_client (exporter, fd);
+    close (fd);
+  }
+  return NULL;
+}
+
+/* Create the socket of EXPORTER, listening on ADDRESS.
+   On success, return 0; on error, print a message and return 1.  */
+static int
+exporter_listen (exporter_t *exporter, const char *address)
+{
+  if (string_has_only_digits (address)) {
+    int port = atoi (address);
+    if (port < 1 || port > 65535) {
+      fprintf (stderr, "bad metrics port %s\n", address);
+      return 1;
+    }
+    exporter->listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+    if (exporter->listen_fd < 0) {
+      perror ("could not create the metrics socket");
+      return 1;
+    }
+    int one = 1;
+    setsockopt (exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    struct sockaddr_in inet_address;
+    memset (&inet_address, 0, sizeof inet_address);
+    inet_address.sin_family = AF_INET;
+    inet_address.sin_port = htons (port);
+    inet_address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (bind (exporter->listen_fd, (struct sockaddr *) &inet_address, sizeof inet_address)) {
+      fprintf (stderr, "could not bind to 127.0.0.1:%d: ", port);
+      perror ("");
+      return 1;
+    }
+  } else {
+    struct sockaddr_un unix_address;
+    memset (&unix_address, 0, sizeof unix_address);
+    unix_address.sun_family = AF_UNIX;
+    if (strlen (address) >= sizeof unix_address.sun_path) {
+      fprintf (stderr, "metrics socket name too long: %s\n", address);
+      return 1;
+    }
+    strcpy (unix_address.sun_path, address);
+    exporter->listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (exporter->listen_fd < 0) {
+      perror ("could not create the metrics socket");
+      return 1;
+    }
+    /* Remove the socket of a previous capture, if any, but nothing
+       else.  */
+    struct stat old;
+    if (lstat (address, &old) == 0) {
+      if (! S_ISSOCK (old.st_mode)) {
+        fprintf (stderr, "%s exists and is not a socket\n", address);
+        return 1;
+      }
+      if (unlink (address)) {
+        fprintf (stderr, "could not remove the old %s: ", address);
+        perror ("");
+        return 1;
+      }
+    } else if (errno != ENOENT) {
+      fprintf (stderr, "could not stat %s: ", address);
+      perror ("");
+      return 1;
+    }
+    if (bind (exporter->listen_fd, (struct sockaddr *) &unix_address, sizeof unix_address)) {
+      fprintf (stderr, "could not bind to %s: ", address);
+      perror ("");
+      return 1;
+    }
+  }
+
+  if (listen (exporter->listen_fd, 16)) {
+    perror ("could not listen on the metrics socket");
+    return 1;
+  }
+  return 0;
+}
+
+/* Listen on ADDRESS and serve the metrics from a new thread.  */
+int
+exporter_start (exporter_t *exporter, const char *address)
+{
+  memset (exporter, 0, sizeof *exporter);
+  exporter->front = -1;
+  if (exporter_listen (exporter, address)) {
+    return 1;
+  }
+  pthread_mutex_init (&exporter->lock, NULL);
+
+  /* Leave the signals, e.g. SIGUSR1, to the sampling thread.  */
+  sigset_t all, old;
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  int error = pthread_create (&exporter->thread, NULL, serve_clients, exporter);
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+  if (error) {
+    fprintf (stderr, "could not start the metrics thread: %s\n", strerror (error));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include "registry.h"           /* registry_t.  */
+#include "capture-stats.h"      /* capture_stats_t.  */
+
+#include <pthread.h>            /* pthread_t.  */
+#include <stdio.h>              /* FILE.  */
+#include <time.h>               /* time_t.  */
+
+/* What the capture publishes for the exporter after each sample.  */
+typedef struct {
+  /* Time of the latest snapshot, and its number of processes.  */
+  time_t timestamp;
+  int nbprocs;
+  /* Registered trees whose totals were computed on that snapshot.  */
+  registered_tree_t *trees;
+  int nbtrees;
+  int capacity;
+  capture_stats_t stats;
+  /* Samples that could not be published because a scrape was still
+     reading the previous ones.  */
+  long long skipped;
+} metrics_t;
+
+/* OpenMetrics endpoint of a capture.  The capture publishes into the
+   buffer that is not the front one, then makes it the front one;
+   scrapes read the front one.  Neither waits for the other but for
+   swapping FRONT.  */
+typedef struct {
+  int listen_fd;
+  pthread_t thread;
+  /* Protects FRONT and READERS.  */
+  pthread_mutex_t lock;
+  metrics_t buffers[2];
+  /* Index of the buffer last published, -1 before the first
+     sample.  */
+  int front;
+  /* Number of scrapes reading each buffer.  */
+  int readers[2];
+  /* Publications skipped so far.  */
+  long long skipped;
+} exporter_t;
+
+/* Listen on ADDRESS, either a TCP port on 127.0.0.1 or the file name
+   of a Unix socket, and serve the metrics that will be published into
+   EXPORTER from a new thread.
+   On success, return 0; on error, print a message and return 1.  */
+int
+exporter_start (exporter_t *exporter, const char *address);
+
+/* Publish the metrics of the sample taken at TIMESTAMP, with NBPROCS
+   processes: the registered trees of REGISTRY and STATS.  Never waits
+   for a scrape: if one is still reading the buffer to publish into,
+   the sample is skipped.  */
+void
+exporter_publish (exporter_t *exporter, time_t timestamp, int nbprocs, const registry_t *registry, const capture_stats_t *stats);
+
+/* Write METRICS, or no sample metrics if it is NULL, and the CPU time
+   of the process into OUTPUT in the OpenMetrics text format.  */
+void
+exporter_format (const metrics_t *metrics, FILE *output);
+
+#endif /* EXPORTER_H */
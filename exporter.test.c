@@ -0,0 +1,146 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as open_memstream ().  */
+#define _GNU_SOURCE
+
+#include "exporter.test.h"
+
+#include "exporter.h"           /* exporter_format ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strstr ().  */
+
+/* Check that the text of one registered tree and a few counters is
+   well-formed.  */
+static int
+test_exporter_format (void)
+{
+  registered_tree_t tree;
+  memset (&tree, 0, sizeof tree);
+  tree.id.pid = 1234;
+  tree.id.has_start_time = 1;
+  tree.id.start_time = 8840341;
+  tree.registered = 1000;
+  tree.totals.VmRSS = 10;
+  tree.max.VmRSS = 20;
+  tree.totals.Utime = 150;
+  tree.totals.Cstime = 1;
+  tree.totals.IoWrite = 3;
+
+  metrics_t metrics;
+  memset (&metrics, 0, sizeof metrics);
+  metrics.timestamp = 1700000000;
+  metrics.nbprocs = 42;
+  metrics.trees = &tree;
+  metrics.nbtrees = 1;
+  metrics.stats.samples = 3;
+  stats_record (&metrics.stats, PHASE_LOCK, 1000);
+  stats_record (&metrics.stats, PHASE_LOCK, 3000);
+
+  char *text = NULL;
+  size_t text_len = 0;
+  FILE *output = open_memstream (&text, &text_len);
+  exporter_format (&metrics, output);
+  fclose (output);
+
+  static const char *const expected[] = {
+    "\nprocess_watcher_snapshot_timestamp_seconds 1700000000\n",
+    "\nprocess_watcher_processes 42\n",
+    "\nprocess_watcher_tree_bytes{pid=\"1234\",start_time=\"8840341\",field=\"VmRSS\"} 10240\n",
+    "\nprocess_watcher_tree_max_bytes{pid=\"1234\",start_time=\"8840341\",field=\"VmRSS\"} 20480\n",
+    "\nprocess_watcher_tree_cpu_seconds{pid=\"1234\",start_time=\"8840341\"} 1.51\n",
+    "\nprocess_watcher_tree_io_bytes{pid=\"1234\",start_time=\"8840341\",direction=\"write\"} 3072\n",
+    "\nprocess_watcher_samples_total 3\n",
+    "\nprocess_watcher_phase_seconds_bucket{phase=\"lock\",le=\"0.000001024\"} 1\n",
+    "\nprocess_watcher_phase_seconds_bucket{phase=\"lock\",le=\"0.000004096\"} 2\n",
+    "\nprocess_watcher_phase_seconds_bucket{phase=\"lock\",le=\"+Inf\"} 2\n",
+    "\nprocess_watcher_phase_seconds_count{phase=\"lock\"} 2\n",
+  };
+  int error = 0;
+  for (size_t i = 0; i < sizeof expected / sizeof expected[0]; i++) {
+    if (strstr (text, expected[i]) == NULL) {
+      fprintf (stderr, "missing metric line: %s", expected[i] + 1);
+      error = 1;
+    }
+  }
+  if (strstr (text, "field=\"Utime\"") != NULL) {
+    fprintf (stderr, "the CPU fields are exported as bytes\n");
+    error = 1;
+  }
+  if (text_len < 6 || strcmp (text + text_len - 6, "# EOF\n") != 0) {
+    fprintf (stderr, "the metrics do not end with # EOF\n");
+    error = 1;
+  }
+  free (text);
+  return error;
+}
+
+/* Check that a sample is skipped, rather than written into a buffer
+   that a scrape is reading.  */
+static int
+test_exporter_publish (void)
+{
+  exporter_t exporter;
+  memset (&exporter, 0, sizeof exporter);
+  exporter.front = -1;
+  pthread_mutex_init (&exporter.lock, NULL);
+  registry_t registry;
+  memset (&registry, 0, sizeof registry);
+  capture_stats_t stats;
+  memset (&stats, 0, sizeof stats);
+
+  int error = 0;
+  exporter_publish (&exporter, 1000, 1, &registry, &stats);
+  int read_buffer = exporter.front;
+  /* A scrape starts reading the front buffer...  */
+  exporter.readers[read_buffer]++;
+  /* ... and two samples are taken meanwhile.  */
+  exporter_publish (&exporter, 1002, 2, &registry, &stats);
+  exporter_publish (&exporter, 1004, 3, &registry, &stats);
+  if (exporter.buffers[read_buffer].timestamp != 1000 || exporter.skipped != 1) {
+    fprintf (stderr, "a buffer being read was overwritten\n");
+    error = 1;
+  }
+  if (exporter.front == read_buffer || exporter.buffers[exporter.front].timestamp != 1002) {
+    fprintf (stderr, "the sample taken during the scrape was not published\n");
+    error = 1;
+  }
+  exporter.readers[read_buffer]--;
+  exporter_publish (&exporter, 1006, 4, &registry, &stats);
+  if (exporter.front != read_buffer || exporter.buffers[read_buffer].timestamp != 1006
+      || exporter.buffers[read_buffer].skipped != 1) {
+    fprintf (stderr, "the sample taken after the scrape was not published\n");
+    error = 1;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    free (exporter.buffers[i].trees);
+  }
+  pthread_mutex_destroy (&exporter.lock);
+  return error;
+}
+
+/* Run all tests on the exporter.c file.  */
+void
+test_exporter (void)
+{
+  if (test_exporter_format () + test_exporter_publish ()) {
+    exit (1);
+  }
+}
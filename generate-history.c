@@ -0,0 +1,538 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "bench.h"              /* BENCH_ROOT_PID.  */
+#include "history.h"            /* history_write_snapshot ().  */
+#include "index.h"              /* index_add ().  */
+#include "names.h"              /* identity_field ().  */
+#include "parse-time.h"         /* format_time ().  */
+#include "smaps.h"              /* smaps_field ().  */
+#include "usage.h"              /* counter_field ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/stat.h>           /* mkdir ().  */
+#include <errno.h>              /* errno.  */
+#include <getopt.h>             /* getopt_long ().  */
+#include <limits.h>             /* INT_MAX, PATH_MAX.  */
+#include <stdint.h>             /* uint64_t.  */
+#include <stdio.h>              /* fopen ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memmove ().  */
+
+/*
+ * Write a synthetic process-watcher.out, and its index, into the
+ * current directory, in the same format as "process-watcher capture".
+ *
+ * Process 1 is init.  The tree rooted at BENCH_ROOT_PID (a build)
+ * holds about 70% of the processes, up to DEPTH levels deep; the other
+ * processes are children of init.  At each snapshot, CHURN percent of
+ * the processes exit and are replaced with new ones, whose PIDs are
+ * allocated like the kernel does, wrapping around at PID_MAX.  The
+ * children of an exiting process are reparented to its parent, as
+ * with a subreaper.  The resident size of each process is drawn
+ * between 1 MB and 1 GB, and varies by up to 5% at each snapshot.
+ *
+ * With --procfs=DIR, write instead the processes of the first
+ * snapshot as a fake procfs tree into DIR: a DIR/PID/status file like
+ * the kernel's, and a DIR/PID/stat file, for each process.  Some of
+ * the processes outside of the tree are kernel threads, without any
+ * memory lines in their status.
+ */
+
+/* Highest PID plus one, as in /proc/sys/kernel/pid_max on 64-bit
+   systems.  */
+#define PID_MAX 4194304
+
+/* First PID used when the PIDs wrap around.  */
+#define PID_MIN_WRAPPED 300
+
+/* Time of the first snapshot: 2025-01-01 00:00:00 UTC.  */
+#define BEGIN_TIME 1735689600
+
+/* Clock ticks per second, for the start times.  */
+#define TICKS_PER_SECOND 100
+
+/* Print the help message.  */
+static void
+usage (void) {
+  puts ("generate-history [OPTION...]\n"
+        " Write a synthetic process-watcher.out and its index into the\n"
+        " current directory, and describe it as a JSON line on stdout.\n"
+        "Options:\n"
+        "  --processes=N   Number of live processes (default 2000).\n"
+        "  --depth=D       Maximum depth of the process tree (default 8).\n"
+        "  --churn=P       Percentage of processes replaced at each snapshot\n"
+        "                  (default 2).\n"
+        "  --snapshots=N   Number of snapshots (default 1000).\n"
+        "  --interval=S    Seconds between snapshots (default 2).\n"
+        "  --seed=N        Seed of the random generator (default 1).\n"
+        "  --fields=LIST   Only record the memory fields in LIST, separated by\n"
+        "                  commas, as with process-watcher capture --fields.\n"
+        "  --procfs=DIR    Write the processes as a fake procfs tree into DIR\n"
+        "                  instead, for process-watcher capture --proc-root=DIR.\n"
+        "  -h, --help      Show this help.");
+}
+
+/* State of the random generator.  */
+static uint64_t random_state;
+
+/* Return a pseudo-random number (splitmix64), the same on all
+   platforms for a given seed.  */
+static uint64_t
+next_random (void)
+{
+  uint64_t z = (random_state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Return a pseudo-random number between 0 and N - 1.  */
+static int
+random_below (int n)
+{
+  return (int) (next_random () % (uint64_t) n);
+}
+
+/* Live processes, in ascending PID order, with their depth in the
+   tree (-1 outside of it) and resident size.  */
+static stat_struct_t *procs;
+static int *depths;
+static int *rss;
+static int nbprocs;
+
+/* Which PIDs are in use.  */
+static unsigned char pid_used[PID_MAX / 8];
+
+/* Last PID allocated.  */
+static int last_pid = BENCH_ROOT_PID;
+
+/* Return the index of PID in PROCS, or of the first process with a
+   larger PID if it is not there.  */
+static int
+find_index (int pid)
+{
+  int low = 0;
+  int high = nbprocs;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (procs[middle].Pid < pid) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/* Allocate a PID like the kernel: the next unused one, wrapping
+   around.  */
+static int
+allocate_pid (void)
+{
+  do {
+    last_pid++;
+    if (last_pid >= PID_MAX) {
+      last_pid = PID_MIN_WRAPPED;
+    }
+  } while (pid_used[last_pid / 8] & (1 << (last_pid % 8)));
+  pid_used[last_pid / 8] |= 1 << (last_pid % 8);
+  return last_pid;
+}
+
+/* Start process PID, child of PPID at depth DEPTH, at TIMESTAMP.  */
+static void
+add_proc (int pid, int ppid, int depth, time_t timestamp)
+{
+  int i = find_index (pid);
+  memmove (procs + i + 1, procs + i, (nbprocs - i) * sizeof *procs);
+  memmove (depths + i + 1, depths + i, (nbprocs - i) * sizeof *depths);
+  memmove (rss + i + 1, rss + i, (nbprocs - i) * sizeof *rss);
+  nbprocs++;
+
+  memset (procs + i, 0, sizeof *procs);
+  procs[i].Pid = pid;
+  procs[i].PPid = ppid;
+  procs[i].StartTime = (unsigned int) ((timestamp - BEGIN_TIME + 86400) * TICKS_PER_SECOND);
+  depths[i] = depth;
+  rss[i] = (1024 << random_below (10)) + random_below (1024);
+}
+
+/* Start a new process at TIMESTAMP, in the tree with probability 70%
+   (below a random member less than MAX_DEPTH deep), else as a child
+   of init.  */
+static void
+spawn (int max_depth, time_t timestamp)
+{
+  int pid = allocate_pid ();
+  if (random_below (10) < 7) {
+    /* Pick random processes until one is a suitable parent.  The root
+       always is, so this ends quickly.  */
+    while (1) {
+      int parent = random_below (nbprocs);
+      if (depths[parent] >= 0 && depths[parent] < max_depth) {
+        add_proc (pid, procs[parent].Pid, depths[parent] + 1, timestamp);
+        return;
+      }
+    }
+  }
+  add_proc (pid, 1, -1, timestamp);
+}
+
+/* Make a random process exit, other than init and the root.  */
+static void
+kill_random (void)
+{
+  int i;
+  do {
+    i = random_below (nbprocs);
+  } while (procs[i].Pid == 1 || procs[i].Pid == BENCH_ROOT_PID);
+
+  int pid = procs[i].Pid;
+  int ppid = procs[i].PPid;
+  for (int j = 0; j < nbprocs; j++) {
+    if (procs[j].PPid == pid) {
+      procs[j].PPid = ppid;
+    }
+  }
+  pid_used[pid / 8] &= ~(1 << (pid % 8));
+
+  memmove (procs + i, procs + i + 1, (nbprocs - i - 1) * sizeof *procs);
+  memmove (depths + i, depths + i + 1, (nbprocs - i - 1) * sizeof *depths);
+  memmove (rss + i, rss + i + 1, (nbprocs - i - 1) * sizeof *rss);
+  nbprocs--;
+}
+
+/* Set the memory fields of the processes from their resident size,
+   after letting it vary.  The fields other than VmRSS are only there
+   to take their share of the bandwidth.  */
+static void
+update_memory (void)
+{
+  for (int i = 0; i < nbprocs; i++) {
+    rss[i] += (random_below (21) - 10) * (rss[i] / 200);
+    if (rss[i] < 1024) {
+      rss[i] = 1024;
+    }
+    for (int field = 0; field < NB_FIELDS; field++) {
+      procs[i].fields[field] = rss[i] >> (field % 4);
+    }
+    procs[i].VmRSS = rss[i];
+  }
+}
+
+/* Names given to the processes.  */
+static const char *const proc_names[] = {
+  "make", "cc1plus", "ld", "bash", "python3", "java", "ninja", "Web Content",
+};
+
+/* Create DIR/NAME, or exit.  */
+static FILE *
+create_file (const char *dir, const char *name)
+{
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/%s", dir, name);
+  FILE *file = fopen (filename, "w");
+  if (file == NULL) {
+    fprintf (stderr, "could not create %s: ", filename);
+    perror ("");
+    exit (1);
+  }
+  return file;
+}
+
+/* Write the status and stat files of process I into DIR/PID.  */
+static void
+write_proc (const char *root, int i)
+{
+  const stat_struct_t *proc = procs + i;
+  char dir[PATH_MAX];
+  snprintf (dir, sizeof dir, "%s/%d", root, proc->Pid);
+  if (mkdir (dir, 0755) && errno != EEXIST) {
+    fprintf (stderr, "could not create %s: ", dir);
+    perror ("");
+    exit (1);
+  }
+
+  int kernel_thread = depths[i] < 0 && proc->Pid % 20 == 0;
+  char name[16];
+  if (kernel_thread) {
+    snprintf (name, sizeof name, "kworker/%d:1", proc->Pid % 64);
+  } else {
+    snprintf (name, sizeof name, "%s", proc_names[proc->Pid % (sizeof proc_names / sizeof proc_names[0])]);
+  }
+
+  FILE *status_file = create_file (dir, "status");
+  fprintf (status_file,
+           "Name:\t%s\n"
+           "Umask:\t0022\n"
+           "State:\tS (sleeping)\n"
+           "Tgid:\t%d\n"
+           "Ngid:\t0\n"
+           "Pid:\t%d\n"
+           "PPid:\t%d\n"
+           "TracerPid:\t0\n"
+           "Uid:\t1000\t1000\t1000\t1000\n"
+           "Gid:\t1000\t1000\t1000\t1000\n"
+           "FDSize:\t64\n"
+           "Groups:\t4 24 27 1000 \n"
+           "NStgid:\t%d\n"
+           "NSpid:\t%d\n"
+           "NSpgid:\t%d\n"
+           "NSsid:\t%d\n",
+           name, proc->Pid, proc->Pid, proc->PPid, proc->Pid, proc->Pid, proc->Pid, proc->Pid);
+  if (! kernel_thread) {
+    /* The other fields are read from /proc/PID/stat, io and
+       smaps_rollup, or are not read from /proc.  */
+    for (int f = 0; f < NB_FIELDS; f++) {
+      if (! counter_field (f) && ! smaps_field (f) && ! identity_field (f)) {
+        fprintf (status_file, "%s:\t%8d kB\n", field_names[f], proc->fields[f]);
+      }
+    }
+  }
+  fprintf (status_file,
+           "Threads:\t1\n"
+           "SigQ:\t0/63459\n"
+           "SigPnd:\t0000000000000000\n"
+           "ShdPnd:\t0000000000000000\n"
+           "SigBlk:\t0000000000000000\n"
+           "SigIgn:\t0000000000001000\n"
+           "SigCgt:\t0000000188004002\n"
+           "CapInh:\t0000000000000000\n"
+           "CapPrm:\t0000000000000000\n"
+           "CapEff:\t0000000000000000\n"
+           "CapBnd:\t000001ffffffffff\n"
+           "CapAmb:\t0000000000000000\n"
+           "NoNewPrivs:\t0\n"
+           "Seccomp:\t0\n"
+           "Seccomp_filters:\t0\n"
+           "Speculation_Store_Bypass:\tthread vulnerable\n"
+           "SpeculationIndirectBranch:\tconditional enabled\n"
+           "Cpus_allowed:\tff\n"
+           "Cpus_allowed_list:\t0-7\n"
+           "Mems_allowed:\t00000000,00000001\n"
+           "Mems_allowed_list:\t0\n"
+           "voluntary_ctxt_switches:\t%d\n"
+           "nonvoluntary_ctxt_switches:\t%d\n",
+           proc->Pid % 997, proc->Pid % 13);
+  if (fclose (status_file)) {
+    perror ("could not write a status file");
+    exit (1);
+  }
+
+  FILE *stat_file = create_file (dir, "stat");
+  fprintf (stat_file, "%d (%s) S %d %d %d 0 -1 4194304 1042 0 0 0 17 4 0 0 20 0 1 0 %u %lld %d 18446744073709551615 1 1 0 0 0 0 0 4096 134295555 0 0 0 17 3 0 0 0 0 0\n",
+           proc->Pid, name, proc->PPid, proc->Pid, proc->Pid, proc->StartTime,
+           kernel_thread ? 0 : proc->VmSize * 1024LL, kernel_thread ? 0 : proc->VmRSS / 4);
+  if (fclose (stat_file)) {
+    perror ("could not write a stat file");
+    exit (1);
+  }
+}
+
+/* Parse the integer option argument ARG of option NAME, which must be
+   at least MIN.  Exit on error.  */
+static int
+parse_int (const char *name, const char *arg, int min)
+{
+  char *end;
+  long value = strtol (arg, &end, 10);
+  if (end == arg || *end != 0 || value < min || value > INT_MAX) {
+    fprintf (stderr, "invalid value %s for %s\n", arg, name);
+    exit (1);
+  }
+  return (int) value;
+}
+
+/* Values returned by getopt_long () for options without a short
+   form.  */
+enum {
+  OPT_PROCESSES = 256,
+  OPT_DEPTH,
+  OPT_CHURN,
+  OPT_SNAPSHOTS,
+  OPT_INTERVAL,
+  OPT_SEED,
+  OPT_FIELDS,
+  OPT_PROCFS,
+};
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option long_opt[] = {
+    { "help", no_argument, NULL, 'h' },
+    { "processes", required_argument, NULL, OPT_PROCESSES },
+    { "depth", required_argument, NULL, OPT_DEPTH },
+    { "churn", required_argument, NULL, OPT_CHURN },
+    { "snapshots", required_argument, NULL, OPT_SNAPSHOTS },
+    { "interval", required_argument, NULL, OPT_INTERVAL },
+    { "seed", required_argument, NULL, OPT_SEED },
+    { "fields", required_argument, NULL, OPT_FIELDS },
+    { "procfs", required_argument, NULL, OPT_PROCFS },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int nb_target = 2000;
+  int max_depth = 8;
+  int churn = 2;
+  int nb_snapshots = 1000;
+  int interval = 2;
+  int seed = 1;
+  const char *procfs = NULL;
+  schema_t schema;
+  schema_init (&schema);
+
+  while (1) {
+    const int c = getopt_long (argc, argv, "h", long_opt, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case 'h':
+      usage ();
+      return 0;
+    case OPT_PROCESSES:
+      nb_target = parse_int ("--processes", optarg, 2);
+      break;
+    case OPT_DEPTH:
+      max_depth = parse_int ("--depth", optarg, 1);
+      break;
+    case OPT_CHURN:
+      churn = parse_int ("--churn", optarg, 0);
+      break;
+    case OPT_SNAPSHOTS:
+      nb_snapshots = parse_int ("--snapshots", optarg, 1);
+      break;
+    case OPT_INTERVAL:
+      interval = parse_int ("--interval", optarg, 1);
+      break;
+    case OPT_SEED:
+      seed = parse_int ("--seed", optarg, 0);
+      break;
+    case OPT_FIELDS:
+      if (schema_select (&schema, optarg)) {
+        return 1;
+      }
+      break;
+    case OPT_PROCFS:
+      procfs = optarg;
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (optind < argc) {
+    fprintf (stderr, "too many arguments\n");
+    return 1;
+  }
+  if (nb_target >= PID_MAX - PID_MIN_WRAPPED) {
+    fprintf (stderr, "too many processes\n");
+    return 1;
+  }
+  random_state = seed;
+
+  procs = xreallocarray (NULL, nb_target, sizeof *procs);
+  depths = xreallocarray (NULL, nb_target, sizeof *depths);
+  rss = xreallocarray (NULL, nb_target, sizeof *rss);
+
+  /* Start init, the root, and the rest.  */
+  time_t now = BEGIN_TIME;
+  pid_used[1 / 8] |= 1 << (1 % 8);
+  pid_used[BENCH_ROOT_PID / 8] |= 1 << (BENCH_ROOT_PID % 8);
+  add_proc (1, 0, -1, now);
+  add_proc (BENCH_ROOT_PID, 1, 0, now);
+  while (nbprocs < nb_target) {
+    spawn (max_depth, now);
+  }
+
+  if (procfs != NULL) {
+    if (mkdir (procfs, 0755) && errno != EEXIST) {
+      fprintf (stderr, "could not create %s: ", procfs);
+      perror ("");
+      exit (1);
+    }
+    update_memory ();
+    for (int i = 0; i < nbprocs; i++) {
+      write_proc (procfs, i);
+    }
+    printf ("{\"generator\": \"generate-history\", \"processes\": %d, \"depth\": %d, \"seed\": %d, "
+            "\"pid\": %d, \"procfs\": \"%s\"}\n",
+            nb_target, max_depth, seed, BENCH_ROOT_PID, procfs);
+    return 0;
+  }
+
+  FILE *output = fopen (history_filename, "w");
+  if (output == NULL) {
+    fprintf (stderr, "could not open %s for writing: ", history_filename);
+    perror ("");
+    exit (1);
+  }
+  uint64_t history_len = history_write_header (&schema, output);
+  if (history_len == 0) {
+    perror ("could not write the header");
+    exit (1);
+  }
+  index_writer_t index_writer;
+  index_create (&index_writer, history_len);
+
+  /* Number of processes to replace at each snapshot, in hundredths.  */
+  long long churn_debt = 0;
+
+  for (int s = 0; s < nb_snapshots; s++) {
+    now = BEGIN_TIME + (time_t) s * interval;
+    if (s > 0) {
+      churn_debt += (long long) nbprocs * churn;
+      for (; churn_debt >= 100; churn_debt -= 100) {
+        kill_random ();
+        spawn (max_depth, now);
+      }
+    }
+    update_memory ();
+
+    snapshot_t snapshot = {
+      .timestamp = now,
+      .nbpids = nbprocs,
+      .procs = procs,
+    };
+    size_t snapshot_len = history_write_snapshot (&schema, &snapshot, output);
+    if (snapshot_len == 0) {
+      perror ("could not write a snapshot");
+      exit (1);
+    }
+    history_len += snapshot_len;
+    index_add (&index_writer, &snapshot, history_len);
+  }
+
+  if (fclose (output) || fclose (index_writer.output)) {
+    perror ("could not close the output");
+    exit (1);
+  }
+
+  char begin_string[15];
+  char end_string[15];
+  format_time (BEGIN_TIME, begin_string);
+  format_time (now, end_string);
+  printf ("{\"generator\": \"generate-history\", \"processes\": %d, \"depth\": %d, \"churn\": %d, "
+          "\"snapshots\": %d, \"interval\": %d, \"seed\": %d, \"bytes\": %llu, "
+          "\"pid\": %d, \"begin\": \"%s\", \"end\": \"%s\"}\n",
+          nb_target, max_depth, churn, nb_snapshots, interval, seed, (unsigned long long) history_len,
+          BENCH_ROOT_PID, begin_string, end_string);
+  return 0;
+}
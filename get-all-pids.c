@@ -17,6 +17,7 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 
 #include "get-all-pids.h"
 #include "string-has-only-digits.h"
+#include "proc-root.h"          /* proc_root.  */
 
 #include "xmalloc.h"
 
@@ -36,7 +37,7 @@ compare_pids (const void *a, const void *b)
   return (*da > *db) - (*da < *db);
 }
 
-/* List all PIDs by looking at /proc.
+/* List all PIDs by looking at /proc, or rather proc_root.
    The PIDs are sorted by ascending PID order.
    Both pids and pnbpids are output arguments.
    The caller should not try deallocating the returned array. */
@@ -52,9 +53,9 @@ get_all_pids (pid_t ** pids, int *pnbpids) {
     ret = (pid_t *) xmalloc(capacity * sizeof (pid_t));
   }
 
-  DIR *procdir = opendir("/proc");
+  DIR *procdir = opendir(proc_root);
   if (procdir == NULL) {
-    fprintf (stderr, "could not opendir /proc: %s\n", strerror (errno));
+    fprintf (stderr, "could not opendir %s: %s\n", proc_root, strerror (errno));
     exit (1);
   }
 
@@ -66,7 +67,7 @@ get_all_pids (pid_t ** pids, int *pnbpids) {
         /* No issue, we just reached the end of the directory.  */
         break;
       } else {
-        perror ("could not read a /proc direntry");
+        fprintf (stderr, "could not read a %s direntry: %s\n", proc_root, strerror (errno));
         exit (1);
       }
     }
@@ -97,7 +98,7 @@ get_all_pids (pid_t ** pids, int *pnbpids) {
   }
 
   if (closedir (procdir)) {
-    perror ("could not closedir /proc");
+    fprintf (stderr, "could not closedir %s: %s\n", proc_root, strerror (errno));
     exit (1);
   }
 
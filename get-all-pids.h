@@ -17,7 +17,7 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 
 #include <unistd.h>
 
-/* List all PIDs by looking at /proc.
+/* List all PIDs by looking at /proc, or rather proc_root.
    The PIDs are sorted by ascending PID order.
    Both pids and pnbpids are output arguments.
    The caller should not try deallocating the returned array. */
@@ -0,0 +1,80 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "histogram.h"
+
+/* Return the bucket of VALUE: VALUE itself if it is small, else the
+   power of 2 below it and its HISTOGRAM_SUB_BITS next bits.  */
+static int
+bucket_of (long long value)
+{
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return value < 0 ? 0 : (int) value;
+  }
+  int shift = 63 - __builtin_clzll ((unsigned long long) value) - HISTOGRAM_SUB_BITS;
+  return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int) ((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/* Return the largest value of BUCKET.  */
+static long long
+bucket_last (int bucket)
+{
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  long long first = (long long) (HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+  return first + ((1LL << shift) - 1);
+}
+
+/* Add VALUE to HISTOGRAM.  */
+void
+histogram_add (histogram_t *histogram, long long value)
+{
+  histogram->counts[bucket_of (value)]++;
+  if (histogram->count == 0 || value > histogram->max) {
+    histogram->max = value < 0 ? 0 : value;
+  }
+  histogram->count++;
+}
+
+/* Return the quantile Q of the values of HISTOGRAM.  */
+long long
+histogram_quantile (const histogram_t *histogram, double q)
+{
+  if (histogram->count == 0) {
+    return 0;
+  }
+  double exact = q * histogram->count;
+  uint64_t rank = (uint64_t) exact;
+  if (rank < exact) {
+    rank++;
+  }
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+    seen += histogram->counts[bucket];
+    if (seen >= rank) {
+      long long last = bucket_last (bucket);
+      return last < histogram->max ? last : histogram->max;
+    }
+  }
+  return histogram->max;
+}
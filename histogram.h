@@ -0,0 +1,53 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>             /* uint64_t.  */
+
+/* Number of buckets per power of 2, which bounds the relative error
+   of the quantiles to 1 / HISTOGRAM_SUB_BUCKETS.  */
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+/* Number of buckets: the values below HISTOGRAM_SUB_BUCKETS exactly,
+   then HISTOGRAM_SUB_BUCKETS per power of 2 up to 2^63.  */
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+/* Distribution of non-negative values in log-linear buckets, from
+   which quantiles are read in bounded memory whatever the number of
+   values.  */
+typedef struct {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  /* Number of values, and the largest one.  */
+  uint64_t count;
+  long long max;
+} histogram_t;
+
+/* Add VALUE to HISTOGRAM, which starts zeroed.  Negative values count
+   as 0.  */
+void
+histogram_add (histogram_t *histogram, long long value);
+
+/* Return the quantile Q (between 0 and 1) of the values of HISTOGRAM:
+   the value of rank ceil (Q * count), rounded up to the end of its
+   bucket but not above the max, or 0 if there are no values.  */
+long long
+histogram_quantile (const histogram_t *histogram, double q);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,74 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "histogram.test.h"
+
+#include "histogram.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Check the quantiles of 1 to 1000, and of large values, against the
+   exact ones.  */
+void
+test_histogram (void)
+{
+  int error = 0;
+  static histogram_t histogram;
+
+  if (histogram_quantile (&histogram, 0.5) != 0) {
+    fprintf (stderr, "histogram_quantile () of no values is not 0\n");
+    error = 1;
+  }
+
+  /* Values below HISTOGRAM_SUB_BUCKETS are exact.  */
+  for (int i = 1; i <= 50; i++) {
+    histogram_add (&histogram, i);
+  }
+  if (histogram_quantile (&histogram, 0.5) != 25 || histogram_quantile (&histogram, 0.9) != 45
+      || histogram_quantile (&histogram, 1) != 50 || histogram_quantile (&histogram, 0) != 1) {
+    fprintf (stderr, "histogram_quantile () of 1 to 50: %lld %lld\n",
+             histogram_quantile (&histogram, 0.5), histogram_quantile (&histogram, 0.9));
+    error = 1;
+  }
+
+  /* Larger values are rounded up by less than 1 / 64, but never above
+     the max.  */
+  memset (&histogram, 0, sizeof histogram);
+  for (long long i = 1; i <= 1000; i++) {
+    histogram_add (&histogram, i * 1000000007LL);
+  }
+  static const int percents[] = { 1, 50, 90, 99 };
+  for (size_t i = 0; i < sizeof percents / sizeof percents[0]; i++) {
+    long long exact = percents[i] * 10 * 1000000007LL;
+    long long quantile = histogram_quantile (&histogram, percents[i] / 100.0);
+    if (quantile < exact || quantile > exact + exact / HISTOGRAM_SUB_BUCKETS) {
+      fprintf (stderr, "histogram_quantile () gave p%d = %lld instead of %lld\n", percents[i], quantile, exact);
+      error = 1;
+    }
+  }
+  if (histogram_quantile (&histogram, 1) != 1000 * 1000000007LL || histogram.count != 1000) {
+    fprintf (stderr, "histogram_quantile () gave max = %lld\n", histogram_quantile (&histogram, 1));
+    error = 1;
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
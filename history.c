@@ -0,0 +1,496 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as mremap ().  */
+#define _GNU_SOURCE
+
+#include "history.h"
+
+#include "xmalloc.h"            /* xreallocarray ().  */
+#include "crc32c.h"             /* crc32c ().  */
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open (), posix_fadvise ().  */
+#include <unistd.h>             /* close (), sysconf ().  */
+#include <stdint.h>             /* SIZE_MAX.  */
+#include <stdio.h>              /* fwrite_unlocked ().  */
+#include <stdlib.h>             /* free ().  */
+#include <string.h>             /* memcmp ().  */
+
+/*
+ * FILE FORMAT
+ *
+ * General remarks:
+ * - Field names are case-sensitive.
+ * - Numbers are in host order.
+ * - pid and memory field values are ints.
+ *
+ * File header: "# process-watcher file format 4\n", then the stride
+ * and the fields of the process records (see schema.c).  Its length
+ * is a multiple of 4 for alignment purposes.  Version 3 had no
+ * trailers, version 2 always had all the fields, and version 1 had no
+ * start time.
+ * Then a sequence of snapshots.  Each snapshot looks like this:
+ * - time_t timestamp
+ * - Number of processes in the snapshot, as int
+ * - sequence of process records, in ascending PID number.  Each record
+ *   looks like this, padded to the stride:
+ *   - int pid
+ *   - int ppid
+ *   - unsigned int start time (low 32 bits)
+ *   - the fields of the header, as ints
+ * - trailer: the length of the snapshot up to it (timestamp, number
+ *   of processes and records) as uint64_t, the CRC32C of these bytes
+ *   as uint32_t, and TRAILER_MAGIC as uint32_t.
+ * With all the fields in the order of stat_struct_t, a record is a
+ * stat_struct_t.
+ *
+ * As every part is a multiple of 4 bytes long, the snapshots are at
+ * offsets that are multiples of 4.  The trailers make it possible to
+ * find the last intact snapshot from the end of the file, and the
+ * next intact snapshot after a corrupt one.
+ */
+
+/* Trailer of each snapshot, since format 4.  */
+typedef struct {
+  uint64_t length;
+  uint32_t crc;
+  uint32_t magic;
+} trailer_t;
+
+/* Last field of the trailers: "PWTR" as a little-endian int.  */
+#define TRAILER_MAGIC 0x52545750
+
+/* Length of the timestamp and number of processes that start each
+   snapshot.  */
+#define HEAD_LEN (sizeof (time_t) + sizeof (int))
+
+/* History file name.  */
+const char history_filename[] = "process-watcher.out";
+
+/* Open FILENAME for reading into HISTORY.
+   On success, return 0; on error, return 1.  */
+int
+history_open (history_t *history, const char *filename)
+{
+  memset (history, 0, sizeof *history);
+  history->fd = open (filename, O_RDONLY, 0);
+  if (history->fd < 0) {
+    fprintf (stderr, "could not open %s for reading: ", filename);
+    perror ("");
+    return 1;
+  }
+  return 0;
+}
+
+/* Make HISTORY map a sliding window of WINDOW_SIZE bytes of the
+   file.  */
+void
+history_set_window (history_t *history, size_t window_size)
+{
+  history->window_size = window_size;
+}
+
+/* Unmap the part of HISTORY that is mapped, if any.  */
+static void
+history_unmap (history_t *history)
+{
+  if (history->map != NULL) {
+    munmap (history->map, history->map_len);
+    history->map = NULL;
+    history->map_offset = 0;
+    history->map_len = 0;
+  }
+}
+
+/* Map the window of HISTORY that starts at or just before OFFSET and
+   holds at least LEN bytes.
+   On success, return 0; on error, set HISTORY->failed and return 1.  */
+static int
+history_slide (history_t *history, size_t offset, size_t len)
+{
+  const size_t page_size = sysconf (_SC_PAGESIZE);
+  size_t start = offset & ~(page_size - 1);
+
+  if (history->map != NULL) {
+    /* Drop what was read before the new window from the page cache,
+       so that scanning a large history does not evict everything
+       else.  */
+    if (start > history->map_offset) {
+      size_t consumed_end = start < history->map_offset + history->map_len ? start : history->map_offset + history->map_len;
+      posix_fadvise (history->fd, history->map_offset, consumed_end - history->map_offset, POSIX_FADV_DONTNEED);
+    }
+    history_unmap (history);
+  }
+
+  size_t map_len = offset + len - start;
+  if (map_len < history->window_size) {
+    map_len = history->window_size;
+  }
+  if (map_len > history->file_len - start) {
+    map_len = history->file_len - start;
+  }
+
+  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, history->fd, start);
+  if (map == MAP_FAILED) {
+    perror ("could not mmap the history file");
+    history->failed = 1;
+    return 1;
+  }
+  madvise (map, map_len, MADV_SEQUENTIAL);
+  history->map = map;
+  history->map_offset = start;
+  history->map_len = map_len;
+
+  /* Start reading the next window already.  */
+  if (start + map_len < history->file_len) {
+    posix_fadvise (history->fd, start + map_len, history->window_size, POSIX_FADV_WILLNEED);
+  }
+  return 0;
+}
+
+/* Return a pointer to the LEN bytes of HISTORY at OFFSET, sliding the
+   window if needed, or NULL if they go beyond the end of the file or
+   the window could not be mapped.  */
+static const char *
+history_bytes (history_t *history, size_t offset, size_t len)
+{
+  if (offset + len > history->file_len) {
+    return NULL;
+  }
+  if (offset < history->map_offset || offset + len > history->map_offset + history->map_len) {
+    /* Only possible with a window: otherwise, the whole file is
+       mapped.  */
+    if (history_slide (history, offset, len)) {
+      return NULL;
+    }
+  }
+  return history->map + (offset - history->map_offset);
+}
+
+/* Map whatever was appended to the history since the last call, and
+   check the header.  If the file was truncated or rewritten (e.g. a
+   new capture was started), the index is discarded.  */
+int
+history_update (history_t *history)
+{
+  struct stat st;
+  if (fstat (history->fd, &st)) {
+    perror ("could not stat the history file");
+    return 1;
+  }
+  size_t len = st.st_size;
+
+  if (len < history->indexed_len) {
+    /* The file was truncated: start over.  */
+    history->nb_locations = 0;
+    history->indexed_len = 0;
+  }
+
+  if (history->window_size != 0) {
+    if (history->map_offset + history->map_len > len) {
+      /* The window goes beyond the end of the truncated file.  */
+      history_unmap (history);
+    }
+  } else if (len != history->map_len) {
+    char *map;
+    if (history->map == NULL) {
+      map = (char *) mmap (NULL, len, PROT_READ, MAP_SHARED, history->fd, 0);
+    } else if (len == 0) {
+      munmap (history->map, history->map_len);
+      map = NULL;
+    } else {
+      map = (char *) mremap (history->map, history->map_len, len, MREMAP_MAYMOVE);
+    }
+    if (map == MAP_FAILED) {
+      perror ("could not mmap the history file");
+      return 1;
+    }
+    history->map = map;
+    history->map_len = len;
+  }
+  history->file_len = len;
+
+  /* The header is parsed again each time, in case a new capture
+     started with other fields.  */
+  size_t header_len;
+  size_t header_max_len = len < 4096 ? len : 4096;
+  const char *header = history_bytes (history, 0, header_max_len);
+  if (header == NULL
+      || schema_parse_header (&history->schema, header, header_max_len, &header_len)) {
+    if (header == NULL) {
+      fprintf (stderr, "bad file: too short to contain the header\n");
+    }
+    return 1;
+  }
+  history->first_offset = header_len;
+  const time_t *first_timestamp = (const time_t *) history_bytes (history, header_len, sizeof (time_t));
+  if (history->nb_locations > 0
+      && (first_timestamp == NULL || *first_timestamp != history->locations[0].timestamp)) {
+    /* The file was rewritten from scratch: start over.  */
+    history->nb_locations = 0;
+    history->indexed_len = 0;
+  }
+  if (history->indexed_len == 0) {
+    history->indexed_len = header_len;
+  }
+
+  return 0;
+}
+
+/* Offset of the first snapshot in the file.  */
+size_t
+history_first_offset (const history_t *history)
+{
+  return history->first_offset;
+}
+
+/* Write the header of a history file with SCHEMA into OUTPUT.  */
+size_t
+history_write_header (const schema_t *schema, FILE *output)
+{
+  return schema_write_header (schema, output);
+}
+
+/* Write SNAPSHOT into OUTPUT with the records of SCHEMA.  */
+size_t
+history_write_snapshot (const schema_t *schema, const snapshot_t *snapshot, FILE *output)
+{
+  uint32_t crc = crc32c (0, &snapshot->timestamp, sizeof snapshot->timestamp);
+  crc = crc32c (crc, &snapshot->nbpids, sizeof snapshot->nbpids);
+  if (fwrite_unlocked (&snapshot->timestamp, sizeof snapshot->timestamp, 1, output) != 1
+      || fwrite_unlocked (&snapshot->nbpids, sizeof snapshot->nbpids, 1, output) != 1
+      || schema_write_records (schema, snapshot->procs, snapshot->nbpids, output, &crc)) {
+    return 0;
+  }
+  size_t len = HEAD_LEN + snapshot->nbpids * schema->stride;
+  if (schema->checksums) {
+    trailer_t trailer = {
+      .length = len,
+      .crc = crc,
+      .magic = TRAILER_MAGIC,
+    };
+    if (fwrite_unlocked (&trailer, sizeof trailer, 1, output) != 1) {
+      return 0;
+    }
+    len += sizeof trailer;
+  }
+  return len;
+}
+
+/* Return the length of the snapshot at OFFSET of HISTORY, trailer
+   included, if it is complete (and its CRC is right if CHECK_CRC), or
+   0 otherwise.  */
+static size_t
+snapshot_check (history_t *history, size_t offset, int check_crc)
+{
+  const char *cursor = history_bytes (history, offset, HEAD_LEN);
+  if (cursor == NULL) {
+    return 0;
+  }
+  int nbpids;
+  memcpy (&nbpids, cursor + sizeof (time_t), sizeof nbpids);
+  if (nbpids < 0) {
+    return 0;
+  }
+  size_t len = HEAD_LEN + (size_t) nbpids * history->schema.stride;
+  size_t trailer_len = history->schema.checksums ? sizeof (trailer_t) : 0;
+  if ((cursor = history_bytes (history, offset, len + trailer_len)) == NULL) {
+    return 0;
+  }
+  if (history->schema.checksums) {
+    trailer_t trailer;
+    memcpy (&trailer, cursor + len, sizeof trailer);
+    if (trailer.magic != TRAILER_MAGIC || trailer.length != len
+        || (check_crc && trailer.crc != crc32c (0, cursor, len))) {
+      return 0;
+    }
+  }
+  return len + trailer_len;
+}
+
+/* Return the offset of the intact snapshot of HISTORY whose trailer
+   ends at END, or SIZE_MAX if there is none.  */
+static size_t
+snapshot_ending_at (history_t *history, size_t end)
+{
+  const char *cursor = history_bytes (history, end - sizeof (trailer_t), sizeof (trailer_t));
+  if (cursor == NULL) {
+    return SIZE_MAX;
+  }
+  trailer_t trailer;
+  memcpy (&trailer, cursor, sizeof trailer);
+  if (trailer.magic != TRAILER_MAGIC
+      || trailer.length > end - sizeof trailer - history->first_offset) {
+    return SIZE_MAX;
+  }
+  size_t start = end - sizeof trailer - trailer.length;
+  return snapshot_check (history, start, 1) == end - start ? start : SIZE_MAX;
+}
+
+/* Return the offset of the first intact snapshot of HISTORY after
+   OFFSET, or the length of the file if there is none.  */
+static size_t
+snapshot_resync (history_t *history, size_t offset)
+{
+  if (history->schema.checksums) {
+    for (size_t end = offset + 4 + HEAD_LEN + sizeof (trailer_t); end <= history->file_len && ! history->failed; end += 4) {
+      size_t start = snapshot_ending_at (history, end);
+      if (start != SIZE_MAX && start > offset) {
+        return start;
+      }
+    }
+  }
+  return history->file_len;
+}
+
+/* Return the offset just past the last intact snapshot of HISTORY.  */
+size_t
+history_recover (history_t *history)
+{
+  const size_t min_end = history->first_offset + HEAD_LEN + sizeof (trailer_t);
+  for (size_t end = history->file_len & ~(size_t) 3; end >= min_end; end -= 4) {
+    if (snapshot_ending_at (history, end) != SIZE_MAX) {
+      return end;
+    }
+  }
+  return history->first_offset;
+}
+
+/* Read the snapshot at *OFFSET into SNAPSHOT and move *OFFSET past
+   it.  */
+int
+history_next_snapshot (history_t *history, size_t *offset, snapshot_t *snapshot)
+{
+  if (*offset == history->file_len) {
+    /* We have reached the end of the file, stop here.  */
+    return 1;
+  }
+
+  /* The trailer is enough to find a torn or misplaced snapshot; the
+     CRC is only checked to resync after one.  */
+  size_t snapshot_len = snapshot_check (history, *offset, 0);
+  if (snapshot_len == 0 && history->failed) {
+    return 1;
+  }
+  if (snapshot_len == 0) {
+    /* Go on with the next intact snapshot, if any.  Warn only once,
+       as the same torn end of file may be read again and again.  */
+    size_t next = snapshot_resync (history, *offset);
+    if (history->failed) {
+      return 1;
+    }
+    if (*offset != history->warned_offset) {
+      history->warned_offset = *offset;
+      if (next == history->file_len) {
+        fprintf (stderr, "warning: ignoring the incomplete snapshot at offset %zu of %zu\n", *offset, history->file_len);
+      } else {
+        fprintf (stderr, "warning: skipping the corrupt snapshot at offset %zu, up to offset %zu\n", *offset, next);
+      }
+    }
+    if (next == history->file_len) {
+      return 1;
+    }
+    *offset = next;
+    snapshot_len = snapshot_check (history, *offset, 0);
+  }
+
+  const char *cursor = history_bytes (history, *offset, snapshot_len);
+  memcpy (&snapshot->timestamp, cursor, sizeof snapshot->timestamp);
+  memcpy (&snapshot->nbpids, cursor + sizeof (time_t), sizeof snapshot->nbpids);
+  if (history->schema.native) {
+    snapshot->procs = (stat_struct_t *) (cursor + HEAD_LEN);
+  } else {
+    if (snapshot->nbpids > history->procs_capacity) {
+      history->procs_capacity = snapshot->nbpids;
+      history->procs = xreallocarray (history->procs, history->procs_capacity, sizeof (stat_struct_t));
+    }
+    schema_decode (&history->schema, cursor + HEAD_LEN, snapshot->nbpids, history->procs);
+    snapshot->procs = history->procs;
+  }
+
+  /* Move offset past the snapshot.  */
+  history->snapshot_offset = *offset;
+  *offset += snapshot_len;
+  return 0;
+}
+
+/* Add the snapshots mapped since the last call to the index.  */
+void
+history_index (history_t *history)
+{
+  snapshot_t snapshot;
+  size_t offset = history->indexed_len;
+
+  while (1) {
+    if (history_next_snapshot (history, &offset, &snapshot)) {
+      break;
+    }
+
+    if (history->nb_locations == history->locations_capacity) {
+      history->locations_capacity = history->locations_capacity ? 2 * history->locations_capacity : 1024;
+      history->locations = xreallocarray (history->locations, history->locations_capacity, sizeof (snapshot_location_t));
+    }
+    snapshot_location_t *location = history->locations + history->nb_locations++;
+    location->timestamp = snapshot.timestamp;
+    location->offset = history->snapshot_offset;
+  }
+
+  history->indexed_len = offset;
+}
+
+/* Return the index of the first indexed snapshot whose timestamp is
+   at or after TIME, or HISTORY->nb_locations if there is none.  */
+size_t
+history_find_time (history_t *history, time_t time)
+{
+  size_t low = 0;
+  size_t high = history->nb_locations;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (history->locations[middle].timestamp < time) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/* Read the indexed snapshot number I into SNAPSHOT.  */
+int
+history_get_snapshot (history_t *history, size_t i, snapshot_t *snapshot)
+{
+  size_t offset = history->locations[i].offset;
+  if (history_next_snapshot (history, &offset, snapshot)
+      || history->snapshot_offset != history->locations[i].offset) {
+    fprintf (stderr, "the snapshot at offset %zu of the history file is gone\n", history->locations[i].offset);
+    return 1;
+  }
+  return 0;
+}
+
+/* Unmap and close HISTORY.  */
+void
+history_close (history_t *history)
+{
+  history_unmap (history);
+  free (history->locations);
+  free (history->procs);
+  close (history->fd);
+}
@@ -0,0 +1,155 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "stat-struct.h"        /* snapshot_t.  */
+#include "schema.h"             /* schema_t.  */
+
+#include <stddef.h>             /* size_t.  */
+#include <time.h>               /* time_t.  */
+
+/* Default history file name.  */
+extern const char history_filename[];
+
+/* Position of a complete snapshot in the history file.  */
+typedef struct {
+  time_t timestamp;
+  size_t offset;
+} snapshot_location_t;
+
+/* A history file mapped in memory for reading, with an optional index
+   of its snapshots.  */
+typedef struct {
+  int fd;
+  /* Length of the file at the last history_update ().  */
+  size_t file_len;
+  /* Mapping of the MAP_LEN bytes of the file at offset MAP_OFFSET: the
+     whole file, unless WINDOW_SIZE is set.  */
+  char *map;
+  size_t map_offset;
+  size_t map_len;
+  /* If not 0, only a window of about WINDOW_SIZE bytes of the file is
+     mapped at a time, and it slides as history_next_snapshot () reads
+     further (see history_set_window ()).  */
+  size_t window_size;
+  /* Layout of the records, and offset of the first snapshot, from the
+     header.  */
+  schema_t schema;
+  size_t first_offset;
+  /* Processes of the last snapshot read, if its records had to be
+     decoded.  */
+  stat_struct_t *procs;
+  int procs_capacity;
+  /* Offset of the last snapshot read, and of the last corrupt or
+     incomplete snapshot that was reported.  */
+  size_t snapshot_offset;
+  size_t warned_offset;
+  /* Whether mapping a window of the file failed.  The reads stop
+     there, as at the end of the file.  */
+  int failed;
+  /* Index of the snapshots found by history_index (), in file
+     order.  INDEXED_LEN is the offset just past the last one.  */
+  snapshot_location_t *locations;
+  size_t nb_locations;
+  size_t locations_capacity;
+  size_t indexed_len;
+} history_t;
+
+/* Open FILENAME for reading into HISTORY.
+   On success, return 0; on error, return 1.  */
+int
+history_open (history_t *history, const char *filename);
+
+/* Make HISTORY map a sliding window of WINDOW_SIZE bytes of the file
+   instead of the whole file, so that the memory used to read it is
+   bounded.  The file is then meant to be read from the beginning to
+   the end with history_next_snapshot (), possibly skipping parts of it:
+   the readahead is sequential, and the parts already read are dropped
+   from memory and from the page cache.  history_index () and
+   history_get_snapshot () need the whole file mapped.  Call it before
+   the first history_update ().  */
+void
+history_set_window (history_t *history, size_t window_size);
+
+/* Map whatever was appended to the history since the last call, and
+   check the header.  The caller should hold a read lock on
+   HISTORY->fd.  If the file was truncated or rewritten (e.g. a new
+   capture was started), the index is discarded.
+   On success, return 0; on error, return 1.  */
+int
+history_update (history_t *history);
+
+/* Offset of the first snapshot in the file, once history_update ()
+   has read the header.  */
+size_t
+history_first_offset (const history_t *history);
+
+/* Write the header of a history file with SCHEMA into OUTPUT.
+   Return its length, i.e. the offset of the first snapshot, or 0 on
+   error.  */
+size_t
+history_write_header (const schema_t *schema, FILE *output);
+
+/* Write SNAPSHOT into OUTPUT with the records of SCHEMA, followed by
+   its trailer if SCHEMA has checksums.
+   Return its length, or 0 on error.  */
+size_t
+history_write_snapshot (const schema_t *schema, const snapshot_t *snapshot, FILE *output);
+
+/* Return the offset just past the last intact snapshot of HISTORY,
+   or the offset of its first snapshot if there is none, looking
+   backwards from the end of the file, so that the time it takes
+   depends on the length of the torn end only.  HISTORY must have
+   checksums, and be mapped whole.  */
+size_t
+history_recover (history_t *history);
+
+/* Read the snapshot at *OFFSET into SNAPSHOT and move *OFFSET past
+   it.  SNAPSHOT->procs points into the mapping if the records are
+   stat_struct_t, or else into a buffer of HISTORY where they are
+   decoded; either way, it is valid until the next call.  A torn
+   snapshot, whose trailer is not where its length says, is skipped with
+   a warning, and the next intact one (CRC included) is read instead;
+   HISTORY->snapshot_offset tells where it was.
+   Return 0 on success, 1 if there is no complete snapshot at or
+   after *OFFSET (end of the mapped data), or if a window could not be
+   mapped (see HISTORY->failed).  */
+int
+history_next_snapshot (history_t *history, size_t *offset, snapshot_t *snapshot);
+
+/* Add the snapshots mapped since the last call to the index.  */
+void
+history_index (history_t *history);
+
+/* Return the index of the first indexed snapshot whose timestamp is
+   at or after TIME, or HISTORY->nb_locations if there is none.  */
+size_t
+history_find_time (history_t *history, time_t time);
+
+/* Read the indexed snapshot number I into SNAPSHOT.
+   On success, return 0; on error (e.g. the file was truncated since it
+   was indexed), return 1.  */
+int
+history_get_snapshot (history_t *history, size_t i, snapshot_t *snapshot);
+
+/* Unmap and close HISTORY.  */
+void
+history_close (history_t *history);
+
+#endif /* HISTORY_H */
@@ -0,0 +1,337 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "history.test.h"
+
+#include "history.h"
+
+#include <assert.h>             /* assert ().  */
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <unistd.h>             /* unlink (), truncate ().  */
+#include <fcntl.h>              /* open ().  */
+
+/* Number of snapshots in the test history.  */
+#define NBSNAPSHOTS 300
+
+/* Number of processes in snapshot number S of the test history: some
+   snapshots are larger than a page, some are empty.  */
+static int
+nbprocs (int s)
+{
+  return (s * 37) % 150;
+}
+
+/* Read the history FILENAME written by write_history () with a
+   window of WINDOW_SIZE bytes, and check its snapshots, where VmPeak
+   is only expected if HAS_VMPEAK.  Return 0 if they are all right, 1
+   otherwise.  */
+static int
+check_history (const char *filename, size_t window_size, int has_vmpeak)
+{
+  history_t history;
+  int status = history_open (&history, filename);
+  assert (status == 0);
+  history_set_window (&history, window_size);
+  status = history_update (&history);
+  assert (status == 0);
+
+  int error = 0;
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  int s = 0;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    if (s == NBSNAPSHOTS || snapshot.timestamp != 1000 + s || snapshot.nbpids != nbprocs (s)) {
+      fprintf (stderr, "window %zu: wrong snapshot %d\n", window_size, s);
+      error = 1;
+      break;
+    }
+    for (int i = 0; i < snapshot.nbpids; i++) {
+      if (snapshot.procs[i].Pid != s + i || snapshot.procs[i].VmRSS != s * i
+          || snapshot.procs[i].VmPeak != (has_vmpeak ? 7 : 0) || snapshot.procs[i].VmSwap != 0) {
+        fprintf (stderr, "window %zu: wrong process %d of snapshot %d\n", window_size, i, s);
+        error = 1;
+      }
+    }
+    s++;
+  }
+  if (s != NBSNAPSHOTS) {
+    fprintf (stderr, "window %zu: %d snapshots instead of %d\n", window_size, s, NBSNAPSHOTS);
+    error = 1;
+  }
+
+  history_close (&history);
+  return error;
+}
+
+/* Write a history into the new file FILENAME, with the records of
+   SCHEMA, or with the header of format 2 if SCHEMA is NULL.  */
+static void
+write_history (char *filename, const schema_t *schema)
+{
+  int fd = mkstemp (filename);
+  assert (fd >= 0);
+  FILE *file = fdopen (fd, "w");
+  assert (file != NULL);
+  schema_t legacy;
+  if (schema == NULL) {
+    fputs ("# process-watcher file format 2\n", file);
+    int error = schema_select (&legacy, "VmPeak,VmSize,VmLck,VmPin,VmHWM,VmRSS,RssAnon,RssFile,"
+                               "RssShmem,VmData,VmStk,VmExe,VmLib,VmPTE,VmSwap");
+    assert (error == 0);
+    legacy.checksums = 0;
+    schema = &legacy;
+  } else {
+    size_t header_len = history_write_header (schema, file);
+    assert (header_len % 4 == 0);
+  }
+  static stat_struct_t procs[150];
+  memset (procs, 0, sizeof procs);
+  for (int s = 0; s < NBSNAPSHOTS; s++) {
+    snapshot_t snapshot = { .timestamp = 1000 + s, .nbpids = nbprocs (s), .procs = procs };
+    for (int i = 0; i < snapshot.nbpids; i++) {
+      procs[i].Pid = s + i;
+      procs[i].VmPeak = 7;
+      procs[i].VmRSS = s * i;
+    }
+    size_t snapshot_len = history_write_snapshot (schema, &snapshot, file);
+    assert (snapshot_len != 0);
+  }
+  int closed = fclose (file);
+  assert (closed == 0);
+}
+
+/* Read histories of several layouts with the whole file mapped, and
+   with windows smaller and larger than a snapshot.  */
+static void
+test_history_window (void)
+{
+  static const struct {
+    /* Fields of the history, NULL for format 2.  */
+    const char *fields;
+    int has_vmpeak;
+  } layouts[] = {
+    { NULL, 1 },
+    { "all", 1 },
+    { "VmRSS", 0 },
+    { "VmPeak,VmRSS", 1 },
+  };
+  static const size_t window_sizes[] = { 0, 1, 4096, 10000, 1 << 20 };
+
+  int error = 0;
+  for (size_t l = 0; l < sizeof layouts / sizeof layouts[0]; l++) {
+    char filename[] = "/tmp/process-watcher-test-XXXXXX";
+    schema_t schema;
+    if (layouts[l].fields == NULL) {
+      write_history (filename, NULL);
+    } else {
+      schema_init (&schema);
+      if (strcmp (layouts[l].fields, "all")) {
+        int selected = schema_select (&schema, layouts[l].fields);
+        assert (selected == 0);
+      }
+      write_history (filename, &schema);
+    }
+    for (size_t i = 0; i < sizeof window_sizes / sizeof window_sizes[0]; i++) {
+      error |= check_history (filename, window_sizes[i], layouts[l].has_vmpeak);
+    }
+    unlink (filename);
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Read the history FILENAME with a window of WINDOW_SIZE bytes, and
+   check that it has the snapshots of write_history () but SKIPPED,
+   and none after LAST.  Return 0 if it does, 1 otherwise.  */
+static int
+check_skipped (const char *filename, size_t window_size, int skipped, int last)
+{
+  history_t history;
+  int status = history_open (&history, filename);
+  assert (status == 0);
+  history_set_window (&history, window_size);
+  status = history_update (&history);
+  assert (status == 0);
+
+  int error = 0;
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  int s = 0;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    if (s == skipped) {
+      s++;
+    }
+    if (s > last || snapshot.timestamp != 1000 + s || snapshot.nbpids != nbprocs (s)) {
+      fprintf (stderr, "window %zu: snapshot at %ld instead of %d\n", window_size, (long) snapshot.timestamp, s);
+      error = 1;
+      break;
+    }
+    s++;
+  }
+  if (s != last + 1) {
+    fprintf (stderr, "window %zu: %d snapshots read instead of %d\n", window_size, s, last + 1);
+    error = 1;
+  }
+
+  history_close (&history);
+  return error;
+}
+
+/* Tear the last snapshot of a history and corrupt another one, and
+   check that the reader skips them, and that the torn end is found
+   from the end of the file.  */
+static void
+test_history_recover (void)
+{
+  char filename[] = "/tmp/process-watcher-test-XXXXXX";
+  schema_t schema;
+  schema_init (&schema);
+  write_history (filename, &schema);
+
+  /* Offsets of the snapshots, and of the end of the last one.  */
+  size_t offsets[NBSNAPSHOTS + 1];
+  history_t history;
+  int status = history_open (&history, filename);
+  assert (status == 0);
+  status = history_update (&history);
+  assert (status == 0);
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  for (int s = 0; s < NBSNAPSHOTS; s++) {
+    status = history_next_snapshot (&history, &offset, &snapshot);
+    assert (status == 0);
+    offsets[s] = history.snapshot_offset;
+  }
+  offsets[NBSNAPSHOTS] = offset;
+  size_t end = history_recover (&history);
+  assert (end == offsets[NBSNAPSHOTS]);
+  history_close (&history);
+
+  /* Tear the last snapshot, and flip a bit of the number of processes
+     of snapshot 151, so that its trailer is not where it should be.  */
+  int error = 0;
+  assert (nbprocs (NBSNAPSHOTS - 1) * sizeof (stat_struct_t) > 100 && nbprocs (151) > 0);
+  status = truncate (filename, offsets[NBSNAPSHOTS - 1] + 100);
+  assert (status == 0);
+  int fd = open (filename, O_RDWR);
+  assert (fd >= 0);
+  char byte;
+  ssize_t len = pread (fd, &byte, 1, offsets[151] + sizeof (time_t));
+  assert (len == 1);
+  byte ^= 1;
+  len = pwrite (fd, &byte, 1, offsets[151] + sizeof (time_t));
+  assert (len == 1);
+  close (fd);
+
+  status = history_open (&history, filename);
+  assert (status == 0);
+  status = history_update (&history);
+  assert (status == 0);
+  if (history_recover (&history) != offsets[NBSNAPSHOTS - 1]) {
+    fprintf (stderr, "the torn snapshot was not found from the end\n");
+    error = 1;
+  }
+  history_close (&history);
+
+  static const size_t window_sizes[] = { 0, 1, 4096 };
+  for (size_t i = 0; i < sizeof window_sizes / sizeof window_sizes[0]; i++) {
+    error |= check_skipped (filename, window_sizes[i], 151, NBSNAPSHOTS - 2);
+  }
+  unlink (filename);
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Read a history in format 1, as written by the first versions:
+   records of a pid, a ppid and the 15 fields from VmPeak to VmSwap,
+   without start time.  */
+static void
+test_history_first_format (void)
+{
+  char filename[] = "/tmp/process-watcher-test-XXXXXX";
+  int fd = mkstemp (filename);
+  assert (fd >= 0);
+  FILE *file = fdopen (fd, "w");
+  assert (file != NULL);
+  fputs ("# process-watcher file format\n\n\n", file);
+  for (int s = 0; s < 3; s++) {
+    time_t timestamp = 1000 + s;
+    int nbpids = 2;
+    fwrite (&timestamp, sizeof timestamp, 1, file);
+    fwrite (&nbpids, sizeof nbpids, 1, file);
+    for (int i = 0; i < nbpids; i++) {
+      /* Pid, PPid, then VmPeak to VmSwap, VmRSS being the sixth.  */
+      int record[17];
+      memset (record, 0, sizeof record);
+      record[0] = 10 + i;
+      record[1] = i == 0 ? 1 : 10;
+      record[2] = 7;
+      record[7] = 100 * s + i;
+      record[16] = 3;
+      fwrite (record, sizeof record, 1, file);
+    }
+  }
+  int closed = fclose (file);
+  assert (closed == 0);
+
+  history_t history;
+  int status = history_open (&history, filename);
+  assert (status == 0);
+  status = history_update (&history);
+  assert (status == 0);
+  int error = 0;
+  size_t offset = history_first_offset (&history);
+  snapshot_t snapshot;
+  int s = 0;
+  while (! history_next_snapshot (&history, &offset, &snapshot)) {
+    const stat_struct_t *procs = snapshot.procs;
+    if (s == 3 || snapshot.timestamp != 1000 + s || snapshot.nbpids != 2
+        || procs[1].Pid != 11 || procs[1].PPid != 10 || procs[1].StartTime != 0
+        || procs[1].VmPeak != 7 || procs[1].VmRSS != 100 * s + 1 || procs[1].VmSwap != 3
+        || procs[1].Utime != 0) {
+      fprintf (stderr, "format 1: wrong snapshot %d\n", s);
+      error = 1;
+      break;
+    }
+    s++;
+  }
+  if (s != 3) {
+    fprintf (stderr, "format 1: %d snapshots read instead of 3\n", s);
+    error = 1;
+  }
+  history_close (&history);
+  unlink (filename);
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run all tests on the history.c file.  */
+void
+test_history (void)
+{
+  test_history_window ();
+  test_history_first_format ();
+  test_history_recover ();
+}
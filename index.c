@@ -0,0 +1,252 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "index.h"
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* close (), pread ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <limits.h>             /* INT_MAX.  */
+
+/*
+ * FILE FORMAT
+ *
+ * Header: "# process-watcher index format\n\n" (32 bytes, without NUL
+ * character), then a sequence of index_block_t, one per
+ * INDEX_BLOCK_SNAPSHOTS snapshots of the history file, in file order.
+ * Numbers are in host order.  The snapshots after the last complete
+ * block are not indexed.
+ */
+
+/* Index file name.  */
+static const char index_filename[] = "process-watcher.idx";
+
+/* First bytes of the index file.
+   The strlen is a multiple of 8 for alignment purposes.  */
+static const char index_header[] = "# process-watcher index format\n\n";
+
+/* Number of hash functions of the Bloom filter.  */
+#define BLOOM_HASHES 3
+
+/* Mix the bits of X (the finalizer of MurmurHash3).  */
+static uint32_t
+mix (uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x85ebca6b;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35;
+  x ^= x >> 16;
+  return x;
+}
+
+/* Store into BITS the BLOOM_HASHES bit numbers of PID in the Bloom
+   filter, by double hashing.  */
+static void
+bloom_bits (int pid, uint32_t bits[BLOOM_HASHES])
+{
+  uint32_t h1 = mix ((uint32_t) pid);
+  uint32_t h2 = mix ((uint32_t) pid ^ 0x5bd1e995) | 1;
+  for (int i = 0; i < BLOOM_HASHES; i++) {
+    bits[i] = (h1 + i * h2) % (INDEX_BLOOM_BYTES * 8);
+  }
+}
+
+/* Start BLOCK, whose first snapshot will be at OFFSET.  */
+void
+index_block_start (index_block_t *block, uint64_t offset)
+{
+  memset (block, 0, sizeof *block);
+  block->offset = offset;
+  block->end_offset = offset;
+  block->min_pid = INT_MAX;
+  block->max_pid = 0;
+}
+
+/* Add to BLOCK the snapshot SNAPSHOT, which ends at END_OFFSET.  */
+void
+index_block_add (index_block_t *block, const snapshot_t *snapshot, uint64_t end_offset)
+{
+  if (block->nb_snapshots == 0) {
+    block->first_timestamp = snapshot->timestamp;
+  }
+  block->last_timestamp = snapshot->timestamp;
+  block->end_offset = end_offset;
+  block->nb_snapshots++;
+
+  if (snapshot->nbpids > 0) {
+    /* The processes are in ascending PID order.  */
+    if (snapshot->procs[0].Pid < block->min_pid) {
+      block->min_pid = snapshot->procs[0].Pid;
+    }
+    if (snapshot->procs[snapshot->nbpids - 1].Pid > block->max_pid) {
+      block->max_pid = snapshot->procs[snapshot->nbpids - 1].Pid;
+    }
+  }
+
+  for (int i = 0; i < snapshot->nbpids; i++) {
+    uint32_t bits[BLOOM_HASHES];
+    bloom_bits (snapshot->procs[i].Pid, bits);
+    for (int j = 0; j < BLOOM_HASHES; j++) {
+      block->bloom[bits[j] / 8] |= 1 << (bits[j] % 8);
+    }
+  }
+}
+
+/* Return 0 if PID is in none of the snapshots of BLOCK, 1 if it may
+   be in some.  */
+int
+index_block_may_contain (const index_block_t *block, int pid)
+{
+  if (pid < block->min_pid || pid > block->max_pid) {
+    return 0;
+  }
+  uint32_t bits[BLOOM_HASHES];
+  bloom_bits (pid, bits);
+  for (int j = 0; j < BLOOM_HASHES; j++) {
+    if (! (block->bloom[bits[j] / 8] & (1 << (bits[j] % 8)))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Open the index file for writing into WRITER, truncating it.  */
+void
+index_create (index_writer_t *writer, uint64_t first_offset)
+{
+  writer->output = fopen (index_filename, "w");
+  if (writer->output == NULL) {
+    fprintf (stderr, "could not open %s for writing: ", index_filename);
+    perror ("");
+    exit (1);
+  }
+  if (fputs_unlocked (index_header, writer->output) == EOF || fflush_unlocked (writer->output)) {
+    perror ("could not write the index header");
+    exit (1);
+  }
+  index_block_start (&writer->block, first_offset);
+}
+
+/* Open the index file for writing into WRITER, to go on indexing
+   HISTORY up to END_OFFSET.  */
+void
+index_resume (index_writer_t *writer, history_t *history, uint64_t end_offset)
+{
+  int fd = open (index_filename, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    fprintf (stderr, "could not open %s for writing: ", index_filename);
+    perror ("");
+    exit (1);
+  }
+
+  /* Keep the blocks that follow each other from the first snapshot,
+     up to END_OFFSET at most.  */
+  const size_t header_len = strlen (index_header);
+  uint64_t offset = history_first_offset (history);
+  off_t len = 0;
+  char header[header_len];
+  if (pread (fd, header, header_len, 0) == (ssize_t) header_len
+      && ! memcmp (header, index_header, header_len)) {
+    len = header_len;
+    index_block_t block;
+    while (pread (fd, &block, sizeof block, len) == sizeof block
+           && block.offset == offset && block.end_offset <= end_offset) {
+      offset = block.end_offset;
+      len += sizeof block;
+    }
+  }
+  if (ftruncate (fd, len) || lseek (fd, len, SEEK_SET) != len
+      || (writer->output = fdopen (fd, "w")) == NULL) {
+    fprintf (stderr, "could not open %s for writing: ", index_filename);
+    perror ("");
+    exit (1);
+  }
+  if (len == 0 && (fputs_unlocked (index_header, writer->output) == EOF || fflush_unlocked (writer->output))) {
+    perror ("could not write the index header");
+    exit (1);
+  }
+
+  /* Index the snapshots after the last block, i.e. fewer than
+     INDEX_BLOCK_SNAPSHOTS of them unless the index was lost.  */
+  index_block_start (&writer->block, offset);
+  snapshot_t snapshot;
+  size_t next = offset;
+  while (next < end_offset && ! history_next_snapshot (history, &next, &snapshot)) {
+    index_add (writer, &snapshot, next);
+  }
+}
+
+/* Add to the index the snapshot SNAPSHOT, which ends at END_OFFSET of
+   the history file, and write the block if it is complete.  */
+void
+index_add (index_writer_t *writer, const snapshot_t *snapshot, uint64_t end_offset)
+{
+  index_block_add (&writer->block, snapshot, end_offset);
+  if (writer->block.nb_snapshots < INDEX_BLOCK_SNAPSHOTS) {
+    return;
+  }
+
+  if (fwrite_unlocked (&writer->block, sizeof writer->block, 1, writer->output) != 1
+      || fflush_unlocked (writer->output)) {
+    perror ("could not write an index block");
+    exit (1);
+  }
+  index_block_start (&writer->block, end_offset);
+}
+
+/* Map the index file into INDEX.  */
+int
+index_open (index_t *index)
+{
+  int fd = open (index_filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  const size_t header_len = strlen (index_header);
+  if (fstat (fd, &st) || (size_t) st.st_size < header_len + sizeof (index_block_t)) {
+    close (fd);
+    return 1;
+  }
+  index->map_len = st.st_size;
+  index->map = (char *) mmap (NULL, index->map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (index->map == MAP_FAILED) {
+    return 1;
+  }
+  if (memcmp (index->map, index_header, header_len) != 0) {
+    munmap (index->map, index->map_len);
+    return 1;
+  }
+  index->blocks = (const index_block_t *) (index->map + header_len);
+  index->nb_blocks = (index->map_len - header_len) / sizeof (index_block_t);
+  return 0;
+}
+
+/* Unmap INDEX.  */
+void
+index_close (index_t *index)
+{
+  munmap (index->map, index->map_len);
+}
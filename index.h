@@ -0,0 +1,102 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "history.h"            /* snapshot_t.  */
+
+#include <stdint.h>             /* uint64_t.  */
+#include <stdio.h>              /* FILE.  */
+
+/* Number of snapshots summarized by each block of the index.  */
+#define INDEX_BLOCK_SNAPSHOTS 64
+
+/* Size of the Bloom filter of the PIDs of each block.  With 3 hash
+   functions, it gives about 1.5% false positives for 3000 distinct
+   PIDs per block.  */
+#define INDEX_BLOOM_BYTES 4096
+
+/* Summary of INDEX_BLOCK_SNAPSHOTS consecutive snapshots of the
+   history file.  */
+typedef struct {
+  time_t first_timestamp;
+  time_t last_timestamp;
+  /* Offsets of the first snapshot and just past the last one in the
+     history file.  */
+  uint64_t offset;
+  uint64_t end_offset;
+  int32_t nb_snapshots;
+  /* Range of the PIDs found in the snapshots.  */
+  int32_t min_pid;
+  int32_t max_pid;
+  int32_t padding;
+  /* Bloom filter of the PIDs found in the snapshots.  */
+  unsigned char bloom[INDEX_BLOOM_BYTES];
+} index_block_t;
+
+/* Writer of the index file, with the block being built.  */
+typedef struct {
+  FILE *output;
+  index_block_t block;
+} index_writer_t;
+
+/* Index file, mapped for reading.  */
+typedef struct {
+  char *map;
+  size_t map_len;
+  const index_block_t *blocks;
+  size_t nb_blocks;
+} index_t;
+
+/* Start BLOCK, whose first snapshot will be at OFFSET.  */
+void
+index_block_start (index_block_t *block, uint64_t offset);
+
+/* Add to BLOCK the snapshot SNAPSHOT, which ends at END_OFFSET.  */
+void
+index_block_add (index_block_t *block, const snapshot_t *snapshot, uint64_t end_offset);
+
+/* Return 0 if PID is in none of the snapshots of BLOCK, 1 if it may
+   be in some.  */
+int
+index_block_may_contain (const index_block_t *block, int pid);
+
+/* Open the index file for writing into WRITER, truncating it.  The
+   first snapshot will be at FIRST_OFFSET of the history file.  Exit
+   on error.  */
+void
+index_create (index_writer_t *writer, uint64_t first_offset);
+
+/* Open the index file for writing into WRITER, to go on indexing
+   HISTORY, whose intact snapshots end at END_OFFSET: keep the blocks
+   of the index up to there, and index the following snapshots again.
+   Exit on error.  */
+void
+index_resume (index_writer_t *writer, history_t *history, uint64_t end_offset);
+
+/* Add to the index the snapshot SNAPSHOT, which ends at END_OFFSET of
+   the history file, and write the block if it is complete.  Exit on
+   error.  */
+void
+index_add (index_writer_t *writer, const snapshot_t *snapshot, uint64_t end_offset);
+
+/* Map the index file into INDEX.
+   On success, return 0; if there is no usable index, return 1.  */
+int
+index_open (index_t *index);
+
+/* Unmap INDEX.  */
+void
+index_close (index_t *index);
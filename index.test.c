@@ -0,0 +1,97 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "index.test.h"
+
+#include "index.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Number of processes in each test snapshot.  */
+#define NBPROCS 1000
+
+/* Build a block of INDEX_BLOCK_SNAPSHOTS snapshots of the even PIDs
+   from 1000 to 5000, and check which PIDs it may contain.  */
+static int
+test_index_block (void)
+{
+  static stat_struct_t procs[NBPROCS];
+  memset (procs, 0, sizeof procs);
+  snapshot_t snapshot = { .nbpids = NBPROCS, .procs = procs };
+
+  index_block_t block;
+  index_block_start (&block, 32);
+  for (int s = 0; s < INDEX_BLOCK_SNAPSHOTS; s++) {
+    snapshot.timestamp = 1000 + 2 * s;
+    for (int i = 0; i < NBPROCS; i++) {
+      procs[i].Pid = 1000 + 2 * (s + 2 * i);
+    }
+    index_block_add (&block, &snapshot, 32 + 100 * (s + 1));
+  }
+
+  int error = 0;
+  if (block.first_timestamp != 1000 || block.last_timestamp != 1000 + 2 * (INDEX_BLOCK_SNAPSHOTS - 1)
+      || block.offset != 32 || block.end_offset != 32 + 100 * INDEX_BLOCK_SNAPSHOTS
+      || block.nb_snapshots != INDEX_BLOCK_SNAPSHOTS) {
+    fprintf (stderr, "wrong block header\n");
+    error = 1;
+  }
+  const int max_pid = 1000 + 2 * (INDEX_BLOCK_SNAPSHOTS - 1 + 2 * (NBPROCS - 1));
+  if (block.min_pid != 1000 || block.max_pid != max_pid) {
+    fprintf (stderr, "wrong PID range %d-%d instead of 1000-%d\n", block.min_pid, block.max_pid, max_pid);
+    error = 1;
+  }
+
+  /* No false negatives.  */
+  for (int pid = 1000; pid <= max_pid; pid += 2) {
+    if (! index_block_may_contain (&block, pid)) {
+      fprintf (stderr, "PID %d is in the block but was not found\n", pid);
+      error = 1;
+    }
+  }
+
+  /* No PIDs out of range.  */
+  if (index_block_may_contain (&block, 998) || index_block_may_contain (&block, max_pid + 2)) {
+    fprintf (stderr, "PIDs out of range were found in the block\n");
+    error = 1;
+  }
+
+  /* Few false positives among the odd PIDs.  */
+  int false_positives = 0;
+  int nb_absent = 0;
+  for (int pid = 1001; pid < max_pid; pid += 2) {
+    false_positives += index_block_may_contain (&block, pid);
+    nb_absent++;
+  }
+  if (false_positives * 20 > nb_absent) {
+    fprintf (stderr, "too many false positives: %d of %d\n", false_positives, nb_absent);
+    error = 1;
+  }
+
+  return error;
+}
+
+/* Run all tests on the index.c file.  */
+void
+test_index (void)
+{
+  if (test_index_block ()) {
+    exit (1);
+  }
+}
@@ -15,17 +15,41 @@ along with process-watcher.
 If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
-#include "lib.h"
-
 /* Enable GNU extensions such as fputs_unlocked ().  */
 #define _GNU_SOURCE
 
+#include "lib.h"
+
 #include "get-all-pids.h"       /* get_all_pids ().  */
 #include "status.h"             /* read_status_pid ().  */
+#include "proc-stat.h"          /* read_stat_pid ().  */
 #include "locks.h"              /* write_lock ().  */
 #include "parse-time.h"         /* parse_time ().  */
+#include "parse-pid.h"          /* try_parse_proc_id ().  */
+#include "accumulate.h"         /* accumulate_max ().  */
+#include "history.h"            /* history_open ().  */
+#include "query.h"              /* query_scan ().  */
+#include "tree.h"               /* tree_totals ().  */
+#include "ring.h"               /* ring_publish ().  */
+#include "registry.h"           /* registry_update ().  */
+#include "rollup.h"             /* rollup_write ().  */
+#include "series.h"             /* series_add ().  */
+#include "window.h"             /* window_add ().  */
+#include "histogram.h"          /* histogram_add ().  */
+#include "breakdown.h"          /* breakdown_add ().  */
+#include "usage.h"              /* usage_add ().  */
+#include "comm.h"               /* comm_write ().  */
+#include "names.h"              /* names_sample ().  */
+#include "topk.h"               /* topk_select ().  */
+#include "index.h"              /* index_add ().  */
+#include "capture-stats.h"      /* stats_record ().  */
+#include "schema.h"             /* field_names.  */
+#include "exporter.h"           /* exporter_publish ().  */
+#include "smaps.h"              /* smaps_sample ().  */
+#include "proc-io.h"            /* io_sample ().  */
+#include "cgroup.h"             /* cgroup_sample ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
 
-#include <sys/mman.h>           /* mmap ().  */
 #include <stdio.h>              /* FILE.  */
 #include <stdlib.h>             /* exit ().  */
 #include <errno.h>              /* errno.  */
@@ -33,306 +57,863 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 #include <assert.h>             /* assert ().  */
 #include <string.h>             /* strerror ().  */
 #include <time.h>               /* time ().  */
-#include <limits.h>             /* INT_MAX.  */
-#include <fcntl.h>              /* open ().  */
-#include <sys/stat.h>           /* fstat ().  */
+#include <stdint.h>             /* uint64_t.  */
+#include <signal.h>             /* sigaction ().  */
 
-/*
- * FILE FORMAT
- *
- * General remarks:
- * - Field names are case-sensitive.
- * - Numbers are in host order.
- * - pid and memory field values are ints.
- *
- * File header: "# process-watcher file format\n" (without NUL character).
- * Then a sequence of snapshots.  Each snapshot looks like this:
- * - time_t timestamp
- * - Number of processes in the snapshot, as int
- * - sequence of process info, in ascending PID number.  Each process
- *   info is a struct stat_struct_t which looks like this:
- *   - int pid
- *   - int ppid
- *   - int VmPeak
- *   - ...
- */
-
-/* First bytes of any history file.
-   The strlen is a multiple of 4 for alignment purposes.  */
-static const char header[] = "# process-watcher file format\n\n\n";
-
-/* History file name.  */
-static const char capture_filename[] = "process-watcher.out";
+/* Read the processes PIDS (NBPIDS of them) into PROCS and their names
+   into NAMES, skipping those that have disappeared.  */
+int
+read_processes (const pid_t *pids, int nbpids, stat_struct_t *procs, char (*names)[NAME_SIZE])
+{
+  /* Loop, iterate over all processes.  */
+  int nbprocs = 0;
+  for (int i = 0; i < nbpids; i++) {
+    pid_t pid = pids[i];
 
-/* Perform the "process-watcher capture" command.  */
-void
-capture (void)
+    if (read_status_pid (pid, procs + nbprocs, names[nbprocs])) {
+      fprintf (stderr, "could not read status from pid %d\n", pid);
+      exit (1);
+    }
+
+    proc_stat_t stat;
+    if (procs[nbprocs].Pid == 0
+        || read_stat_pid (pid, &stat)) {
+      /* The process has just disappeared: skip it.  */
+      continue;
+    }
+    procs[nbprocs].StartTime = stat.start_time;
+    stat_store_cpu (&stat, procs + nbprocs);
+    nbprocs++;
+  }
+  return nbprocs;
+}
+
+/* Seconds between two samples.  */
+#define SAMPLE_PERIOD 2
+
+/* Number of samples between two writes of the --stats-file.  */
+#define STATS_FILE_PERIOD 30
+
+/* Set by SIGUSR1 to request a dump of the capture statistics.  */
+static volatile sig_atomic_t stats_requested;
+
+/* Handle SIGUSR1.  */
+static void
+request_stats (int signum __attribute__ ((unused)))
+{
+  stats_requested = 1;
+}
+
+/* Open the history file into *OUTPUT to write the snapshots of SCHEMA,
+   and the index into INDEX_WRITER.  With APPEND, go on with the
+   history already there, if any, from the end of its last intact
+   snapshot; otherwise, truncate it.  Return the offset of the end of
+   the history file.  Exit on error.  */
+static uint64_t
+open_history (const schema_t *schema, int append, FILE **output, index_writer_t *index_writer)
 {
-  FILE *output = fopen (capture_filename, "w");
-  if (output == NULL) {
+  *output = fopen (history_filename, append ? "a" : "w");
+  if (*output == NULL) {
     perror ("could not open process-watcher.out for writing");
     exit (1);
   }
 
-  int fd = fileno_unlocked (output);
+  int fd = fileno_unlocked (*output);
   if (fd == -1) {
-    fprintf (stderr, "could not get file descriptor for %s\n", capture_filename);
+    fprintf (stderr, "could not get file descriptor for %s\n", history_filename);
     exit (1);
   }
 
-  fputs_unlocked (header, output);
-  if (ferror_unlocked (output)) {
+  if (append && lseek (fd, 0, SEEK_END) > 0) {
+    history_t history;
+    if (history_open (&history, history_filename) || history_update (&history)) {
+      exit (1);
+    }
+    if (! schema_equal (&history.schema, schema)) {
+      fprintf (stderr, "cannot append to %s, which records other fields or has no snapshot trailers: "
+               "capture with the same options, or move it away\n", history_filename);
+      exit (1);
+    }
+    uint64_t history_len = history_recover (&history);
+    size_t torn_len = history.file_len - history_len;
+    index_resume (index_writer, &history, history_len);
+    /* Closing another file descriptor of the file would release the
+       lock, so take it after.  */
+    history_close (&history);
+
+    if (torn_len > 0) {
+      fprintf (stderr, "dropping the last %zu bytes of %s, which are not a complete snapshot\n", torn_len, history_filename);
+      if (write_lock (fd)) {
+        fprintf (stderr, "could not take a write lock on file %s\n", history_filename);
+        exit (1);
+      }
+      if (ftruncate (fd, history_len)) {
+        perror ("could not truncate process-watcher.out");
+        exit (1);
+      }
+      if (unlock (fd)) {
+        fprintf (stderr, "could not unlock file %s\n", history_filename);
+        exit (1);
+      }
+    }
+    return history_len;
+  }
+
+  uint64_t history_len = history_write_header (schema, *output);
+  if (history_len == 0) {
     fprintf (stderr, "write error while writing the header: %s\n", strerror (errno));
     exit (1);
   }
+  index_create (index_writer, history_len);
+  return history_len;
+}
 
-  /* Loop, one iteration per sample.  */
-  while (1) {
-    /* Take a write lock before writing to the file.  */
-    if (write_lock (fd)) {
-      fprintf (stderr, "could not take a write lock on file %s\n", capture_filename);
+/* Perform the "process-watcher capture" command.  */
+void
+capture (const options_t *options)
+{
+  schema_t schema;
+  if (options->fields != NULL) {
+    if (schema_select (&schema, options->fields)) {
       exit (1);
     }
-
-    time_t now = time (NULL);
-    if (fwrite_unlocked (&now, 1, sizeof now, output) != sizeof now) {
-      fprintf (stderr, "write error while writing a timestamp\n");
+  } else {
+    /* Do not fill the records with the fields of the optional sources
+       that are not read.  */
+    char selected[NB_FIELDS];
+    for (int field = 0; field < NB_FIELDS; field++) {
+      selected[field] = (options->smaps_budget_ms > 0 || ! smaps_field (field))
+        && (options->io || ! io_field (field))
+        && (options->cmdline || strcmp (field_names[field], "CmdHash"));
+    }
+    if (schema_select_mask (&schema, selected)) {
       exit (1);
     }
+  }
+
+  /* Offset of the end of the history file.  */
+  FILE *output;
+  index_writer_t index_writer;
+  uint64_t history_len = open_history (&schema, options->append, &output, &index_writer);
+  int fd = fileno_unlocked (output);
+
+  ring_t ring;
+  if (options->shm_name != NULL
+      && ring_create (&ring, options->shm_name, options->shm_slots, options->shm_procs, options->append)) {
+    exit (1);
+  }
+
+  exporter_t exporter;
+  if (options->metrics != NULL && exporter_start (&exporter, options->metrics)) {
+    exit (1);
+  }
+
+  registry_t registry;
+  registry_open (&registry);
+  smaps_t smaps;
+  smaps_init (&smaps, options->smaps_budget_ms * 1000000LL);
+  io_sampler_t io_sampler;
+  memset (&io_sampler, 0, sizeof io_sampler);
+  int sample_cgroups = options->nbcgroup_dirs > 0 || options->nbcgroup_trees > 0;
+  cgroup_sampler_t cgroup_sampler;
+  if (sample_cgroups) {
+    cgroup_create (&cgroup_sampler, options->cgroup_dirs, options->nbcgroup_dirs, options->cgroup_trees, options->nbcgroup_trees, options->append);
+  }
+  FILE *rollup_output = rollup_create (options->append);
+  /* The names of the processes go into the name dictionary when
+     NameId is recorded, and into the PID-to-name file otherwise.  */
+  int write_comm = ! schema_has_field (&schema, field_index ("NameId"));
+  comm_writer_t comm_writer;
+  if (write_comm) {
+    comm_create (&comm_writer, options->append);
+  }
+  names_writer_t names_writer;
+  names_create (&names_writer, names_filename, options->append);
+
+  accumulate_init ();
+
+  /* Dump the statistics on stderr on SIGUSR1.  */
+  capture_stats_t stats;
+  memset (&stats, 0, sizeof stats);
+  struct sigaction action;
+  memset (&action, 0, sizeof action);
+  action.sa_handler = request_stats;
+  /* Restart the system calls it interrupts, such as the F_SETLKW of
+     write_lock (), rather than failing them with EINTR.  */
+  action.sa_flags = SA_RESTART;
+  sigemptyset (&action.sa_mask);
+  if (sigaction (SIGUSR1, &action, NULL)) {
+    perror ("could not set the SIGUSR1 handler");
+    exit (1);
+  }
+
+  /* Processes of the current snapshot, and their names.  */
+  stat_struct_t *procs = NULL;
+  char (*names)[NAME_SIZE] = NULL;
+  int procs_capacity = 0;
+
+  /* Loop, one iteration per sample.  */
+  while (1) {
+    time_t now = time (NULL);
+    long long sample_start = stats_now_ns ();
 
     pid_t *pids;
     int nbpids;
     get_all_pids (&pids, &nbpids);
-
-    /* Write the number of pids in this capture.  */
-    if (fwrite_unlocked (&nbpids, 1, sizeof nbpids, output) != sizeof nbpids) {
-      fprintf (stderr, "could not write to the record: %s\n", strerror (errno));
-      exit (1);
+    long long phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_PIDS, phase_end - sample_start);
+    long long phase_start = phase_end;
+
+    if (nbpids > procs_capacity) {
+      procs_capacity = nbpids;
+      procs = xreallocarray (procs, procs_capacity, sizeof (stat_struct_t));
+      names = xreallocarray (names, procs_capacity, NAME_SIZE);
     }
 
-    /* Loop, iterate over all processes.  */
-    for (int i = 0; i < nbpids; i++) {
-      pid_t pid = pids[i];
-      stat_struct_t stat_struct;
-
-      if (read_status_pid (pid, &stat_struct)) {
-        fprintf (stderr, "could not read status from pid %d\n", pid);
-        exit (1);
-      }
+    int nbprocs = read_processes (pids, nbpids, procs, names);
+    names_sample (&names_writer, procs, names, nbprocs, options->cmdline);
+    stats.processes_read += nbprocs;
+    stats.processes_vanished += nbpids - nbprocs;
+    phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_STATUS, phase_end - phase_start);
+    phase_start = phase_end;
+
+    snapshot_t snapshot = {
+      .timestamp = now,
+      .nbpids = nbprocs,
+      .procs = procs,
+    };
+    /* Register the new trees first, so that their processes are read
+       by --smaps first, and by --io.  */
+    registry_poll (&registry);
+    if (options->smaps_budget_ms > 0) {
+      smaps_sample (&smaps, &snapshot, &registry, &stats);
+      phase_end = stats_now_ns ();
+      stats_record (&stats, PHASE_SMAPS, phase_end - phase_start);
+      phase_start = phase_end;
+    }
+    if (options->io) {
+      io_sample (&io_sampler, &snapshot, &registry);
+      phase_end = stats_now_ns ();
+      stats_record (&stats, PHASE_IO, phase_end - phase_start);
+      phase_start = phase_end;
+    }
+    schema_clear_unrecorded (&schema, procs, nbprocs);
+    registry_update (&registry, &snapshot);
+    phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_REGISTRY, phase_end - phase_start);
+    phase_start = phase_end;
 
-      if (fwrite_unlocked (&stat_struct, 1, sizeof stat_struct, output) != sizeof stat_struct) {
-        fprintf (stderr, "could not write a capture: ");
-        perror ("");
-        exit (1);
-      }
+    /* Take a write lock before writing to the file.  */
+    if (write_lock (fd)) {
+      fprintf (stderr, "could not take a write lock on file %s\n", history_filename);
+      exit (1);
+    }
+    phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_LOCK, phase_end - phase_start);
+    phase_start = phase_end;
+
+    size_t snapshot_len = history_write_snapshot (&schema, &snapshot, output);
+    if (snapshot_len == 0) {
+      fprintf (stderr, "could not write a capture: ");
+      perror ("");
+      exit (1);
     }
 
     fflush_unlocked (output);
+    stats.bytes_written += snapshot_len;
+    phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_WRITE, phase_end - phase_start);
+    phase_start = phase_end;
+
+    rollup_write (rollup_output, &registry, now);
+    if (write_comm) {
+      comm_write (&comm_writer, now, procs, names, nbprocs);
+    }
+    history_len += snapshot_len;
+    index_add (&index_writer, &snapshot, history_len);
 
     /* Release the lock.  */
     if (unlock (fd)) {
-      fprintf (stderr, "could not unlock file %s\n", capture_filename);
+      fprintf (stderr, "could not unlock file %s\n", history_filename);
       exit (1);
     }
 
-    sleep (2);
+    phase_end = stats_now_ns ();
+    stats_record (&stats, PHASE_SIDE_FILES, phase_end - phase_start);
+    phase_start = phase_end;
+
+    if (sample_cgroups) {
+      cgroup_sample (&cgroup_sampler, now);
+      phase_end = stats_now_ns ();
+      stats_record (&stats, PHASE_CGROUPS, phase_end - phase_start);
+      phase_start = phase_end;
+    }
+
+    if (options->shm_name != NULL) {
+      ring_publish (&ring, now, procs, nbprocs);
+      phase_end = stats_now_ns ();
+      stats_record (&stats, PHASE_RING, phase_end - phase_start);
+    }
+
+    long long sample_ns = phase_end - sample_start;
+    stats_record (&stats, PHASE_SAMPLE, sample_ns);
+    stats.samples++;
+    if (sample_ns >= SAMPLE_PERIOD * 1000000000LL) {
+      stats.overruns++;
+    }
+    if (options->metrics != NULL) {
+      exporter_publish (&exporter, now, nbprocs, &registry, &stats);
+    }
+    if (options->stats_file != NULL && stats.samples % STATS_FILE_PERIOD == 0) {
+      stats_write_file (&stats, options->stats_file);
+    }
+
+    /* Sleep, dumping the statistics whenever SIGUSR1 interrupts.  */
+    unsigned int left = SAMPLE_PERIOD;
+    do {
+      left = sleep (left);
+      if (stats_requested) {
+        stats_requested = 0;
+        stats_print (&stats, stderr);
+        if (options->stats_file != NULL) {
+          stats_write_file (&stats, options->stats_file);
+        }
+      }
+    } while (left > 0);
   }
 }
 
-/* Comparator for pointers to stat_struct_t.
-   Compare according to stat_struct->Pid.
-   Returns <, ==, >0 if a is <, ==, >b.  */
-static int
-compare_stat_structs (const void *a, const void *b)
+/* State of a get query.  */
+struct get_data {
+  /* Top process of the tree.  Without a start time, it is the first
+     process found with its PID in the time window.  Its PID is 0 for
+     all the processes, with --name only.  */
+  proc_id_t top_id;
+  /* With --name, whether the processes of each NameId below
+     NBNAME_IDS are summed up (see names_match ()); NULL otherwise.  */
+  char *name_matches;
+  int nbname_ids;
+  /* Running max of the tree totals.  */
+  totals_t max;
+  /* Series of the tree totals, or NULL.  */
+  series_t *series;
+  /* CPU time and I/O of the tree.  */
+  usage_t usage;
+  /* Number of largest processes to remember at the peaks, 0 for
+     none.  */
+  int top;
+  /* Field whose peak is tracked, -1 for all of them.  */
+  int top_field;
+  /* Members of the tree in the current snapshot.  */
+  stat_struct_t **members;
+  int members_capacity;
+  /* For each field, the time of its peak and the largest processes of
+     the tree then.  */
+  time_t peak_time[NB_FIELDS];
+  stat_struct_t *peak_top[NB_FIELDS];
+  int peak_top_count[NB_FIELDS];
+  /* With --window, the maxima of the tree totals over the sliding
+     windows, else NULL.  */
+  window_t *window;
+  /* Where the maxima of the windows are written as CSV, unless they go
+     to HISTOGRAMS.  */
+  FILE *window_output;
+  /* With --percentiles, the distribution of each field of the tree
+     totals, or with --window of their maxima over the windows; NULL
+     otherwise.  */
+  histogram_t *histograms;
+  /* With --tree, the peaks of the subtrees, and the percentage of the
+     peak of the tree below which they are not printed; NULL
+     otherwise.  */
+  breakdown_t *breakdown;
+  int breakdown_percent;
+};
+
+/* Add TOTALS to the distributions of the measures of DATA.  */
+static void
+get_histograms_add (struct get_data *data, const totals_t *totals)
 {
-  const stat_struct_t *da = (const stat_struct_t *) a;
-  const stat_struct_t *db = (const stat_struct_t *) b;
-  return (da->Pid > db->Pid) - (da->Pid < db->Pid);
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (measure_field (field)) {
+      histogram_add (data->histograms + field, totals->fields[field]);
+    }
+  }
 }
 
-/* Given the snapshot defined by (SNAPSHOT_START, SNAPSHOT_SIZE),
-   determine whether the process identified by CANDIDATE_PROC
-   is a subprocess of TOP_PROC (recursively).  */
-static int
-is_proc_descendant_of_proc (stat_struct_t *candidate_proc, stat_struct_t *top_proc, stat_struct_t *snapshot_start, size_t snapshot_size)
+/* Take into account the MAX of the tree totals in the window starting
+   at START, for use with window_start ().  */
+static void
+get_window (time_t start, const totals_t *max, void *data)
 {
-  while (1) {
-    if (candidate_proc == top_proc) {
-      return 1;
+  struct get_data *get_data = data;
+  if (get_data->histograms != NULL) {
+    get_histograms_add (get_data, max);
+    return;
+  }
+  char time_string[15];
+  format_time (start, time_string);
+  fprintf (get_data->window_output, "%s", time_string);
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (measure_field (field)) {
+      fprintf (get_data->window_output, ",%lld", max->fields[field]);
     }
+  }
+  fprintf (get_data->window_output, "\n");
+}
 
-    /* Find the parent of candidate.  */
-    stat_struct_t dummy_parent = {
-      .Pid = candidate_proc->PPid,
-    };
-    stat_struct_t *parent_proc = (stat_struct_t *) bsearch (&dummy_parent, snapshot_start, snapshot_size, sizeof (stat_struct_t), compare_stat_structs);
-    if (parent_proc == NULL) {
-      /* Could not find the parent. */
-      return 0;
+/* Take into account the TOTALS of the tree in the snapshot taken at
+   TIMESTAMP.  */
+static void
+get_sample (time_t timestamp, const totals_t *totals, void *data)
+{
+  struct get_data *get_data = data;
+  accumulate_max (&get_data->max, totals);
+  usage_add (&get_data->usage, timestamp, totals);
+  if (get_data->series != NULL) {
+    series_add (get_data->series, timestamp, totals);
+  }
+  if (get_data->window != NULL) {
+    window_add (get_data->window, timestamp, totals);
+  } else if (get_data->histograms != NULL) {
+    get_histograms_add (get_data, totals);
+  }
+}
+
+/* Take into account the tree in SNAPSHOT, or with --name its matching
+   processes, for use with ring_read ().  */
+static void
+get_snapshot (const snapshot_t *snapshot, void *data)
+{
+  struct get_data *get_data = data;
+  totals_t snapshot_totals;
+
+  if (get_data->top == 0 && get_data->name_matches == NULL && get_data->breakdown == NULL) {
+    proc_id_resolve (&get_data->top_id, snapshot);
+    if (tree_totals (snapshot, &get_data->top_id, &snapshot_totals)) {
+      get_sample (snapshot->timestamp, &snapshot_totals, data);
     }
+    return;
+  }
 
-    if (candidate_proc == parent_proc) {
-      /* We have detected a tight loop, candidate_proc is its own
-         parent.  */
-      return 0;
+  if (snapshot->nbpids > get_data->members_capacity) {
+    get_data->members_capacity = snapshot->nbpids;
+    get_data->members = xreallocarray (get_data->members, get_data->members_capacity, sizeof (stat_struct_t *));
+  }
+  int nbmembers;
+  if (get_data->top_id.pid == 0) {
+    for (int i = 0; i < snapshot->nbpids; i++) {
+      get_data->members[i] = snapshot->procs + i;
+    }
+    nbmembers = snapshot->nbpids;
+  } else {
+    proc_id_resolve (&get_data->top_id, snapshot);
+    if (! tree_members (snapshot, &get_data->top_id, &snapshot_totals, get_data->members, &nbmembers)) {
+      return;
     }
+  }
+  if (get_data->name_matches != NULL) {
+    nbmembers = names_filter (get_data->name_matches, get_data->nbname_ids, get_data->members, nbmembers, &snapshot_totals);
+  }
+  if (get_data->breakdown != NULL) {
+    breakdown_add (get_data->breakdown, snapshot->timestamp, get_data->members, nbmembers);
+  }
 
-    /* Now we need to know if parent_proc is a descendant of top_proc.  */
-    candidate_proc = parent_proc;
+  /* Remember the largest processes of the fields that peak now.  */
+  for (int field = 0; field < NB_FIELDS && get_data->top > 0; field++) {
+    if ((get_data->top_field == -1 || get_data->top_field == field)
+        && snapshot_totals.fields[field] > get_data->max.fields[field]) {
+      get_data->peak_time[field] = snapshot->timestamp;
+      get_data->peak_top_count[field] = topk_select (get_data->members, nbmembers, field, get_data->top, get_data->peak_top[field]);
+    }
   }
+
+  get_sample (snapshot->timestamp, &snapshot_totals, data);
 }
 
-/* Perform the "process-watcher get" command.  */
-void
-get (char *pid_string, char *begin_string, char *end_string)
+/* Print the largest processes of the tree at the peak of each tracked
+   field.  */
+static void
+print_top (const struct get_data *data)
 {
-  errno = 0;
-  long parsed_long = strtol (pid_string, NULL, 10);
-  if (errno) {
-    fprintf (stderr, "could not parse pid string %s: ", pid_string);
-    perror ("");
-    exit (1);
+  int total = 0;
+  for (int field = 0; field < NB_FIELDS; field++) {
+    total += data->peak_top_count[field];
   }
-  if (parsed_long < 1 || parsed_long > INT_MAX) {
-    fprintf (stderr, "cannot decode pid %s: out of range\n", pid_string);
-    exit (1);
+  if (total == 0) {
+    return;
   }
-  int top_pid = (int) parsed_long;
 
-  time_t begin = parse_time (begin_string);
-  time_t end = parse_time (end_string);
+  /* Names of the processes of all the fields, in order, from their
+     NameId.  Histories without NameId have them in the PID-to-name
+     file instead, which is read once for all the processes left.  */
+  char (*names)[NAME_SIZE] = xreallocarray (NULL, total, NAME_SIZE);
+  int *missing = xreallocarray (NULL, total, sizeof (int));
+  int *pids = xreallocarray (NULL, total, sizeof (int));
+  time_t *times = xreallocarray (NULL, total, sizeof (time_t));
+  names_t dictionary;
+  int has_names = ! names_open (&dictionary, names_filename);
+  int nbmissing = 0;
+  int k = 0;
+  for (int field = 0; field < NB_FIELDS; field++) {
+    for (int i = 0; i < data->peak_top_count[field]; i++, k++) {
+      const stat_struct_t *proc = data->peak_top[field] + i;
+      if (! has_names || names_lookup (&dictionary, proc->NameId, names[k])) {
+        missing[nbmissing] = k;
+        pids[nbmissing] = proc->Pid;
+        times[nbmissing] = data->peak_time[field];
+        nbmissing++;
+      }
+    }
+  }
+  if (has_names) {
+    names_close (&dictionary);
+  }
+  if (nbmissing > 0) {
+    char (*comm_names)[NAME_SIZE] = xreallocarray (NULL, nbmissing, NAME_SIZE);
+    comm_lookup (nbmissing, times, pids, comm_names);
+    for (int m = 0; m < nbmissing; m++) {
+      memcpy (names[missing[m]], comm_names[m], NAME_SIZE);
+    }
+    free (comm_names);
+  }
 
-  if (begin > end) {
-    fprintf (stderr, "bad time range: the beginning is after the end\n");
-    exit (1);
+  k = 0;
+  for (int field = 0; field < NB_FIELDS; field++) {
+    int count = data->peak_top_count[field];
+    if (count == 0) {
+      continue;
+    }
+    const stat_struct_t *top = data->peak_top[field];
+    char time_string[15];
+    format_time (data->peak_time[field], time_string);
+    printf ("Largest processes at the %s peak (%s):\n", field_names[field], time_string);
+    for (int i = 0; i < count; i++, k++) {
+      printf (" %20d  %s  pid %d  ppid %d  %s\n", top[i].fields[field], field_names[field], top[i].Pid, top[i].PPid, names[k]);
+    }
   }
+  free (names);
+  free (missing);
+  free (pids);
+  free (times);
+}
 
-  int fd = open (capture_filename, O_RDONLY, 0);
-  if (fd < 0) {
-    perror ("could not open process-watcher.out for reading");
-    exit (1);
+/* Print the result of get: the max of the memory fields, then the CPU
+   time and I/O.  */
+static void
+print_max (const struct get_data *data)
+{
+  printf ("Max values:\n");
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (measure_field (field)) {
+      printf (" %20lld  %s\n", data->max.fields[field], field_names[field]);
+    }
   }
+  usage_print (&data->usage, &data->max, stdout);
+}
 
-  struct stat st;
-  if (fstat (fd, &st)) {
-    perror ("could not stat process-watcher.out");
-    exit (1);
+/* Percentiles printed by --percentiles.  */
+static const int percentiles[] = { 50, 90, 99, 100 };
+
+/* Print the percentiles of the memory fields.  */
+static void
+print_percentiles (const struct get_data *data)
+{
+  if (data->window != NULL) {
+    printf ("Percentiles of the max over %llu windows of %d s:\n", (unsigned long long) data->histograms[0].count, data->window->width);
+  } else {
+    printf ("Percentiles over %llu snapshots:\n", (unsigned long long) data->histograms[0].count);
+  }
+  printf (" ");
+  for (size_t i = 0; i < sizeof percentiles / sizeof percentiles[0]; i++) {
+    char header[8];
+    snprintf (header, sizeof header, "p%d", percentiles[i]);
+    printf (" %20s", header);
   }
+  printf ("\n");
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (! measure_field (field)) {
+      continue;
+    }
+    printf (" ");
+    for (size_t i = 0; i < sizeof percentiles / sizeof percentiles[0]; i++) {
+      printf (" %20lld", histogram_quantile (data->histograms + field, percentiles[i] / 100.0));
+    }
+    printf ("  %s\n", field_names[field]);
+  }
+}
 
-  size_t map_len = st.st_size;
+/* Start the query of DATA between BEGIN and END, writing the series or
+   the windows into OUTPUT.  */
+static void
+get_start (struct get_data *data, const options_t *options, FILE *output, time_t begin, time_t end)
+{
+  memset (&data->max, 0, sizeof data->max);
+  memset (&data->usage, 0, sizeof data->usage);
+  memset (data->peak_top_count, 0, sizeof data->peak_top_count);
+  if (data->histograms != NULL) {
+    memset (data->histograms, 0, NB_FIELDS * sizeof (histogram_t));
+  }
+  if (data->breakdown != NULL) {
+    breakdown_reset (data->breakdown);
+  }
+  if (data->series != NULL) {
+    series_start (data->series, output, options->buckets, begin, end);
+  }
+  if (data->window != NULL) {
+    window_start (data->window, begin, end, options->window, options->step, get_window, data);
+    data->window_output = output;
+    if (data->histograms == NULL) {
+      fprintf (output, "time");
+      for (int field = 0; field < NB_FIELDS; field++) {
+        if (measure_field (field)) {
+          fprintf (output, ",max_%s", field_names[field]);
+        }
+      }
+      fprintf (output, "\n");
+    }
+  }
+}
 
-  if (read_lock (fd)) {
-    fprintf (stderr, "could not take a read lock\n");
-    exit (1);
+/* Write what remains of the series and of the windows of DATA.  */
+static void
+get_finish (struct get_data *data)
+{
+  if (data->series != NULL) {
+    series_finish (data->series);
   }
+  if (data->window != NULL) {
+    window_finish (data->window);
+  }
+}
+
+/* Print the result of the query of DATA, unless it was written as it
+   came, i.e. the series or the windows.  */
+static void
+get_print (const struct get_data *data)
+{
+  if (data->series != NULL || (data->window != NULL && data->histograms == NULL)) {
+    return;
+  }
+  print_max (data);
+  print_top (data);
+  if (data->histograms != NULL) {
+    print_percentiles (data);
+  }
+  if (data->breakdown != NULL) {
+    breakdown_print (data->breakdown, data->breakdown_percent, stdout);
+  }
+}
 
-  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
-  if (map == MAP_FAILED) {
-    perror ("could not mmap process-watcher.out");
+/* Free what the query of DATA allocated.  */
+static void
+get_free (struct get_data *data)
+{
+  free (data->members);
+  for (int field = 0; field < NB_FIELDS; field++) {
+    free (data->peak_top[field]);
+  }
+  free (data->histograms);
+  free (data->name_matches);
+  if (data->breakdown != NULL) {
+    breakdown_free (data->breakdown);
+  }
+}
+
+/* Take into account each snapshot of the history file of QUERY taken
+   between BEGIN and END.  Exit on error.  */
+static void
+scan_history (query_t *query, struct get_data *data, time_t begin, time_t end)
+{
+  if (query_scan (query, data->top_id.pid, begin, end, get_snapshot, data)) {
     exit (1);
   }
+}
 
-  char *cursor = map;
-  char *map_end = map + map_len;
+/* Max memory of a cgroup over a time window.  */
+struct cgroup_max {
+  /* Max of memory.current.  */
+  uint64_t current;
+  /* Max of memory.current and of memory.peak since the previous
+     sample, i.e. the exact envelope of the time window, in the
+     samples whose memory.peak is known since the previous one.  */
+  uint64_t peak;
+  /* memory.peak since the creation of the cgroup in the last sample
+     whose memory.peak could not be reset, 0 if none.  */
+  uint64_t peak_since_creation;
+};
+
+/* Take into account the cgroup RECORD, for use with cgroup_read ().  */
+static void
+get_cgroup_record (const cgroup_record_t *record, void *data)
+{
+  struct cgroup_max *max = data;
+  if (record->current > max->current) {
+    max->current = record->current;
+  }
+  if (record->flags & CGROUP_PEAK_RESET) {
+    if (record->peak > max->peak) {
+      max->peak = record->peak;
+    }
+  } else {
+    max->peak_since_creation = record->peak;
+  }
+  if (max->current > max->peak) {
+    max->peak = max->current;
+  }
+}
 
-  const size_t header_len = strlen (header);
-  if (cursor + header_len > map_end) {
-    fprintf (stderr, "bad file: too short to contain the header\n");
+/* Perform "process-watcher get" on the cgroup PATH.  */
+static void
+get_cgroup (const options_t *options, const char *path, time_t begin, time_t end)
+{
+  if (options->series || options->top > 0 || options->window > 0 || options->percentiles || options->tree
+      || options->name != NULL) {
+    fprintf (stderr, "--series, --top, --window, --percentiles, --tree and --name are not supported for cgroups\n");
     exit (1);
   }
-  if (memcmp (header, cursor, header_len) != 0) {
-    fprintf (stderr, "bad header: should be {%s}\n", header);
+  struct cgroup_max max;
+  memset (&max, 0, sizeof max);
+  if (cgroup_read (path, begin, end, get_cgroup_record, &max)) {
+    fprintf (stderr, "no record of cgroup %s in the time window\n", path);
     exit (1);
   }
-  cursor += header_len;
-
-  stat_struct_t max;
-  memset (&max, 0, sizeof max); /* Set each element to 0.  */
 
-  /* Loop, one iteration per sample.  */
-  while (1) {
-    if (cursor == map_end) {
-      /* We have reached the end of the file, stop here.  */
-      break;
-    }
+  /* In kB, like the memory fields of processes.  */
+  printf ("Max values:\n");
+  printf (" %20llu  memory.current\n", (unsigned long long) max.current / 1024);
+  printf (" %20llu  memory.peak\n", (unsigned long long) max.peak / 1024);
+  if (max.peak_since_creation != 0) {
+    printf (" %20llu  memory.peak since the creation of the cgroup\n", (unsigned long long) max.peak_since_creation / 1024);
+  }
+}
 
-    if (cursor + sizeof (time_t) > map_end) {
-      fprintf (stderr, "cursor=%p map_end=%p no room for the timestamp\n", cursor, map_end);
-      exit (1);
-    }
-    time_t timestamp = * (time_t *) cursor;
-    cursor += sizeof (time_t);
+/* Perform the "process-watcher get" command.  */
+void
+get (const options_t *options, char *pid_string, char *begin_string, char *end_string)
+{
+  time_t begin = parse_time (begin_string);
+  time_t end = parse_time (end_string);
 
-    if (cursor + sizeof (int) > map_end) {
-      fprintf (stderr, "truncated snapshot: no nbpids: cursor=%p map_end=%p\n", cursor, map_end);
-      exit (1);
-    }
-    int nbpids = * (int *) cursor;
-    cursor += sizeof (int);
+  if (begin > end) {
+    fprintf (stderr, "bad time range: the beginning is after the end\n");
+    exit (1);
+  }
 
-    stat_struct_t *snapshot_start = (stat_struct_t *) cursor;
-    size_t snapshot_count = nbpids;
-    stat_struct_t *snapshot_end = snapshot_start + snapshot_count;
-    if (snapshot_end > (stat_struct_t *) map_end) {
-      fprintf (stderr, "truncated snapshot: %d pids,\n  %p  snapshot_start\n  %p  snapshot_end,\n  %p  map_end\n", nbpids, snapshot_start, snapshot_end, map_end);
-      abort ();
-      exit (1);
-    }
+  /* Cgroups are named by their directory.  */
+  if (pid_string != NULL && strchr (pid_string, '/') != NULL) {
+    get_cgroup (options, pid_string, begin, end);
+    return;
+  }
 
-    /* Move cursor past the snapshot.  */
-    cursor = (char *) snapshot_end;
+  proc_id_t top_id;
+  memset (&top_id, 0, sizeof top_id);
+  if (pid_string != NULL && try_parse_proc_id (pid_string, &top_id)) {
+    exit (1);
+  }
 
-    if (timestamp < begin) {
-      /* Current snapshot is before the requested time window.  */
-      continue;
-    }
+  accumulate_init ();
 
-    if (timestamp > end) {
-      /* Current snapshot is after of the requested time window.  */
-      break;
+  struct get_data data;
+  memset (&data, 0, sizeof data);
+  data.top_id = top_id;
+  series_t series;
+  if (options->series) {
+    data.series = &series;
+  }
+  window_t window;
+  if (options->window > 0) {
+    data.window = &window;
+  }
+  if (options->percentiles) {
+    data.histograms = xreallocarray (NULL, NB_FIELDS, sizeof (histogram_t));
+  }
+  breakdown_t breakdown;
+  if (options->tree) {
+    breakdown_init (&breakdown, options->top_field);
+    data.breakdown = &breakdown;
+    data.breakdown_percent = options->tree_percent;
+  }
+  data.top = options->top;
+  data.top_field = options->top_field;
+  if (options->name != NULL) {
+    /* Resolve the pattern once: the snapshots only hold the ids of the
+       names.  */
+    names_t names;
+    if (names_open (&names, names_filename)) {
+      fprintf (stderr, "could not read the name dictionary %s\n", names_filename);
+      exit (1);
     }
-
-    /* Find the top process.  */
-    stat_struct_t dummy_top = {
-      .Pid = top_pid,
-    };
-    stat_struct_t *top_proc = (stat_struct_t *) bsearch (&dummy_top, snapshot_start, snapshot_count, sizeof (stat_struct_t), compare_stat_structs);
-    if (top_proc == NULL) {
-      /* Cannot find the requested process.  */
-      continue;
+    data.nbname_ids = names.nbnames + 1;
+    data.name_matches = xreallocarray (NULL, data.nbname_ids, 1);
+    int count = names_match (&names, options->name, data.name_matches);
+    names_close (&names);
+    if (count == 0) {
+      fprintf (stderr, "no process name matches %s\n", options->name);
+      exit (1);
     }
-
-    stat_struct_t snapshot_totals;
-    memset (&snapshot_totals, 0, sizeof snapshot_totals); /* Set each element to 0.  */
-
-    /* Loop, iterate over all processes.  */
-    for (int procidx = 0; procidx < nbpids; procidx++) {
-      stat_struct_t *candidate_proc = snapshot_start + procidx;
-      if (is_proc_descendant_of_proc (candidate_proc, top_proc, snapshot_start, snapshot_count)) {
-        /* Add the current process to the accumulator.  */
-#define X(field) snapshot_totals.field += candidate_proc->field;
-#include "fields.out.h"
-#undef X
+  }
+  if (data.top > 0) {
+    for (int field = 0; field < NB_FIELDS; field++) {
+      if (data.top_field == -1 || data.top_field == field) {
+        data.peak_top[field] = xreallocarray (NULL, data.top, sizeof (stat_struct_t));
       }
     }
+  }
 
-    /* Update max according to snapshot_totals.  */
-#define X(field)                                \
-    if (snapshot_totals.field > max.field) {    \
-      max.field = snapshot_totals.field;        \
+  /* Try the recent snapshots in shared memory first.  */
+  ring_t ring;
+  if (options->shm_name != NULL && ring_open (&ring, options->shm_name) == 0) {
+    /* The series or the windows are kept in memory until we know that
+       the shared memory held the whole time window.  They are no
+       larger than the shared memory.  */
+    char *text = NULL;
+    size_t text_size = 0;
+    FILE *text_stream = open_memstream (&text, &text_size);
+    get_start (&data, options, text_stream, begin, end);
+    int missing = ring_read (&ring, begin, end, get_snapshot, &data);
+    ring_close (&ring);
+    get_finish (&data);
+    fclose (text_stream);
+    if (! missing) {
+      fwrite_unlocked (text, 1, text_size, stdout);
+      free (text);
+      get_print (&data);
+      get_free (&data);
+      return;
     }
-#include "fields.out.h"
-#undef X
+    free (text);
   }
 
-  printf ("Max values:\n");
-#define X(field) printf (" %20d  %s\n", max.field, #field);
-#include "fields.out.h"
-#undef X
-
-  munmap (map, map_len);
-
-  unlock (fd);
+  query_t *query = query_open (NULL);
+  if (query == NULL) {
+    exit (1);
+  }
+  query_set_window (query, options->map_window);
+  get_start (&data, options, stdout, begin, end);
+
+  /* Then the rollups computed by the capture, if the tree was
+     registered.  They do not have the processes needed by --top and
+     --tree, nor their names.  */
+  time_t raw_end;
+  time_t raw_begin;
+  if (data.top == 0 && data.name_matches == NULL && data.breakdown == NULL && rollup_read (&top_id, begin, end, &raw_end, &raw_begin, NULL, NULL) == 0) {
+    /* The first rollup_read () only resolves the copy TOP_ID: without
+       a given start time, the tree is the first process found with
+       the PID, which may be in the history before the registration.  */
+    if (raw_end > begin) {
+      scan_history (query, &data, begin, raw_end - 1);
+    }
+    rollup_read (&data.top_id, begin, end, &raw_end, &raw_begin, get_sample, &data);
+    if (raw_begin <= end) {
+      scan_history (query, &data, raw_begin, end);
+    }
+  } else {
+    scan_history (query, &data, begin, end);
+  }
+  query_close (query);
 
-  close (fd);
+  get_finish (&data);
+  get_print (&data);
+  get_free (&data);
 }
@@ -15,10 +15,21 @@ along with process-watcher.
 If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
+#include "options.h"            /* options_t.  */
+#include "status.h"             /* NAME_SIZE.  */
+
+/* Read the status and start time of the processes PIDS (NBPIDS of
+   them) into PROCS and their names into NAMES, as the capture does
+   for each sample, skipping those that have disappeared.  Return the
+   number of processes read.  Exit on error.  */
+int
+read_processes (const pid_t *pids, int nbpids, stat_struct_t *procs, char (*names)[NAME_SIZE]);
+
 /* Perform the "process-watcher capture" command.  */
 void
-capture (void);
+capture (const options_t *options);
 
-/* Perform the "process-watcher get" command.  */
+/* Perform the "process-watcher get" command.  PID_STRING is NULL with
+   --name for all the processes.  */
 void
-get (char *pid_string, char *begin_string, char *end_string);
+get (const options_t *options, char *pid_string, char *begin_string, char *end_string);
@@ -0,0 +1,326 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "names.h"
+
+#include "accumulate.h"         /* accumulate_add ().  */
+#include "proc-root.h"          /* proc_path ().  */
+#include "schema.h"             /* field_names.  */
+#include "side-file.h"          /* side_file_create ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* read ().  */
+#include <fnmatch.h>            /* fnmatch ().  */
+#include <stdint.h>             /* uint32_t.  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strcmp ().  */
+#include <limits.h>             /* PATH_MAX.  */
+
+/*
+ * FILE FORMAT
+ *
+ * Header: "# process-watcher names format\n\n" (32 bytes, without NUL
+ * character), then the names, each NUL-padded to NAME_SIZE bytes, in
+ * the order of their ids: the first one has id 1.  A name is written
+ * before the first snapshot that uses its id, so that the dictionary
+ * always covers the history.
+ */
+
+/* Name dictionary file name.  */
+const char names_filename[] = "process-watcher.names";
+
+/* First bytes of the name dictionary.
+   The strlen is a multiple of 8 for alignment purposes.  */
+static const char names_header[] = "# process-watcher names format\n\n";
+
+/* Return whether FIELD identifies the process.  */
+int
+identity_field (int field)
+{
+  return ! strcmp (field_names[field], "NameId") || ! strcmp (field_names[field], "CmdHash");
+}
+
+/* 32-bit FNV-1a offset basis and prime.  */
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/* Return the FNV-1a hash of the LEN bytes DATA, continuing HASH.  */
+static uint32_t
+fnv1a (uint32_t hash, const void *data, size_t len)
+{
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/* Insert ID, whose name is in WRITER, into the hash table.  */
+static void
+insert_slot (names_writer_t *writer, int id)
+{
+  const char *name = writer->names[id - 1];
+  size_t mask = writer->nbslots - 1;
+  size_t slot = fnv1a (FNV_BASIS, name, strlen (name)) & mask;
+  while (writer->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  writer->slots[slot] = id;
+}
+
+/* Add NAME to the dictionary in memory, and return its id.  */
+static int
+add_name (names_writer_t *writer, const char *name)
+{
+  if (writer->nbnames == writer->capacity) {
+    writer->capacity = writer->capacity == 0 ? 256 : 2 * writer->capacity;
+    writer->names = xreallocarray (writer->names, writer->capacity, NAME_SIZE);
+  }
+  memset (writer->names[writer->nbnames], 0, NAME_SIZE);
+  strncpy (writer->names[writer->nbnames], name, NAME_SIZE - 1);
+  writer->nbnames++;
+
+  /* Keep the table at most half full.  */
+  if (2 * (size_t) writer->nbnames > writer->nbslots) {
+    free (writer->slots);
+    writer->nbslots = writer->nbslots == 0 ? 512 : 2 * writer->nbslots;
+    writer->slots = xreallocarray (NULL, writer->nbslots, sizeof (int));
+    memset (writer->slots, 0, writer->nbslots * sizeof (int));
+    for (int id = 1; id < writer->nbnames; id++) {
+      insert_slot (writer, id);
+    }
+  }
+  insert_slot (writer, writer->nbnames);
+  return writer->nbnames;
+}
+
+/* Open the name dictionary FILENAME for writing into WRITER.  */
+void
+names_create (names_writer_t *writer, const char *filename, int append)
+{
+  memset (writer, 0, sizeof *writer);
+
+  /* The names kept by side_file_create () are those that names_open ()
+     finds.  */
+  names_t names;
+  if (append && ! names_open (&names, filename)) {
+    for (int i = 0; i < names.nbnames; i++) {
+      add_name (writer, names.names[i]);
+    }
+    names_close (&names);
+  }
+  writer->output = side_file_create (filename, names_header, NAME_SIZE, append);
+}
+
+/* Return the id of NAME, adding it to the dictionary if it is new.  */
+int
+names_id (names_writer_t *writer, const char *name)
+{
+  if (writer->nbslots > 0) {
+    size_t mask = writer->nbslots - 1;
+    size_t slot = fnv1a (FNV_BASIS, name, strlen (name)) & mask;
+    while (writer->slots[slot] != 0) {
+      int id = writer->slots[slot];
+      if (! strncmp (writer->names[id - 1], name, NAME_SIZE - 1)) {
+        return id;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  int id = add_name (writer, name);
+  if (fwrite_unlocked (writer->names[id - 1], NAME_SIZE, 1, writer->output) != 1) {
+    perror ("could not write a name");
+    exit (1);
+  }
+  return id;
+}
+
+/* Return the hash of /proc/PID/cmdline, 0 if it is empty (a kernel
+   thread) or cannot be read.  */
+static int
+cmdline_hash (pid_t pid)
+{
+  char filename[PATH_MAX];
+  proc_path (filename, sizeof filename, pid, "cmdline");
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  uint32_t hash = FNV_BASIS;
+  size_t total = 0;
+  char buffer[4096];
+  ssize_t len;
+  while ((len = read (fd, buffer, sizeof buffer)) > 0) {
+    hash = fnv1a (hash, buffer, len);
+    total += len;
+  }
+  close (fd);
+  return total == 0 ? 0 : (int) hash;
+}
+
+/* Set the NameId, and CmdHash if CMDLINE, of the processes.  */
+void
+names_sample (names_writer_t *writer, stat_struct_t *procs, char (*names)[NAME_SIZE], int nbprocs, int cmdline)
+{
+  /* Both the previous and the current processes are in ascending PID
+     order: walk them together.  A process that is the same one (same
+     start time) with the same name is assumed to have kept its
+     command line.  */
+  int previous = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    stat_struct_t *proc = procs + i;
+    proc->NameId = names_id (writer, names[i]);
+    proc->CmdHash = 0;
+    if (! cmdline) {
+      continue;
+    }
+    while (previous < writer->nbprevious && writer->previous[previous].Pid < proc->Pid) {
+      previous++;
+    }
+    const stat_struct_t *old = writer->previous + previous;
+    if (previous < writer->nbprevious
+        && old->Pid == proc->Pid
+        && old->StartTime == proc->StartTime
+        && old->NameId == proc->NameId) {
+      proc->CmdHash = old->CmdHash;
+    } else {
+      proc->CmdHash = cmdline_hash (proc->Pid);
+    }
+  }
+  /* The new names are on disk before the snapshot that uses them.  */
+  if (fflush_unlocked (writer->output)) {
+    perror ("could not write a name");
+    exit (1);
+  }
+
+  if (! cmdline) {
+    return;
+  }
+  if (nbprocs > writer->previous_capacity) {
+    writer->previous_capacity = nbprocs;
+    writer->previous = xreallocarray (writer->previous, nbprocs, sizeof (stat_struct_t));
+  }
+  memcpy (writer->previous, procs, (size_t) nbprocs * sizeof (stat_struct_t));
+  writer->nbprevious = nbprocs;
+}
+
+/* Close the name dictionary of WRITER.  */
+void
+names_writer_close (names_writer_t *writer)
+{
+  if (fclose (writer->output)) {
+    perror ("could not write a name");
+    exit (1);
+  }
+  free (writer->names);
+  free (writer->slots);
+  free (writer->previous);
+}
+
+/* Map the name dictionary FILENAME into NAMES.  */
+int
+names_open (names_t *names, const char *filename)
+{
+  memset (names, 0, sizeof *names);
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  const size_t header_len = strlen (names_header);
+  if (fstat (fd, &st) || (size_t) st.st_size < header_len) {
+    close (fd);
+    return 1;
+  }
+  size_t map_len = st.st_size;
+  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED) {
+    return 1;
+  }
+  if (memcmp (map, names_header, header_len) != 0) {
+    munmap (map, map_len);
+    return 1;
+  }
+
+  names->names = (const char (*)[NAME_SIZE]) (map + header_len);
+  names->nbnames = (map_len - header_len) / NAME_SIZE;
+  names->map = map;
+  names->map_len = map_len;
+  return 0;
+}
+
+/* Unmap NAMES.  */
+void
+names_close (names_t *names)
+{
+  munmap (names->map, names->map_len);
+}
+
+/* Copy the name of ID into NAME.  */
+int
+names_lookup (const names_t *names, int id, char name[NAME_SIZE])
+{
+  if (id <= 0 || id > names->nbnames) {
+    return 1;
+  }
+  memcpy (name, names->names[id - 1], NAME_SIZE);
+  name[NAME_SIZE - 1] = 0;
+  return 0;
+}
+
+/* Resolve PATTERN against each name of NAMES.  */
+int
+names_match (const names_t *names, const char *pattern, char *matches)
+{
+  int count = 0;
+  matches[0] = 0;
+  for (int i = 0; i < names->nbnames; i++) {
+    char name[NAME_SIZE];
+    memcpy (name, names->names[i], NAME_SIZE);
+    name[NAME_SIZE - 1] = 0;
+    matches[i + 1] = ! fnmatch (pattern, name, 0);
+    count += matches[i + 1];
+  }
+  return count;
+}
+
+/* Keep the MEMBERS whose name matches, and sum them into TOTALS.  */
+int
+names_filter (const char *matches, int nbids, stat_struct_t **members, int nbmembers, totals_t *totals)
+{
+  memset (totals, 0, sizeof *totals);
+  int count = 0;
+  for (int i = 0; i < nbmembers; i++) {
+    int id = members[i]->NameId;
+    if (id >= 0 && id < nbids && matches[id]) {
+      accumulate_add (totals, members[i]);
+      members[count++] = members[i];
+    }
+  }
+  totals->NameId = 0;
+  totals->CmdHash = 0;
+  return count;
+}
@@ -0,0 +1,116 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include "stat-struct.h"        /* stat_struct_t.  */
+#include "status.h"             /* NAME_SIZE.  */
+
+#include <stdio.h>              /* FILE.  */
+#include <stddef.h>             /* size_t.  */
+
+/* Name dictionary file name.  */
+extern const char names_filename[];
+
+/* Return whether the field of stat_struct_t of index FIELD identifies
+   the process rather than measures it: NameId or CmdHash.  Such fields
+   are not summed over trees.  */
+int
+identity_field (int field);
+
+/* Writer of the name dictionary, which gives each process name an id
+   so that the snapshots only hold the ids.  */
+typedef struct {
+  FILE *output;
+  /* Names, the one of id I at index I - 1.  */
+  char (*names)[NAME_SIZE];
+  int nbnames;
+  int capacity;
+  /* Open addressing hash table of the ids, by the hash of their name,
+     0 for an empty slot.  Its size is a power of 2.  */
+  int *slots;
+  size_t nbslots;
+  /* Processes of the previous snapshot, whose command line hashes are
+     reused.  */
+  stat_struct_t *previous;
+  int nbprevious;
+  int previous_capacity;
+} names_writer_t;
+
+/* Open the name dictionary FILENAME for writing into WRITER,
+   truncating it unless APPEND (see side_file_create ()), in which case
+   its names keep their ids.  Exit on error.  */
+void
+names_create (names_writer_t *writer, const char *filename, int append);
+
+/* Return the id of NAME, adding it to the dictionary if it is new.
+   Exit on error.  */
+int
+names_id (names_writer_t *writer, const char *name);
+
+/* Set the NameId of the NBPROCS processes PROCS from their NAMES, and
+   if CMDLINE, their CmdHash from their /proc/PID/cmdline.  The command
+   line is only read for the processes that are new or renamed since
+   the previous call.  Exit on error.  */
+void
+names_sample (names_writer_t *writer, stat_struct_t *procs, char (*names)[NAME_SIZE], int nbprocs, int cmdline);
+
+/* Close the name dictionary of WRITER and free WRITER.  Exit on
+   error.  */
+void
+names_writer_close (names_writer_t *writer);
+
+/* Name dictionary open for reading.  */
+typedef struct {
+  /* Names, the one of id I at index I - 1.  */
+  const char (*names)[NAME_SIZE];
+  int nbnames;
+  void *map;
+  size_t map_len;
+} names_t;
+
+/* Map the name dictionary FILENAME into NAMES.
+   On success, return 0; if the file is missing or is not a name
+   dictionary, return 1.  */
+int
+names_open (names_t *names, const char *filename);
+
+/* Unmap NAMES.  */
+void
+names_close (names_t *names);
+
+/* Copy into NAME the name of id ID in NAMES.
+   If it is known, return 0; otherwise, return 1.  */
+int
+names_lookup (const names_t *names, int id, char name[NAME_SIZE]);
+
+/* Set MATCHES[ID] for each id of NAMES from 0 to NAMES->nbnames: 1 if
+   its name matches the shell wildcard PATTERN (see fnmatch (3)), 0
+   otherwise, and 0 for the unknown name 0.  Return the number of
+   matching names.  */
+int
+names_match (const names_t *names, const char *pattern, char *matches);
+
+/* Keep among the NBMEMBERS processes MEMBERS those whose NameId is
+   below NBIDS and set in MATCHES, and store their sum into TOTALS.
+   Return their number.  */
+int
+names_filter (const char *matches, int nbids, stat_struct_t **members, int nbmembers, totals_t *totals);
+
+#endif /* NAMES_H */
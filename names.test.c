@@ -0,0 +1,184 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "names.test.h"
+
+#include "names.h"
+#include "accumulate.h"         /* accumulate_init ().  */
+#include "proc-root.h"          /* proc_root.  */
+#include "test-procfs.h"        /* test_procfs_write ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <unistd.h>             /* chdir (), unlink ().  */
+
+/* Check that the names get stable ids, also across an append, and
+   that patterns are resolved against them.  */
+static int
+test_names_dictionary (void)
+{
+  int error = 0;
+  names_writer_t writer;
+  names_create (&writer, names_filename, 0);
+  int bash = names_id (&writer, "bash");
+  int ld = names_id (&writer, "ld.lld");
+  /* Enough names to grow the hash table a few times.  */
+  char name[NAME_SIZE];
+  for (int i = 0; i < 3000; i++) {
+    snprintf (name, sizeof name, "worker-%d", i);
+    if (names_id (&writer, name) != i + 3) {
+      fprintf (stderr, "%s got id %d\n", name, names_id (&writer, name));
+      error = 1;
+    }
+  }
+  if (bash != 1 || ld != 2 || names_id (&writer, "bash") != 1 || names_id (&writer, "ld.lld") != 2) {
+    fprintf (stderr, "bash got id %d, ld.lld %d\n", bash, ld);
+    error = 1;
+  }
+  names_writer_close (&writer);
+
+  /* Going on with the dictionary keeps the ids.  */
+  names_create (&writer, names_filename, 1);
+  if (names_id (&writer, "ld.lld") != 2 || names_id (&writer, "worker-2999") != 3002
+      || names_id (&writer, "cc1plus") != 3003) {
+    fprintf (stderr, "the ids changed after an append\n");
+    error = 1;
+  }
+  names_writer_close (&writer);
+
+  names_t names;
+  int opened = names_open (&names, names_filename);
+  assert (opened == 0);
+  char matches[names.nbnames + 1];
+  int count = names_match (&names, "worker-1?", matches);
+  if (names.nbnames != 3003 || count != 10 || ! matches[13] || matches[12] || matches[0]) {
+    fprintf (stderr, "%d names, worker-1? matched %d\n", names.nbnames, count);
+    error = 1;
+  }
+  if (names_match (&names, "ld*", matches) != 1 || ! matches[2]) {
+    fprintf (stderr, "ld* did not match ld.lld only\n");
+    error = 1;
+  }
+  names_close (&names);
+  return error;
+}
+
+/* Check the ids and command line hashes set by names_sample (), and
+   that the hash of a process is only computed once.  */
+static int
+test_names_sample (void)
+{
+  int error = 0;
+  test_procfs_write (".", "42", "cmdline", "ld.lld\0-o\0a.out", 15);
+  test_procfs_write (".", "43", "cmdline", "ld.lld\0-o\0b.out", 15);
+  test_procfs_write (".", "44", "cmdline", "", 0);
+  const char *old_proc_root = proc_root;
+  proc_root = ".";
+
+  names_writer_t writer;
+  names_create (&writer, names_filename, 0);
+  stat_struct_t procs[3];
+  memset (procs, 0, sizeof procs);
+  char names[3][NAME_SIZE] = { "ld.lld", "ld.lld", "kthreadd" };
+  for (int i = 0; i < 3; i++) {
+    procs[i].Pid = 42 + i;
+    procs[i].StartTime = 100;
+  }
+  names_sample (&writer, procs, names, 3, 1);
+  int hash = procs[0].CmdHash;
+  if (procs[0].NameId != 1 || procs[1].NameId != 1 || procs[2].NameId != 2
+      || hash == 0 || procs[1].CmdHash == hash || procs[2].CmdHash != 0) {
+    fprintf (stderr, "names_sample () set ids %d %d %d, hashes %d %d %d\n",
+             procs[0].NameId, procs[1].NameId, procs[2].NameId, procs[0].CmdHash, procs[1].CmdHash, procs[2].CmdHash);
+    error = 1;
+  }
+
+  /* Process 42 is the same one: its command line is not read again.
+     Process 43 was replaced by a new one with the same PID.  */
+  test_procfs_write (".", "42", "cmdline", "ld.lld\0-o\0b.out", 15);
+  procs[1].StartTime = 200;
+  names_sample (&writer, procs, names, 3, 1);
+  if (procs[0].CmdHash != hash || procs[1].CmdHash == hash) {
+    fprintf (stderr, "names_sample () did not reuse the hash\n");
+    error = 1;
+  }
+  names_writer_close (&writer);
+
+  proc_root = old_proc_root;
+  test_procfs_remove (".", "42", "cmdline");
+  test_procfs_remove (".", "43", "cmdline");
+  test_procfs_remove (".", "44", "cmdline");
+  return error;
+}
+
+/* Check that names_filter () sums up the matching processes only,
+   without their identity fields.  */
+static int
+test_names_filter (void)
+{
+  stat_struct_t procs[3];
+  memset (procs, 0, sizeof procs);
+  stat_struct_t *members[3];
+  for (int i = 0; i < 3; i++) {
+    procs[i].NameId = i;
+    procs[i].CmdHash = 7;
+    procs[i].VmRSS = 1 << i;
+    members[i] = procs + i;
+  }
+  /* Id 5 is unknown to the matches.  */
+  procs[0].NameId = 5;
+  static const char matches[3] = { 0, 1, 1 };
+  totals_t totals;
+  int count = names_filter (matches, 3, members, 3, &totals);
+  if (count != 2 || members[0] != procs + 1 || members[1] != procs + 2
+      || totals.VmRSS != 6 || totals.NameId != 0 || totals.CmdHash != 0) {
+    fprintf (stderr, "names_filter () kept %d processes, VmRSS %lld\n", count, totals.VmRSS);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run all tests on the names.c file.  */
+void
+test_names (void)
+{
+  accumulate_init ();
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  char old_cwd[PATH_MAX];
+  char *got_cwd = getcwd (old_cwd, sizeof old_cwd);
+  assert (got_cwd != NULL);
+  int status = chdir (root);
+  assert (status == 0);
+
+  int error = test_names_dictionary ();
+  error |= test_names_sample ();
+  error |= test_names_filter ();
+
+  unlink (names_filename);
+  status = chdir (old_cwd);
+  assert (status == 0);
+  rmdir (root);
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,103 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stddef.h>             /* size_t.  */
+#include <time.h>               /* time_t.  */
+
+/* Options given on the command line.  */
+typedef struct {
+  /* Name of the POSIX shared memory object in which capture publishes
+     its most recent snapshots, and in which get looks for them before
+     reading the history file.  NULL if not used.  */
+  const char *shm_name;
+  /* Number of snapshots kept in the shared memory.  */
+  int shm_slots;
+  /* Maximum number of processes per snapshot in the shared memory.  */
+  int shm_procs;
+  /* Whether get prints the series of the tree totals instead of their
+     max.  */
+  int series;
+  /* Number of time buckets into which get downsamples the series, 0
+     for one row per snapshot.  */
+  int buckets;
+  /* Width and period in seconds of the sliding windows over which get
+     prints the max of the tree totals, 0 for none.  */
+  int window;
+  int step;
+  /* Whether get also prints percentiles of the tree totals, or with
+     WINDOW of their maxima over the windows.  */
+  int percentiles;
+  /* Number of largest processes that get prints at the peak, 0 for
+     none.  */
+  int top;
+  /* Index of the memory field whose peak is used by --top, -1 for
+     the peak of each field.  */
+  int top_field;
+  /* Whether get also prints the peak of the TOP_FIELD total of each
+     subtree, and the percentage of the peak of the tree below which
+     the subtrees are not printed.  */
+  int tree;
+  int tree_percent;
+  /* File into which capture writes its statistics periodically, or
+     NULL.  */
+  const char *stats_file;
+  /* Address on which capture serves its metrics: a TCP port on
+     127.0.0.1, or the file name of a Unix socket.  NULL if not
+     used.  */
+  const char *metrics;
+  /* Comma-separated memory fields that capture records, or NULL for
+     all of them.  */
+  const char *fields;
+  /* Size of the window of the history file that get maps at a time, 0
+     to map the whole file.  */
+  size_t map_window;
+  /* Time in milliseconds that capture spends reading
+     /proc/PID/smaps_rollup at each sample, 0 not to read it.  */
+  int smaps_budget_ms;
+  /* Whether capture reads /proc/PID/io for the processes of the
+     registered trees.  */
+  int io;
+  /* Whether capture records a hash of the command line of each
+     process.  */
+  int cmdline;
+  /* Shell wildcard pattern of the names of the processes that get sums
+     up, or NULL for all the processes of the tree.  */
+  const char *name;
+  /* Directories of the cgroups that capture samples, and of the
+     cgroups whose whole subtree it samples.  */
+  const char **cgroup_dirs;
+  int nbcgroup_dirs;
+  const char **cgroup_trees;
+  int nbcgroup_trees;
+  /* Whether capture goes on with the existing history instead of
+     truncating it.  */
+  int append;
+  /* Directory into which compact writes its history.  */
+  const char *output;
+  /* Whether compact drops the processes without any recorded value
+     nor children.  */
+  int drop_idle;
+  /* Period in seconds of the snapshots that compact keeps, 0 to keep
+     them all, and time before which it applies, 0 for always.  */
+  int downsample;
+  time_t downsample_before;
+} options_t;
+
+#endif /* OPTIONS_H */
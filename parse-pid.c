@@ -0,0 +1,80 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "parse-pid.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* strtol ().  */
+#include <errno.h>              /* errno.  */
+#include <limits.h>             /* INT_MAX.  */
+#include <string.h>             /* strchr ().  */
+
+/* Parse the process ID in STRING and store it into *PID.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_pid (const char *string, int *pid)
+{
+  char *end;
+  errno = 0;
+  long parsed_long = strtol (string, &end, 10);
+  if (errno || end == string || *end != 0) {
+    fprintf (stderr, "could not parse pid string %s\n", string);
+    return 1;
+  }
+  if (parsed_long < 1 || parsed_long > INT_MAX) {
+    fprintf (stderr, "cannot decode pid %s: out of range\n", string);
+    return 1;
+  }
+  *pid = (int) parsed_long;
+  return 0;
+}
+
+/* Parse STRING, either "PID" or "PID@STARTTIME", and store it into
+   *ID.  */
+int
+try_parse_proc_id (const char *string, proc_id_t *id)
+{
+  const char *at = strchr (string, '@');
+  if (at == NULL) {
+    id->has_start_time = 0;
+    id->start_time = 0;
+    return try_parse_pid (string, &id->pid);
+  }
+
+  char pid_string[16];
+  if ((size_t) (at - string) >= sizeof pid_string) {
+    fprintf (stderr, "could not parse pid string %s\n", string);
+    return 1;
+  }
+  memcpy (pid_string, string, at - string);
+  pid_string[at - string] = 0;
+  if (try_parse_pid (pid_string, &id->pid)) {
+    return 1;
+  }
+
+  char *end;
+  errno = 0;
+  unsigned long long parsed = strtoull (at + 1, &end, 10);
+  if (errno || end == at + 1 || *end != 0 || at[1] == '-') {
+    fprintf (stderr, "could not parse start time in %s\n", string);
+    return 1;
+  }
+  /* Only the low 32 bits are recorded.  */
+  id->has_start_time = 1;
+  id->start_time = (unsigned int) parsed;
+  return 0;
+}
@@ -0,0 +1,31 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "stat-struct.h"        /* proc_id_t.  */
+
+/* Parse the process ID in STRING and store it into *PID.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_pid (const char *string, int *pid);
+
+/* Parse STRING, either "PID" or "PID@STARTTIME", and store it into
+   *ID.  STARTTIME is the start time of the process in clock ticks
+   after boot, as in field 22 of /proc/PID/stat; without it, the start
+   time of ID is left unknown.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_proc_id (const char *string, proc_id_t *id);
@@ -20,48 +20,99 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 #include <string.h>             /* strlen ().  */
 #include <stdio.h>              /* fprintf ().  */
 #include <stdlib.h>             /* exit ().  */
-#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* INT_MAX.  */
 
-/* Parse the given STRING and convert into time_t.
-   STRING is supposed to have the format: YYYYMMDDhhmmss.  */
-time_t
-parse_time (char *string)
+/* Parse the given STRING and store it into *RESULT.
+   STRING is supposed to have the format: YYYYMMDDhhmmss.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_time (const char *string, time_t *result)
 {
   /* String is supposed to be: YYYYMMDDhhmmss i.e. 14 chars.  */
   if (strlen (string) != 14) {
     fprintf (stderr, "time string \"%s\" is not 14 chars long\n", string);
-    exit (1);
+    return 1;
   }
   struct tm tm;
+  memset (&tm, 0, sizeof tm);
 
   int year, month, day, hour, min, sec;
-  if (sscanf (string, "%4d%02d%02d%02d%02d%02d", &year, &month, &day, &hour, &min, &sec) != 6) {
+  if (sscanf (string, "%4d%02d%02d%02d%02d%02d", &year, &month, &day, &hour, &min, &sec) != 6
+      || year <= 1900
+      || month < 1 || month > 12
+      || day < 1 || day > 31
+      || hour < 0 || hour >= 24
+      || min < 0 || min >= 60
+      || sec < 0 || sec > 60) {
     fprintf (stderr, "could not parse time from string %s\n", string);
-    exit (1);
+    return 1;
   }
 
-  assert (year > 1900);
   tm.tm_year = year - 1900;
-
-  assert (month >= 1);
-  assert (month <= 12);
   tm.tm_mon = month - 1;
-
-  assert (day >= 1);
-  assert (day <= 31);
   tm.tm_mday = day;
-
-  assert (hour >= 0);
-  assert (hour < 24);
   tm.tm_hour = hour;
-
-  assert (min >= 0);
-  assert (min < 60);
   tm.tm_min = min;
-
-  assert (sec >= 0);
-  assert (sec <= 60);
   tm.tm_sec = sec;
 
-  return timegm (&tm);
+  *result = timegm (&tm);
+  return 0;
+}
+
+/* Parse the given STRING and convert into time_t.
+   STRING is supposed to have the format: YYYYMMDDhhmmss.
+   Exit on error.  */
+time_t
+parse_time (char *string)
+{
+  time_t result;
+  if (try_parse_time (string, &result)) {
+    exit (1);
+  }
+  return result;
+}
+
+/* Parse the duration STRING into *SECONDS.  */
+int
+try_parse_duration (const char *string, int *seconds)
+{
+  char *end;
+  long value = strtol (string, &end, 10);
+  long unit = 1;
+  if (end != string && end[0] != 0 && end[1] == 0) {
+    switch (end[0]) {
+    case 's':
+      unit = 1;
+      end++;
+      break;
+    case 'm':
+      unit = 60;
+      end++;
+      break;
+    case 'h':
+      unit = 3600;
+      end++;
+      break;
+    case 'd':
+      unit = 86400;
+      end++;
+      break;
+    }
+  }
+  if (end == string || *end != 0 || value < 1 || value > INT_MAX / unit) {
+    fprintf (stderr, "could not parse duration from string %s\n", string);
+    return 1;
+  }
+  *seconds = (int) (value * unit);
+  return 0;
+}
+
+/* Write TIME into BUFFER with the format YYYYMMDDhhmmss, as accepted
+   by parse_time ().  */
+void
+format_time (time_t time, char buffer[15])
+{
+  struct tm tm;
+  gmtime_r (&time, &tm);
+  strftime (buffer, 15, "%Y%m%d%H%M%S", &tm);
 }
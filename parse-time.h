@@ -17,7 +17,26 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 
 #include <time.h>               /* time_t.  */
 
+/* Parse the given STRING and store it into *RESULT.
+   STRING is supposed to have the format: YYYYMMDDhhmmss.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_time (const char *string, time_t *result);
+
 /* Parse the given STRING and convert into time_t.
-   STRING is supposed to have the format: YYYYMMDDhhmmss.  */
+   STRING is supposed to have the format: YYYYMMDDhhmmss.
+   Exit on error.  */
 time_t
 parse_time (char *string);
+
+/* Parse the duration STRING into *SECONDS: a positive number of
+   seconds, or of minutes, hours or days if it ends with m, h or d,
+   e.g. 10m.
+   On success, return 0; on error, print a message and return 1.  */
+int
+try_parse_duration (const char *string, int *seconds);
+
+/* Write TIME into BUFFER with the format YYYYMMDDhhmmss, as accepted
+   by parse_time ().  */
+void
+format_time (time_t time, char buffer[15]);
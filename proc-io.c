@@ -0,0 +1,204 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "proc-io.h"
+
+#include "proc-root.h"          /* proc_path ().  */
+#include "schema.h"             /* field_names.  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <stddef.h>             /* offsetof ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* read ().  */
+#include <stdlib.h>             /* strtoull ().  */
+#include <string.h>             /* strcmp (), strncmp ().  */
+#include <limits.h>             /* PATH_MAX, INT_MAX.  */
+
+/*
+ * Example of /proc/PID/io:
+ *
+ * rchar: 323934931
+ * wchar: 323929600
+ * syscr: 632687
+ * syscw: 632675
+ * read_bytes: 0
+ * write_bytes: 323932160
+ * cancelled_write_bytes: 0
+ *
+ * Only the owner of the process (or root) can read it.
+ */
+
+/* Fields of /proc/PID/io that are kept, and where they go.  */
+static const struct {
+  const char *name;
+  size_t offset;
+} io_lines[] = {
+  { "syscr", offsetof (proc_io_t, syscr) },
+  { "syscw", offsetof (proc_io_t, syscw) },
+  { "read_bytes", offsetof (proc_io_t, read_bytes) },
+  { "write_bytes", offsetof (proc_io_t, write_bytes) },
+};
+
+/* Names of the fields filled from /proc/PID/io.  */
+static const char *const io_names[] = { "IoRead", "IoWrite", "Syscr", "Syscw" };
+
+/* Return whether FIELD is filled from /proc/PID/io.  */
+int
+io_field (int field)
+{
+  for (size_t i = 0; i < sizeof io_names / sizeof io_names[0]; i++) {
+    if (! strcmp (field_names[field], io_names[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Parse TEXT into *IO.  */
+int
+parse_io (const char *text, proc_io_t *io)
+{
+  int found = 0;
+  for (const char *line = text; *line != 0; ) {
+    const char *colon = strchr (line, ':');
+    const char *end = strchr (line, '\n');
+    if (end == NULL) {
+      end = line + strlen (line);
+    }
+    if (colon != NULL && colon < end) {
+      for (size_t i = 0; i < sizeof io_lines / sizeof io_lines[0]; i++) {
+        size_t name_len = strlen (io_lines[i].name);
+        if ((size_t) (colon - line) == name_len && ! strncmp (line, io_lines[i].name, name_len)) {
+          *(unsigned long long *) ((char *) io + io_lines[i].offset) = strtoull (colon + 1, NULL, 10);
+          found |= 1 << i;
+        }
+      }
+    }
+    line = *end == 0 ? end : end + 1;
+  }
+  return found != (1 << (sizeof io_lines / sizeof io_lines[0])) - 1;
+}
+
+/* Read /proc/PID/io into *IO.  */
+int
+read_io_pid (pid_t pid, proc_io_t *io)
+{
+  char filename[PATH_MAX];
+  proc_path (filename, sizeof filename, pid, "io");
+
+  /* As for /proc/PID/stat, a single read () gets it whole.  */
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  char text[512];
+  ssize_t len = read (fd, text, sizeof text - 1);
+  close (fd);
+  if (len <= 0) {
+    return 1;
+  }
+  text[len] = 0;
+  return parse_io (text, io);
+}
+
+/* Return VALUE saturated to INT_MAX.  */
+static int
+saturate (unsigned long long value)
+{
+  return value > INT_MAX ? INT_MAX : (int) value;
+}
+
+/* Store IO into the I/O fields of PROC.  */
+void
+io_store (const proc_io_t *io, stat_struct_t *proc)
+{
+  proc->IoRead = saturate (io->read_bytes / 1024);
+  proc->IoWrite = saturate (io->write_bytes / 1024);
+  proc->Syscr = saturate (io->syscr);
+  proc->Syscw = saturate (io->syscw);
+}
+
+/* Store into PROC what IO counts since FIRST.  */
+static void
+io_store_since (const proc_io_t *io, const proc_io_t *first, stat_struct_t *proc)
+{
+  proc_io_t since = {
+    .read_bytes = io->read_bytes - first->read_bytes,
+    .write_bytes = io->write_bytes - first->write_bytes,
+    .syscr = io->syscr - first->syscr,
+    .syscw = io->syscw - first->syscw,
+  };
+  io_store (&since, proc);
+}
+
+/* Fill the I/O fields of the processes of the registered trees.  */
+void
+io_sample (io_sampler_t *sampler, snapshot_t *snapshot, const registry_t *registry)
+{
+  int nbprocs = snapshot->nbpids;
+  if (nbprocs > sampler->capacity) {
+    sampler->capacity = nbprocs;
+    sampler->marks = xreallocarray (sampler->marks, nbprocs, 1);
+    sampler->members = xreallocarray (sampler->members, nbprocs, sizeof (stat_struct_t *));
+    sampler->readings = xreallocarray (sampler->readings, nbprocs, sizeof (io_reading_t));
+    sampler->next_readings = xreallocarray (sampler->next_readings, nbprocs, sizeof (io_reading_t));
+  }
+  registry_mark_members (registry, snapshot, sampler->marks, sampler->members);
+
+  /* Both the processes and the readings are sorted by pid.  */
+  int nbnext = 0;
+  int r = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    stat_struct_t *proc = snapshot->procs + i;
+    while (r < sampler->nbreadings && sampler->readings[r].pid < proc->Pid) {
+      r++;
+    }
+    const io_reading_t *reading = NULL;
+    if (r < sampler->nbreadings && sampler->readings[r].pid == proc->Pid
+        && sampler->readings[r].start_time == proc->StartTime) {
+      reading = sampler->readings + r;
+    }
+
+    proc_io_t io;
+    if (! sampler->marks[i]) {
+      memset (&io, 0, sizeof io);
+      io_store (&io, proc);
+      continue;
+    }
+    io_reading_t *next = sampler->next_readings + nbnext;
+    if (read_io_pid (proc->Pid, &io)) {
+      if (reading == NULL) {
+        memset (&io, 0, sizeof io);
+        io_store (&io, proc);
+        continue;
+      }
+      *next = *reading;
+    } else {
+      next->pid = proc->Pid;
+      next->start_time = proc->StartTime;
+      next->first = reading != NULL ? reading->first : io;
+      next->last = io;
+    }
+    io_store_since (&next->last, &next->first, proc);
+    nbnext++;
+  }
+
+  io_reading_t *swap = sampler->readings;
+  sampler->readings = sampler->next_readings;
+  sampler->next_readings = swap;
+  sampler->nbreadings = nbnext;
+}
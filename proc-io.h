@@ -0,0 +1,89 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef PROC_IO_H
+#define PROC_IO_H
+
+#include "registry.h"           /* registry_t.  */
+
+#include <sys/types.h>          /* pid_t.  */
+
+/* What is read from /proc/PID/io.  */
+typedef struct {
+  /* Bytes that the process, and its children that were waited for,
+     caused to be fetched from and sent to the storage.  */
+  unsigned long long read_bytes;
+  unsigned long long write_bytes;
+  /* Their numbers of read and write system calls.  */
+  unsigned long long syscr;
+  unsigned long long syscw;
+} proc_io_t;
+
+/* Return whether the memory field of stat_struct_t of index FIELD is
+   filled from /proc/PID/io.  */
+int
+io_field (int field);
+
+/* Parse TEXT, the contents of /proc/PID/io, into *IO.
+   On success, return 0; if a field is missing, return 1.  */
+int
+parse_io (const char *text, proc_io_t *io);
+
+/* Read /proc/PID/io into *IO.
+   On success, return 0; if the process has disappeared, or its file
+   cannot be read (e.g. a process of another user), return 1.  */
+int
+read_io_pid (pid_t pid, proc_io_t *io);
+
+/* Store IO into the IoRead, IoWrite, Syscr and Syscw fields of PROC,
+   the bytes in kB, saturated to INT_MAX.  */
+void
+io_store (const proc_io_t *io, stat_struct_t *proc);
+
+/* First and last readings of a process, so that its I/O fields count
+   from its first reading.  */
+typedef struct {
+  int pid;
+  unsigned int start_time;
+  proc_io_t first;
+  proc_io_t last;
+} io_reading_t;
+
+/* State of the /proc/PID/io source of a capture.  */
+typedef struct {
+  /* Readings of the processes read in the previous sample, sorted by
+     pid, and the array into which those of the current sample are
+     built.  */
+  io_reading_t *readings;
+  int nbreadings;
+  io_reading_t *next_readings;
+  /* Work arrays with room for one entry per process.  */
+  char *marks;
+  stat_struct_t **members;
+  int capacity;
+} io_sampler_t;
+
+/* Fill the I/O fields of the processes of SNAPSHOT, sorted by pid,
+   that belong to the trees of REGISTRY with what they did since they
+   were first read, so that a process that joins a tree, e.g. when the
+   tree is registered, brings none of its past I/O to the sums.  A
+   process whose file cannot be read keeps the values of its last
+   reading.  The fields of the other processes are left 0.  */
+void
+io_sample (io_sampler_t *sampler, snapshot_t *snapshot, const registry_t *registry);
+
+#endif /* PROC_IO_H */
@@ -0,0 +1,140 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "proc-io.test.h"
+
+#include "proc-io.h"            /* parse_io ().  */
+#include "proc-root.h"          /* proc_root.  */
+#include "test-procfs.h"        /* test_procfs_write ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit (), free ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <unistd.h>             /* rmdir ().  */
+
+/* Run the tests on parse_io ().  */
+static void
+test_parse_io (void)
+{
+  int error = 0;
+  proc_io_t io;
+
+  const char *text = ("rchar: 323934931\nwchar: 323929600\nsyscr: 632687\nsyscw: 632675\n"
+                      "read_bytes: 4096\nwrite_bytes: 323932160\ncancelled_write_bytes: 0\n");
+  if (parse_io (text, &io)
+      || io.syscr != 632687 || io.syscw != 632675 || io.read_bytes != 4096 || io.write_bytes != 323932160) {
+    fprintf (stderr, "parse_io (\"%s\") found %llu %llu %llu %llu\n", text, io.syscr, io.syscw, io.read_bytes, io.write_bytes);
+    error = 1;
+  }
+  if (! parse_io ("rchar: 1\nwchar: 2\n", &io)) {
+    fprintf (stderr, "parse_io () accepts a file without read_bytes\n");
+    error = 1;
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Write the io file of process PID into ROOT, with READ_KB kB
+   read.  */
+static void
+write_io (const char *root, const char *pid, int read_kb)
+{
+  char text[128];
+  int len = snprintf (text, sizeof text, "rchar: 0\nwchar: 0\nsyscr: 3\nsyscw: 4\nread_bytes: %d\nwrite_bytes: 0\n", read_kb * 1024);
+  test_procfs_write (root, pid, "io", text, len);
+}
+
+/* Sample a fake procfs tree where process 42 and its child 43 are a
+   registered tree, and 44 is not.  */
+static void
+test_io_sample (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  write_io (root, "42", 1);
+  write_io (root, "43", 2);
+  write_io (root, "44", 4);
+
+  const char *old_proc_root = proc_root;
+  proc_root = root;
+  int error = 0;
+
+  stat_struct_t procs[3];
+  memset (procs, 0, sizeof procs);
+  procs[0].Pid = 42;
+  procs[0].PPid = 1;
+  procs[1].Pid = 43;
+  procs[1].PPid = 42;
+  procs[2].Pid = 44;
+  procs[2].PPid = 1;
+  snapshot_t snapshot = { .nbpids = 3, .procs = procs };
+  registered_tree_t tree;
+  memset (&tree, 0, sizeof tree);
+  tree.id.pid = 42;
+  registry_t registry = { .control_fd = -1, .trees = &tree, .nbtrees = 1, .capacity = 1 };
+
+  /* The first reading is the baseline of each process.  */
+  io_sampler_t sampler;
+  memset (&sampler, 0, sizeof sampler);
+  io_sample (&sampler, &snapshot, &registry);
+  if (procs[0].IoRead != 0 || procs[1].IoRead != 0 || procs[2].IoRead != 0 || procs[0].Syscr != 0) {
+    fprintf (stderr, "io_sample () read %d %d %d kB at first\n", procs[0].IoRead, procs[1].IoRead, procs[2].IoRead);
+    error = 1;
+  }
+
+  test_procfs_remove (root, "42", "io");
+  write_io (root, "42", 5);
+  test_procfs_remove (root, "43", "io");
+  write_io (root, "43", 6);
+  io_sample (&sampler, &snapshot, &registry);
+  if (procs[0].IoRead != 4 || procs[1].IoRead != 4 || procs[2].IoRead != 0 || procs[0].Syscr != 0) {
+    fprintf (stderr, "io_sample () read %d %d %d kB\n", procs[0].IoRead, procs[1].IoRead, procs[2].IoRead);
+    error = 1;
+  }
+
+  /* Process 43 cannot be read.  */
+  test_procfs_remove (root, "43", "io");
+  io_sample (&sampler, &snapshot, &registry);
+  if (procs[0].IoRead != 4 || procs[1].IoRead != 4) {
+    fprintf (stderr, "io_sample () read %d %d kB after a failure\n", procs[0].IoRead, procs[1].IoRead);
+    error = 1;
+  }
+
+  proc_root = old_proc_root;
+  test_procfs_remove (root, "42", "io");
+  test_procfs_remove (root, "44", "io");
+  rmdir (root);
+  free (sampler.readings);
+  free (sampler.next_readings);
+  free (sampler.marks);
+  free (sampler.members);
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run all tests on the proc-io.c file.  */
+void
+test_proc_io (void)
+{
+  test_parse_io ();
+  test_io_sample ();
+}
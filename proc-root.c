@@ -0,0 +1,35 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "proc-root.h"
+
+#include <stdio.h>              /* snprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+
+/* Directory where the procfs to read from is mounted.  */
+const char *proc_root = "/proc";
+
+/* Store into BUFFER the path of FILE of process PID.  */
+void
+proc_path (char *buffer, size_t size, pid_t pid, const char *file)
+{
+  int len = snprintf (buffer, size, "%s/%d/%s", proc_root, pid, file);
+  if (len < 0 || (size_t) len >= size) {
+    fprintf (stderr, "could not fit %s/%d/%s into a buffer of %zu bytes\n", proc_root, pid, file, size);
+    exit (1);
+  }
+}
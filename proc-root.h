@@ -0,0 +1,29 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <stddef.h>             /* size_t.  */
+#include <sys/types.h>          /* pid_t.  */
+
+/* Directory where the procfs to read from is mounted: "/proc", unless
+   changed with --proc-root, e.g. to a tree written by
+   "generate-history --procfs".  */
+extern const char *proc_root;
+
+/* Store into BUFFER (SIZE bytes) the path of FILE of process PID,
+   e.g. "/proc/42/status".  Exit if it does not fit.  */
+void
+proc_path (char *buffer, size_t size, pid_t pid, const char *file);
@@ -0,0 +1,151 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "proc-stat.h"
+
+#include "proc-root.h"          /* proc_path ().  */
+
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* read (), sysconf ().  */
+#include <stdio.h>              /* snprintf ().  */
+#include <stdlib.h>             /* strtoull ().  */
+#include <string.h>             /* strrchr ().  */
+#include <errno.h>              /* errno.  */
+#include <limits.h>             /* PATH_MAX.  */
+
+/*
+ * Example of /proc/PID/stat, all on one line:
+ *
+ * 4242 (cc1plus) R 4241 4200 4200 0 -1 4194304 51023 0 0 0 187 12 0 0
+ * 20 0 1 0 8840341 1092538368 38558 ...
+ *
+ * The second field is the name of the process between parentheses,
+ * and may itself contain spaces and parentheses, so the fields are
+ * counted from the last ")".  The CPU times are fields 14 to 17, and
+ * the start time is field 22.
+ */
+
+/* Number of the first field after the name.  */
+#define FIRST_FIELD_AFTER_NAME 3
+
+/* Numbers of the CPU time fields: utime, stime, cutime and cstime.  */
+#define UTIME_FIELD 14
+#define CSTIME_FIELD 17
+
+/* Number of the start time field.  */
+#define START_TIME_FIELD 22
+
+/* Parse LINE into *STAT.  */
+int
+parse_stat (const char *line, proc_stat_t *stat)
+{
+  const char *cursor = strrchr (line, ')');
+  if (cursor == NULL) {
+    return 1;
+  }
+  cursor++;
+
+  unsigned long long cpu[CSTIME_FIELD - UTIME_FIELD + 1];
+  for (int field = FIRST_FIELD_AFTER_NAME; field <= START_TIME_FIELD; field++) {
+    while (*cursor == ' ') {
+      cursor++;
+    }
+    if ((field >= UTIME_FIELD && field <= CSTIME_FIELD) || field == START_TIME_FIELD) {
+      char *end;
+      errno = 0;
+      unsigned long long parsed = strtoull (cursor, &end, 10);
+      if (errno || end == cursor || (*end != ' ' && *end != '\n' && *end != 0)) {
+        return 1;
+      }
+      if (field == START_TIME_FIELD) {
+        stat->start_time = (unsigned int) parsed;
+      } else {
+        cpu[field - UTIME_FIELD] = parsed;
+      }
+      cursor = end;
+    } else {
+      /* Skip the field.  */
+      while (*cursor != ' ') {
+        if (*cursor == 0) {
+          return 1;
+        }
+        cursor++;
+      }
+    }
+  }
+
+  stat->utime = cpu[0];
+  stat->stime = cpu[1];
+  stat->cutime = cpu[2];
+  stat->cstime = cpu[3];
+  return 0;
+}
+
+/* Read /proc/PID/stat into *STAT.  */
+int
+read_stat_pid (pid_t pid, proc_stat_t *stat)
+{
+  char filename[PATH_MAX];
+  proc_path (filename, sizeof filename, pid, "stat");
+
+  /* The file is read with a single read (), without stdio: it is
+     much shorter than the buffer, and the kernel generates it whole
+     at each read.  */
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  char line[1024];
+  ssize_t len = read (fd, line, sizeof line - 1);
+  close (fd);
+  if (len <= 0) {
+    return 1;
+  }
+  line[len] = 0;
+
+  if (parse_stat (line, stat)) {
+    fprintf (stderr, "could not parse %s\n", filename);
+    return 1;
+  }
+  return 0;
+}
+
+/* Convert TICKS clock ticks into hundredths of seconds, saturated to
+   INT_MAX.  */
+static int
+ticks_to_centiseconds (unsigned long long ticks)
+{
+  static long ticks_per_second;
+  if (ticks_per_second == 0) {
+    ticks_per_second = sysconf (_SC_CLK_TCK);
+    if (ticks_per_second <= 0) {
+      ticks_per_second = 100;
+    }
+  }
+  unsigned long long centiseconds = ticks * 100 / ticks_per_second;
+  return centiseconds > INT_MAX ? INT_MAX : (int) centiseconds;
+}
+
+/* Store the CPU times of STAT into the CPU fields of PROC.  */
+void
+stat_store_cpu (const proc_stat_t *stat, stat_struct_t *proc)
+{
+  proc->Utime = ticks_to_centiseconds (stat->utime);
+  proc->Stime = ticks_to_centiseconds (stat->stime);
+  proc->Cutime = ticks_to_centiseconds (stat->cutime);
+  proc->Cstime = ticks_to_centiseconds (stat->cstime);
+}
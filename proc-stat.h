@@ -0,0 +1,50 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "stat-struct.h"        /* stat_struct_t.  */
+
+#include <sys/types.h>          /* pid_t.  */
+
+/* What is read from /proc/PID/stat.  */
+typedef struct {
+  /* Low 32 bits of the start time of the process (field 22), in clock
+     ticks after boot.  */
+  unsigned int start_time;
+  /* CPU time spent by the process in user and system mode (fields 14
+     and 15), and by its children that exited and were waited for
+     (fields 16 and 17), in clock ticks.  */
+  unsigned long long utime;
+  unsigned long long stime;
+  unsigned long long cutime;
+  unsigned long long cstime;
+} proc_stat_t;
+
+/* Parse LINE, the contents of /proc/PID/stat, into *STAT.
+   On success, return 0; on error, return 1.  */
+int
+parse_stat (const char *line, proc_stat_t *stat);
+
+/* Read /proc/PID/stat into *STAT.
+   On success, return 0; if the process has disappeared, return 1.  */
+int
+read_stat_pid (pid_t pid, proc_stat_t *stat);
+
+/* Store the CPU times of STAT into the Utime, Stime, Cutime and
+   Cstime fields of PROC, in hundredths of seconds whatever the clock
+   tick, and saturated to INT_MAX (about 248 days).  */
+void
+stat_store_cpu (const proc_stat_t *stat, stat_struct_t *proc);
@@ -0,0 +1,87 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "proc-stat.test.h"
+
+#include "proc-stat.h"          /* parse_stat ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Parse LINE and check that the start time is EXPECTED, or that
+   parsing fails if EXPECTED_ERROR.  */
+static int
+test_parse_stat_args (const char *line, int expected_error, unsigned int expected)
+{
+  proc_stat_t stat;
+  memset (&stat, 0, sizeof stat);
+  int error = parse_stat (line, &stat);
+  if (error != expected_error) {
+    fprintf (stderr, "parse_stat (\"%s\") returned %d instead of %d\n", line, error, expected_error);
+    return 1;
+  }
+  if (! error && stat.start_time != expected) {
+    fprintf (stderr, "parse_stat (\"%s\") found a start time of %u instead of %u\n", line, stat.start_time, expected);
+    return 1;
+  }
+  return 0;
+}
+
+/* Check that parse_stat () finds the CPU times of LINE.  */
+static int
+test_parse_stat_cpu (void)
+{
+  proc_stat_t stat;
+  const char *line = "4242 (cc1plus) R 4241 4200 4200 0 -1 4194304 51023 0 0 0 187 12 3 4 20 0 1 0 8840341 1092538368 38558\n";
+  if (parse_stat (line, &stat)) {
+    fprintf (stderr, "parse_stat (\"%s\") failed\n", line);
+    return 1;
+  }
+  if (stat.utime != 187 || stat.stime != 12 || stat.cutime != 3 || stat.cstime != 4 || stat.start_time != 8840341) {
+    fprintf (stderr, "parse_stat (\"%s\") found %llu %llu %llu %llu %u\n", line,
+             stat.utime, stat.stime, stat.cutime, stat.cstime, stat.start_time);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run all tests on the proc-stat.c file.  */
+void
+test_proc_stat (void)
+{
+  int error = 0;
+
+  error += test_parse_stat_args
+    ("4242 (cc1plus) R 4241 4200 4200 0 -1 4194304 51023 0 0 0 187 12 0 0 20 0 1 0 8840341 1092538368 38558\n",
+     0, 8840341);
+  /* Names can contain spaces and parentheses.  */
+  error += test_parse_stat_args
+    ("17 (a) b (c) S 1 17 17 0 -1 4194560 100 0 0 0 1 2 0 0 20 0 1 0 99 4096 10\n",
+     0, 99);
+  /* Only the low 32 bits are kept.  */
+  error += test_parse_stat_args
+    ("5 (x) S 1 5 5 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 4294967298 0 0",
+     0, 2);
+  error += test_parse_stat_args ("5 (x) S 1 5 5 0 -1 0", 1, 0);
+  error += test_parse_stat_cpu ();
+  error += test_parse_stat_args ("5 x S 1 5 5 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 99 0 0", 1, 0);
+
+  if (error) {
+    exit (1);
+  }
+}
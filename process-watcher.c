@@ -16,13 +16,21 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
 #include "lib.h"
+#include "serve.h"
+#include "watch.h"
+#include "compact.h"
+#include "registry.h"
+#include "proc-root.h"          /* proc_root.  */
+#include "schema.h"             /* field_index ().  */
+#include "parse-time.h"         /* parse_time ().  */
 
 #include <stdio.h>		/* printf ().  */
 #include <getopt.h>		/* getopt_long ().  */
 #include <assert.h>             /* assert ().  */
 #include <limits.h>             /* INT_MAX.  */
+#include <stdint.h>             /* SIZE_MAX.  */
 #include <unistd.h>             /* chdir ().  */
-#include <stdlib.h>             /* abort ().  */
+#include <stdlib.h>             /* abort (), strtoull ().  */
 #include <string.h>             /* strcmp ().  */
 
 /* Print the help message.  */
@@ -32,25 +40,260 @@ usage (void) {
         " Start a capturing process.\n"
         "process-watcher [OPTION...] get PID BEGIN END\n"
         " Target the process tree rooted at PID\n"
-        " and collect the max of each measure between BEGIN and END times.\n"
+        " and collect the max of each measure between BEGIN and END times,\n"
+        " and the CPU time and parallelism of the tree.\n"
         " Times are written as YYYYMMDDhhmmss in UTC.\n"
+        " PID may be written PID@STARTTIME, with the start time of the\n"
+        " process (field 22 of /proc/PID/stat), so that another process\n"
+        " reusing PID is not mistaken for it.  Otherwise, it is the first\n"
+        " process with that PID in the time window.\n"
+        "process-watcher [OPTION...] get --name=PATTERN [PID] BEGIN END\n"
+        " Likewise for the processes whose name matches PATTERN, among those\n"
+        " of the tree rooted at PID if given, else among all of them.\n"
+        "process-watcher [OPTION...] get CGROUP BEGIN END\n"
+        " Print the max memory of the cgroup v2 directory CGROUP between\n"
+        " BEGIN and END, as recorded by capture --cgroup or --cgroup-tree.\n"
+        "process-watcher [OPTION...] register PID\n"
+        " Ask the running capture to maintain the totals of the process\n"
+        " tree rooted at PID as it samples, so that get can use them\n"
+        " instead of scanning the history.\n"
+        "process-watcher [OPTION...] watch PID [BEGIN]\n"
+        " Follow the history as it grows and print, at each snapshot, the\n"
+        " totals of the process tree rooted at PID and their running max,\n"
+        " starting from BEGIN if given, else from the next snapshot.\n"
+        " Stop when PID exits.\n"
+        "process-watcher [OPTION...] serve\n"
+        " Answer get queries on the process-watcher.sock Unix socket,\n"
+        " keeping the history mapped and indexed between queries.\n"
+        "process-watcher [OPTION...] compact IN... -o OUT\n"
+        " Merge the history files IN, e.g. successive captures of a host, in\n"
+        " timestamp order into the history of the directory OUT, with its\n"
+        " index, recording only the fields of --fields (by default, those of\n"
+        " any input).  get gives the same results on it, for these fields.\n"
         "kill PW_PID\n"
         " Stop the capturing process.\n"
         "Options:\n"
         "  -C, --directory=DIR   Use DIR as working directory instead of current working directory.\n"
+        "      --shm=NAME        capture: also publish the recent snapshots in the POSIX shared\n"
+        "                        memory object NAME (e.g. /process-watcher).\n"
+        "                        get: read them from there when they cover the time window.\n"
+        "      --shm-slots=K     Keep the K most recent snapshots in shared memory (default 128).\n"
+        "      --shm-procs=N     Make room for N processes per snapshot in shared memory\n"
+        "                        (default 4096).\n"
+        "      --series          get: print the tree totals of each snapshot as CSV\n"
+        "                        instead of their max.\n"
+        "      --buckets=N       get: downsample the series into N time buckets,\n"
+        "                        with the max and mean of each bucket.\n"
+        "      --window=DURATION get: print instead the max of the tree totals over each\n"
+        "                        window of DURATION, e.g. 10m, as CSV.  DURATION is in\n"
+        "                        seconds, or ends with s, m, h or d.\n"
+        "      --step=DURATION   get: start a window every DURATION (default: the window\n"
+        "                        width).\n"
+        "      --percentiles     get: also print the 50th, 90th and 99th percentiles and\n"
+        "                        the max of the tree totals over the snapshots, or with\n"
+        "                        --window of their window maxima, within 1.6%.\n"
+        "      --top=K           get: also print the K largest processes of the tree\n"
+        "                        in the snapshot where the --top-field total peaked.\n"
+        "      --top-field=FIELD Field used by --top (default VmRSS), or \"all\" for\n"
+        "                        the peak of each field.\n"
+        "      --tree            get: also print the peak of the --top-field total of\n"
+        "                        each subtree of the tree, with its PID and name, for\n"
+        "                        the subtrees above the --threshold.\n"
+        "      --threshold=PERCENT\n"
+        "                        get --tree: only print the subtrees whose peak is at\n"
+        "                        least PERCENT % of the peak of the tree (default 5).\n"
+        "      --stats-file=FILE capture: write the timings and counters of the capture\n"
+        "                        into FILE every minute.  They are also printed on\n"
+        "                        stderr on SIGUSR1.\n"
+        "      --fields=LIST     capture: only record the memory fields in LIST, separated\n"
+        "                        by commas, e.g. VmHWM,VmRSS,RssAnon.  get reads any\n"
+        "                        history, and reports 0 for the fields not recorded.\n"
+        "                        compact: only keep these fields.\n"
+        "      --metrics=ADDRESS capture: serve the totals of the registered trees and the\n"
+        "                        statistics of the capture in the OpenMetrics format over\n"
+        "                        HTTP on ADDRESS, a TCP port on 127.0.0.1 (e.g. 9100) or\n"
+        "                        the file name of a Unix socket.\n"
+        "      --proc-root=DIR   capture: read the processes from DIR instead of /proc,\n"
+        "                        e.g. a tree written by generate-history --procfs.\n"
+        "      --map-window=SIZE get: map at most about SIZE bytes of the history file at\n"
+        "                        a time (default 64M), or the whole file if 0.  SIZE may\n"
+        "                        end with k, M or G.  compact: likewise for each input.\n"
+        "      --smaps=MS        capture: also record Pss, Pss_Anon, Private_Clean and\n"
+        "                        Private_Dirty from /proc/PID/smaps_rollup, spending at\n"
+        "                        most MS milliseconds per sample on it: the registered\n"
+        "                        trees first, then the largest processes.  The others\n"
+        "                        are estimated from VmRSS, and their estimated Pss is\n"
+        "                        recorded in PssEstimated.\n"
+        "      --io              capture: also record the storage I/O of the processes of\n"
+        "                        the registered trees from /proc/PID/io, so that get\n"
+        "                        reports the I/O of these trees.\n"
+        "      --cgroup=DIR      capture: also record memory.current and memory.peak of\n"
+        "                        the cgroup v2 DIR, e.g. /sys/fs/cgroup/build.slice, for\n"
+        "                        get CGROUP.  May be given several times.\n"
+        "      --cgroup-tree=DIR capture: likewise for DIR and every cgroup under it,\n"
+        "                        as they come and go.\n"
+        "      --append          capture: go on with the existing history, e.g. after a\n"
+        "                        restart, instead of truncating it.  An incomplete\n"
+        "                        snapshot left at its end is dropped.\n"
+        "      --cmdline         capture: also record a hash of the command line of each\n"
+        "                        process in CmdHash.\n"
+        "      --name=PATTERN    get: only sum up the processes whose name, the Name: line\n"
+        "                        of /proc/PID/status, matches the shell wildcard PATTERN,\n"
+        "                        e.g. 'ld.*'.  The history must come from a capture that\n"
+        "                        recorded NameId.\n"
+        "  -o, --output=OUT      compact: write into the directory OUT.\n"
+        "      --drop-idle       compact: drop the processes without children whose\n"
+        "                        recorded fields are all 0, e.g. kernel threads.\n"
+        "      --downsample=S    compact: keep only the first snapshot of every S\n"
+        "                        seconds, so that get gives the results of that period.\n"
+        "      --downsample-before=TIME\n"
+        "                        compact: only downsample the snapshots before TIME,\n"
+        "                        written as YYYYMMDDhhmmss in UTC.\n"
         "  -h, --help            Show this help.");
 }
 
+/* Parse the positive integer option argument ARG of option NAME.
+   Exit on error.  */
+static int
+parse_positive_int (const char *name, const char *arg)
+{
+  char *end;
+  long value = strtol (arg, &end, 10);
+  if (end == arg || *end != 0 || value < 1 || value > INT_MAX) {
+    fprintf (stderr, "bad value for %s: %s\n", name, arg);
+    exit (1);
+  }
+  return (int) value;
+}
+
+/* Parse the size option argument ARG of option NAME: a number of
+   bytes, possibly followed by k, M or G.  Exit on error.  */
+static size_t
+parse_size (const char *name, const char *arg)
+{
+  char *end;
+  unsigned long long value = strtoull (arg, &end, 10);
+  int shift = 0;
+  switch (*end) {
+  case 'k':
+    shift = 10;
+    end++;
+    break;
+  case 'M':
+    shift = 20;
+    end++;
+    break;
+  case 'G':
+    shift = 30;
+    end++;
+    break;
+  }
+  if (end == arg || *end != 0 || arg[0] == '-' || value > (SIZE_MAX >> shift)) {
+    fprintf (stderr, "bad value for %s: %s\n", name, arg);
+    exit (1);
+  }
+  return (size_t) value << shift;
+}
+
+/* Values returned by getopt_long () for options without a short
+   form.  */
+enum {
+  OPT_SHM = 256,
+  OPT_SHM_SLOTS,
+  OPT_SHM_PROCS,
+  OPT_SERIES,
+  OPT_BUCKETS,
+  OPT_WINDOW,
+  OPT_STEP,
+  OPT_PERCENTILES,
+  OPT_TOP,
+  OPT_TOP_FIELD,
+  OPT_TREE,
+  OPT_THRESHOLD,
+  OPT_STATS_FILE,
+  OPT_FIELDS,
+  OPT_METRICS,
+  OPT_PROC_ROOT,
+  OPT_MAP_WINDOW,
+  OPT_SMAPS,
+  OPT_IO,
+  OPT_CGROUP,
+  OPT_CGROUP_TREE,
+  OPT_APPEND,
+  OPT_CMDLINE,
+  OPT_NAME,
+  OPT_DROP_IDLE,
+  OPT_DOWNSAMPLE,
+  OPT_DOWNSAMPLE_BEFORE,
+};
+
 int
 main (int argc, char *argv[]) {
   static const struct option long_opt[] = {
     { "help", no_argument, NULL, 'h' },
     { "directory", required_argument, NULL, 'C' },
+    { "shm", required_argument, NULL, OPT_SHM },
+    { "shm-slots", required_argument, NULL, OPT_SHM_SLOTS },
+    { "shm-procs", required_argument, NULL, OPT_SHM_PROCS },
+    { "series", no_argument, NULL, OPT_SERIES },
+    { "buckets", required_argument, NULL, OPT_BUCKETS },
+    { "window", required_argument, NULL, OPT_WINDOW },
+    { "step", required_argument, NULL, OPT_STEP },
+    { "percentiles", no_argument, NULL, OPT_PERCENTILES },
+    { "top", required_argument, NULL, OPT_TOP },
+    { "top-field", required_argument, NULL, OPT_TOP_FIELD },
+    { "tree", no_argument, NULL, OPT_TREE },
+    { "threshold", required_argument, NULL, OPT_THRESHOLD },
+    { "stats-file", required_argument, NULL, OPT_STATS_FILE },
+    { "fields", required_argument, NULL, OPT_FIELDS },
+    { "metrics", required_argument, NULL, OPT_METRICS },
+    { "proc-root", required_argument, NULL, OPT_PROC_ROOT },
+    { "map-window", required_argument, NULL, OPT_MAP_WINDOW },
+    { "smaps", required_argument, NULL, OPT_SMAPS },
+    { "io", no_argument, NULL, OPT_IO },
+    { "cgroup", required_argument, NULL, OPT_CGROUP },
+    { "cgroup-tree", required_argument, NULL, OPT_CGROUP_TREE },
+    { "append", no_argument, NULL, OPT_APPEND },
+    { "cmdline", no_argument, NULL, OPT_CMDLINE },
+    { "name", required_argument, NULL, OPT_NAME },
+    { "output", required_argument, NULL, 'o' },
+    { "drop-idle", no_argument, NULL, OPT_DROP_IDLE },
+    { "downsample", required_argument, NULL, OPT_DOWNSAMPLE },
+    { "downsample-before", required_argument, NULL, OPT_DOWNSAMPLE_BEFORE },
     { NULL, 0, NULL, 0 }
   };
 
+  /* There are fewer cgroup options than arguments.  */
+  const char *cgroup_dirs[argc];
+  const char *cgroup_trees[argc];
+  options_t options = {
+    .shm_name = NULL,
+    .shm_slots = 128,
+    .shm_procs = 4096,
+    .series = 0,
+    .buckets = 0,
+    .top = 0,
+    .top_field = field_index ("VmRSS"),
+    .tree_percent = 5,
+    .stats_file = NULL,
+    .metrics = NULL,
+    .fields = NULL,
+    .map_window = 64 << 20,
+    .smaps_budget_ms = 0,
+    .io = 0,
+    .cgroup_dirs = cgroup_dirs,
+    .nbcgroup_dirs = 0,
+    .cgroup_trees = cgroup_trees,
+    .nbcgroup_trees = 0,
+    .append = 0,
+    .output = NULL,
+    .drop_idle = 0,
+    .downsample = 0,
+    .downsample_before = 0,
+  };
+
   while (1) {
-    const int c = getopt_long (argc, argv, "hC:", long_opt, NULL);
+    const int c = getopt_long (argc, argv, "hC:o:", long_opt, NULL);
     if (c == -1)
       break;
     switch (c) {
@@ -63,6 +306,107 @@ main (int argc, char *argv[]) {
         return 1;
       }
       break;
+    case OPT_SHM:
+      options.shm_name = optarg;
+      break;
+    case OPT_SHM_SLOTS:
+      options.shm_slots = parse_positive_int ("--shm-slots", optarg);
+      break;
+    case OPT_SHM_PROCS:
+      options.shm_procs = parse_positive_int ("--shm-procs", optarg);
+      break;
+    case OPT_SERIES:
+      options.series = 1;
+      break;
+    case OPT_BUCKETS:
+      options.series = 1;
+      options.buckets = parse_positive_int ("--buckets", optarg);
+      break;
+    case OPT_WINDOW:
+      if (try_parse_duration (optarg, &options.window)) {
+        return 1;
+      }
+      break;
+    case OPT_STEP:
+      if (try_parse_duration (optarg, &options.step)) {
+        return 1;
+      }
+      break;
+    case OPT_PERCENTILES:
+      options.percentiles = 1;
+      break;
+    case OPT_TOP:
+      options.top = parse_positive_int ("--top", optarg);
+      break;
+    case OPT_TOP_FIELD:
+      if (! strcmp (optarg, "all")) {
+        options.top_field = -1;
+      } else {
+        options.top_field = field_index (optarg);
+        if (options.top_field == -1) {
+          fprintf (stderr, "unknown field %s\n", optarg);
+          return 1;
+        }
+      }
+      break;
+    case OPT_TREE:
+      options.tree = 1;
+      break;
+    case OPT_THRESHOLD:
+      options.tree_percent = parse_positive_int ("--threshold", optarg);
+      if (options.tree_percent > 100) {
+        fprintf (stderr, "bad value for --threshold: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_STATS_FILE:
+      options.stats_file = optarg;
+      break;
+    case OPT_FIELDS:
+      options.fields = optarg;
+      break;
+    case OPT_METRICS:
+      options.metrics = optarg;
+      break;
+    case OPT_PROC_ROOT:
+      proc_root = optarg;
+      break;
+    case OPT_MAP_WINDOW:
+      options.map_window = parse_size ("--map-window", optarg);
+      break;
+    case OPT_SMAPS:
+      options.smaps_budget_ms = parse_positive_int ("--smaps", optarg);
+      break;
+    case OPT_IO:
+      options.io = 1;
+      break;
+    case OPT_APPEND:
+      options.append = 1;
+      break;
+    case OPT_CMDLINE:
+      options.cmdline = 1;
+      break;
+    case OPT_NAME:
+      options.name = optarg;
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    case OPT_DROP_IDLE:
+      options.drop_idle = 1;
+      break;
+    case OPT_DOWNSAMPLE:
+      options.downsample = parse_positive_int ("--downsample", optarg);
+      break;
+    case OPT_DOWNSAMPLE_BEFORE:
+      options.downsample_before = parse_time (optarg);
+      break;
+    case OPT_CGROUP:
+      cgroup_dirs[options.nbcgroup_dirs++] = optarg;
+      break;
+    case OPT_CGROUP_TREE:
+      cgroup_trees[options.nbcgroup_trees++] = optarg;
+      break;
     case '?':
       return 1;
     default:
@@ -76,17 +420,81 @@ main (int argc, char *argv[]) {
     return 1;
   }
 
+  if (options.series && options.top) {
+    fprintf (stderr, "--top cannot be used with --series\n");
+    return 1;
+  }
+  if (options.window > 0 && (options.series || options.top)) {
+    fprintf (stderr, "--window cannot be used with --series nor --top\n");
+    return 1;
+  }
+  if (options.percentiles && options.series) {
+    fprintf (stderr, "--percentiles cannot be used with --series\n");
+    return 1;
+  }
+  if (options.tree && (options.series || options.window > 0 || options.name != NULL)) {
+    fprintf (stderr, "--tree cannot be used with --series, --window nor --name\n");
+    return 1;
+  }
+  if (options.tree && options.top_field == -1) {
+    fprintf (stderr, "--tree needs a single --top-field\n");
+    return 1;
+  }
+  if (options.step > 0 && options.window == 0) {
+    fprintf (stderr, "--step needs --window\n");
+    return 1;
+  }
+  if (options.step == 0) {
+    options.step = options.window;
+  }
+
   if (! strcmp (argv[0], "capture")) {
     argc--; argv++;
     if (argc > 0) {
       fprintf (stderr, "too many arguments\n");
       return 1;
     }
-    capture ();
+    capture (&options);
+    return 0;
+  } else if (! strcmp (argv[0], "register")) {
+    argc--; argv++;
+    /* We expect PID.  */
+    if (argc < 1) {
+      fprintf (stderr, "missing parameter\n");
+      return 1;
+    } else if (argc > 1) {
+      fprintf (stderr, "too many arguments\n");
+      return 1;
+    }
+    register_pid (argv[0]);
+    return 0;
+  } else if (! strcmp (argv[0], "watch")) {
+    argc--; argv++;
+    /* We expect PID [BEGIN].  */
+    if (argc < 1) {
+      fprintf (stderr, "missing parameter\n");
+      return 1;
+    } else if (argc > 2) {
+      fprintf (stderr, "too many arguments\n");
+      return 1;
+    }
+    watch (argv[0], argc > 1 ? argv[1] : NULL);
+    return 0;
+  } else if (! strcmp (argv[0], "serve")) {
+    argc--; argv++;
+    if (argc > 0) {
+      fprintf (stderr, "too many arguments\n");
+      return 1;
+    }
+    serve ();
     return 0;
   } else if (! strcmp (argv[0], "get")) {
     argc--; argv++;
-    /* We expect PID BEGIN END.  */
+    /* We expect PID BEGIN END, or with --name [PID] BEGIN END.  */
+    if (options.name != NULL && argc == 2) {
+      get (&options, NULL, argv[0], argv[1]);
+      return 0;
+    }
     if (argc < 3) {
       fprintf (stderr, "missing parameter\n");
       return 1;
@@ -94,7 +502,16 @@ main (int argc, char *argv[]) {
       fprintf (stderr, "too many arguments\n");
       return 1;
     }
-    get (argv[0], argv[1], argv[2]);
+    get (&options, argv[0], argv[1], argv[2]);
+    return 0;
+  } else if (! strcmp (argv[0], "compact")) {
+    argc--; argv++;
+    /* We expect IN... -o OUT.  */
+    if (argc < 1 || options.output == NULL) {
+      fprintf (stderr, "missing parameter\n");
+      return 1;
+    }
+    compact (&options, argv, argc);
     return 0;
   } else {
     fprintf (stderr, "invalid command %s\n", argv[0]);
@@ -0,0 +1,362 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "query.h"
+
+#include "history.h"            /* history_open ().  */
+#include "tree.h"               /* tree_totals ().  */
+#include "accumulate.h"         /* accumulate_max ().  */
+#include "index.h"              /* index_open ().  */
+#include "locks.h"              /* read_lock ().  */
+#include "xmalloc.h"            /* xmalloc ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* free ().  */
+#include <string.h>             /* memset ().  */
+
+/* Number of process trees whose per-snapshot totals are cached.  */
+#define CACHE_ENTRIES 16
+
+/* Maximum number of snapshots cached per tree.  Queries on larger
+   windows are computed without the cache.  */
+#define CACHE_MAX_SNAPSHOTS 16384
+
+/* Per-snapshot totals of one process tree, for the indexed snapshots
+   FIRST to FIRST + COUNT - 1.  */
+typedef struct {
+  /* Top process of the tree, with a known start time.  Its PID is 0
+     if the entry is unused.  */
+  proc_id_t id;
+  /* Value of use_counter at the last use, for LRU eviction.  */
+  unsigned long last_use;
+  size_t first;
+  size_t count;
+  totals_t *totals;
+  /* Whether the top PID is in each snapshot.  */
+  char *present;
+} cache_entry_t;
+
+struct query {
+  /* History file, mapped and indexed.  */
+  history_t history;
+  char *filename;
+  /* Size of the window of the history file mapped at a time by
+     query_scan (), 0 for the whole file.  */
+  size_t map_window;
+  cache_entry_t cache[CACHE_ENTRIES];
+  unsigned long use_counter;
+};
+
+/* Forget all the totals cached by QUERY.  */
+static void
+cache_clear (query_t *query)
+{
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    query->cache[i].id.pid = 0;
+    query->cache[i].count = 0;
+  }
+}
+
+/* Return the cache entry of QUERY for ID, recycling the least
+   recently used one if there is none.  */
+static cache_entry_t *
+cache_lookup (query_t *query, const proc_id_t *id)
+{
+  cache_entry_t *cache = query->cache;
+  cache_entry_t *victim = cache;
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    if (cache[i].id.pid == id->pid && cache[i].id.start_time == id->start_time) {
+      victim = cache + i;
+      break;
+    }
+    if (cache[i].last_use < victim->last_use) {
+      victim = cache + i;
+    }
+  }
+  if (victim->id.pid != id->pid || victim->id.start_time != id->start_time) {
+    victim->id = *id;
+    victim->count = 0;
+  }
+  victim->last_use = ++query->use_counter;
+  return victim;
+}
+
+/* Make ENTRY cover the indexed snapshots LOW to HIGH - 1, computing
+   the totals of the snapshots it did not cover yet.
+   On success, return 0; on error, return 1.  */
+static int
+cache_fill (cache_entry_t *entry, history_t *history, size_t low, size_t high)
+{
+  size_t old_first = entry->first;
+  size_t old_end = entry->first + entry->count;
+  if (entry->count > 0 && low >= old_first && high <= old_end) {
+    /* Already covered.  */
+    return 0;
+  }
+
+  /* Keep what is cached if the ranges overlap or touch, unless that
+     makes the entry too large.  */
+  size_t new_first = low;
+  size_t new_end = high;
+  if (entry->count > 0 && low <= old_end && high >= old_first) {
+    size_t union_first = old_first < low ? old_first : low;
+    size_t union_end = old_end > high ? old_end : high;
+    if (union_end - union_first <= CACHE_MAX_SNAPSHOTS) {
+      new_first = union_first;
+      new_end = union_end;
+    }
+  }
+
+  size_t new_count = new_end - new_first;
+  totals_t *totals = xreallocarray (NULL, new_count, sizeof (totals_t));
+  char *present = xreallocarray (NULL, new_count, 1);
+
+  for (size_t i = new_first; i < new_end; i++) {
+    size_t slot = i - new_first;
+    if (entry->count > 0 && i >= old_first && i < old_end) {
+      totals[slot] = entry->totals[i - old_first];
+      present[slot] = entry->present[i - old_first];
+    } else {
+      snapshot_t snapshot;
+      if (history_get_snapshot (history, i, &snapshot)) {
+        free (totals);
+        free (present);
+        return 1;
+      }
+      present[slot] = tree_totals (&snapshot, &entry->id, totals + slot);
+    }
+  }
+
+  free (entry->totals);
+  free (entry->present);
+  entry->totals = totals;
+  entry->present = present;
+  entry->first = new_first;
+  entry->count = new_count;
+  return 0;
+}
+
+/* Compute into RESULT the max values of the tree rooted at
+   RESULT->top over the indexed snapshots between BEGIN and END.
+   On success, return 0; on error, return 1.  */
+static int
+compute (query_t *query, time_t begin, time_t end, query_result_t *result)
+{
+  history_t *history = &query->history;
+  size_t low = history_find_time (history, begin);
+  size_t high = history_find_time (history, end + 1);
+  if (low >= high) {
+    return 0;
+  }
+  result->nb_snapshots = high - low;
+
+  /* Without a start time, take the process found first in the time
+     window.  */
+  for (size_t i = low; i < high && ! result->top.has_start_time; i++) {
+    snapshot_t snapshot;
+    if (history_get_snapshot (history, i, &snapshot)) {
+      return 1;
+    }
+    proc_id_resolve (&result->top, &snapshot);
+  }
+  if (! result->top.has_start_time) {
+    return 0;
+  }
+
+  if (high - low > CACHE_MAX_SNAPSHOTS) {
+    for (size_t i = low; i < high; i++) {
+      snapshot_t snapshot;
+      totals_t totals;
+      if (history_get_snapshot (history, i, &snapshot)) {
+        return 1;
+      }
+      if (tree_totals (&snapshot, &result->top, &totals)) {
+        accumulate_max (&result->max, &totals);
+        result->nb_present++;
+      }
+    }
+    return 0;
+  }
+
+  cache_entry_t *entry = cache_lookup (query, &result->top);
+  if (cache_fill (entry, history, low, high)) {
+    /* The history changed under the cache.  */
+    cache_clear (query);
+    return 1;
+  }
+  for (size_t i = low; i < high; i++) {
+    size_t slot = i - entry->first;
+    if (entry->present[slot]) {
+      accumulate_max (&result->max, entry->totals + slot);
+      result->nb_present++;
+    }
+  }
+  return 0;
+}
+
+/* Open the history file FILENAME for queries.  */
+query_t *
+query_open (const char *filename)
+{
+  query_t *query = xmalloc (sizeof (query_t));
+  memset (query, 0, sizeof *query);
+  if (filename == NULL) {
+    filename = history_filename;
+  }
+  if (history_open (&query->history, filename)) {
+    free (query);
+    return NULL;
+  }
+  size_t filename_size = strlen (filename) + 1;
+  query->filename = xmalloc (filename_size);
+  memcpy (query->filename, filename, filename_size);
+  accumulate_init ();
+  return query;
+}
+
+/* Make query_scan () map a window of WINDOW_SIZE bytes of the history
+   at a time.  */
+void
+query_set_window (query_t *query, size_t window_size)
+{
+  query->map_window = window_size;
+}
+
+/* Compute into RESULT the max values of the tree rooted at TOP
+   between BEGIN and END.  */
+int
+query_get (query_t *query, const proc_id_t *top, time_t begin, time_t end, query_result_t *result)
+{
+  history_t *history = &query->history;
+  memset (result, 0, sizeof *result); /* Set each element to 0.  */
+  result->top = *top;
+
+  if (read_lock (history->fd)) {
+    fprintf (stderr, "could not take a read lock\n");
+    return 1;
+  }
+  size_t old_nb_locations = history->nb_locations;
+  if (history_update (history)) {
+    unlock (history->fd);
+    return 1;
+  }
+  if (history->nb_locations < old_nb_locations) {
+    /* The history was truncated.  */
+    cache_clear (query);
+  }
+  history_index (history);
+
+  int status = compute (query, begin, end, result);
+  unlock (history->fd);
+  return status;
+}
+
+/* Call CALLBACK (SNAPSHOT, DATA) on each snapshot of HISTORY between
+   OFFSET and END_OFFSET taken between BEGIN and END.  Set *DONE if a
+   snapshot after END was found.  */
+static void
+scan_snapshots (history_t *history, size_t offset, size_t end_offset, time_t begin, time_t end, void (*callback) (const snapshot_t *snapshot, void *data), void *data, int *done)
+{
+  snapshot_t snapshot;
+  while (offset < end_offset && ! history_next_snapshot (history, &offset, &snapshot)) {
+    if (snapshot.timestamp < begin) {
+      /* Current snapshot is before the requested time window.  */
+      continue;
+    }
+
+    if (snapshot.timestamp > end) {
+      /* Current snapshot is after the requested time window.  */
+      *done = 1;
+      return;
+    }
+
+    callback (&snapshot, data);
+  }
+}
+
+/* Call CALLBACK (SNAPSHOT, DATA) on each snapshot taken between BEGIN
+   and END that may contain PID.  */
+int
+query_scan (query_t *query, int pid, time_t begin, time_t end, void (*callback) (const snapshot_t *snapshot, void *data), void *data)
+{
+  /* The history is read once, in file order, through its own
+     window.  */
+  history_t history;
+  if (history_open (&history, query->filename)) {
+    return 1;
+  }
+  history_set_window (&history, query->map_window);
+
+  if (read_lock (history.fd)) {
+    fprintf (stderr, "could not take a read lock\n");
+    history_close (&history);
+    return 1;
+  }
+  if (history_update (&history)) {
+    unlock (history.fd);
+    history_close (&history);
+    return 1;
+  }
+
+  size_t offset = history_first_offset (&history);
+
+  /* Skip the indexed blocks that are outside of the time window or
+     cannot contain PID.  Stop using the index at the first block that
+     does not match the history file, e.g. because a new capture was
+     started in between.  */
+  index_t index;
+  int done = 0;
+  if (! index_open (&index)) {
+    for (size_t i = 0; i < index.nb_blocks && ! done; i++) {
+      const index_block_t *block = index.blocks + i;
+      if (block->offset != offset || block->end_offset > history.file_len) {
+        break;
+      }
+      if (block->first_timestamp > end) {
+        done = 1;
+      } else if (block->last_timestamp >= begin
+                 && (pid == 0 || index_block_may_contain (block, pid))) {
+        scan_snapshots (&history, offset, block->end_offset, begin, end, callback, data, &done);
+      }
+      offset = block->end_offset;
+    }
+    index_close (&index);
+  }
+
+  /* Scan the snapshots that are not indexed yet.  */
+  if (! done) {
+    scan_snapshots (&history, offset, history.file_len, begin, end, callback, data, &done);
+  }
+
+  int status = history.failed;
+  unlock (history.fd);
+  history_close (&history);
+  return status;
+}
+
+/* Close QUERY.  */
+void
+query_close (query_t *query)
+{
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    free (query->cache[i].totals);
+    free (query->cache[i].present);
+  }
+  history_close (&query->history);
+  free (query->filename);
+  free (query);
+}
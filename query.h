@@ -0,0 +1,112 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef QUERY_H
+#define QUERY_H
+
+/*
+ * Query API of libprocesswatcher, for programs that query the history
+ * often (e.g. a build tool after each step) without spawning
+ * "process-watcher get" and parsing its output:
+ *
+ *     query_t *query = query_open (NULL);
+ *     proc_id_t top;
+ *     time_t begin, end;
+ *     query_result_t result;
+ *     if (query != NULL
+ *         && ! try_parse_proc_id ("1234", &top)
+ *         && ! try_parse_time ("20250328120000", &begin)
+ *         && ! try_parse_time ("20250328130000", &end)
+ *         && ! query_get (query, &top, begin, end, &result)) {
+ *       for (int i = 0; i < NB_FIELDS; i++) {
+ *         printf ("%s %lld\n", field_names[i], result.max.fields[i]);
+ *       }
+ *     }
+ *
+ * A query_t keeps the history file mapped and indexed, and the
+ * per-snapshot totals of the most recently queried trees, so that the
+ * next queries only read what the capture appended in between.  It is
+ * what "process-watcher serve" answers its clients with.  Queries that
+ * need the processes themselves go through query_scan () instead, as
+ * "process-watcher get" does.
+ *
+ * Errors are printed on stderr and returned: a corrupt history file or
+ * a failing mmap () does not exit the process, running out of memory
+ * does.
+ */
+
+#include "stat-struct.h"        /* totals_t, proc_id_t, snapshot_t.  */
+#include "schema.h"             /* field_names.  */
+#include "parse-pid.h"          /* try_parse_proc_id ().  */
+#include "parse-time.h"         /* try_parse_time ().  */
+
+#include <stddef.h>             /* size_t.  */
+#include <time.h>               /* time_t.  */
+
+/* A history file open for queries.  */
+typedef struct query query_t;
+
+/* Result of query_get ().  */
+typedef struct {
+  /* Top process of the tree, with its start time if it was found in
+     the time window.  */
+  proc_id_t top;
+  /* Number of snapshots in the time window, and number of those in
+     which the top process was alive.  */
+  size_t nb_snapshots;
+  size_t nb_present;
+  /* Max over the time window of the totals of the tree, by name
+     (MAX.VmRSS) or by index (MAX.fields[i], see field_names).  All 0
+     if NB_PRESENT is 0.  */
+  totals_t max;
+} query_result_t;
+
+/* Open the history file FILENAME for queries, or process-watcher.out
+   in the current directory if it is NULL.
+   Return NULL on error.  */
+query_t *
+query_open (const char *filename);
+
+/* Compute into RESULT the max values of the tree rooted at TOP over
+   the snapshots taken between BEGIN and END (included).  Without a
+   start time, TOP is the first process found with its PID in the time
+   window.  The history is read under a read lock, so it can be called
+   while the capture is running.
+   On success, return 0; on error, return 1.  */
+int
+query_get (query_t *query, const proc_id_t *top, time_t begin, time_t end, query_result_t *result);
+
+/* Make query_scan () map a sliding window of about WINDOW_SIZE bytes
+   of the history file at a time instead of the whole file, so that the
+   memory it uses is bounded.  */
+void
+query_set_window (query_t *query, size_t window_size);
+
+/* Call CALLBACK (SNAPSHOT, DATA) on each snapshot taken between BEGIN
+   and END (included), in time order, reading the history file once
+   under a read lock.  Unless PID is 0, the parts of the history that
+   its index tells cannot contain PID may be skipped.  SNAPSHOT is only
+   valid during the call.
+   On success, return 0; on error, return 1.  */
+int
+query_scan (query_t *query, int pid, time_t begin, time_t end, void (*callback) (const snapshot_t *snapshot, void *data), void *data);
+
+/* Close QUERY and free everything it holds.  */
+void
+query_close (query_t *query);
+
+#endif /* QUERY_H */
@@ -0,0 +1,141 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "query.test.h"
+
+#include "query.h"
+#include "history.h"            /* history_write_snapshot ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <unistd.h>             /* chdir (), unlink ().  */
+
+/* Number of snapshots of the test history.  */
+#define NBSNAPSHOTS 10
+
+/* Write a history of NBSNAPSHOTS snapshots taken every 4 seconds from
+   100, with process 1 and its child 10, whose VmRSS is the
+   timestamp.  */
+static void
+write_history (void)
+{
+  FILE *file = fopen (history_filename, "w");
+  assert (file != NULL);
+  schema_t schema;
+  schema_init (&schema);
+  size_t header_len = history_write_header (&schema, file);
+  assert (header_len != 0);
+  stat_struct_t procs[2];
+  memset (procs, 0, sizeof procs);
+  procs[0].Pid = 1;
+  procs[1].Pid = 10;
+  procs[1].PPid = 1;
+  for (int s = 0; s < NBSNAPSHOTS; s++) {
+    snapshot_t snapshot = { .timestamp = 100 + 4 * s, .nbpids = 2, .procs = procs };
+    procs[1].VmRSS = snapshot.timestamp;
+    size_t snapshot_len = history_write_snapshot (&schema, &snapshot, file);
+    assert (snapshot_len != 0);
+  }
+  int closed = fclose (file);
+  assert (closed == 0);
+}
+
+/* Sum the timestamps of the snapshots in *DATA, for query_scan ().  */
+static void
+sum_timestamps (const snapshot_t *snapshot, void *data)
+{
+  *(time_t *) data += snapshot->timestamp;
+}
+
+/* Query the test history, then check that a corrupt header is
+   reported as an error.  */
+static int
+test_query_errors (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  char old_cwd[PATH_MAX];
+  char *got_cwd = getcwd (old_cwd, sizeof old_cwd);
+  assert (got_cwd != NULL);
+  int status = chdir (root);
+  assert (status == 0);
+  write_history ();
+
+  int error = 0;
+  query_t *query = query_open (NULL);
+  assert (query != NULL);
+  query_set_window (query, 1);
+  time_t sum = 0;
+  status = query_scan (query, 1, 108, 120, sum_timestamps, &sum);
+  if (status != 0 || sum != 108 + 112 + 116 + 120) {
+    fprintf (stderr, "query_scan () returned %d, with a sum of timestamps of %ld\n", status, (long) sum);
+    error = 1;
+  }
+  proc_id_t top = { .pid = 10 };
+  query_result_t result;
+  status = query_get (query, &top, 100, 200, &result);
+  if (status != 0 || result.nb_present != NBSNAPSHOTS || result.max.VmRSS != 136) {
+    fprintf (stderr, "query_get () returned %d, with %zu snapshots and a VmRSS of %lld\n", status, result.nb_present, result.max.VmRSS);
+    error = 1;
+  }
+  query_close (query);
+
+  /* Overwrite the header: the queries fail, without exiting.  */
+  FILE *file = fopen (history_filename, "r+");
+  assert (file != NULL);
+  int written = fputs ("# garbage", file);
+  assert (written != EOF);
+  int closed = fclose (file);
+  assert (closed == 0);
+  query = query_open (NULL);
+  assert (query != NULL);
+  status = query_get (query, &top, 100, 200, &result);
+  if (status != 1) {
+    fprintf (stderr, "query_get () returned %d on a corrupt history\n", status);
+    error = 1;
+  }
+  status = query_scan (query, 1, 100, 200, sum_timestamps, &sum);
+  if (status != 1) {
+    fprintf (stderr, "query_scan () returned %d on a corrupt history\n", status);
+    error = 1;
+  }
+  query_close (query);
+
+  unlink (history_filename);
+  status = chdir (old_cwd);
+  assert (status == 0);
+  rmdir (root);
+  return error;
+}
+
+/* Run all tests on the query.c file.  */
+void
+test_query (void)
+{
+  int error = 0;
+
+  error += test_query_errors ();
+
+  if (error) {
+    exit (1);
+  }
+}
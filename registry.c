@@ -0,0 +1,180 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "registry.h"
+
+#include "tree.h"               /* tree_totals ().  */
+#include "accumulate.h"         /* accumulate_max ().  */
+#include "parse-pid.h"          /* try_parse_proc_id ().  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <sys/stat.h>           /* mkfifo ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* read ().  */
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memchr ().  */
+#include <errno.h>              /* errno.  */
+
+/*
+ * CONTROL FIFO
+ *
+ * The capture reads registrations from the "process-watcher.ctl"
+ * FIFO.  Each registration is a line holding a PID in decimal,
+ * optionally followed by "@" and its start time in decimal.  Lines
+ * are shorter than PIPE_BUF, so that writes from several clients are
+ * not interleaved.
+ */
+
+/* Control FIFO file name.  */
+static const char control_filename[] = "process-watcher.ctl";
+
+/* Create the control FIFO if needed and open it into REGISTRY.  */
+void
+registry_open (registry_t *registry)
+{
+  memset (registry, 0, sizeof *registry);
+
+  if (mkfifo (control_filename, 0622) && errno != EEXIST) {
+    fprintf (stderr, "could not create %s: ", control_filename);
+    perror ("");
+    exit (1);
+  }
+
+  /* Open for writing too, so that reads never see an end of file when
+     clients close their end.  */
+  registry->control_fd = open (control_filename, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (registry->control_fd < 0) {
+    fprintf (stderr, "could not open %s: ", control_filename);
+    perror ("");
+    exit (1);
+  }
+}
+
+/* Add the tree rooted at ID to REGISTRY unless it is already there.  */
+static void
+registry_add (registry_t *registry, const proc_id_t *id)
+{
+  for (int i = 0; i < registry->nbtrees; i++) {
+    const proc_id_t *other = &registry->trees[i].id;
+    if (other->pid == id->pid
+        && (! other->has_start_time || ! id->has_start_time || other->start_time == id->start_time)) {
+      return;
+    }
+  }
+
+  if (registry->nbtrees == registry->capacity) {
+    registry->capacity = registry->capacity ? 2 * registry->capacity : 16;
+    registry->trees = xreallocarray (registry->trees, registry->capacity, sizeof (registered_tree_t));
+  }
+  registered_tree_t *tree = registry->trees + registry->nbtrees++;
+  memset (tree, 0, sizeof *tree);
+  tree->id = *id;
+}
+
+/* Register the trees whose PIDs were written into the control FIFO
+   since the last call.  */
+void
+registry_poll (registry_t *registry)
+{
+  char buffer[4096];
+  while (1) {
+    ssize_t len = read (registry->control_fd, buffer, sizeof buffer - 1);
+    if (len <= 0) {
+      /* Nothing more for now (EAGAIN).  */
+      return;
+    }
+    buffer[len] = 0;
+
+    char *saveptr;
+    for (char *line = strtok_r (buffer, "\n", &saveptr); line != NULL; line = strtok_r (NULL, "\n", &saveptr)) {
+      proc_id_t id;
+      if (try_parse_proc_id (line, &id) == 0) {
+        registry_add (registry, &id);
+      }
+    }
+  }
+}
+
+/* Update the totals and running max of the registered trees with
+   SNAPSHOT.  */
+void
+registry_update (registry_t *registry, const snapshot_t *snapshot)
+{
+  for (int i = 0; i < registry->nbtrees; i++) {
+    registered_tree_t *tree = registry->trees + i;
+    proc_id_resolve (&tree->id, snapshot);
+    if (! tree_totals (snapshot, &tree->id, &tree->totals)) {
+      /* The tree is gone.  */
+      registry->trees[i--] = registry->trees[--registry->nbtrees];
+      continue;
+    }
+    if (tree->registered == 0) {
+      tree->registered = snapshot->timestamp;
+    }
+    accumulate_max (&tree->max, &tree->totals);
+  }
+}
+
+/* Mark the processes of SNAPSHOT that belong to the trees of
+   REGISTRY.  */
+void
+registry_mark_members (const registry_t *registry, const snapshot_t *snapshot, char *marks, stat_struct_t **members)
+{
+  memset (marks, 0, snapshot->nbpids);
+  for (int i = 0; i < registry->nbtrees; i++) {
+    totals_t totals;
+    int nbmembers;
+    if (tree_members (snapshot, &registry->trees[i].id, &totals, members, &nbmembers)) {
+      for (int j = 0; j < nbmembers; j++) {
+        marks[members[j] - snapshot->procs] = 1;
+      }
+    }
+  }
+}
+
+/* Perform the "process-watcher register" command.  */
+void
+register_pid (char *pid_string)
+{
+  proc_id_t id;
+  if (try_parse_proc_id (pid_string, &id)) {
+    exit (1);
+  }
+
+  /* Do not block if there is no capture reading the FIFO.  */
+  int fd = open (control_filename, O_WRONLY | O_NONBLOCK);
+  if (fd < 0) {
+    if (errno == ENXIO || errno == ENOENT) {
+      fprintf (stderr, "no capture is running in this directory\n");
+    } else {
+      fprintf (stderr, "could not open %s: ", control_filename);
+      perror ("");
+    }
+    exit (1);
+  }
+
+  char line[32];
+  int len = id.has_start_time
+    ? snprintf (line, sizeof line, "%d@%u\n", id.pid, id.start_time)
+    : snprintf (line, sizeof line, "%d\n", id.pid);
+  if (write (fd, line, len) != len) {
+    perror ("could not register the pid");
+    exit (1);
+  }
+  close (fd);
+}
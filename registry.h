@@ -0,0 +1,72 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "history.h"            /* snapshot_t.  */
+
+/* A process tree registered with "process-watcher register".  */
+typedef struct {
+  /* Top process of the tree.  Its start time is taken from the first
+     snapshot after the registration, unless it was given.  */
+  proc_id_t id;
+  /* Timestamp of the first snapshot in which the capture computed
+     the tree totals, 0 until then.  */
+  time_t registered;
+  /* Totals of the tree in the latest snapshot.  */
+  totals_t totals;
+  /* Running max of TOTALS since REGISTERED.  */
+  totals_t max;
+} registered_tree_t;
+
+/* Registered trees of a capture, and the control FIFO through which
+   they are registered.  */
+typedef struct {
+  int control_fd;
+  registered_tree_t *trees;
+  int nbtrees;
+  int capacity;
+} registry_t;
+
+/* Create the control FIFO if needed and open it into REGISTRY.
+   Exit on error.  */
+void
+registry_open (registry_t *registry);
+
+/* Register the trees whose top processes were written into the control FIFO
+   since the last call.  */
+void
+registry_poll (registry_t *registry);
+
+/* Update the totals and running max of the registered trees with
+   SNAPSHOT.  The trees whose top process is not in SNAPSHOT anymore
+   are unregistered.  */
+void
+registry_update (registry_t *registry, const snapshot_t *snapshot);
+
+/* Set MARKS[I] to 1 if process I of SNAPSHOT belongs to one of the
+   trees of REGISTRY, and to 0 otherwise.  MARKS and MEMBERS must have
+   room for SNAPSHOT->nbpids entries.  */
+void
+registry_mark_members (const registry_t *registry, const snapshot_t *snapshot, char *marks, stat_struct_t **members);
+
+/* Perform the "process-watcher register" command.  */
+void
+register_pid (char *pid_string);
+
+#endif /* REGISTRY_H */
@@ -0,0 +1,241 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "ring.h"
+
+#include "xmalloc.h"            /* xmalloc ().  */
+
+#include <sys/mman.h>           /* shm_open ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* O_RDWR.  */
+#include <unistd.h>             /* ftruncate (), getpid ().  */
+#include <signal.h>             /* kill ().  */
+#include <errno.h>              /* errno.  */
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* free ().  */
+#include <string.h>             /* memcpy ().  */
+
+/* Round N up to a multiple of 64 bytes, the size of a cache line.  */
+#define ROUND_UP_64(n) (((n) + 63) / 64 * 64)
+
+/* Return the address of slot number I of RING.  */
+static ring_slot_t *
+ring_slot (ring_t *ring, uint64_t i)
+{
+  return (ring_slot_t *) ((char *) ring->header + ring->header->header_size + i * ring->header->slot_size);
+}
+
+/* Return whether the capture that publishes into RING is still
+   running.  */
+static int
+ring_writer_alive (const ring_t *ring)
+{
+  return kill (ring->header->writer_pid, 0) == 0 || errno != ESRCH;
+}
+
+/* Create (or recreate) the shared memory object NAME with NB_SLOTS
+   slots of MAX_PROCS processes, and map it for writing into RING.  */
+int
+ring_create (ring_t *ring, const char *name, int nb_slots, int max_procs, int resumed)
+{
+  size_t header_size = ROUND_UP_64 (sizeof (ring_header_t));
+  size_t slot_size = ROUND_UP_64 (sizeof (ring_slot_t) + (size_t) max_procs * sizeof (stat_struct_t));
+  ring->size = header_size + (size_t) nb_slots * slot_size;
+  ring->buffer = NULL;
+
+  /* Start from a new object, so that readers of the old one do not
+     see it change layout under their feet.  */
+  shm_unlink (name);
+  int fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    fprintf (stderr, "could not create shared memory %s: ", name);
+    perror ("");
+    return 1;
+  }
+  if (ftruncate (fd, ring->size)) {
+    perror ("could not size the shared memory");
+    close (fd);
+    return 1;
+  }
+  ring->header = (ring_header_t *) mmap (NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (ring->header == MAP_FAILED) {
+    perror ("could not mmap the shared memory");
+    return 1;
+  }
+
+  ring_header_t *header = ring->header;
+  header->header_size = header_size;
+  header->nb_slots = nb_slots;
+  header->slot_size = slot_size;
+  header->max_procs = max_procs;
+  header->record_size = sizeof (stat_struct_t);
+  header->nb_fields = NB_FIELDS;
+  header->writer_pid = getpid ();
+  header->sequence = 0;
+  header->covered_from = resumed ? INT64_MAX : 0;
+  size_t len = 0;
+#define X(field) len += snprintf (header->field_names + len, sizeof header->field_names - len, len ? " %s" : "%s", #field);
+#include "fields.out.h"
+#undef X
+  header->version = RING_VERSION;
+  /* Readers check the magic number last.  */
+  __atomic_store_n (&header->magic, RING_MAGIC, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/* Publish into RING the snapshot made of the NBPIDS processes PROCS
+   taken at TIMESTAMP.  */
+void
+ring_publish (ring_t *ring, time_t timestamp, const stat_struct_t *procs, int nbpids)
+{
+  ring_header_t *header = ring->header;
+  uint64_t sequence = header->sequence;
+  ring_slot_t *slot = ring_slot (ring, sequence % header->nb_slots);
+
+  /* Make the generation odd: the slot is being modified.  */
+  uint64_t generation = slot->generation;
+  __atomic_store_n (&slot->generation, generation + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  slot->sequence = sequence;
+  slot->timestamp = timestamp;
+  if (sequence == 0 && header->covered_from != 0) {
+    __atomic_store_n (&header->covered_from, (int64_t) timestamp, __ATOMIC_RELAXED);
+  }
+  if (nbpids <= (int) header->max_procs) {
+    slot->nbpids = nbpids;
+    memcpy (slot + 1, procs, nbpids * sizeof (stat_struct_t));
+  } else {
+    slot->nbpids = -1;
+  }
+
+  /* Make the generation even again: the slot is consistent.  */
+  __atomic_store_n (&slot->generation, generation + 2, __ATOMIC_RELEASE);
+  __atomic_store_n (&header->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+/* Map the existing shared memory object NAME for reading into RING.  */
+int
+ring_open (ring_t *ring, const char *name)
+{
+  int fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  if (fstat (fd, &st) || (size_t) st.st_size < sizeof (ring_header_t)) {
+    close (fd);
+    return 1;
+  }
+  ring->size = st.st_size;
+  ring->header = (ring_header_t *) mmap (NULL, ring->size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (ring->header == MAP_FAILED) {
+    return 1;
+  }
+
+  ring_header_t *header = ring->header;
+  if (__atomic_load_n (&header->magic, __ATOMIC_ACQUIRE) != RING_MAGIC
+      || header->version != RING_VERSION
+      || header->record_size != sizeof (stat_struct_t)
+      || header->nb_fields != NB_FIELDS
+      || header->header_size + (size_t) header->nb_slots * header->slot_size > ring->size) {
+    fprintf (stderr, "shared memory %s has an unexpected layout, ignoring it\n", name);
+    munmap (ring->header, ring->size);
+    return 1;
+  }
+  if (! ring_writer_alive (ring)) {
+    fprintf (stderr, "shared memory %s was left by capture %d, which has exited, ignoring it\n", name, (int) header->writer_pid);
+    munmap (ring->header, ring->size);
+    return 1;
+  }
+
+  ring->buffer = xmalloc (header->max_procs * sizeof (stat_struct_t));
+  return 0;
+}
+
+/* Call CALLBACK (SNAPSHOT, DATA) on each snapshot of RING taken
+   between BEGIN and END, in order.  */
+int
+ring_read (ring_t *ring, time_t begin, time_t end, void (*callback) (const snapshot_t *snapshot, void *data), void *data)
+{
+  ring_header_t *header = ring->header;
+  uint64_t last = __atomic_load_n (&header->sequence, __ATOMIC_ACQUIRE);
+  uint64_t first = last > header->nb_slots ? last - header->nb_slots : 0;
+
+  if (begin < __atomic_load_n (&header->covered_from, __ATOMIC_RELAXED)) {
+    /* The history has older snapshots of the window, taken before the
+       ring was created.  */
+    return 1;
+  }
+  if (! ring_writer_alive (ring)) {
+    /* The capture exited since the ring was opened: the history may
+       have newer snapshots of the window.  */
+    return 1;
+  }
+
+  for (uint64_t sequence = first; sequence < last; sequence++) {
+    ring_slot_t *slot = ring_slot (ring, sequence % header->nb_slots);
+
+    uint64_t generation = __atomic_load_n (&slot->generation, __ATOMIC_ACQUIRE);
+    snapshot_t snapshot = {
+      .timestamp = slot->timestamp,
+      .nbpids = slot->nbpids,
+      .procs = ring->buffer,
+    };
+    int in_window = snapshot.timestamp >= begin && snapshot.timestamp <= end;
+    if (in_window && snapshot.nbpids > 0 && snapshot.nbpids <= (int) header->max_procs) {
+      memcpy (ring->buffer, slot + 1, snapshot.nbpids * sizeof (stat_struct_t));
+    }
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (generation % 2 == 1
+        || __atomic_load_n (&slot->generation, __ATOMIC_RELAXED) != generation
+        || slot->sequence != sequence) {
+      /* The writer has modified the slot while we were reading it.  */
+      return 1;
+    }
+
+    if (sequence == first && first > 0 && snapshot.timestamp >= begin) {
+      /* Older snapshots of the window have already been
+         overwritten.  */
+      return 1;
+    }
+    if (snapshot.timestamp > end) {
+      break;
+    }
+    if (! in_window) {
+      continue;
+    }
+    if (snapshot.nbpids < 0) {
+      /* This snapshot did not fit in the slot.  */
+      return 1;
+    }
+    callback (&snapshot, data);
+  }
+
+  return 0;
+}
+
+/* Unmap RING.  */
+void
+ring_close (ring_t *ring)
+{
+  munmap (ring->header, ring->size);
+  free (ring->buffer);
+}
@@ -0,0 +1,129 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "history.h"            /* snapshot_t.  */
+
+#include <stdint.h>             /* uint32_t.  */
+
+/*
+ * SHARED MEMORY LAYOUT
+ *
+ * The capture can publish its most recent snapshots into a POSIX
+ * shared memory object (see shm_open (3)), so that local readers can
+ * get them without any system call or disk I/O.  The layout is fixed
+ * for a given RING_VERSION, numbers are in host order:
+ *
+ * - a ring_header_t, padded to HEADER_SIZE bytes,
+ * - NB_SLOTS slots of SLOT_SIZE bytes each.  Each slot is a
+ *   ring_slot_t followed by MAX_PROCS records of RECORD_SIZE bytes,
+ *   i.e. stat_struct_t, whose memory fields are named in FIELD_NAMES.
+ *
+ * The snapshot number S (counting from 0 since the capture started)
+ * is in slot S % NB_SLOTS.  The writer makes GENERATION odd before
+ * modifying a slot and even again afterwards (a seqlock), then
+ * increments the header SEQUENCE.  A reader copies a slot, then checks
+ * that GENERATION was even and did not change during the copy, and
+ * that the slot still holds the expected SEQUENCE; otherwise the copy
+ * is not valid.
+ *
+ * COVERED_FROM is the time from which the ring has held every snapshot
+ * of the history: 0 if the history started with the ring, else the
+ * time of the first snapshot published, e.g. by a capture --append.
+ *
+ * WRITER_PID is the PID of the capture that publishes into the ring.
+ * Once it is gone, the ring is left as it was, while another capture
+ * may be appending to the history: readers then ignore it.
+ */
+
+#define RING_MAGIC 0x52577750   /* "PwWR" in little-endian order.  */
+#define RING_VERSION 4
+
+/* Header of the shared memory object.  */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t nb_slots;
+  uint32_t slot_size;
+  uint32_t max_procs;
+  uint32_t record_size;
+  uint32_t nb_fields;
+  /* PID of the capture that publishes into the ring.  */
+  int32_t writer_pid;
+  uint32_t padding;
+  /* Number of snapshots published so far.  */
+  uint64_t sequence;
+  /* Time from which the ring holds all the snapshots of the history,
+     INT64_MAX until the first one is published if it does not hold
+     them all.  */
+  int64_t covered_from;
+  /* Names of the memory fields, separated by spaces.  */
+  char field_names[256];
+} ring_header_t;
+
+/* Header of a slot.  */
+typedef struct {
+  uint64_t generation;
+  uint64_t sequence;
+  int64_t timestamp;
+  /* Number of processes, or -1 if they did not fit in the slot.  */
+  int32_t nbpids;
+  int32_t padding;
+} ring_slot_t;
+
+/* A mapping of the shared memory object.  */
+typedef struct {
+  ring_header_t *header;
+  size_t size;
+  /* Reader's copy of one slot.  */
+  stat_struct_t *buffer;
+} ring_t;
+
+/* Create (or recreate) the shared memory object NAME with NB_SLOTS
+   slots of MAX_PROCS processes, and map it for writing into RING.
+   RESUMED tells whether the history already holds snapshots, which the
+   ring does not have.
+   On success, return 0; on error, return 1.  */
+int
+ring_create (ring_t *ring, const char *name, int nb_slots, int max_procs, int resumed);
+
+/* Publish into RING the snapshot made of the NBPIDS processes PROCS
+   taken at TIMESTAMP.  */
+void
+ring_publish (ring_t *ring, time_t timestamp, const stat_struct_t *procs, int nbpids);
+
+/* Map the existing shared memory object NAME for reading into RING.
+   On success, return 0; on error, or if the capture that wrote it has
+   exited, return 1.  */
+int
+ring_open (ring_t *ring, const char *name);
+
+/* Call CALLBACK (SNAPSHOT, DATA) on each snapshot of RING taken
+   between BEGIN and END, in order.
+   Return 0 if RING holds all the snapshots of that time window, i.e.
+   none older than it were overwritten, the history has none before the
+   ring in the window, and the capture that writes it is still
+   running.
+   Otherwise, return 1; in that case CALLBACK may have been called
+   on part of the window, and the caller should discard its results
+   and read the history file instead.  */
+int
+ring_read (ring_t *ring, time_t begin, time_t end, void (*callback) (const snapshot_t *snapshot, void *data), void *data);
+
+/* Unmap RING.  */
+void
+ring_close (ring_t *ring);
@@ -0,0 +1,105 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "ring.test.h"
+
+#include "ring.h"
+
+#include <sys/mman.h>           /* shm_unlink ().  */
+#include <sys/wait.h>           /* waitpid ().  */
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <unistd.h>             /* fork ().  */
+
+/* Count the snapshots in *DATA, for ring_read ().  */
+static void
+count_snapshot (const snapshot_t *snapshot, void *data)
+{
+  (*(int *) data)++;
+}
+
+/* Publish a snapshot, then check that it is only read while its
+   writer is alive.  */
+static int
+test_ring_dead_writer (void)
+{
+  char name[64];
+  snprintf (name, sizeof name, "/process-watcher-test-%d", (int) getpid ());
+  ring_t writer;
+  int status = ring_create (&writer, name, 4, 8, 0);
+  assert (status == 0);
+  stat_struct_t procs[1];
+  memset (procs, 0, sizeof procs);
+  procs[0].Pid = 1;
+  procs[0].VmRSS = 42;
+  ring_publish (&writer, 100, procs, 1);
+
+  int error = 0;
+  ring_t reader;
+  status = ring_open (&reader, name);
+  assert (status == 0);
+  int count = 0;
+  status = ring_read (&reader, 100, 100, count_snapshot, &count);
+  if (status != 0 || count != 1) {
+    fprintf (stderr, "ring_read () returned %d, with %d snapshots\n", status, count);
+    error = 1;
+  }
+
+  /* Make the writer a process that has exited.  */
+  pid_t child = fork ();
+  assert (child >= 0);
+  if (child == 0) {
+    _exit (0);
+  }
+  pid_t waited = waitpid (child, NULL, 0);
+  assert (waited == child);
+  writer.header->writer_pid = child;
+
+  status = ring_read (&reader, 100, 100, count_snapshot, &count);
+  if (status != 1) {
+    fprintf (stderr, "ring_read () returned %d after its writer exited\n", status);
+    error = 1;
+  }
+  ring_close (&reader);
+  ring_t stale;
+  status = ring_open (&stale, name);
+  if (status != 1) {
+    fprintf (stderr, "ring_open () returned %d after its writer exited\n", status);
+    ring_close (&stale);
+    error = 1;
+  }
+
+  ring_close (&writer);
+  shm_unlink (name);
+  return error;
+}
+
+/* Run all tests on the ring.c file.  */
+void
+test_ring (void)
+{
+  int error = 0;
+
+  error += test_ring_dead_writer ();
+
+  if (error) {
+    exit (1);
+  }
+}
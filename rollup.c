@@ -0,0 +1,157 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "rollup.h"
+
+#include "side-file.h"          /* side_file_create ().  */
+
+#include <sys/mman.h>           /* mmap ().  */
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* close ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memcmp ().  */
+
+/*
+ * FILE FORMAT
+ *
+ * Header: "# process-watcher rollup format 2\n\n\n\n\n\n\n" (40 bytes,
+ * without NUL character), then a sequence of rollup_record_t in ascending
+ * timestamp order.  Numbers are in host order.
+ */
+
+/* Rollup file name.  */
+static const char rollup_filename[] = "process-watcher.rollup";
+
+/* First bytes of the rollup file.
+   The strlen is a multiple of 8 for alignment purposes.  */
+static const char rollup_header[] = "# process-watcher rollup format 2\n\n\n\n\n\n\n";
+
+/* Open the rollup file for writing, truncating it and writing its
+   header unless APPEND.  */
+FILE *
+rollup_create (int append)
+{
+  return side_file_create (rollup_filename, rollup_header, sizeof (rollup_record_t), append);
+}
+
+/* Write the rollup records of the registered trees of REGISTRY for the
+   snapshot taken at TIMESTAMP into OUTPUT.  */
+void
+rollup_write (FILE *output, const registry_t *registry, time_t timestamp)
+{
+  for (int i = 0; i < registry->nbtrees; i++) {
+    const registered_tree_t *tree = registry->trees + i;
+    rollup_record_t record = {
+      .timestamp = timestamp,
+      .pid = tree->id.pid,
+      .start_time = tree->id.start_time,
+      .flags = tree->registered == timestamp ? ROLLUP_REGISTERED : 0,
+      .totals = tree->totals,
+      .max = tree->max,
+    };
+    if (fwrite_unlocked (&record, sizeof record, 1, output) != 1) {
+      perror ("could not write a rollup record");
+      exit (1);
+    }
+  }
+  fflush_unlocked (output);
+}
+
+/* Call CALLBACK (TIMESTAMP, TOTALS, DATA) on the totals of each rollup
+   record of the tree rooted at PID between BEGIN and END, in time
+   order.  */
+int
+rollup_read (proc_id_t *top, time_t begin, time_t end, time_t *raw_end, time_t *raw_begin, void (*callback) (time_t timestamp, const totals_t *totals, void *data), void *data)
+{
+  int fd = open (rollup_filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  const size_t header_len = strlen (rollup_header);
+  if (fstat (fd, &st) || (size_t) st.st_size <= header_len) {
+    close (fd);
+    return 1;
+  }
+  size_t map_len = st.st_size;
+  char *map = (char *) mmap (NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED) {
+    return 1;
+  }
+  if (memcmp (map, rollup_header, header_len) != 0) {
+    munmap (map, map_len);
+    return 1;
+  }
+
+  const rollup_record_t *records = (const rollup_record_t *) (map + header_len);
+  size_t nbrecords = (map_len - header_len) / sizeof (rollup_record_t);
+
+  /* Find the first record in the time window.  */
+  size_t low = 0;
+  size_t high = nbrecords;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (records[middle].timestamp < begin) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  /* Check the records first, so that CALLBACK is only called if they
+     can be used.  */
+  int found = 0;
+  *raw_end = begin;
+  *raw_begin = end + 1;
+  for (size_t i = low; i < nbrecords && records[i].timestamp <= end; i++) {
+    if (records[i].pid != top->pid
+        || (top->has_start_time && records[i].start_time != top->start_time)) {
+      continue;
+    }
+    top->has_start_time = 1;
+    top->start_time = records[i].start_time;
+    if (records[i].flags & ROLLUP_REGISTERED) {
+      if (found) {
+        /* Registered again, e.g. after a capture --append: the
+           snapshots in between are only in the history.  */
+        found = 0;
+        break;
+      }
+      /* The tree was registered within the time window: what came
+         before is only in the history.  */
+      *raw_end = records[i].timestamp;
+    }
+    found = 1;
+    *raw_begin = records[i].timestamp + 1;
+  }
+
+  if (found && callback != NULL) {
+    for (size_t i = low; i < nbrecords && records[i].timestamp <= end; i++) {
+      if (records[i].pid == top->pid && records[i].start_time == top->start_time) {
+        callback (records[i].timestamp, &records[i].totals, data);
+      }
+    }
+  }
+
+  munmap (map, map_len);
+  return ! found;
+}
@@ -0,0 +1,67 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "registry.h"           /* registry_t.  */
+
+#include <stdio.h>              /* FILE.  */
+
+/* Rollup records are written next to the history file, one per
+   registered tree per snapshot.  */
+typedef struct {
+  /* Timestamp of the snapshot.  */
+  time_t timestamp;
+  /* Top process of the tree.  */
+  int pid;
+  unsigned int start_time;
+  /* ROLLUP_* flags.  */
+  int flags;
+  int padding;
+  /* Totals of the tree in the snapshot.  */
+  totals_t totals;
+  /* Running max of the totals since the registration.  */
+  totals_t max;
+} rollup_record_t;
+
+/* The record is the first one after the registration of the tree.  */
+#define ROLLUP_REGISTERED 1
+
+/* Open the rollup file for writing, truncating it and writing its
+   header unless APPEND (see side_file_create ()).  Exit on error.  */
+FILE *
+rollup_create (int append);
+
+/* Write the rollup records of the registered trees of REGISTRY for the
+   snapshot taken at TIMESTAMP into OUTPUT.  Exit on error.  */
+void
+rollup_write (FILE *output, const registry_t *registry, time_t timestamp);
+
+/* Call CALLBACK (TIMESTAMP, TOTALS, DATA) on the totals of each rollup
+   record of the tree rooted at TOP between BEGIN and END, in time
+   order.  If the start time of TOP is not known, it is taken from the
+   first record of TOP->pid.  CALLBACK may be NULL.  The snapshots taken before the
+   registration of the tree are not in the rollups: *RAW_END is set to
+   the time before which the history itself must be read (BEGIN if
+   none).  Nor are those taken after its last rollup, e.g. after a
+   capture --append, which starts with no registered tree: *RAW_BEGIN
+   is set to the time from which the history must be read again (after
+   END if none).
+   Return 0 on success, 1 if there are no rollups for TOP in the time
+   window, or if it was registered again within it, so that the rollups
+   miss the snapshots between the two registrations.  CALLBACK is then
+   not called.  */
+int
+rollup_read (proc_id_t *top, time_t begin, time_t end, time_t *raw_end, time_t *raw_begin, void (*callback) (time_t timestamp, const totals_t *totals, void *data), void *data);
@@ -0,0 +1,118 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "rollup.test.h"
+
+#include "rollup.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <unistd.h>             /* chdir (), unlink ().  */
+
+/* Count the records read by rollup_read () in *DATA.  */
+static void
+count_record (time_t timestamp, const totals_t *totals, void *data)
+{
+  (*(int *) data)++;
+}
+
+/* Write a rollup record of the tree rooted at PID 42 into OUTPUT.  */
+static void
+write_record (FILE *output, time_t timestamp, int flags)
+{
+  rollup_record_t record;
+  memset (&record, 0, sizeof record);
+  record.timestamp = timestamp;
+  record.pid = 42;
+  record.start_time = 7;
+  record.flags = flags;
+  size_t written = fwrite (&record, sizeof record, 1, output);
+  assert (written == 1);
+}
+
+/* Check the return value, *RAW_END, *RAW_BEGIN and the number of
+   records read by rollup_read () between BEGIN and END.  */
+static int
+check_read (time_t begin, time_t end, int expected, time_t expected_raw_end, time_t expected_raw_begin, int expected_count)
+{
+  proc_id_t top = { .pid = 42 };
+  time_t raw_end = 0;
+  time_t raw_begin = 0;
+  int count = 0;
+  int status = rollup_read (&top, begin, end, &raw_end, &raw_begin, count_record, &count);
+  if (status != expected
+      || (status == 0 && (raw_end != expected_raw_end || raw_begin != expected_raw_begin))
+      || count != expected_count) {
+    fprintf (stderr, "rollup_read (%ld, %ld): got %d, %ld, %ld, %d records\n", (long) begin, (long) end, status, (long) raw_end, (long) raw_begin, count);
+    return 1;
+  }
+  return 0;
+}
+
+/* Register the tree, append to the capture (no rollups), then register
+   the tree again: the rollups must not be used across the gap.  */
+static int
+test_rollup_registered_again (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  char old_cwd[PATH_MAX];
+  char *got_cwd = getcwd (old_cwd, sizeof old_cwd);
+  assert (got_cwd != NULL);
+  int status = chdir (root);
+  assert (status == 0);
+
+  FILE *output = rollup_create (0);
+  write_record (output, 100, ROLLUP_REGISTERED);
+  write_record (output, 101, 0);
+  write_record (output, 102, 0);
+  /* Snapshots 103 and 104 were taken by a capture --append.  */
+  write_record (output, 105, ROLLUP_REGISTERED);
+  write_record (output, 106, 0);
+  status = fclose (output);
+  assert (status == 0);
+
+  int error = 0;
+  error |= check_read (100, 106, 1, 0, 0, 0);
+  error |= check_read (90, 102, 0, 100, 103, 3);
+  error |= check_read (105, 110, 0, 105, 107, 2);
+  error |= check_read (103, 104, 1, 0, 0, 0);
+
+  unlink ("process-watcher.rollup");
+  status = chdir (old_cwd);
+  assert (status == 0);
+  rmdir (root);
+  return error;
+}
+
+/* Run all tests on the rollup.c file.  */
+void
+test_rollup (void)
+{
+  int error = 0;
+
+  error += test_rollup_registered_again ();
+
+  if (error) {
+    exit (1);
+  }
+}
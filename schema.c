@@ -0,0 +1,415 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fwrite_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "schema.h"
+
+#include "crc32c.h"             /* crc32c ().  */
+
+#include <stdlib.h>             /* strtoul ().  */
+#include <string.h>             /* strcmp ().  */
+
+/*
+ * FILE HEADER
+ *
+ * Since format 3, the header of a history file describes its records:
+ *
+ * # process-watcher file format 4
+ * stride 32
+ * fields VmHWM VmRSS RssAnon RssFile RssShmem
+ *
+ * followed by as many newlines as needed to make its length a
+ * multiple of 4.  The header ends at the first empty line; lines
+ * that are not known are ignored, so that later versions can add
+ * some.  Each record is the pid, the ppid and the start time as in
+ * stat_struct_t, followed by the fields as ints in the order of the
+ * "fields" line, followed by padding up to the stride.
+ *
+ * Format 4 added a trailer with a CRC32C after each snapshot, to
+ * recover from a torn one; format 3 is the same without it.
+ *
+ * Format 2 had a header of its own line only, and records laid out as
+ * stat_struct_t with the fields of legacy_fields below, those of the
+ * "fields" file when it was frozen.  Format 1 was the same without
+ * the start time, with the header "# process-watcher file format"
+ * followed by three newlines.
+ */
+
+_Static_assert (offsetof (stat_struct_t, fields) == SCHEMA_RECORD_HEADER_SIZE,
+                "the records start like stat_struct_t");
+
+/* First line of a history file, up to the version.  */
+static const char magic[] = "# process-watcher file format ";
+
+/* Whole header of format 1.  */
+static const char first_header[] = "# process-watcher file format\n\n\n";
+
+/* Current and previous formats.  */
+#define FORMAT_VERSION 4
+#define NO_TRAILER_VERSION 3
+#define LEGACY_VERSION 2
+
+/* Maximum length of a header.  */
+#define MAX_HEADER_LEN 4096
+
+/* Fields of the records of format 2, in order.  */
+static const char *const legacy_fields[] = {
+  "VmPeak", "VmSize", "VmLck", "VmPin", "VmHWM", "VmRSS", "RssAnon", "RssFile",
+  "RssShmem", "VmData", "VmStk", "VmExe", "VmLib", "VmPTE", "VmSwap",
+};
+#define NB_LEGACY_FIELDS ((int) (sizeof legacy_fields / sizeof legacy_fields[0]))
+
+/* Names of the memory fields, in stat_struct_t order.  */
+const char *const field_names[NB_FIELDS] = {
+#define X(field) #field,
+#include "fields.out.h"
+#undef X
+};
+
+/* Return the index of the memory field named NAME, or -1 if there is
+   none.  */
+int
+field_index (const char *name)
+{
+  for (int i = 0; i < NB_FIELDS; i++) {
+    if (! strcmp (name, field_names[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Compute the runs and whether SCHEMA is native from its names.  */
+static void
+schema_compile (schema_t *schema)
+{
+  schema->native = schema->nbfields == NB_FIELDS && schema->stride == sizeof (stat_struct_t)
+    && schema->record_header_size == SCHEMA_RECORD_HEADER_SIZE;
+  schema->nbruns = 0;
+  schema_run_t *run = NULL;
+  for (int i = 0; i < schema->nbfields; i++) {
+    int field = field_index (schema->names[i]);
+    schema->native &= field == i;
+    if (field == -1) {
+      /* Recorded by another build.  */
+      run = NULL;
+      continue;
+    }
+    if (run != NULL && run->field + run->count == field) {
+      run->count++;
+    } else {
+      run = schema->runs + schema->nbruns++;
+      run->offset = schema->record_header_size + i * sizeof (int);
+      run->field = field;
+      run->count = 1;
+    }
+  }
+}
+
+/* Make SCHEMA record all the fields of stat_struct_t.  */
+void
+schema_init (schema_t *schema)
+{
+  memset (schema, 0, sizeof *schema);
+  for (int i = 0; i < NB_FIELDS; i++) {
+    strcpy (schema->names[i], field_names[i]);
+  }
+  schema->nbfields = NB_FIELDS;
+  schema->stride = sizeof (stat_struct_t);
+  schema->record_header_size = SCHEMA_RECORD_HEADER_SIZE;
+  schema->checksums = 1;
+  schema_compile (schema);
+}
+
+/* Make SCHEMA record only the fields in LIST.  */
+int
+schema_select (schema_t *schema, const char *list)
+{
+  char selected[NB_FIELDS];
+  memset (selected, 0, sizeof selected);
+  size_t list_len = strlen (list);
+  char copy[list_len + 1];
+  memcpy (copy, list, list_len + 1);
+  for (char *name = strtok (copy, ","); name != NULL; name = strtok (NULL, ",")) {
+    int field = field_index (name);
+    if (field == -1) {
+      fprintf (stderr, "unknown field %s\n", name);
+      return 1;
+    }
+    selected[field] = 1;
+  }
+  return schema_select_mask (schema, selected);
+}
+
+/* Make SCHEMA record the fields set in SELECTED.  */
+int
+schema_select_mask (schema_t *schema, const char selected[NB_FIELDS])
+{
+  memset (schema, 0, sizeof *schema);
+  for (int i = 0; i < NB_FIELDS; i++) {
+    if (selected[i]) {
+      strcpy (schema->names[schema->nbfields++], field_names[i]);
+    }
+  }
+  if (schema->nbfields == 0) {
+    fprintf (stderr, "no fields selected\n");
+    return 1;
+  }
+  schema->stride = SCHEMA_RECORD_HEADER_SIZE + schema->nbfields * sizeof (int);
+  schema->record_header_size = SCHEMA_RECORD_HEADER_SIZE;
+  schema->checksums = 1;
+  schema_compile (schema);
+  return 0;
+}
+
+/* Return whether A and B have the same layout.  */
+int
+schema_equal (const schema_t *a, const schema_t *b)
+{
+  if (a->nbfields != b->nbfields || a->stride != b->stride || a->checksums != b->checksums
+      || a->record_header_size != b->record_header_size) {
+    return 0;
+  }
+  for (int i = 0; i < a->nbfields; i++) {
+    if (strcmp (a->names[i], b->names[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Return whether SCHEMA records FIELD.  */
+int
+schema_has_field (const schema_t *schema, int field)
+{
+  for (int i = 0; i < schema->nbruns; i++) {
+    if (field >= schema->runs[i].field && field < schema->runs[i].field + schema->runs[i].count) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Write the header of SCHEMA into OUTPUT.  */
+size_t
+schema_write_header (const schema_t *schema, FILE *output)
+{
+  char header[MAX_HEADER_LEN];
+  int len = snprintf (header, sizeof header, "%s%d\nstride %zu\nfields", magic, FORMAT_VERSION, schema->stride);
+  for (int i = 0; i < schema->nbfields; i++) {
+    len += snprintf (header + len, sizeof header - len, " %s", schema->names[i]);
+  }
+  header[len++] = '\n';
+  do {
+    header[len++] = '\n';
+  } while (len % 4 != 0);
+
+  if (fwrite (header, 1, len, output) != (size_t) len) {
+    return 0;
+  }
+  return len;
+}
+
+/* Parse the "fields" line LINE of a header into SCHEMA.
+   On success, return 0; on error, print a message and return 1.  */
+static int
+parse_fields (schema_t *schema, char *line)
+{
+  schema->nbfields = 0;
+  for (char *name = strtok (line, " "); name != NULL; name = strtok (NULL, " ")) {
+    if (schema->nbfields == SCHEMA_MAX_FIELDS || strlen (name) >= SCHEMA_NAME_SIZE) {
+      fprintf (stderr, "bad header: too many fields, or too long\n");
+      return 1;
+    }
+    strcpy (schema->names[schema->nbfields++], name);
+  }
+  return 0;
+}
+
+/* Make SCHEMA the layout of formats 1 and 2, whose records start
+   with RECORD_HEADER_SIZE bytes.  */
+static void
+schema_legacy (schema_t *schema, size_t record_header_size)
+{
+  memset (schema, 0, sizeof *schema);
+  for (int i = 0; i < NB_LEGACY_FIELDS; i++) {
+    strcpy (schema->names[i], legacy_fields[i]);
+  }
+  schema->nbfields = NB_LEGACY_FIELDS;
+  schema->record_header_size = record_header_size;
+  schema->stride = record_header_size + NB_LEGACY_FIELDS * sizeof (int);
+  schema_compile (schema);
+}
+
+/* Parse the header at DATA into SCHEMA.  */
+int
+schema_parse_header (schema_t *schema, const char *data, size_t len, size_t *header_len)
+{
+  const size_t first_header_len = strlen (first_header);
+  if (len >= first_header_len && memcmp (data, first_header, first_header_len) == 0) {
+    schema_legacy (schema, SCHEMA_RECORD_HEADER_SIZE_V1);
+    *header_len = first_header_len;
+    return 0;
+  }
+
+  const size_t magic_len = strlen (magic);
+  if (len < magic_len + 2) {
+    fprintf (stderr, "bad file: too short to contain the header\n");
+    return 1;
+  }
+  if (memcmp (data, magic, magic_len) != 0) {
+    fprintf (stderr, "bad header: should start with {%s}\n", magic);
+    return 1;
+  }
+
+  if (data[magic_len] == '0' + LEGACY_VERSION && data[magic_len + 1] == '\n') {
+    schema_legacy (schema, SCHEMA_RECORD_HEADER_SIZE);
+    *header_len = magic_len + 2;
+    return 0;
+  }
+  if ((data[magic_len] != '0' + FORMAT_VERSION && data[magic_len] != '0' + NO_TRAILER_VERSION)
+      || data[magic_len + 1] != '\n') {
+    fprintf (stderr, "bad header: unknown file format %c\n", data[magic_len]);
+    return 1;
+  }
+
+  /* Copy the header up to the empty line, to split it.  */
+  char header[MAX_HEADER_LEN];
+  size_t end = 0;
+  while (end + 1 < len && end + 1 < sizeof header && ! (data[end] == '\n' && data[end + 1] == '\n')) {
+    end++;
+  }
+  if (end + 1 >= len || end + 1 >= sizeof header) {
+    fprintf (stderr, "bad file: too short to contain the header\n");
+    return 1;
+  }
+  memcpy (header, data, end);
+  header[end] = 0;
+  end = (end + 2 + 3) / 4 * 4;
+  if (end > len) {
+    fprintf (stderr, "bad file: too short to contain the header\n");
+    return 1;
+  }
+
+  memset (schema, 0, sizeof *schema);
+  schema->record_header_size = SCHEMA_RECORD_HEADER_SIZE;
+  schema->checksums = data[magic_len] == '0' + FORMAT_VERSION;
+  char *next_line = NULL;
+  for (char *line = strtok_r (header + magic_len + 2, "\n", &next_line); line != NULL;
+       line = strtok_r (NULL, "\n", &next_line)) {
+    if (! strncmp (line, "stride ", 7)) {
+      schema->stride = strtoul (line + 7, NULL, 10);
+    } else if (! strncmp (line, "fields ", 7)) {
+      if (parse_fields (schema, line + 7)) {
+        return 1;
+      }
+    }
+  }
+  if (schema->nbfields == 0
+      || schema->stride < SCHEMA_RECORD_HEADER_SIZE + schema->nbfields * sizeof (int)
+      || schema->stride % sizeof (int) != 0) {
+    fprintf (stderr, "bad header: %d fields in records of %zu bytes\n", schema->nbfields, schema->stride);
+    return 1;
+  }
+  schema_compile (schema);
+  *header_len = end;
+  return 0;
+}
+
+/* Write PROCS into OUTPUT as records of SCHEMA.  */
+int
+schema_write_records (const schema_t *schema, const stat_struct_t *procs, int nbprocs, FILE *output, uint32_t *crc)
+{
+  if (schema->native) {
+    *crc = crc32c (*crc, procs, nbprocs * sizeof (stat_struct_t));
+    return fwrite_unlocked (procs, sizeof (stat_struct_t), nbprocs, output) != (size_t) nbprocs;
+  }
+
+  char record[schema->stride];
+  memset (record, 0, schema->stride);
+  for (int i = 0; i < nbprocs; i++) {
+    memcpy (record, procs + i, SCHEMA_RECORD_HEADER_SIZE);
+    for (int r = 0; r < schema->nbruns; r++) {
+      const schema_run_t *run = schema->runs + r;
+      memcpy (record + run->offset, procs[i].fields + run->field, run->count * sizeof (int));
+    }
+    *crc = crc32c (*crc, record, schema->stride);
+    if (fwrite_unlocked (record, schema->stride, 1, output) != 1) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Set to 0 the fields of PROCS that SCHEMA does not record.  */
+void
+schema_clear_unrecorded (const schema_t *schema, stat_struct_t *procs, int nbprocs)
+{
+  if (schema->native) {
+    return;
+  }
+  for (int i = 0; i < nbprocs; i++) {
+    int fields[NB_FIELDS];
+    memcpy (fields, procs[i].fields, sizeof fields);
+    memset (procs[i].fields, 0, sizeof fields);
+    for (int r = 0; r < schema->nbruns; r++) {
+      const schema_run_t *run = schema->runs + r;
+      memcpy (procs[i].fields + run->field, fields + run->field, run->count * sizeof (int));
+    }
+  }
+}
+
+/* Decode the records of SCHEMA at RECORDS into PROCS.  */
+void
+schema_decode (const schema_t *schema, const char *records, int nbprocs, stat_struct_t *procs)
+{
+  const size_t stride = schema->stride;
+  const size_t header_size = schema->record_header_size;
+  const int nbruns = schema->nbruns;
+  const schema_run_t *runs = schema->runs;
+
+  if (nbprocs == 0) {
+    return;
+  }
+  if (nbruns == 1) {
+    /* The common case of a selection of consecutive fields: one copy
+       per record, of a size known for the whole snapshot.  */
+    const size_t offset = runs[0].offset;
+    int *const fields = procs[0].fields + runs[0].field;
+    const size_t size = runs[0].count * sizeof (int);
+    memset (procs, 0, nbprocs * sizeof (stat_struct_t));
+    for (int i = 0; i < nbprocs; i++) {
+      const char *record = records + i * stride;
+      memcpy (procs + i, record, header_size);
+      memcpy ((char *) fields + i * sizeof (stat_struct_t), record + offset, size);
+    }
+    return;
+  }
+
+  for (int i = 0; i < nbprocs; i++) {
+    const char *record = records + i * stride;
+    stat_struct_t *proc = procs + i;
+    proc->StartTime = 0;
+    memcpy (proc, record, header_size);
+    memset (proc->fields, 0, sizeof proc->fields);
+    for (int r = 0; r < nbruns; r++) {
+      memcpy (proc->fields + runs[r].field, record + runs[r].offset, runs[r].count * sizeof (int));
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "stat-struct.h"        /* stat_struct_t.  */
+
+#include <stddef.h>             /* size_t.  */
+#include <stdint.h>             /* uint32_t.  */
+#include <stdio.h>              /* FILE.  */
+
+/* Maximum number of memory fields in a history file.  */
+#define SCHEMA_MAX_FIELDS 64
+
+/* Maximum length of a field name, with its NUL.  */
+#define SCHEMA_NAME_SIZE 32
+
+/* Size of the pid, ppid and start time at the start of each record.  */
+#define SCHEMA_RECORD_HEADER_SIZE 12
+
+/* Size of the pid and ppid at the start of each record of format 1,
+   which had no start time.  */
+#define SCHEMA_RECORD_HEADER_SIZE_V1 8
+
+/* Names of the memory fields of stat_struct_t, in order.  */
+extern const char *const field_names[NB_FIELDS];
+
+/* Return the index of the memory field of stat_struct_t named NAME,
+   or -1 if there is none.  */
+int
+field_index (const char *name);
+
+/* Fields that are consecutive both in the records of a history file
+   and in stat_struct_t.  */
+typedef struct {
+  /* Offset of the first one in the record.  */
+  int offset;
+  /* Index of the first one in the FIELDS of stat_struct_t.  */
+  int field;
+  int count;
+} schema_run_t;
+
+/* Layout of the process records of a history file.  */
+typedef struct {
+  /* Memory fields of the records, in order.  */
+  int nbfields;
+  char names[SCHEMA_MAX_FIELDS][SCHEMA_NAME_SIZE];
+  /* Size of a record in bytes.  */
+  size_t stride;
+  /* Size of the pid, ppid and start time at its start:
+     SCHEMA_RECORD_HEADER_SIZE, or SCHEMA_RECORD_HEADER_SIZE_V1 without
+     the start time, which then reads as 0.  */
+  size_t record_header_size;
+  /* Whether the records are stat_struct_t as compiled in, so that
+     they can be used in place.  */
+  int native;
+  /* The fields known to this build, as runs to copy into
+     stat_struct_t.  The other fields of stat_struct_t are 0.  */
+  int nbruns;
+  schema_run_t runs[SCHEMA_MAX_FIELDS];
+  /* Whether each snapshot ends with a trailer holding its CRC32C
+     (since format 4, see history.c).  */
+  int checksums;
+} schema_t;
+
+/* Make SCHEMA record all the fields of stat_struct_t.  */
+void
+schema_init (schema_t *schema);
+
+/* Make SCHEMA record only the fields named in LIST, separated by
+   commas.  They are recorded in the order of stat_struct_t.
+   On success, return 0; on error, print a message and return 1.  */
+int
+schema_select (schema_t *schema, const char *list);
+
+/* Make SCHEMA record only the fields of stat_struct_t whose entry in
+   SELECTED is not 0.
+   On success, return 0; if there are none, print a message and return
+   1.  */
+int
+schema_select_mask (schema_t *schema, const char selected[NB_FIELDS]);
+
+/* Return whether the history files of A and B have the same
+   layout.  */
+int
+schema_equal (const schema_t *a, const schema_t *b);
+
+/* Return whether SCHEMA records the field of stat_struct_t of index
+   FIELD.  */
+int
+schema_has_field (const schema_t *schema, int field);
+
+/* Write the header of a history file with SCHEMA into OUTPUT.
+   Return its length, or 0 on error.  */
+size_t
+schema_write_header (const schema_t *schema, FILE *output);
+
+/* Parse the header of a history file from the LEN bytes of DATA,
+   which must hold the whole header if the file is long enough, into
+   SCHEMA, and store its length into *HEADER_LEN.
+   On success, return 0; on error, print a message and return 1.  */
+int
+schema_parse_header (schema_t *schema, const char *data, size_t len, size_t *header_len);
+
+/* Write the NBPROCS processes PROCS into OUTPUT as records of
+   SCHEMA, and update *CRC with them (see crc32c ()).
+   On success, return 0; on error, return 1.  */
+int
+schema_write_records (const schema_t *schema, const stat_struct_t *procs, int nbprocs, FILE *output, uint32_t *crc);
+
+/* Set to 0 the fields of the NBPROCS processes PROCS that SCHEMA does
+   not record, so that they read the same from memory as from the
+   history.  */
+void
+schema_clear_unrecorded (const schema_t *schema, stat_struct_t *procs, int nbprocs);
+
+/* Decode the NBPROCS records of SCHEMA at RECORDS into PROCS.  */
+void
+schema_decode (const schema_t *schema, const char *records, int nbprocs, stat_struct_t *procs);
+
+#endif /* SCHEMA_H */
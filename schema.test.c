@@ -0,0 +1,167 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as open_memstream ().  */
+#define _GNU_SOURCE
+
+#include "schema.test.h"
+
+#include "schema.h"
+#include "crc32c.h"             /* crc32c ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strcmp ().  */
+
+/* Write the header of a selection of fields, parse it back, and
+   encode and decode a process with it.  */
+static int
+test_schema_roundtrip (void)
+{
+  schema_t schema;
+  if (schema_select (&schema, "RssAnon,VmPeak,VmRSS")) {
+    return 1;
+  }
+
+  char *text = NULL;
+  size_t text_len = 0;
+  FILE *output = open_memstream (&text, &text_len);
+  size_t header_len = schema_write_header (&schema, output);
+  stat_struct_t proc;
+  memset (&proc, 0, sizeof proc);
+  proc.Pid = 42;
+  proc.PPid = 1;
+  proc.StartTime = 1234;
+  for (int i = 0; i < NB_FIELDS; i++) {
+    proc.fields[i] = 100 + i;
+  }
+  uint32_t crc = 0;
+  schema_write_records (&schema, &proc, 1, output, &crc);
+  fclose (output);
+
+  int error = 0;
+  schema_t parsed;
+  size_t parsed_len;
+  if (header_len % 4 != 0 || text_len != header_len + schema.stride
+      || schema_parse_header (&parsed, text, text_len, &parsed_len)
+      || parsed_len != header_len) {
+    fprintf (stderr, "bad header of %zu bytes: {%s}\n", header_len, text);
+    free (text);
+    return 1;
+  }
+  if (parsed.nbfields != 3 || parsed.stride != 24 || parsed.native
+      || strcmp (parsed.names[0], "VmPeak") || strcmp (parsed.names[1], "VmRSS")
+      || strcmp (parsed.names[2], "RssAnon") || parsed.nbruns != 2
+      || ! parsed.checksums || ! schema_equal (&parsed, &schema)) {
+    fprintf (stderr, "the parsed schema differs: {%s}\n", text);
+    error = 1;
+  }
+
+  if (crc != crc32c (0, text + header_len, schema.stride)) {
+    fprintf (stderr, "the CRC of the records is %08x\n", crc);
+    error = 1;
+  }
+
+  stat_struct_t decoded;
+  schema_decode (&parsed, text + header_len, 1, &decoded);
+  for (int i = 0; i < NB_FIELDS; i++) {
+    int recorded = schema_has_field (&parsed, i);
+    if (decoded.fields[i] != (recorded ? 100 + i : 0)) {
+      fprintf (stderr, "field %s decoded as %d\n", field_names[i], decoded.fields[i]);
+      error = 1;
+    }
+  }
+  if (decoded.Pid != 42 || decoded.PPid != 1 || decoded.StartTime != 1234) {
+    fprintf (stderr, "the pid, ppid or start time were not decoded\n");
+    error = 1;
+  }
+  free (text);
+  return error;
+}
+
+/* Read a header written by a build with other fields and lines, and
+   records with some padding.  */
+static int
+test_schema_other_build (void)
+{
+  static const char header[] = "# process-watcher file format 3\n"
+    "stride 28\n"
+    "compression none\n"
+    "fields VmHWM VmFoo VmRSS\n"
+    "\n\n\n\n";
+  char data[sizeof header - 1 + 28];
+  memcpy (data, header, sizeof header - 1);
+  int record[7] = { 42, 1, 1234, 10, 20, 30, -1 };
+  memcpy (data + sizeof header - 1, record, sizeof record);
+
+  schema_t schema;
+  size_t header_len;
+  if (schema_parse_header (&schema, data, sizeof data, &header_len)
+      || header_len != sizeof header - 1 || schema.nbfields != 3 || schema.stride != 28
+      || schema.checksums) {
+    fprintf (stderr, "could not parse the header of another build\n");
+    return 1;
+  }
+  stat_struct_t proc;
+  schema_decode (&schema, data + header_len, 1, &proc);
+  if (proc.Pid != 42 || proc.VmHWM != 10 || proc.VmRSS != 30 || proc.VmPeak != 0) {
+    fprintf (stderr, "bad decoding of a field unknown to this build\n");
+    return 1;
+  }
+  return 0;
+}
+
+/* Check that HEADER is rejected.  */
+static int
+test_schema_bad_header (const char *header)
+{
+  schema_t schema;
+  size_t header_len;
+  if (! schema_parse_header (&schema, header, strlen (header), &header_len)) {
+    fprintf (stderr, "bad header accepted: {%s}\n", header);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run all tests on the schema.c file.  */
+void
+test_schema (void)
+{
+  int error = 0;
+  error += test_schema_roundtrip ();
+  error += test_schema_other_build ();
+  error += test_schema_bad_header ("# process-watcher file format 9\n\n\n\n");
+  error += test_schema_bad_header ("# process-watcher file format 3\nstride 16\nfields VmRSS VmHWM\n\n");
+  error += test_schema_bad_header ("# process-watcher file format 3\nstride 16\nfields VmRSS\n");
+  error += test_schema_bad_header ("# process-watcher file format 3\nstride 16\n\n\n");
+
+  schema_t schema;
+  if (! schema_select (&schema, "VmRSS,VmFoo")) {
+    fprintf (stderr, "an unknown field was selected\n");
+    error++;
+  }
+  schema_init (&schema);
+  if (! schema.native || schema.nbruns != 1 || schema.runs[0].count != NB_FIELDS) {
+    fprintf (stderr, "the schema of all fields is not native\n");
+    error++;
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,148 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "series.h"
+
+#include "accumulate.h"         /* accumulate_max ().  */
+#include "parse-time.h"         /* format_time ().  */
+#include "schema.h"             /* field_names.  */
+#include "usage.h"              /* measure_field ().  */
+
+#include <string.h>             /* memset ().  */
+
+/*
+ * OUTPUT FORMAT
+ *
+ * Without buckets, one line per snapshot:
+ *   time,VmPeak,VmSize,...
+ * With buckets, one line per non-empty bucket, with the number of
+ * snapshots in the bucket, then the max and the (rounded) mean of each
+ * field:
+ *   time,count,max_VmPeak,...,mean_VmPeak,...
+ * Times are the snapshot or bucket start times, as YYYYMMDDhhmmss in
+ * UTC.  The cumulative counters and the identity fields, whose sums
+ * over a tree mean nothing on their own, are left out.
+ */
+
+/* Write into OUTPUT the names of the fields written, each after PREFIX
+   and a comma.  */
+static void
+series_write_names (FILE *output, const char *prefix)
+{
+  for (int i = 0; i < NB_FIELDS; i++) {
+    if (measure_field (i)) {
+      fprintf (output, ",%s%s", prefix, field_names[i]);
+    }
+  }
+}
+
+/* Write into OUTPUT the VALUES of the fields written, after a comma,
+   rounding them to the nearest integer after dividing by DIVISOR.  */
+static void
+series_write_values (FILE *output, const totals_t *values, int divisor)
+{
+  for (int i = 0; i < NB_FIELDS; i++) {
+    if (measure_field (i)) {
+      fprintf (output, ",%lld", (values->fields[i] + divisor / 2) / divisor);
+    }
+  }
+}
+
+/* Start writing into OUTPUT the series of the time window BEGIN to
+   END, downsampled into NB_BUCKETS buckets (0 for none).  */
+void
+series_start (series_t *series, FILE *output, int nb_buckets, time_t begin, time_t end)
+{
+  series->output = output;
+  series->nb_buckets = nb_buckets;
+  series->begin = begin;
+  series->end = end;
+  series->bucket = -1;
+  series->count = 0;
+
+  if (nb_buckets == 0) {
+    fprintf (output, "time");
+    series_write_names (output, "");
+  } else {
+    fprintf (output, "time,count");
+    series_write_names (output, "max_");
+    series_write_names (output, "mean_");
+  }
+  fprintf (output, "\n");
+}
+
+/* Write the current bucket if it is not empty.  */
+static void
+series_flush_bucket (series_t *series)
+{
+  if (series->count == 0) {
+    return;
+  }
+
+  /* Start time of the bucket, the inverse of the computation in
+     series_add ().  */
+  long long width = (long long) (series->end - series->begin) + 1;
+  time_t start = series->begin + (series->bucket * width + series->nb_buckets - 1) / series->nb_buckets;
+  char time_string[15];
+  format_time (start, time_string);
+
+  fprintf (series->output, "%s,%d", time_string, series->count);
+  series_write_values (series->output, &series->max, 1);
+  series_write_values (series->output, &series->sum, series->count);
+  fprintf (series->output, "\n");
+
+  series->count = 0;
+}
+
+/* Add the TOTALS of the snapshot taken at TIMESTAMP.  */
+void
+series_add (series_t *series, time_t timestamp, const totals_t *totals)
+{
+  if (series->nb_buckets == 0) {
+    char time_string[15];
+    format_time (timestamp, time_string);
+    fprintf (series->output, "%s", time_string);
+    series_write_values (series->output, totals, 1);
+    fprintf (series->output, "\n");
+    return;
+  }
+
+  long long width = (long long) (series->end - series->begin) + 1;
+  long bucket = (long) ((timestamp - series->begin) * (long long) series->nb_buckets / width);
+  if (bucket != series->bucket) {
+    series_flush_bucket (series);
+    series->bucket = bucket;
+    memset (&series->max, 0, sizeof series->max);
+    memset (&series->sum, 0, sizeof series->sum);
+  }
+
+  series->count++;
+  accumulate_max (&series->max, totals);
+  for (int i = 0; i < NB_FIELDS; i++) {
+    series->sum.fields[i] += totals->fields[i];
+  }
+}
+
+/* Write what remains of the series.  */
+void
+series_finish (series_t *series)
+{
+  if (series->nb_buckets > 0) {
+    series_flush_bucket (series);
+  }
+  fflush (series->output);
+}
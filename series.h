@@ -0,0 +1,54 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "stat-struct.h"        /* totals_t.  */
+
+#include <stdio.h>              /* FILE.  */
+#include <time.h>               /* time_t.  */
+
+/* Writer of the per-snapshot totals of a tree as CSV, optionally
+   downsampled into fixed-size time buckets.  */
+typedef struct {
+  FILE *output;
+  /* Number of buckets between BEGIN and END, 0 for one row per
+     snapshot.  */
+  int nb_buckets;
+  time_t begin;
+  time_t end;
+  /* Current bucket, -1 if none yet.  */
+  long bucket;
+  /* Number of snapshots, max and sum of the totals in the current
+     bucket.  */
+  int count;
+  totals_t max;
+  totals_t sum;
+} series_t;
+
+/* Start writing into OUTPUT the series of the time window BEGIN to
+   END, downsampled into NB_BUCKETS buckets (0 for none).  Write the
+   CSV header line.  */
+void
+series_start (series_t *series, FILE *output, int nb_buckets, time_t begin, time_t end);
+
+/* Add the TOTALS of the snapshot taken at TIMESTAMP.  Snapshots must
+   be added in time order.  */
+void
+series_add (series_t *series, time_t timestamp, const totals_t *totals);
+
+/* Write what remains of the series.  */
+void
+series_finish (series_t *series);
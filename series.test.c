@@ -0,0 +1,105 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "series.h"
+
+#include "names.h"              /* identity_field ().  */
+#include "usage.h"              /* counter_field ().  */
+
+#include <stdio.h>              /* open_memstream ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strstr ().  */
+
+/* Run one test of series_add () with buckets: add snapshots to 10
+   buckets of 10 s each, and check the lines of the output.  */
+static int
+test_series_buckets (void)
+{
+  int error = 0;
+  char *output;
+  size_t output_size;
+  FILE *stream = open_memstream (&output, &output_size);
+
+  series_t series;
+  totals_t totals;
+  memset (&totals, 0, sizeof totals);
+  series_start (&series, stream, 10, 1000, 1099);
+  totals.fields[0] = 10;
+  series_add (&series, 1000, &totals);
+  totals.fields[0] = 31;
+  series_add (&series, 1009, &totals);
+  totals.fields[0] = 5;
+  series_add (&series, 1010, &totals);
+  totals.fields[0] = 7;
+  series_add (&series, 1099, &totals);
+  series_finish (&series);
+  fclose (stream);
+
+  /* 1000 is 1970-01-01 00:16:40 UTC.  */
+  static const char *expected[] = {
+    "\n19700101001640,2,31,",
+    "\n19700101001650,1,5,",
+    "\n19700101001810,1,7,",
+  };
+  for (size_t i = 0; i < sizeof expected / sizeof expected[0]; i++) {
+    if (strstr (output, expected[i]) == NULL) {
+      fprintf (stderr, "test_series_buckets: no line starting with \"%s\" in:\n%s", expected[i] + 1, output);
+      error = 1;
+    }
+  }
+
+  /* The counters and the identity fields are left out.  */
+  if (strstr (output, "Utime") != NULL || strstr (output, "NameId") != NULL) {
+    fprintf (stderr, "test_series_buckets: counters or identities in the header:\n%s", output);
+    error = 1;
+  }
+
+  /* The mean of 10 and 31 is rounded to 21.  */
+  int nbcolumns = 0;
+  for (int i = 0; i < NB_FIELDS; i++) {
+    nbcolumns += ! counter_field (i) && ! identity_field (i);
+  }
+  char *line = strstr (output, "\n19700101001640,");
+  if (line != NULL) {
+    char *end = strchr (line + 1, '\n');
+    *end = 0;
+    char *mean = line;
+    for (int i = 0; i < 2 + nbcolumns; i++) {
+      mean = strchr (mean + 1, ',');
+    }
+    if (strncmp (mean, ",21,", 4)) {
+      fprintf (stderr, "test_series_buckets: bad mean in \"%s\"\n", line + 1);
+      error = 1;
+    }
+  }
+
+  free (output);
+  return error;
+}
+
+/* Run all tests on the series.c file.  */
+void
+test_series (void)
+{
+  int error = 0;
+
+  error += test_series_buckets ();
+
+  if (error) {
+    exit (1);
+  }
+}
@@ -0,0 +1,257 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "serve.h"
+
+#include "query.h"              /* query_get (), try_parse_proc_id ().  */
+#include "usage.h"              /* measure_field ().  */
+
+#include <sys/socket.h>         /* socket ().  */
+#include <sys/un.h>             /* struct sockaddr_un.  */
+#include <poll.h>               /* poll ().  */
+#include <unistd.h>             /* unlink ().  */
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* strcmp ().  */
+#include <errno.h>              /* errno.  */
+
+/*
+ * PROTOCOL
+ *
+ * Clients connect to the "process-watcher.sock" Unix stream socket
+ * and send requests, one per line.  Each request gets a response of
+ * exactly one line, which starts with "ok" or "error".
+ *
+ * - "fields": respond with the names of the fields whose max is
+ *   meaningful, i.e. without the counters and identity fields:
+ *   "ok VmPeak VmSize ...".
+ * - "get PID BEGIN END": same as "process-watcher get PID BEGIN END",
+ *   where PID may also be PID@STARTTIME, respond with the max values in the same order as "fields":
+ *   "ok 1037716 1029832 ...".
+ */
+
+/* Socket file name.  */
+static const char socket_filename[] = "process-watcher.sock";
+
+/* Maximum number of simultaneous clients.  */
+#define MAX_CLIENTS 64
+
+/* Maximum length of a request line.  */
+#define MAX_REQUEST_LEN 256
+
+/* A connected client and its partial request.  */
+typedef struct {
+  int fd;
+  char request[MAX_REQUEST_LEN];
+  size_t request_len;
+} client_t;
+
+/* Send the NUL-terminated RESPONSE to client FD.  */
+static void
+respond (int fd, const char *response)
+{
+  size_t len = strlen (response);
+  while (len > 0) {
+    ssize_t written = send (fd, response, len, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* The client is gone; its socket will be closed when poll
+         reports it.  */
+      return;
+    }
+    response += written;
+    len -= written;
+  }
+}
+
+/* Handle the request line REQUEST, responding to client FD.  */
+static void
+handle_request (query_t *query, int fd, char *request)
+{
+  char response[32 * (NB_FIELDS + 1)];
+  char *words[5];
+  int nbwords = 0;
+  for (char *word = strtok (request, " \t\r"); word != NULL; word = strtok (NULL, " \t\r")) {
+    if (nbwords == 5) {
+      respond (fd, "error too many arguments\n");
+      return;
+    }
+    words[nbwords++] = word;
+  }
+
+  if (nbwords == 1 && ! strcmp (words[0], "fields")) {
+    int len = snprintf (response, sizeof response, "ok");
+    for (int field = 0; field < NB_FIELDS; field++) {
+      if (measure_field (field)) {
+        len += snprintf (response + len, sizeof response - len, " %s", field_names[field]);
+      }
+    }
+    snprintf (response + len, sizeof response - len, "\n");
+    respond (fd, response);
+    return;
+  }
+
+  if (nbwords == 4 && ! strcmp (words[0], "get")) {
+    proc_id_t top;
+    time_t begin, end;
+    if (try_parse_proc_id (words[1], &top)
+        || try_parse_time (words[2], &begin)
+        || try_parse_time (words[3], &end)) {
+      respond (fd, "error bad arguments\n");
+      return;
+    }
+    if (begin > end) {
+      respond (fd, "error bad time range: the beginning is after the end\n");
+      return;
+    }
+
+    query_result_t result;
+    if (query_get (query, &top, begin, end, &result)) {
+      respond (fd, "error could not read the history\n");
+      return;
+    }
+
+    int len = snprintf (response, sizeof response, "ok");
+    for (int field = 0; field < NB_FIELDS; field++) {
+      if (measure_field (field)) {
+        len += snprintf (response + len, sizeof response - len, " %lld", result.max.fields[field]);
+      }
+    }
+    snprintf (response + len, sizeof response - len, "\n");
+    respond (fd, response);
+    return;
+  }
+
+  respond (fd, "error unknown request\n");
+}
+
+/* Read what client CLIENT has sent and handle its complete requests.
+   Return 1 if the client should be disconnected.  */
+static int
+handle_client (query_t *query, client_t *client)
+{
+  ssize_t len = read (client->fd, client->request + client->request_len, MAX_REQUEST_LEN - client->request_len);
+  if (len < 0 && errno == EINTR) {
+    return 0;
+  }
+  if (len <= 0) {
+    return 1;
+  }
+  client->request_len += len;
+
+  while (1) {
+    char *newline = memchr (client->request, '\n', client->request_len);
+    if (newline == NULL) {
+      break;
+    }
+    *newline = 0;
+    handle_request (query, client->fd, client->request);
+    size_t consumed = newline + 1 - client->request;
+    memmove (client->request, newline + 1, client->request_len - consumed);
+    client->request_len -= consumed;
+  }
+
+  if (client->request_len == MAX_REQUEST_LEN) {
+    respond (client->fd, "error request too long\n");
+    return 1;
+  }
+  return 0;
+}
+
+/* Perform the "process-watcher serve" command.  */
+void
+serve (void)
+{
+  query_t *query = query_open (NULL);
+  if (query == NULL) {
+    exit (1);
+  }
+
+  int listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    perror ("could not create a socket");
+    exit (1);
+  }
+
+  struct sockaddr_un address;
+  memset (&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  strcpy (address.sun_path, socket_filename);
+
+  /* Remove the socket of a previous server, if any.  */
+  if (unlink (socket_filename) && errno != ENOENT) {
+    fprintf (stderr, "could not remove the old %s: ", socket_filename);
+    perror ("");
+    exit (1);
+  }
+  if (bind (listen_fd, (struct sockaddr *) &address, sizeof address)) {
+    fprintf (stderr, "could not bind to %s: ", socket_filename);
+    perror ("");
+    exit (1);
+  }
+  if (listen (listen_fd, 16)) {
+    perror ("could not listen on the socket");
+    exit (1);
+  }
+
+  static client_t clients[MAX_CLIENTS];
+  int nbclients = 0;
+  struct pollfd pollfds[MAX_CLIENTS + 1];
+
+  /* Loop, one iteration per batch of events.  */
+  while (1) {
+    pollfds[0].fd = listen_fd;
+    pollfds[0].events = nbclients < MAX_CLIENTS ? POLLIN : 0;
+    for (int i = 0; i < nbclients; i++) {
+      pollfds[i + 1].fd = clients[i].fd;
+      pollfds[i + 1].events = POLLIN;
+    }
+
+    if (poll (pollfds, nbclients + 1, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror ("poll failed");
+      exit (1);
+    }
+
+    /* Serve the clients, from the last one so that removing one does
+       not move those not yet served.  */
+    for (int i = nbclients - 1; i >= 0; i--) {
+      if (pollfds[i + 1].revents == 0) {
+        continue;
+      }
+      if (handle_client (query, clients + i)) {
+        close (clients[i].fd);
+        clients[i] = clients[--nbclients];
+      }
+    }
+
+    if (pollfds[0].revents & POLLIN) {
+      int fd = accept (listen_fd, NULL, NULL);
+      if (fd < 0) {
+        perror ("could not accept a connection");
+        continue;
+      }
+      clients[nbclients].fd = fd;
+      clients[nbclients].request_len = 0;
+      nbclients++;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/* Enable GNU extensions such as fputs_unlocked ().  */
+#define _GNU_SOURCE
+
+#include "side-file.h"
+
+#include <sys/stat.h>           /* fstat ().  */
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* ftruncate ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memcmp ().  */
+
+/* Open FILENAME for writing at its end.  */
+FILE *
+side_file_create (const char *filename, const char *header, size_t record_size, int append)
+{
+  int fd = open (filename, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    fprintf (stderr, "could not open %s for writing: ", filename);
+    perror ("");
+    exit (1);
+  }
+
+  const size_t header_len = strlen (header);
+  off_t len = 0;
+  struct stat st;
+  char start[header_len];
+  if (append && ! fstat (fd, &st) && (size_t) st.st_size >= header_len
+      && pread (fd, start, header_len, 0) == (ssize_t) header_len
+      && ! memcmp (start, header, header_len)) {
+    len = header_len + (st.st_size - header_len) / record_size * record_size;
+  }
+  if (ftruncate (fd, len) || lseek (fd, len, SEEK_SET) != len) {
+    fprintf (stderr, "could not truncate %s: ", filename);
+    perror ("");
+    exit (1);
+  }
+
+  FILE *output = fdopen (fd, "w");
+  if (output == NULL) {
+    fprintf (stderr, "could not open %s for writing: ", filename);
+    perror ("");
+    exit (1);
+  }
+  if (len == 0 && (fputs_unlocked (header, output) == EOF || fflush_unlocked (output))) {
+    fprintf (stderr, "could not write the header of %s: ", filename);
+    perror ("");
+    exit (1);
+  }
+  return output;
+}
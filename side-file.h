@@ -0,0 +1,33 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef SIDE_FILE_H
+#define SIDE_FILE_H
+
+#include <stddef.h>             /* size_t.  */
+#include <stdio.h>              /* FILE.  */
+
+/* Open the file FILENAME written next to the history, made of HEADER
+   followed by records of RECORD_SIZE bytes, for writing at its end.
+   Unless APPEND, or if it does not start with HEADER, truncate it and
+   write HEADER; otherwise, keep its records, but drop the incomplete
+   one that a killed capture may have left at the end.  Exit on
+   error.  */
+FILE *
+side_file_create (const char *filename, const char *header, size_t record_size, int append);
+
+#endif /* SIDE_FILE_H */
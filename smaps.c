@@ -0,0 +1,296 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "smaps.h"
+
+#include "proc-root.h"          /* proc_path ().  */
+#include "schema.h"             /* field_names.  */
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <fcntl.h>              /* open ().  */
+#include <unistd.h>             /* read ().  */
+#include <stdlib.h>             /* qsort (), strtol ().  */
+#include <string.h>             /* strncmp ().  */
+#include <limits.h>             /* PATH_MAX.  */
+
+/*
+ * Example of /proc/PID/smaps_rollup:
+ *
+ * 55a4c5b7e000-7ffd2a1f6000 ---p 00000000 00:00 0          [rollup]
+ * Rss:              884836 kB
+ * Pss:              601823 kB
+ * Pss_Dirty:        530100 kB
+ * Pss_Anon:         530488 kB
+ * Pss_File:          71335 kB
+ * Pss_Shmem:             0 kB
+ * Shared_Clean:     281720 kB
+ * Shared_Dirty:       1004 kB
+ * Private_Clean:     72440 kB
+ * Private_Dirty:    529672 kB
+ * ...
+ *
+ * The kernel walks all the mappings of the process to generate it,
+ * which costs from microseconds to milliseconds per process, much
+ * more than /proc/PID/status.  Hence the budget.
+ */
+
+/* Names of the fields read from /proc/PID/smaps_rollup.  */
+const char *const smaps_names[SMAPS_NB_VALUES] = {
+  [SMAPS_PSS] = "Pss",
+  [SMAPS_PSS_ANON] = "Pss_Anon",
+  [SMAPS_PRIVATE_CLEAN] = "Private_Clean",
+  [SMAPS_PRIVATE_DIRTY] = "Private_Dirty",
+};
+
+/* Return whether FIELD is filled from /proc/PID/smaps_rollup.  */
+int
+smaps_field (int field)
+{
+  for (int i = 0; i < SMAPS_NB_VALUES; i++) {
+    if (! strcmp (field_names[field], smaps_names[i])) {
+      return 1;
+    }
+  }
+  return ! strcmp (field_names[field], "PssEstimated");
+}
+
+/* Parse TEXT into VALUES.  */
+int
+parse_smaps_rollup (const char *text, int values[SMAPS_NB_VALUES])
+{
+  memset (values, 0, SMAPS_NB_VALUES * sizeof (int));
+  int found_pss = 0;
+  for (const char *line = text; *line != 0; ) {
+    const char *colon = strchr (line, ':');
+    const char *end = strchr (line, '\n');
+    if (end == NULL) {
+      end = line + strlen (line);
+    }
+    if (colon != NULL && colon < end) {
+      for (int i = 0; i < SMAPS_NB_VALUES; i++) {
+        size_t name_len = strlen (smaps_names[i]);
+        if ((size_t) (colon - line) == name_len && ! strncmp (line, smaps_names[i], name_len)) {
+          values[i] = (int) strtol (colon + 1, NULL, 10);
+          found_pss |= i == SMAPS_PSS;
+        }
+      }
+    }
+    line = *end == 0 ? end : end + 1;
+  }
+  return ! found_pss;
+}
+
+/* Read /proc/PID/smaps_rollup into VALUES.  */
+int
+read_smaps_rollup (pid_t pid, int values[SMAPS_NB_VALUES])
+{
+  char filename[PATH_MAX];
+  proc_path (filename, sizeof filename, pid, "smaps_rollup");
+
+  /* As for /proc/PID/stat, a single read () gets it whole.  */
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  char text[4096];
+  ssize_t len = read (fd, text, sizeof text - 1);
+  close (fd);
+  if (len <= 0) {
+    return 1;
+  }
+  text[len] = 0;
+  return parse_smaps_rollup (text, values);
+}
+
+/* Estimate the fields of PROC from its VmRSS.  */
+void
+smaps_estimate (const stat_struct_t *proc, const smaps_reading_t *reading, int values[SMAPS_NB_VALUES])
+{
+  if (reading != NULL && reading->rss > 0) {
+    /* Assume that the process grew or shrank uniformly since it was
+       read.  */
+    for (int i = 0; i < SMAPS_NB_VALUES; i++) {
+      values[i] = (int) ((long long) reading->values[i] * proc->VmRSS / reading->rss);
+    }
+    return;
+  }
+
+  /* Never read: assume that nothing is shared, which is an upper
+     bound of Pss.  */
+  values[SMAPS_PSS] = proc->VmRSS;
+  values[SMAPS_PSS_ANON] = proc->RssAnon;
+  values[SMAPS_PRIVATE_CLEAN] = 0;
+  values[SMAPS_PRIVATE_DIRTY] = proc->RssAnon;
+}
+
+/* Initialize SMAPS.  */
+void
+smaps_init (smaps_t *smaps, long long budget_ns)
+{
+  memset (smaps, 0, sizeof *smaps);
+  smaps->budget_ns = budget_ns;
+}
+
+/* Processes in the order in which they are read, for qsort ().  */
+static const stat_struct_t *sort_procs;
+static const char *sort_priority;
+static const smaps_t *sort_smaps;
+
+/* Return the number of the sample in which process INDEX was last
+   read, 0 if never.  */
+static long long
+last_read (int index)
+{
+  int r = sort_smaps->reading_of[index];
+  return r < 0 ? 0 : sort_smaps->readings[r].sample;
+}
+
+/* Compare the processes of index A and B: the members of registered
+   trees first, then the ones read the longest ago, then by decreasing
+   VmRSS.  */
+static int
+compare_read_order (const void *a, const void *b)
+{
+  int index_a = *(const int *) a;
+  int index_b = *(const int *) b;
+  if (sort_priority[index_a] != sort_priority[index_b]) {
+    return sort_priority[index_b] - sort_priority[index_a];
+  }
+  long long read_a = last_read (index_a);
+  long long read_b = last_read (index_b);
+  if (read_a != read_b) {
+    return (read_a > read_b) - (read_a < read_b);
+  }
+  int rss_a = sort_procs[index_a].VmRSS;
+  int rss_b = sort_procs[index_b].VmRSS;
+  return (rss_a < rss_b) - (rss_a > rss_b);
+}
+
+/* Store VALUES into the fields of PROC.  */
+static void
+smaps_store (stat_struct_t *proc, const int values[SMAPS_NB_VALUES], int estimated)
+{
+  proc->Pss = values[SMAPS_PSS];
+  proc->Pss_Anon = values[SMAPS_PSS_ANON];
+  proc->Private_Clean = values[SMAPS_PRIVATE_CLEAN];
+  proc->Private_Dirty = values[SMAPS_PRIVATE_DIRTY];
+  proc->PssEstimated = estimated ? values[SMAPS_PSS] : 0;
+}
+
+/* Fill the smaps_rollup fields of the processes of SNAPSHOT.  */
+void
+smaps_sample (smaps_t *smaps, snapshot_t *snapshot, const registry_t *registry, capture_stats_t *stats)
+{
+  int nbprocs = snapshot->nbpids;
+  stat_struct_t *procs = snapshot->procs;
+  if (nbprocs > smaps->capacity) {
+    smaps->capacity = nbprocs;
+    smaps->order = xreallocarray (smaps->order, nbprocs, sizeof (int));
+    smaps->priority = xreallocarray (smaps->priority, nbprocs, 1);
+    smaps->exact = xreallocarray (smaps->exact, nbprocs, 1);
+    smaps->reading_of = xreallocarray (smaps->reading_of, nbprocs, sizeof (int));
+    smaps->members = xreallocarray (smaps->members, nbprocs, sizeof (stat_struct_t *));
+  }
+  if (nbprocs > smaps->readings_capacity) {
+    smaps->readings_capacity = nbprocs;
+    smaps->readings = xreallocarray (smaps->readings, nbprocs, sizeof (smaps_reading_t));
+    smaps->next_readings = xreallocarray (smaps->next_readings, nbprocs, sizeof (smaps_reading_t));
+  }
+  memset (smaps->exact, 0, nbprocs);
+  registry_mark_members (registry, snapshot, smaps->priority, smaps->members);
+  smaps->nbsamples++;
+
+  /* Find the last readings of the processes, both arrays being sorted
+     by pid.  */
+  int r = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    while (r < smaps->nbreadings && smaps->readings[r].pid < procs[i].Pid) {
+      r++;
+    }
+    smaps->reading_of[i] = -1;
+    if (r < smaps->nbreadings && smaps->readings[r].pid == procs[i].Pid
+        && smaps->readings[r].start_time == procs[i].StartTime) {
+      smaps->reading_of[i] = r;
+    }
+  }
+
+  /* Kernel threads have no memory, and nothing to read.  */
+  int nbcandidates = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    if (procs[i].VmRSS > 0) {
+      smaps->order[nbcandidates++] = i;
+    } else {
+      smaps->exact[i] = 1;
+    }
+  }
+  sort_procs = procs;
+  sort_priority = smaps->priority;
+  sort_smaps = smaps;
+  qsort (smaps->order, nbcandidates, sizeof (int), compare_read_order);
+
+  /* Read in that order until the budget is spent.  */
+  long long deadline = stats_now_ns () + smaps->budget_ns;
+  int values[SMAPS_NB_VALUES];
+  for (int k = 0; k < nbcandidates && stats_now_ns () < deadline; k++) {
+    stat_struct_t *proc = procs + smaps->order[k];
+    if (read_smaps_rollup (proc->Pid, values) == 0) {
+      smaps_store (proc, values, 0);
+      smaps->exact[smaps->order[k]] = 1;
+      stats->smaps_read++;
+    }
+  }
+
+  /* Estimate the others from their last readings, and keep the
+     readings of the current processes for the next sample.  */
+  int nbnext = 0;
+  for (int i = 0; i < nbprocs; i++) {
+    stat_struct_t *proc = procs + i;
+    const smaps_reading_t *reading = NULL;
+    if (smaps->reading_of[i] >= 0) {
+      reading = smaps->readings + smaps->reading_of[i];
+    }
+
+    if (smaps->exact[i]) {
+      if (proc->VmRSS == 0) {
+        memset (values, 0, sizeof values);
+        smaps_store (proc, values, 0);
+        continue;
+      }
+      smaps_reading_t *next = smaps->next_readings + nbnext++;
+      next->pid = proc->Pid;
+      next->start_time = proc->StartTime;
+      next->sample = smaps->nbsamples;
+      next->rss = proc->VmRSS;
+      next->values[SMAPS_PSS] = proc->Pss;
+      next->values[SMAPS_PSS_ANON] = proc->Pss_Anon;
+      next->values[SMAPS_PRIVATE_CLEAN] = proc->Private_Clean;
+      next->values[SMAPS_PRIVATE_DIRTY] = proc->Private_Dirty;
+    } else {
+      smaps_estimate (proc, reading, values);
+      smaps_store (proc, values, 1);
+      stats->smaps_estimated++;
+      if (reading != NULL) {
+        smaps->next_readings[nbnext++] = *reading;
+      }
+    }
+  }
+
+  smaps_reading_t *swap = smaps->readings;
+  smaps->readings = smaps->next_readings;
+  smaps->next_readings = swap;
+  smaps->nbreadings = nbnext;
+}
@@ -0,0 +1,118 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef SMAPS_H
+#define SMAPS_H
+
+#include "registry.h"           /* registry_t.  */
+#include "capture-stats.h"      /* capture_stats_t.  */
+
+#include <sys/types.h>          /* pid_t.  */
+
+/* Fields read from /proc/PID/smaps_rollup, in the order of
+   smaps_names.  */
+enum {
+  SMAPS_PSS,
+  SMAPS_PSS_ANON,
+  SMAPS_PRIVATE_CLEAN,
+  SMAPS_PRIVATE_DIRTY,
+  SMAPS_NB_VALUES
+};
+
+/* Names of the fields read from /proc/PID/smaps_rollup, which are also
+   the names of the memory fields of stat_struct_t.  */
+extern const char *const smaps_names[SMAPS_NB_VALUES];
+
+/* Return whether the memory field of stat_struct_t of index FIELD is
+   filled from /proc/PID/smaps_rollup: one of smaps_names, or
+   PssEstimated.  */
+int
+smaps_field (int field);
+
+/* Parse TEXT, the contents of /proc/PID/smaps_rollup, into VALUES, in
+   kB.  The fields not found are 0.
+   On success, return 0; if there is no Pss line, return 1.  */
+int
+parse_smaps_rollup (const char *text, int values[SMAPS_NB_VALUES]);
+
+/* Read /proc/PID/smaps_rollup into VALUES.
+   On success, return 0; if the process has disappeared, or the file
+   cannot be read (e.g. a process of another user, or a kernel older
+   than 4.14), return 1.  */
+int
+read_smaps_rollup (pid_t pid, int values[SMAPS_NB_VALUES]);
+
+/* Last exact reading of a process, from which its fields are
+   estimated until it is read again.  */
+typedef struct {
+  int pid;
+  unsigned int start_time;
+  /* Number of the sample in which it was read, from 1.  */
+  long long sample;
+  /* VmRSS when it was read.  */
+  int rss;
+  int values[SMAPS_NB_VALUES];
+} smaps_reading_t;
+
+/* State of the smaps_rollup source of a capture.  */
+typedef struct {
+  /* Time that each sample may spend reading smaps_rollup files.  */
+  long long budget_ns;
+  /* Last exact readings of the processes of the previous sample,
+     sorted by pid, and the array into which those of the current
+     sample are built.  */
+  smaps_reading_t *readings;
+  int nbreadings;
+  smaps_reading_t *next_readings;
+  int readings_capacity;
+  /* Number of samples taken.  */
+  long long nbsamples;
+  /* Work arrays with room for one entry per process.  */
+  int *order;
+  char *priority;
+  /* Index in READINGS of the last exact reading of each process, -1
+     if there is none.  */
+  int *reading_of;
+  char *exact;
+  stat_struct_t **members;
+  int capacity;
+} smaps_t;
+
+/* Initialize SMAPS to spend at most BUDGET_NS nanoseconds per
+   sample.  */
+void
+smaps_init (smaps_t *smaps, long long budget_ns);
+
+/* Fill the smaps_rollup fields of the processes of SNAPSHOT, sorted
+   by pid.  Within the budget, the members of the trees of REGISTRY
+   are read first, then the other processes.  Among each, the
+   processes never read come first, then those read the longest ago,
+   so that all are read in turn, and then the largest VmRSS first.
+   The fields of the processes left are estimated from their VmRSS, and
+   scaled from their last exact reading if there is one; their
+   PssEstimated is then their estimated Pss, and 0 otherwise.  The
+   processes read and estimated are counted in STATS.  */
+void
+smaps_sample (smaps_t *smaps, snapshot_t *snapshot, const registry_t *registry, capture_stats_t *stats);
+
+/* Estimate the smaps_rollup fields of PROC into VALUES from its
+   VmRSS, RssAnon and RssShmem, and from READING, its last exact
+   reading, unless it is NULL.  */
+void
+smaps_estimate (const stat_struct_t *proc, const smaps_reading_t *reading, int values[SMAPS_NB_VALUES]);
+
+#endif /* SMAPS_H */
@@ -0,0 +1,185 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "smaps.test.h"
+
+#include "smaps.h"              /* parse_smaps_rollup ().  */
+#include "proc-root.h"          /* proc_root.  */
+#include "test-procfs.h"        /* test_procfs_write ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <assert.h>             /* assert ().  */
+#include <unistd.h>             /* rmdir ().  */
+
+/* Parse TEXT and check the result and the values found.  */
+static int
+test_parse_smaps_rollup_args (const char *text, int expected_error, int pss, int pss_anon, int private_clean, int private_dirty)
+{
+  int values[SMAPS_NB_VALUES];
+  int error = parse_smaps_rollup (text, values);
+  if (error != expected_error) {
+    fprintf (stderr, "parse_smaps_rollup (\"%s\") returned %d instead of %d\n", text, error, expected_error);
+    return 1;
+  }
+  if (! error
+      && (values[SMAPS_PSS] != pss || values[SMAPS_PSS_ANON] != pss_anon
+          || values[SMAPS_PRIVATE_CLEAN] != private_clean || values[SMAPS_PRIVATE_DIRTY] != private_dirty)) {
+    fprintf (stderr, "parse_smaps_rollup (\"%s\") found %d %d %d %d instead of %d %d %d %d\n", text,
+             values[SMAPS_PSS], values[SMAPS_PSS_ANON], values[SMAPS_PRIVATE_CLEAN], values[SMAPS_PRIVATE_DIRTY],
+             pss, pss_anon, private_clean, private_dirty);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run the tests on parse_smaps_rollup ().  */
+static void
+test_parse_smaps_rollup (void)
+{
+  int error = 0;
+
+  error += test_parse_smaps_rollup_args
+    ("55a4c5b7e000-7ffd2a1f6000 ---p 00000000 00:00 0          [rollup]\n"
+     "Rss:              884836 kB\n"
+     "Pss:              601823 kB\n"
+     "Pss_Dirty:        530100 kB\n"
+     "Pss_Anon:         530488 kB\n"
+     "Pss_File:          71335 kB\n"
+     "Shared_Clean:     281720 kB\n"
+     "Private_Clean:     72440 kB\n"
+     "Private_Dirty:    529672 kB\n",
+     0, 601823, 530488, 72440, 529672);
+  /* Older kernels have no Pss_Anon, and no final newline.  */
+  error += test_parse_smaps_rollup_args ("Rss: 8 kB\nPss: 6 kB\nPrivate_Dirty: 4 kB", 0, 6, 0, 0, 4);
+  /* The file of a process without memory is empty.  */
+  error += test_parse_smaps_rollup_args ("", 1, 0, 0, 0, 0);
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run the tests on smaps_estimate ().  */
+static void
+test_smaps_estimate (void)
+{
+  int error = 0;
+  stat_struct_t proc;
+  memset (&proc, 0, sizeof proc);
+  proc.VmRSS = 2000;
+  proc.RssAnon = 1500;
+  int values[SMAPS_NB_VALUES];
+
+  /* Never read: an upper bound.  */
+  smaps_estimate (&proc, NULL, values);
+  if (values[SMAPS_PSS] != 2000 || values[SMAPS_PSS_ANON] != 1500
+      || values[SMAPS_PRIVATE_CLEAN] != 0 || values[SMAPS_PRIVATE_DIRTY] != 1500) {
+    fprintf (stderr, "smaps_estimate () without reading found %d %d %d %d\n",
+             values[SMAPS_PSS], values[SMAPS_PSS_ANON], values[SMAPS_PRIVATE_CLEAN], values[SMAPS_PRIVATE_DIRTY]);
+    error = 1;
+  }
+
+  /* Read when it was half as large.  */
+  smaps_reading_t reading = { .rss = 1000, .values = { 600, 400, 100, 300 } };
+  smaps_estimate (&proc, &reading, values);
+  if (values[SMAPS_PSS] != 1200 || values[SMAPS_PSS_ANON] != 800
+      || values[SMAPS_PRIVATE_CLEAN] != 200 || values[SMAPS_PRIVATE_DIRTY] != 600) {
+    fprintf (stderr, "smaps_estimate () from a reading found %d %d %d %d\n",
+             values[SMAPS_PSS], values[SMAPS_PSS_ANON], values[SMAPS_PRIVATE_CLEAN], values[SMAPS_PRIVATE_DIRTY]);
+    error = 1;
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Sample processes 42 and 43 of a fake procfs tree, where only 42 has
+   a smaps_rollup, first without budget, then with enough of it.  */
+static void
+test_smaps_sample (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  static const char rollup[] = "Rss: 1000 kB\nPss: 600 kB\nPss_Anon: 400 kB\nPrivate_Clean: 100 kB\nPrivate_Dirty: 300 kB\n";
+  test_procfs_write (root, "42", "smaps_rollup", rollup, sizeof rollup - 1);
+
+  const char *old_proc_root = proc_root;
+  proc_root = root;
+  int error = 0;
+
+  stat_struct_t procs[2];
+  memset (procs, 0, sizeof procs);
+  procs[0].Pid = 42;
+  procs[0].VmRSS = 1000;
+  procs[0].RssAnon = 500;
+  procs[1].Pid = 43;
+  procs[1].VmRSS = 200;
+  procs[1].RssAnon = 100;
+  snapshot_t snapshot = { .nbpids = 2, .procs = procs };
+  registry_t registry;
+  memset (&registry, 0, sizeof registry);
+  capture_stats_t stats;
+  memset (&stats, 0, sizeof stats);
+
+  smaps_t smaps;
+  smaps_init (&smaps, 0);
+  smaps_sample (&smaps, &snapshot, &registry, &stats);
+  if (procs[0].Pss != 1000 || procs[0].PssEstimated != 1000 || stats.smaps_estimated != 2) {
+    fprintf (stderr, "smaps_sample () without budget: Pss %d, PssEstimated %d, %lld estimated\n",
+             procs[0].Pss, procs[0].PssEstimated, stats.smaps_estimated);
+    error = 1;
+  }
+
+  smaps.budget_ns = 1000000000LL;
+  smaps_sample (&smaps, &snapshot, &registry, &stats);
+  if (procs[0].Pss != 600 || procs[0].Pss_Anon != 400 || procs[0].PssEstimated != 0
+      || procs[1].Pss != 200 || procs[1].PssEstimated != 200 || stats.smaps_read != 1) {
+    fprintf (stderr, "smaps_sample () with budget: Pss %d %d, PssEstimated %d %d, %lld read\n",
+             procs[0].Pss, procs[1].Pss, procs[0].PssEstimated, procs[1].PssEstimated, stats.smaps_read);
+    error = 1;
+  }
+
+  /* Out of budget again, 42 is scaled from its reading.  */
+  smaps.budget_ns = 0;
+  procs[0].VmRSS = 2000;
+  smaps_sample (&smaps, &snapshot, &registry, &stats);
+  if (procs[0].Pss != 1200 || procs[0].PssEstimated != 1200) {
+    fprintf (stderr, "smaps_sample () from a reading: Pss %d, PssEstimated %d\n",
+             procs[0].Pss, procs[0].PssEstimated);
+    error = 1;
+  }
+
+  proc_root = old_proc_root;
+  test_procfs_remove (root, "42", "smaps_rollup");
+  rmdir (root);
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run all tests on the smaps.c file.  */
+void
+test_smaps (void)
+{
+  test_parse_smaps_rollup ();
+  test_smaps_estimate ();
+  test_smaps_sample ();
+}
@@ -15,11 +15,67 @@ along with process-watcher.
 If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
-/* Pid, PPid and memory information about a process.  */
+#ifndef STAT_STRUCT_H
+#define STAT_STRUCT_H
+
+#include <time.h>               /* time_t.  */
+
+/* Number of memory fields, i.e. number of lines in fields.out.h.  */
+enum {
+  NB_FIELDS = 0
+#define X(field) + 1
+#include "fields.out.h"
+#undef X
+};
+
+/* Pid, PPid, start time and memory information about a process.
+   The memory fields are also reachable as the FIELDS array, so that
+   they can be processed as one fixed run of ints.  */
 typedef struct {
+  int Pid;
+  int PPid;
+  /* Low 32 bits of the start time of the process, in clock ticks
+     after boot (field 22 of /proc/PID/stat).  Together with Pid, it
+     identifies the process even if its PID is reused later.  */
+  unsigned int StartTime;
+  union {
+    struct {
 #define X(field) int field;
-X(Pid)
-X(PPid)
 #include "fields.out.h"
 #undef X
+    };
+    int fields[NB_FIELDS];
+  };
 } stat_struct_t;
+
+/* Sums and maxima of memory fields over several processes.  They are
+   64 bits wide so that summing a whole tree cannot overflow.  */
+typedef union {
+  struct {
+#define X(field) long long field;
+#include "fields.out.h"
+#undef X
+  };
+  long long fields[NB_FIELDS];
+} totals_t;
+
+/* One snapshot of all processes, as found in the history file.  */
+typedef struct {
+  /* Time at which the snapshot was taken.  */
+  time_t timestamp;
+  /* Number of processes in the snapshot.  */
+  int nbpids;
+  /* Processes, in ascending PID order.  */
+  stat_struct_t *procs;
+} snapshot_t;
+
+/* Identity of a process across snapshots: its PID and start time.  */
+typedef struct {
+  int pid;
+  /* Whether START_TIME is known.  Until then, any process with PID
+     matches.  */
+  int has_start_time;
+  unsigned int start_time;
+} proc_id_t;
+
+#endif /* STAT_STRUCT_H */
@@ -17,13 +17,18 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 
 #include "status.h"
 
+#include "proc-root.h"          /* proc_path ().  */
+
 #include <string.h>             /* strchr ().  */
 #include <stdlib.h>             /* exit ().  */
 #include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
 
 /*
  * Example fields from /proc/PID/status:
  *
+ * Name:	cc1plus
+ * ...
  * VmPeak:	 1083532 kB
  * VmSize:	 1066808 kB
  * VmLck:	       0 kB
@@ -43,6 +48,18 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
  * Note that there is a mix of TAB and SPC characters.
  */
 
+/* Skip the rest of the current line of STATUS_FILE.  */
+static void
+skip_line (FILE *status_file)
+{
+  while (1) {
+    int c = fgetc_unlocked (status_file);
+    if (c == EOF || c == '\n') {
+      return;
+    }
+  }
+}
+
 /* Process one line of /proc/PID/status, storing the value into STAT_STRUCT.
 
    STATUS_FILE is an open stream on /proc/PID/status.
@@ -51,13 +68,15 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
    into TOKEN, then call
    process_line_starting_with_token(). process_line_starting_with_token
    reads the rest of the line, extracts the value and stores it into
-   STAT_STRUCT if it corresponds to one of the watched tokens.
+   STAT_STRUCT if it corresponds to one of the watched tokens.  The
+   value of the "Name:" line is stored into NAME (NAME_SIZE bytes)
+   unless NAME is NULL.
 
    TOKEN should be the first token of a line, including any ":",
    e.g. "VmRSS:".
 */
 int
-process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t *stat_struct)
+process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t *stat_struct, char *name)
 {
   /* Replace the : in TOKEN with a NUL char.  */
   char *colon = strchr (token, ':');
@@ -69,6 +88,22 @@ process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t
 
   if (0) {
   }
+  else if (name != NULL && ! strcmp (token, "Name")) {
+    /* The name follows a TAB and may contain spaces.  */
+    int c = fgetc_unlocked (status_file);
+    if (c == '\t') {
+      c = fgetc_unlocked (status_file);
+    }
+    int len = 0;
+    while (c != EOF && c != '\n') {
+      if (len < NAME_SIZE - 1) {
+        name[len++] = c;
+      }
+      c = fgetc_unlocked (status_file);
+    }
+    name[len] = 0;
+    return 0;
+  }
 #define X(field)                                                        \
   else if (! strcmp (token, #field)) {                                  \
     int scan = fscanf (status_file, " %d", &stat_struct->field);        \
@@ -83,18 +118,14 @@ process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t
 #undef X
 
   /* Skip until after the next newline.  */
-  while (1) {
-    int c = fgetc_unlocked (status_file);
-    if (c == EOF || c == '\n') {
-      return 0;
-    }
-  }
+  skip_line (status_file);
+  return 0;
 }
 
 /* Read an open stream on file /proc/PID/status and fill the given
-   STAT_STRUCT.  */
+   STAT_STRUCT, and NAME unless it is NULL.  */
 int
-read_status_file (FILE *status_file, stat_struct_t *stat_struct)
+read_status_file (FILE *status_file, stat_struct_t *stat_struct, char *name)
 {
   while (1) {
     /* First token of the current line.  Certain tokens can be quite
@@ -111,7 +142,14 @@ read_status_file (FILE *status_file, stat_struct_t *stat_struct)
 
     assert (i == 1);
 
-    if (process_line_starting_with_token (status_file, first_token, stat_struct)) {
+    if (strlen (first_token) == sizeof first_token - 1) {
+      /* The token may have been truncated, and is in any case longer
+         than the watched ones: ignore the line.  */
+      skip_line (status_file);
+      continue;
+    }
+
+    if (process_line_starting_with_token (status_file, first_token, stat_struct, name)) {
       fprintf (stderr, "error while processing line starting with token %s\n", first_token);
       return 1;
     }
@@ -121,24 +159,18 @@ read_status_file (FILE *status_file, stat_struct_t *stat_struct)
 }
 
 /* Get the ppid and memory information from the given PID and fill the
-   given STAT_STRUCT.  */
+   given STAT_STRUCT, and its name into NAME unless it is NULL.  */
 int
-read_status_pid (pid_t pid, stat_struct_t *stat_struct)
+read_status_pid (pid_t pid, stat_struct_t *stat_struct, char *name)
 {
   /* Initialize everything in stat_struct to 0.  */
   memset (stat_struct, 0, sizeof *stat_struct);
-
-  /* A PID is normally 4 bytes (tested on my x86-64 laptop).
-   * Therefore it is 10 digits maximum.
-   * So /proc/.../status is 13+10+1 bytes maximum.
-   * Let's allocate 32 bytes.  */
-  int filename_size = 32;
-  char filename[filename_size];
-  if (snprintf (filename, filename_size - 1, "/proc/%d/status", pid) >= filename_size - 1) {
-    fprintf (stderr, "could not fit /proc/%d/status into filename buffer\n", pid);
-    exit (1);
+  if (name != NULL) {
+    name[0] = 0;
   }
-  filename[filename_size - 1] = 0;
+
+  char filename[PATH_MAX];
+  proc_path (filename, sizeof filename, pid, "status");
 
   FILE *status_file = fopen (filename, "r");
   if (status_file == NULL) {
@@ -164,7 +196,7 @@ read_status_pid (pid_t pid, stat_struct_t *stat_struct)
     return 1;
   }
 
-  if (read_status_file(status_file, stat_struct)) {
+  if (read_status_file(status_file, stat_struct, name)) {
     fprintf (stderr, "could not read status file %s\n", filename);
     return 1;
   }
@@ -20,6 +20,10 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 
 #include "stat-struct.h"        /* stat_struct_t.  */
 
+/* Size of a process name, including the final NUL character, as
+   TASK_COMM_LEN in the kernel.  Longer names are truncated.  */
+#define NAME_SIZE 16
+
 /* Process one line of /proc/PID/status, storing the value into STAT_STRUCT.
 
    STATUS_FILE is an open stream on /proc/PID/status.
@@ -28,20 +32,22 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
    into TOKEN, then call
    process_line_starting_with_token(). process_line_starting_with_token
    reads the rest of the line, extracts the value and stores it into
-   STAT_STRUCT if it corresponds to one of the watched tokens.
+   STAT_STRUCT if it corresponds to one of the watched tokens.  The
+   value of the "Name:" line is stored into NAME (NAME_SIZE bytes)
+   unless NAME is NULL.
 
    TOKEN should be the first token of a line, including any ":",
    e.g. "VmRSS:".
 */
 int
-process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t *stat_struct);
+process_line_starting_with_token (FILE *status_file, char *token, stat_struct_t *stat_struct, char *name);
 
 /* Read an open stream on file /proc/PID/status and fill the given
-   STAT_STRUCT.  */
+   STAT_STRUCT, and NAME unless it is NULL.  */
 int
-read_status_file (FILE *status_file, stat_struct_t *stat_struct);
+read_status_file (FILE *status_file, stat_struct_t *stat_struct, char *name);
 
 /* Get the ppid and memory information from the given PID and fill the
-   given STAT_STRUCT.  */
+   given STAT_STRUCT, and its name into NAME unless it is NULL.  */
 int
-read_status_pid (pid_t pid, stat_struct_t *stat_struct);
+read_status_pid (pid_t pid, stat_struct_t *stat_struct, char *name);
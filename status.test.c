@@ -16,10 +16,13 @@ If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
 #include "status.h"             /* process_line_starting_with_token ().  */
+#include "proc-root.h"          /* proc_root.  */
+#include "test-procfs.h"        /* test_procfs_write ().  */
 
 #include <stdlib.h>             /* exit ().  */
 #include <string.h>             /* memset ().  */
 #include <assert.h>             /* assert ().  */
+#include <unistd.h>             /* rmdir ().  */
 
 /* Define a test on field FIELD.  */
 #define DEFINE_test_process_line_starting_with_token_args(field)        \
@@ -36,7 +39,7 @@ test_process_line_starting_with_token_args_##field (const char *token, const cha
   strcpy (token_modifiable, token);                                     \
   strcpy (file_contents_modifiable, file_contents);                     \
   status_file = fmemopen (file_contents_modifiable, strlen (file_contents_modifiable), "r"); \
-  process_line_starting_with_token (status_file, token_modifiable, &stat_struct); \
+  process_line_starting_with_token (status_file, token_modifiable, &stat_struct, NULL); \
   actual = stat_struct.field;                                           \
   if (actual != expected) {                                             \
     fprintf (stderr, "error: process_line_starting_with_token(file=\"%s\", token=\"%s\", CAPTURE) resulted in item %s having value %d instead of %d\n", file_contents, token, #field, actual, expected); \
@@ -69,14 +72,16 @@ test_read_status_file (void)
 {
   int error = 0;
   static char *test_input =
-    ("VmRSS: \t42 kB\n"
+    ("Name:\tWeb Content\n"
+     "VmRSS: \t42 kB\n"
      "VmSize: \t24 kB\n"
      "Pid: \t16\n");
   FILE *file = fmemopen (test_input, strlen(test_input), "r");
   assert (file != NULL);
   stat_struct_t stat_struct;
   memset (&stat_struct, 0, sizeof stat_struct);
-  int result = read_status_file (file, &stat_struct);
+  char name[NAME_SIZE];
+  int result = read_status_file (file, &stat_struct, name);
   if (result != 0) {
     fprintf (stderr, "read_status_file returned %d instead of 0\n", result);
     error++;
@@ -93,15 +98,111 @@ test_read_status_file (void)
     fprintf (stderr, "Pid is %d but should be 16\n", stat_struct.Pid);
     error++;
   }
+  if (strcmp (name, "Web Content")) {
+    fprintf (stderr, "Name is \"%s\" but should be \"Web Content\"\n", name);
+    error++;
+  }
   if (error)
     exit (1);
   fclose (file);
 }
 
+/* Read the status INPUT and check the values of Pid, PPid and VmRSS,
+   and the return value.  */
+static int
+test_read_status_file_args (const char *input, int expected_result, int expected_pid, int expected_ppid, int expected_rss)
+{
+  char input_modifiable[4096];
+  strcpy (input_modifiable, input);
+  FILE *file = fmemopen (input_modifiable, strlen (input_modifiable), "r");
+  assert (file != NULL);
+  stat_struct_t stat_struct;
+  memset (&stat_struct, 0, sizeof stat_struct);
+  char name[NAME_SIZE];
+  int result = read_status_file (file, &stat_struct, name);
+  fclose (file);
+
+  if (result != expected_result) {
+    fprintf (stderr, "read_status_file (\"%s\") returned %d instead of %d\n", input, result, expected_result);
+    return 1;
+  }
+  if (result == 0
+      && (stat_struct.Pid != expected_pid || stat_struct.PPid != expected_ppid || stat_struct.VmRSS != expected_rss)) {
+    fprintf (stderr, "read_status_file (\"%s\") found Pid %d, PPid %d, VmRSS %d instead of %d, %d, %d\n",
+             input, stat_struct.Pid, stat_struct.PPid, stat_struct.VmRSS, expected_pid, expected_ppid, expected_rss);
+    return 1;
+  }
+  return 0;
+}
+
+/* Run the tests on unusual status files.  */
+static void
+test_read_status_file_edge_cases (void)
+{
+  int error = 0;
+
+  /* Spaces instead of TABs, several of them, and no unit.  */
+  error += test_read_status_file_args ("Pid:   7\nPPid:\t\t 1\nVmRSS:    42\n", 0, 7, 1, 42);
+  /* No final newline.  */
+  error += test_read_status_file_args ("Pid:\t7\nVmRSS:\t42 kB", 0, 7, 0, 42);
+  /* Kernel threads have no memory lines.  */
+  error += test_read_status_file_args ("Name:\tkworker/0:1\nPid:\t9\nPPid:\t2\nThreads:\t1\n", 0, 9, 2, 0);
+  /* Empty lines and empty values.  */
+  error += test_read_status_file_args ("Name:\n\nGroups:\t\nPid:\t7\n", 0, 7, 0, 0);
+  /* Tokens longer than the buffer are skipped with their line.  */
+  error += test_read_status_file_args ("Pid:\t7\nA_token_that_is_much_longer_than_32_characters:\t1 2 3\nVmRSS:\t42 kB\n", 0, 7, 0, 42);
+  /* An empty file, as for a process that exits while it is read.  */
+  error += test_read_status_file_args ("", 0, 0, 0, 0);
+  /* A watched field without a number.  */
+  error += test_read_status_file_args ("Pid:\t7\nVmRSS:\tkB\n", 1, 0, 0, 0);
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Read the status of processes from a fake procfs tree.  */
+static void
+test_read_status_pid (void)
+{
+  char root[] = "/tmp/process-watcher-test-XXXXXX";
+  char *made = mkdtemp (root);
+  assert (made != NULL);
+  static const char status[] = "Name:\tcc1plus\nPid:\t42\nPPid:\t1\nVmRSS:\t  1234 kB\n";
+  test_procfs_write (root, "42", "status", status, sizeof status - 1);
+
+  const char *old_proc_root = proc_root;
+  proc_root = root;
+  int error = 0;
+
+  stat_struct_t stat_struct;
+  char name[NAME_SIZE];
+  if (read_status_pid (42, &stat_struct, name) != 0
+      || stat_struct.Pid != 42 || stat_struct.VmRSS != 1234 || strcmp (name, "cc1plus")) {
+    fprintf (stderr, "could not read the status of process 42 in %s\n", root);
+    error = 1;
+  }
+
+  /* A process that has disappeared is all zeros.  */
+  if (read_status_pid (43, &stat_struct, name) != 0 || stat_struct.Pid != 0) {
+    fprintf (stderr, "the status of a vanished process is not all zeros\n");
+    error = 1;
+  }
+
+  proc_root = old_proc_root;
+  test_procfs_remove (root, "42", "status");
+  rmdir (root);
+  if (error) {
+    exit (1);
+  }
+}
+
 /* Run all tests on the status.c file.   */
 void
 test_status (void)
 {
   test_process_line_starting_with_token ();
   test_read_status_file ();
+  test_read_status_file_edge_cases ();
+  test_read_status_pid ();
 }
@@ -0,0 +1,52 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "test-procfs.h"
+
+#include <stdio.h>              /* fopen ().  */
+#include <assert.h>             /* assert ().  */
+#include <limits.h>             /* PATH_MAX.  */
+#include <sys/stat.h>           /* mkdir ().  */
+#include <unistd.h>             /* unlink (), rmdir ().  */
+
+/* Write TEXT into ROOT/DIR/NAME.  */
+void
+test_procfs_write (const char *root, const char *dir, const char *name, const char *text, size_t len)
+{
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/%s", root, dir);
+  mkdir (filename, 0755);
+  snprintf (filename, sizeof filename, "%s/%s/%s", root, dir, name);
+  FILE *file = fopen (filename, "w");
+  assert (file != NULL);
+  size_t written = fwrite (text, 1, len, file);
+  assert (written == len);
+  int closed = fclose (file);
+  assert (closed == 0);
+}
+
+/* Remove ROOT/DIR/NAME, and ROOT/DIR if it is empty.  */
+void
+test_procfs_remove (const char *root, const char *dir, const char *name)
+{
+  char filename[PATH_MAX];
+  snprintf (filename, sizeof filename, "%s/%s/%s", root, dir, name);
+  unlink (filename);
+  snprintf (filename, sizeof filename, "%s/%s", root, dir);
+  rmdir (filename);
+}
@@ -0,0 +1,40 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#ifndef TEST_PROCFS_H
+#define TEST_PROCFS_H
+
+/*
+ * Fake procfs and cgroup trees for the tests: the files are written
+ * under a temporary ROOT, e.g. ROOT/42/io for process 42, which the
+ * code under test reads through proc_root or its own path.
+ */
+
+#include <stddef.h>             /* size_t.  */
+
+/* Write the LEN bytes of TEXT into the file ROOT/DIR/NAME, creating
+   the directory ROOT/DIR if needed.  */
+void
+test_procfs_write (const char *root, const char *dir, const char *name, const char *text, size_t len);
+
+/* Remove the file ROOT/DIR/NAME, and the directory ROOT/DIR if it is
+   then empty.  */
+void
+test_procfs_remove (const char *root, const char *dir, const char *name);
+
+#endif /* TEST_PROCFS_H */
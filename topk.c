@@ -0,0 +1,86 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "topk.h"
+
+#include "xmalloc.h"            /* xmalloc ().  */
+
+#include <stdlib.h>             /* free ().  */
+
+/* Restore the min-heap property of HEAP (SIZE processes, ordered on
+   fields[FIELD]) below position I.  */
+static void
+sift_down (const stat_struct_t **heap, int size, int field, int i)
+{
+  while (1) {
+    int smallest = i;
+    int left = 2 * i + 1;
+    int right = left + 1;
+    if (left < size && heap[left]->fields[field] < heap[smallest]->fields[field]) {
+      smallest = left;
+    }
+    if (right < size && heap[right]->fields[field] < heap[smallest]->fields[field]) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    const stat_struct_t *swap = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = swap;
+    i = smallest;
+  }
+}
+
+/* Select the K processes of MEMBERS that have the largest value of the
+   memory field number FIELD.  Keep a min-heap of the best K seen so
+   far, whose root is the one to evict next: this is O(N log K).  */
+int
+topk_select (stat_struct_t *const *members, int nbmembers, int field, int k, stat_struct_t *top)
+{
+  if (k > nbmembers) {
+    k = nbmembers;
+  }
+  if (k <= 0) {
+    return 0;
+  }
+
+  const stat_struct_t **heap = xmalloc (k * sizeof *heap);
+  for (int i = 0; i < k; i++) {
+    heap[i] = members[i];
+  }
+  for (int i = k / 2 - 1; i >= 0; i--) {
+    sift_down (heap, k, field, i);
+  }
+
+  for (int i = k; i < nbmembers; i++) {
+    if (members[i]->fields[field] > heap[0]->fields[field]) {
+      heap[0] = members[i];
+      sift_down (heap, k, field, 0);
+    }
+  }
+
+  /* Pop the heap from the smallest, filling TOP from its end.  */
+  for (int size = k; size > 0; size--) {
+    top[size - 1] = *heap[0];
+    heap[0] = heap[size - 1];
+    sift_down (heap, size - 1, field, 0);
+  }
+
+  free (heap);
+  return k;
+}
@@ -0,0 +1,25 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "stat-struct.h"        /* stat_struct_t.  */
+
+/* Select the K processes of MEMBERS (NBMEMBERS pointers) that have the
+   largest value of the memory field number FIELD, i.e.
+   stat_struct_t.fields[FIELD].  Copy them into TOP in descending order
+   of that value, and return their number, at most K.  */
+int
+topk_select (stat_struct_t *const *members, int nbmembers, int field, int k, stat_struct_t *top);
@@ -0,0 +1,77 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "topk.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Select the top K of 10 processes and check their order.  */
+static int
+test_topk_select_args (int k, int expected_count)
+{
+  static const int values[] = { 5, 42, 7, 0, 42, 13, 1, 99, 8, 13 };
+  const int nbprocs = sizeof values / sizeof values[0];
+  stat_struct_t procs[nbprocs];
+  stat_struct_t *members[nbprocs];
+  memset (procs, 0, sizeof procs);
+  for (int i = 0; i < nbprocs; i++) {
+    procs[i].Pid = i + 1;
+    procs[i].fields[NB_FIELDS - 1] = values[i];
+    members[i] = procs + i;
+  }
+
+  int error = 0;
+  stat_struct_t top[nbprocs];
+  int count = topk_select (members, nbprocs, NB_FIELDS - 1, k, top);
+  if (count != expected_count) {
+    fprintf (stderr, "topk_select with k=%d returned %d processes instead of %d\n", k, count, expected_count);
+    return 1;
+  }
+
+  /* The expected values in descending order.  */
+  static const int sorted[] = { 99, 42, 42, 13, 13, 8, 7, 5, 1, 0 };
+  for (int i = 0; i < count; i++) {
+    if (top[i].fields[NB_FIELDS - 1] != sorted[i]) {
+      fprintf (stderr, "topk_select with k=%d: value %d is %d instead of %d\n", k, i, top[i].fields[NB_FIELDS - 1], sorted[i]);
+      error = 1;
+    }
+  }
+  if (count > 0 && top[0].Pid != 8) {
+    fprintf (stderr, "topk_select with k=%d: first process is %d instead of 8\n", k, top[0].Pid);
+    error = 1;
+  }
+  return error;
+}
+
+/* Run all tests on the topk.c file.  */
+void
+test_topk (void)
+{
+  int error = 0;
+
+  error += test_topk_select_args (3, 3);
+  error += test_topk_select_args (1, 1);
+  error += test_topk_select_args (10, 10);
+  error += test_topk_select_args (20, 10);
+  error += test_topk_select_args (0, 0);
+
+  if (error) {
+    exit (1);
+  }
+}
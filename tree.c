@@ -0,0 +1,154 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "tree.h"
+
+#include "accumulate.h"         /* accumulate_add ().  */
+
+#include <stdlib.h>             /* bsearch ().  */
+#include <string.h>             /* memset ().  */
+
+/* Comparator for pointers to stat_struct_t.
+   Compare according to stat_struct->Pid.
+   Returns <, ==, >0 if a is <, ==, >b.  */
+static int
+compare_stat_structs (const void *a, const void *b)
+{
+  const stat_struct_t *da = (const stat_struct_t *) a;
+  const stat_struct_t *db = (const stat_struct_t *) b;
+  return (da->Pid > db->Pid) - (da->Pid < db->Pid);
+}
+
+/* Find the process TOP_PID in SNAPSHOT.
+   Return NULL if it is not there.  */
+stat_struct_t *
+find_proc (const snapshot_t *snapshot, int top_pid)
+{
+  stat_struct_t dummy = {
+    .Pid = top_pid,
+  };
+  return (stat_struct_t *) bsearch (&dummy, snapshot->procs, snapshot->nbpids, sizeof (stat_struct_t), compare_stat_structs);
+}
+
+/* Find the process TOP in SNAPSHOT, with the same start time if it is
+   known.  Return NULL if it is not there.  */
+stat_struct_t *
+find_top_proc (const snapshot_t *snapshot, const proc_id_t *top)
+{
+  stat_struct_t *top_proc = find_proc (snapshot, top->pid);
+  if (top_proc != NULL && top->has_start_time && top_proc->StartTime != top->start_time) {
+    /* Another process that reuses the PID.  */
+    return NULL;
+  }
+  return top_proc;
+}
+
+/* If the start time of TOP is not known yet, take it from process
+   TOP->pid in SNAPSHOT, if it is there.  */
+void
+proc_id_resolve (proc_id_t *top, const snapshot_t *snapshot)
+{
+  if (top->has_start_time) {
+    return;
+  }
+  stat_struct_t *top_proc = find_proc (snapshot, top->pid);
+  if (top_proc != NULL) {
+    top->has_start_time = 1;
+    top->start_time = top_proc->StartTime;
+  }
+}
+
+/* Given SNAPSHOT, determine whether the process identified by
+   CANDIDATE_PROC is a subprocess of TOP_PROC (recursively).  */
+int
+is_proc_descendant_of_proc (stat_struct_t *candidate_proc, stat_struct_t *top_proc, const snapshot_t *snapshot)
+{
+  while (1) {
+    if (candidate_proc == top_proc) {
+      return 1;
+    }
+
+    /* Find the parent of candidate.  */
+    stat_struct_t *parent_proc = find_proc (snapshot, candidate_proc->PPid);
+    if (parent_proc == NULL) {
+      /* Could not find the parent. */
+      return 0;
+    }
+
+    if (candidate_proc == parent_proc) {
+      /* We have detected a tight loop, candidate_proc is its own
+         parent.  */
+      return 0;
+    }
+
+    if ((int) (parent_proc->StartTime - candidate_proc->StartTime) > 0) {
+      /* The parent exited and its PID was reused by a younger process
+         while the snapshot was taken.  The difference is signed so
+         that it survives the wrap-around of the start times.  */
+      return 0;
+    }
+
+    /* Now we need to know if parent_proc is a descendant of top_proc.  */
+    candidate_proc = parent_proc;
+  }
+}
+
+/* Sum into TOTALS the memory fields of the processes of SNAPSHOT that
+   belong to the tree rooted at TOP.  */
+int
+tree_totals (const snapshot_t *snapshot, const proc_id_t *top, totals_t *totals)
+{
+  return tree_members (snapshot, top, totals, NULL, NULL);
+}
+
+/* Like tree_totals (), and also store pointers to the processes of the
+   tree into MEMBERS (unless it is NULL) and their number into
+   *NBMEMBERS.  */
+int
+tree_members (const snapshot_t *snapshot, const proc_id_t *top, totals_t *totals, stat_struct_t **members, int *nbmembers)
+{
+  /* Find the top process.  */
+  stat_struct_t *top_proc = find_top_proc (snapshot, top);
+  if (top_proc == NULL) {
+    /* Cannot find the requested process.  */
+    return 0;
+  }
+
+  memset (totals, 0, sizeof *totals); /* Set each element to 0.  */
+  int count = 0;
+
+  /* Loop, iterate over all processes.  */
+  for (int procidx = 0; procidx < snapshot->nbpids; procidx++) {
+    stat_struct_t *candidate_proc = snapshot->procs + procidx;
+    if (is_proc_descendant_of_proc (candidate_proc, top_proc, snapshot)) {
+      /* Add the current process to the accumulator.  */
+      accumulate_add (totals, candidate_proc);
+      if (members != NULL) {
+        members[count++] = candidate_proc;
+      }
+    }
+  }
+
+  /* The identity fields are not quantities.  */
+  totals->NameId = 0;
+  totals->CmdHash = 0;
+
+  if (nbmembers != NULL) {
+    *nbmembers = count;
+  }
+  return 1;
+}
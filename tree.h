@@ -0,0 +1,58 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef TREE_H
+#define TREE_H
+
+#include "history.h"            /* snapshot_t.  */
+
+/* Find the process TOP_PID in SNAPSHOT.
+   Return NULL if it is not there.  */
+stat_struct_t *
+find_proc (const snapshot_t *snapshot, int top_pid);
+
+/* Find the process TOP in SNAPSHOT, with the same start time if it is
+   known.  Return NULL if it is not there.  */
+stat_struct_t *
+find_top_proc (const snapshot_t *snapshot, const proc_id_t *top);
+
+/* If the start time of TOP is not known yet, take it from process
+   TOP->pid in SNAPSHOT, if it is there.  */
+void
+proc_id_resolve (proc_id_t *top, const snapshot_t *snapshot);
+
+/* Given SNAPSHOT, determine whether the process identified by
+   CANDIDATE_PROC is a subprocess of TOP_PROC (recursively).  A parent
+   that started after its child is a reused PID, not the parent.  */
+int
+is_proc_descendant_of_proc (stat_struct_t *candidate_proc, stat_struct_t *top_proc, const snapshot_t *snapshot);
+
+/* Sum into TOTALS the memory fields of the processes of SNAPSHOT that
+   belong to the tree rooted at TOP (see find_top_proc ()), leaving 0
+   in the identity fields (see identity_field ()).
+   Return 1 if TOP is in SNAPSHOT, 0 otherwise (TOTALS is then left
+   untouched).  */
+int
+tree_totals (const snapshot_t *snapshot, const proc_id_t *top, totals_t *totals);
+
+/* Like tree_totals (), and also store pointers to the processes of the
+   tree into MEMBERS, which must have room for SNAPSHOT->nbpids
+   entries, and their number into *NBMEMBERS.  */
+int
+tree_members (const snapshot_t *snapshot, const proc_id_t *top, totals_t *totals, stat_struct_t **members, int *nbmembers);
+
+#endif /* TREE_H */
@@ -15,8 +15,30 @@ along with process-watcher.
 If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
 */
 
+#include "accumulate.test.h"             /* test_accumulate ().  */
+#include "breakdown.test.h"              /* test_breakdown ().  */
+#include "capture-stats.test.h"          /* test_capture_stats ().  */
+#include "cgroup.test.h"                 /* test_cgroup ().  */
+#include "compact.test.h"                /* test_compact ().  */
+#include "crc32c.test.h"                 /* test_crc32c ().  */
+#include "exporter.test.h"               /* test_exporter ().  */
+#include "histogram.test.h"              /* test_histogram ().  */
+#include "history.test.h"                /* test_history ().  */
+#include "index.test.h"                  /* test_index ().  */
+#include "names.test.h"                  /* test_names ().  */
+#include "proc-io.test.h"                /* test_proc_io ().  */
+#include "proc-stat.test.h"              /* test_proc_stat ().  */
+#include "query.test.h"                  /* test_query ().  */
+#include "ring.test.h"                   /* test_ring ().  */
+#include "rollup.test.h"                 /* test_rollup ().  */
+#include "schema.test.h"                 /* test_schema ().  */
+#include "series.test.h"                 /* test_series ().  */
+#include "smaps.test.h"                  /* test_smaps ().  */
 #include "status.test.h"                 /* test_status ().  */
 #include "string-has-only-digits.test.h" /* test_string_has_only_digits ().  */
+#include "topk.test.h"                   /* test_topk ().  */
+#include "usage.test.h"                  /* test_usage ().  */
+#include "window.test.h"                 /* test_window ().  */
 
 #include <stdlib.h>             /* exit ().  */
 #include <string.h>             /* memset ().  */
@@ -28,6 +50,28 @@ int
 main (void) {
   test_string_has_only_digits ();
   test_status ();
+  test_accumulate ();
+  test_series ();
+  test_topk ();
+  test_breakdown ();
+  test_index ();
+  test_proc_stat ();
+  test_proc_io ();
+  test_cgroup ();
+  test_capture_stats ();
+  test_crc32c ();
+  test_history ();
+  test_compact ();
+  test_names ();
+  test_exporter ();
+  test_schema ();
+  test_smaps ();
+  test_usage ();
+  test_histogram ();
+  test_window ();
+  test_rollup ();
+  test_query ();
+  test_ring ();
   printf ("ok\n");
   return 0;
 }
@@ -0,0 +1,133 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "usage.h"
+
+#include "names.h"              /* identity_field ().  */
+#include "schema.h"             /* field_names.  */
+
+#include <string.h>             /* strcmp ().  */
+
+/*
+ * The CPU time that a tree used between two snapshots is the increase
+ * of the sum of Utime, Stime, Cutime and Cstime over its processes.
+ * A process that exits in between leaves the sum, but its parent,
+ * when it waits for it, gains its whole CPU time in Cutime and Cstime,
+ * so that the time it used before exiting is still counted, once.
+ * The same goes for I/O: /proc/PID/io includes the I/O of the
+ * children that were waited for.  Orphans are waited for by init or a
+ * subreaper, outside of the tree; the sums may then decrease, and such
+ * intervals count as 0.
+ */
+
+/* Names of the cumulative fields.  */
+static const char *const counter_names[] = {
+  "Utime", "Stime", "Cutime", "Cstime", "IoRead", "IoWrite", "Syscr", "Syscw",
+};
+
+/* Return whether FIELD is a cumulative counter.  */
+int
+counter_field (int field)
+{
+  for (size_t i = 0; i < sizeof counter_names / sizeof counter_names[0]; i++) {
+    if (! strcmp (field_names[field], counter_names[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Return whether FIELD is a measure rather than a counter or an
+   identity field.  */
+int
+measure_field (int field)
+{
+  return ! counter_field (field) && ! identity_field (field);
+}
+
+/* Return the value of COUNTER in TOTALS.  */
+long long
+usage_counter (const totals_t *totals, int counter)
+{
+  switch (counter) {
+  case USAGE_CPU:
+    return totals->Utime + totals->Stime + totals->Cutime + totals->Cstime;
+  case USAGE_READ:
+    return totals->IoRead;
+  case USAGE_WRITE:
+    return totals->IoWrite;
+  case USAGE_SYSCR:
+    return totals->Syscr;
+  default:
+    return totals->Syscw;
+  }
+}
+
+/* Add the TOTALS of the snapshot taken at TIMESTAMP.  */
+void
+usage_add (usage_t *usage, time_t timestamp, const totals_t *totals)
+{
+  for (int counter = 0; counter < NB_USAGE_COUNTERS; counter++) {
+    long long value = usage_counter (totals, counter);
+    if (usage->count > 0 && timestamp > usage->last_time) {
+      long long used = value - usage->last[counter];
+      if (used > 0) {
+        usage->total[counter] += used;
+        double rate = (double) used / (timestamp - usage->last_time);
+        if (rate > usage->peak_rate[counter]) {
+          usage->peak_rate[counter] = rate;
+        }
+      }
+    }
+    usage->last[counter] = value;
+  }
+  if (usage->count == 0) {
+    usage->first_time = timestamp;
+  }
+  usage->count++;
+  usage->last_time = timestamp;
+}
+
+/* Print USAGE into OUTPUT.  */
+void
+usage_print (const usage_t *usage, const totals_t *max, FILE *output)
+{
+  if (usage->count < 2 || usage->last_time == usage->first_time) {
+    return;
+  }
+  double seconds = usage->total[USAGE_CPU] / 100.0;
+  fprintf (output, "CPU time:\n");
+  fprintf (output, " %20.2f  seconds\n", seconds);
+  fprintf (output, " %20.2f  average parallelism\n", seconds / (usage->last_time - usage->first_time));
+  fprintf (output, " %20.2f  peak parallelism\n", usage->peak_rate[USAGE_CPU] / 100.0);
+  if (max->VmRSS > 0) {
+    /* VmRSS is in kB.  */
+    fprintf (output, " %20.2f  seconds per GB of VmRSS peak\n", seconds / (max->VmRSS / 1048576.0));
+  }
+
+  /* Any process that ran has made system calls.  */
+  if (usage->last[USAGE_SYSCR] == 0 && usage->last[USAGE_SYSCW] == 0) {
+    return;
+  }
+  fprintf (output, "I/O:\n");
+  fprintf (output, " %20lld  bytes read\n", usage->total[USAGE_READ] * 1024);
+  fprintf (output, " %20lld  bytes written\n", usage->total[USAGE_WRITE] * 1024);
+  fprintf (output, " %20lld  read system calls\n", usage->total[USAGE_SYSCR]);
+  fprintf (output, " %20lld  write system calls\n", usage->total[USAGE_SYSCW]);
+  fprintf (output, " %20.0f  peak bytes read per second\n", usage->peak_rate[USAGE_READ] * 1024);
+  fprintf (output, " %20.0f  peak bytes written per second\n", usage->peak_rate[USAGE_WRITE] * 1024);
+}
@@ -0,0 +1,85 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef USAGE_H
+#define USAGE_H
+
+#include "stat-struct.h"        /* totals_t.  */
+
+#include <stdio.h>              /* FILE.  */
+#include <time.h>               /* time_t.  */
+
+/* Counters of the resources used by a process tree, computed from the
+   cumulative fields of its processes.  */
+enum {
+  /* Utime + Stime + Cutime + Cstime, in hundredths of seconds.  */
+  USAGE_CPU,
+  /* IoRead and IoWrite, in kB.  */
+  USAGE_READ,
+  USAGE_WRITE,
+  /* Syscr and Syscw.  */
+  USAGE_SYSCR,
+  USAGE_SYSCW,
+  NB_USAGE_COUNTERS
+};
+
+/* Resources used by a process tree over a time window, computed from
+   the totals of its cumulative fields in successive snapshots.  */
+typedef struct {
+  /* Number of snapshots added.  */
+  int count;
+  time_t first_time;
+  time_t last_time;
+  /* Counters of the tree in the last snapshot.  */
+  long long last[NB_USAGE_COUNTERS];
+  /* Increase of the counters since the first snapshot.  */
+  long long total[NB_USAGE_COUNTERS];
+  /* Highest increase per second of the counters between two
+     successive snapshots.  For USAGE_CPU, divided by 100, it is the
+     number of processors busy on average in between.  */
+  double peak_rate[NB_USAGE_COUNTERS];
+} usage_t;
+
+/* Return whether the field of stat_struct_t of index FIELD is a
+   cumulative counter (CPU time or I/O) rather than a memory field.  */
+int
+counter_field (int field);
+
+/* Return whether the field of stat_struct_t of index FIELD is a measure
+   whose max over a tree is meaningful, rather than a cumulative counter
+   or an identity field (see identity_field ()).  */
+int
+measure_field (int field);
+
+/* Return the value of COUNTER in TOTALS.  */
+long long
+usage_counter (const totals_t *totals, int counter);
+
+/* Add the TOTALS of the tree in the snapshot taken at TIMESTAMP.
+   Snapshots must be added in time order.  */
+void
+usage_add (usage_t *usage, time_t timestamp, const totals_t *totals);
+
+/* Print USAGE into OUTPUT: the CPU seconds used, the average and peak
+   parallelism, the CPU seconds per GB of the VmRSS peak of the tree,
+   from MAX, and, if the I/O of the tree was recorded, the bytes and
+   system calls of its I/O, with their peak rate.  Print nothing if
+   there were less than two snapshots.  */
+void
+usage_print (const usage_t *usage, const totals_t *max, FILE *output);
+
+#endif /* USAGE_H */
@@ -0,0 +1,103 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "usage.test.h"
+
+#include "usage.h"              /* usage_add ().  */
+#include "schema.h"             /* field_index ().  */
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Return the totals of a tree whose processes used UTIME and whose
+   exited children used CUTIME, in hundredths of seconds, and that
+   read READ kB.  */
+static totals_t
+usage_totals_of (long long utime, long long cutime, long long read)
+{
+  totals_t totals;
+  memset (&totals, 0, sizeof totals);
+  totals.Utime = utime;
+  totals.Cutime = cutime;
+  totals.IoRead = read;
+  return totals;
+}
+
+/* Follow a tree whose child exits, then loses an orphan.  */
+static void
+test_usage_add (void)
+{
+  int error = 0;
+  usage_t usage;
+  memset (&usage, 0, sizeof usage);
+
+  /* 4 s before the window are not counted.  */
+  totals_t totals = usage_totals_of (400, 0, 10);
+  usage_add (&usage, 100, &totals);
+  /* 2 processors busy for 2 s.  */
+  totals = usage_totals_of (800, 0, 20);
+  usage_add (&usage, 102, &totals);
+  /* A child that had used 300 of these exits after using 100 more,
+     and its parent used 100: 2 s in total.  The I/O of the child is
+     also added to its parent.  */
+  totals = usage_totals_of (600, 400, 60);
+  usage_add (&usage, 104, &totals);
+  /* An orphan that had used 500 exits outside the tree.  */
+  totals = usage_totals_of (100, 400, 5);
+  usage_add (&usage, 106, &totals);
+
+  if (usage.total[USAGE_CPU] != 600 || usage.peak_rate[USAGE_CPU] != 200.0
+      || usage.total[USAGE_READ] != 50 || usage.peak_rate[USAGE_READ] != 20.0
+      || usage.first_time != 100 || usage.last_time != 106) {
+    fprintf (stderr, "usage_add () found %lld cs, peak %g cs/s, %lld kB read, peak %g kB/s, from %ld to %ld\n",
+             usage.total[USAGE_CPU], usage.peak_rate[USAGE_CPU], usage.total[USAGE_READ], usage.peak_rate[USAGE_READ], (long) usage.first_time, (long) usage.last_time);
+    error = 1;
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Check which fields are measures.  */
+static void
+test_usage_measure_field (void)
+{
+  static const char *const names[] = { "VmRSS", "Pss", "Utime", "IoRead", "NameId", "CmdHash" };
+  static const int expected[] = { 1, 1, 0, 0, 0, 0 };
+  int error = 0;
+  for (size_t i = 0; i < sizeof names / sizeof names[0]; i++) {
+    int measure = measure_field (field_index (names[i]));
+    if (measure != expected[i]) {
+      fprintf (stderr, "measure_field (%s) is %d\n", names[i], measure);
+      error = 1;
+    }
+  }
+
+  if (error) {
+    exit (1);
+  }
+}
+
+/* Run all tests on the usage.c file.  */
+void
+test_usage (void)
+{
+  test_usage_add ();
+  test_usage_measure_field ();
+}
@@ -0,0 +1,175 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include "watch.h"
+
+#include "history.h"            /* history_open ().  */
+#include "tree.h"               /* tree_totals ().  */
+#include "accumulate.h"         /* accumulate_max ().  */
+#include "locks.h"              /* read_lock ().  */
+#include "parse-time.h"         /* parse_time ().  */
+#include "parse-pid.h"          /* try_parse_proc_id ().  */
+#include "schema.h"             /* field_names.  */
+#include "usage.h"              /* measure_field ().  */
+
+#include <sys/inotify.h>        /* inotify_init1 ().  */
+#include <poll.h>               /* poll ().  */
+#include <unistd.h>             /* read ().  */
+#include <stdio.h>              /* printf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+#include <errno.h>              /* errno.  */
+
+/* Longest wait for a new snapshot, in milliseconds.  The history is
+   also checked at this period, in case inotify is not available (e.g.
+   on network file systems).  */
+#define POLL_PERIOD_MS 2000
+
+/* Print the header line.  The counters and identity fields, whose
+   max means nothing, are left out.  */
+static void
+print_header (void)
+{
+  printf ("# time");
+  for (int max = 0; max < 2; max++) {
+    for (int field = 0; field < NB_FIELDS; field++) {
+      if (measure_field (field)) {
+        printf (max ? " max_%s" : " %s", field_names[field]);
+      }
+    }
+  }
+  printf ("\n");
+}
+
+/* Print one line with the tree TOTALS of the snapshot taken at
+   TIMESTAMP and the running MAX.  */
+static void
+print_sample (time_t timestamp, const totals_t *totals, const totals_t *max)
+{
+  char time_string[15];
+  format_time (timestamp, time_string);
+  printf ("%s", time_string);
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (measure_field (field)) {
+      printf (" %lld", totals->fields[field]);
+    }
+  }
+  for (int field = 0; field < NB_FIELDS; field++) {
+    if (measure_field (field)) {
+      printf (" %lld", max->fields[field]);
+    }
+  }
+  printf ("\n");
+  fflush (stdout);
+}
+
+/* Perform the "process-watcher watch" command.  */
+void
+watch (char *pid_string, char *begin_string)
+{
+  proc_id_t top;
+  if (try_parse_proc_id (pid_string, &top)) {
+    exit (1);
+  }
+
+  history_t history;
+  if (history_open (&history, history_filename)) {
+    exit (1);
+  }
+
+  int inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd >= 0 && inotify_add_watch (inotify_fd, history_filename, IN_MODIFY) < 0) {
+    close (inotify_fd);
+    inotify_fd = -1;
+  }
+
+  accumulate_init ();
+
+  totals_t max;
+  memset (&max, 0, sizeof max); /* Set each element to 0.  */
+
+  /* Index of the next snapshot to process.  It is set after the first
+     indexing.  */
+  size_t next = 0;
+  int first = 1;
+  int seen = 0;
+
+  print_header ();
+
+  /* Loop, one iteration per batch of new snapshots.  */
+  while (1) {
+    if (read_lock (history.fd)) {
+      fprintf (stderr, "could not take a read lock\n");
+      exit (1);
+    }
+    if (history_update (&history)) {
+      exit (1);
+    }
+    history_index (&history);
+
+    if (first) {
+      next = begin_string == NULL ? history.nb_locations : history_find_time (&history, parse_time (begin_string));
+      first = 0;
+    } else if (next > history.nb_locations) {
+      /* The history was rewritten: start over from its beginning.  */
+      next = 0;
+    }
+
+    for (; next < history.nb_locations; next++) {
+      snapshot_t snapshot;
+      if (history_get_snapshot (&history, next, &snapshot)) {
+        exit (1);
+      }
+
+      /* The first process found with the PID is the one watched.  */
+      proc_id_resolve (&top, &snapshot);
+      totals_t totals;
+      if (tree_totals (&snapshot, &top, &totals)) {
+        seen = 1;
+        accumulate_max (&max, &totals);
+        print_sample (snapshot.timestamp, &totals, &max);
+      } else if (seen) {
+        /* The top process has exited: the tree is gone.  */
+        unlock (history.fd);
+        history_close (&history);
+        return;
+      }
+    }
+
+    if (unlock (history.fd)) {
+      exit (1);
+    }
+
+    /* Wait for the capture to append something.  */
+    struct pollfd pollfd = {
+      .fd = inotify_fd,
+      .events = POLLIN,
+    };
+    if (inotify_fd >= 0) {
+      if (poll (&pollfd, 1, POLL_PERIOD_MS) < 0 && errno != EINTR) {
+        perror ("poll failed");
+        exit (1);
+      }
+      /* Drain the events, we only need to know there were some.  */
+      char events[4096];
+      while (read (inotify_fd, events, sizeof events) > 0) {
+      }
+    } else {
+      poll (NULL, 0, POLL_PERIOD_MS);
+    }
+  }
+}
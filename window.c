@@ -0,0 +1,133 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "window.h"
+
+#include "xmalloc.h"            /* xreallocarray ().  */
+
+#include <stdlib.h>             /* free ().  */
+#include <string.h>             /* memset ().  */
+
+/* Start the windows.  */
+void
+window_start (window_t *window, time_t begin, time_t end, int width, int step, window_fn fn, void *data)
+{
+  memset (window, 0, sizeof *window);
+  window->end = end;
+  window->width = width;
+  window->step = step;
+  window->start = begin;
+  window->fn = fn;
+  window->data = data;
+}
+
+/* Append TIMESTAMP and VALUE to DEQUE, after dropping the values that
+   can no longer be a max.  */
+static void
+deque_push (window_deque_t *deque, time_t timestamp, long long value)
+{
+  size_t mask = deque->capacity - 1;
+  while (deque->count > 0 && deque->values[(deque->head + deque->count - 1) & mask] <= value) {
+    deque->count--;
+  }
+
+  if (deque->count == deque->capacity) {
+    /* Double the ring, moving the wrapped entries after the others.  */
+    size_t capacity = deque->capacity == 0 ? 64 : 2 * deque->capacity;
+    deque->timestamps = xreallocarray (deque->timestamps, capacity, sizeof (time_t));
+    deque->values = xreallocarray (deque->values, capacity, sizeof (long long));
+    for (size_t i = 0; i < deque->head; i++) {
+      deque->timestamps[deque->capacity + i] = deque->timestamps[i];
+      deque->values[deque->capacity + i] = deque->values[i];
+    }
+    deque->capacity = capacity;
+    mask = capacity - 1;
+  }
+
+  size_t back = (deque->head + deque->count) & mask;
+  deque->timestamps[back] = timestamp;
+  deque->values[back] = value;
+  deque->count++;
+}
+
+/* Report the window that starts at WINDOW->start, if it has snapshots,
+   and move to the next one.  */
+static void
+report (window_t *window)
+{
+  totals_t max;
+  int empty = 0;
+  for (int field = 0; field < NB_FIELDS; field++) {
+    window_deque_t *deque = window->deques + field;
+    size_t mask = deque->capacity - 1;
+    while (deque->count > 0 && deque->timestamps[deque->head] < window->start) {
+      deque->head = (deque->head + 1) & mask;
+      deque->count--;
+    }
+    /* The last snapshot is in every deque: they are all empty or
+       not.  */
+    if (deque->count == 0) {
+      empty = 1;
+      break;
+    }
+    max.fields[field] = deque->values[deque->head];
+  }
+  if (! empty) {
+    window->fn (window->start, &max, window->data);
+  }
+  window->start += window->step;
+}
+
+/* Return whether the next window ends by the end of the time range.  */
+static int
+in_range (const window_t *window)
+{
+  return window->start + (window->width - 1) <= window->end;
+}
+
+/* Add the TOTALS of the snapshot taken at TIMESTAMP.  */
+void
+window_add (window_t *window, time_t timestamp, const totals_t *totals)
+{
+  while (in_range (window) && timestamp >= window->start + window->width) {
+    if (window->deques[0].count == 0) {
+      /* Skip the empty windows before TIMESTAMP at once, e.g. while
+         the capture was stopped.  */
+      window->start += ((timestamp - window->width - window->start) / window->step + 1) * window->step;
+    } else {
+      report (window);
+    }
+  }
+  for (int field = 0; field < NB_FIELDS; field++) {
+    deque_push (window->deques + field, timestamp, totals->fields[field]);
+  }
+}
+
+/* Report the remaining windows, and free WINDOW.  */
+void
+window_finish (window_t *window)
+{
+  while (in_range (window) && window->deques[0].count > 0) {
+    report (window);
+  }
+  for (int field = 0; field < NB_FIELDS; field++) {
+    free (window->deques[field].timestamps);
+    free (window->deques[field].values);
+  }
+  memset (window->deques, 0, sizeof window->deques);
+}
@@ -0,0 +1,76 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "stat-struct.h"        /* totals_t.  */
+
+#include <stddef.h>             /* size_t.  */
+#include <time.h>               /* time_t.  */
+
+/* Values of one field that may still be the max of a window: the
+   snapshots not followed by a larger or equal value, so decreasing
+   values in time order.  It is a ring buffer.  */
+typedef struct {
+  time_t *timestamps;
+  long long *values;
+  /* Index of the first entry, number of entries, and room, a power of
+     2.  */
+  size_t head;
+  size_t count;
+  size_t capacity;
+} window_deque_t;
+
+/* Function called with the START time of a window and the MAX of the
+   totals of its snapshots.  */
+typedef void (*window_fn) (time_t start, const totals_t *max, void *data);
+
+/* Sliding windows of WIDTH seconds, one every STEP seconds from BEGIN,
+   over the totals of a tree.  Each snapshot is added once, and is
+   removed at most once from the deque of each field, so that the
+   maxima of all the windows take a single pass, whatever their
+   overlap.  */
+typedef struct {
+  time_t end;
+  int width;
+  int step;
+  /* Start of the next window to report.  */
+  time_t start;
+  window_deque_t deques[NB_FIELDS];
+  window_fn fn;
+  void *data;
+} window_t;
+
+/* Start the windows of WIDTH seconds every STEP seconds that start at
+   BEGIN or later and end by END, calling FN with DATA for each one
+   that has snapshots.  */
+void
+window_start (window_t *window, time_t begin, time_t end, int width, int step, window_fn fn, void *data);
+
+/* Add the TOTALS of the snapshot taken at TIMESTAMP, after reporting
+   the windows that end before it.  Snapshots must be added in time
+   order.  */
+void
+window_add (window_t *window, time_t timestamp, const totals_t *totals);
+
+/* Report the remaining windows, and free WINDOW.  */
+void
+window_finish (window_t *window);
+
+#endif /* WINDOW_H */
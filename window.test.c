@@ -0,0 +1,97 @@
+/*
+This file is part of process-watcher.
+
+process-watcher is free software: you can redistribute it and/or
+modify it under the terms of the Apache 2.0 License as published by
+the Apache Software Foundation.
+
+process-watcher is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the License
+for more details.
+
+You should have received a copy of the Apache 2.0 License
+along with process-watcher.
+If not, see <https://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+
+#include "window.test.h"
+
+#include "window.h"
+
+#include <stdio.h>              /* fprintf ().  */
+#include <stdlib.h>             /* exit ().  */
+#include <string.h>             /* memset ().  */
+
+/* Windows reported by record_window ().  */
+struct windows {
+  int count;
+  time_t starts[16];
+  long long rss[16];
+};
+
+/* Record the window starting at START, for use with window_start ().  */
+static void
+record_window (time_t start, const totals_t *max, void *data)
+{
+  struct windows *windows = data;
+  if (windows->count < 16) {
+    windows->starts[windows->count] = start;
+    windows->rss[windows->count] = max->VmRSS;
+  }
+  windows->count++;
+}
+
+/* Check the maxima of windows of 10 s every 5 s from 100 to 139, over
+   snapshots every 2 s but for a gap from 114 to 130.  */
+void
+test_window (void)
+{
+  static const int rss[] = { 5, 9, 3, 7, 1, 2, 8, 4 };
+  static const time_t timestamps[] = { 100, 102, 104, 106, 108, 110, 112, 130 };
+  struct windows windows;
+  memset (&windows, 0, sizeof windows);
+  window_t window;
+  window_start (&window, 100, 139, 10, 5, record_window, &windows);
+  for (int i = 0; i < 8; i++) {
+    totals_t totals;
+    memset (&totals, 0, sizeof totals);
+    totals.VmRSS = rss[i];
+    window_add (&window, timestamps[i], &totals);
+  }
+  window_finish (&window);
+
+  /* [100, 110) [105, 115) [110, 120) [125, 135) [130, 140); [115, 125)
+     and [120, 130) have no snapshot, and [135, 145) ends after 139.  */
+  static const time_t starts[] = { 100, 105, 110, 125, 130 };
+  static const long long maxima[] = { 9, 8, 8, 4, 4 };
+  int error = windows.count != 5;
+  for (int i = 0; i < 5 && ! error; i++) {
+    error = windows.starts[i] != starts[i] || windows.rss[i] != maxima[i];
+  }
+  if (error) {
+    fprintf (stderr, "window_add () reported %d windows:", windows.count);
+    for (int i = 0; i < windows.count && i < 16; i++) {
+      fprintf (stderr, " %ld:%lld", (long) windows.starts[i], windows.rss[i]);
+    }
+    fprintf (stderr, "\n");
+    exit (1);
+  }
+
+  /* Many snapshots of decreasing values in one window grow the
+     deques.  */
+  memset (&windows, 0, sizeof windows);
+  window_start (&window, 0, 999, 1000, 1000, record_window, &windows);
+  for (int i = 0; i < 1000; i++) {
+    totals_t totals;
+    memset (&totals, 0, sizeof totals);
+    totals.VmRSS = 1000 - i;
+    window_add (&window, i, &totals);
+  }
+  window_finish (&window);
+  if (windows.count != 1 || windows.rss[0] != 1000) {
+    fprintf (stderr, "window_add () reported %d windows of max %lld\n", windows.count, windows.rss[0]);
+    exit (1);
+  }
+}